@@ -0,0 +1,254 @@
+/*
+ *
+ * Copyright (C) 2016-2024 ARM Limited
+ * All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+// Dispatch overhead benchmark for a factory layer.
+//
+// The benchmark is linked with the generated layer_factory.cpp and the
+// interceptors of one factory layer. It plays the loader and the next layer:
+// the dispatchable handles are fake objects which start with a dispatch key,
+// like the loader objects, and the next layer only returns. Every entry point
+// is then called through the layer and directly, and the difference is the
+// cost of the layer:
+//
+//     vlf_dispatch_bench_starter_layer [iterations] [threads]
+//
+// The demo layer prints every call, run it with stdout redirected.
+
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include "vulkan/vk_layer.h"
+
+namespace vulkan_layer_factory {
+VKAPI_ATTR VkResult VKAPI_CALL CreateInstance(const VkInstanceCreateInfo *pCreateInfo, const VkAllocationCallbacks *pAllocator,
+                                              VkInstance *pInstance);
+VKAPI_ATTR void VKAPI_CALL DestroyInstance(VkInstance instance, const VkAllocationCallbacks *pAllocator);
+VKAPI_ATTR VkResult VKAPI_CALL CreateDevice(VkPhysicalDevice gpu, const VkDeviceCreateInfo *pCreateInfo,
+                                            const VkAllocationCallbacks *pAllocator, VkDevice *pDevice);
+VKAPI_ATTR void VKAPI_CALL DestroyDevice(VkDevice device, const VkAllocationCallbacks *pAllocator);
+VKAPI_ATTR void VKAPI_CALL CmdBindPipeline(VkCommandBuffer commandBuffer, VkPipelineBindPoint pipelineBindPoint,
+                                           VkPipeline pipeline);
+VKAPI_ATTR void VKAPI_CALL CmdDraw(VkCommandBuffer commandBuffer, uint32_t vertexCount, uint32_t instanceCount,
+                                   uint32_t firstVertex, uint32_t firstInstance);
+VKAPI_ATTR void VKAPI_CALL CmdDrawIndexed(VkCommandBuffer commandBuffer, uint32_t indexCount, uint32_t instanceCount,
+                                          uint32_t firstIndex, int32_t vertexOffset, uint32_t firstInstance);
+VKAPI_ATTR VkResult VKAPI_CALL QueueSubmit(VkQueue queue, uint32_t submitCount, const VkSubmitInfo *pSubmits, VkFence fence);
+}  // namespace vulkan_layer_factory
+
+// Dispatchable objects start with the dispatch key, physical devices share the
+// key of their instance and command buffers and queues the key of their device.
+struct FakeDispatchable {
+    void *dispatch_key;
+};
+
+static int instance_key;
+static int device_key;
+static FakeDispatchable fake_instance = {&instance_key};
+static FakeDispatchable fake_physical_device = {&instance_key};
+static FakeDispatchable fake_device = {&device_key};
+static FakeDispatchable fake_queue = {&device_key};
+static FakeDispatchable fake_command_buffer = {&device_key};
+
+// The next layer
+static VKAPI_ATTR VkResult VKAPI_CALL NextCreateInstance(const VkInstanceCreateInfo *pCreateInfo,
+                                                         const VkAllocationCallbacks *pAllocator, VkInstance *pInstance) {
+    *pInstance = reinterpret_cast<VkInstance>(&fake_instance);
+    return VK_SUCCESS;
+}
+
+static VKAPI_ATTR void VKAPI_CALL NextDestroyInstance(VkInstance instance, const VkAllocationCallbacks *pAllocator) {}
+
+static VKAPI_ATTR VkResult VKAPI_CALL NextCreateDevice(VkPhysicalDevice gpu, const VkDeviceCreateInfo *pCreateInfo,
+                                                       const VkAllocationCallbacks *pAllocator, VkDevice *pDevice) {
+    *pDevice = reinterpret_cast<VkDevice>(&fake_device);
+    return VK_SUCCESS;
+}
+
+static VKAPI_ATTR void VKAPI_CALL NextDestroyDevice(VkDevice device, const VkAllocationCallbacks *pAllocator) {}
+
+static VKAPI_ATTR void VKAPI_CALL NextGetPhysicalDeviceProperties(VkPhysicalDevice physicalDevice,
+                                                                  VkPhysicalDeviceProperties *pProperties) {
+    memset(pProperties, 0, sizeof(*pProperties));
+    pProperties->apiVersion = VK_API_VERSION_1_0;
+}
+
+static VKAPI_ATTR void VKAPI_CALL NextCmdBindPipeline(VkCommandBuffer commandBuffer, VkPipelineBindPoint pipelineBindPoint,
+                                                      VkPipeline pipeline) {}
+
+static VKAPI_ATTR void VKAPI_CALL NextCmdDraw(VkCommandBuffer commandBuffer, uint32_t vertexCount, uint32_t instanceCount,
+                                              uint32_t firstVertex, uint32_t firstInstance) {}
+
+static VKAPI_ATTR void VKAPI_CALL NextCmdDrawIndexed(VkCommandBuffer commandBuffer, uint32_t indexCount, uint32_t instanceCount,
+                                                     uint32_t firstIndex, int32_t vertexOffset, uint32_t firstInstance) {}
+
+static VKAPI_ATTR VkResult VKAPI_CALL NextQueueSubmit(VkQueue queue, uint32_t submitCount, const VkSubmitInfo *pSubmits,
+                                                      VkFence fence) {
+    return VK_SUCCESS;
+}
+
+static const struct {
+    const char *name;
+    PFN_vkVoidFunction function;
+} next_functions[] = {
+    {"vkCreateInstance", reinterpret_cast<PFN_vkVoidFunction>(NextCreateInstance)},
+    {"vkDestroyInstance", reinterpret_cast<PFN_vkVoidFunction>(NextDestroyInstance)},
+    {"vkCreateDevice", reinterpret_cast<PFN_vkVoidFunction>(NextCreateDevice)},
+    {"vkDestroyDevice", reinterpret_cast<PFN_vkVoidFunction>(NextDestroyDevice)},
+    {"vkGetPhysicalDeviceProperties", reinterpret_cast<PFN_vkVoidFunction>(NextGetPhysicalDeviceProperties)},
+    {"vkCmdBindPipeline", reinterpret_cast<PFN_vkVoidFunction>(NextCmdBindPipeline)},
+    {"vkCmdDraw", reinterpret_cast<PFN_vkVoidFunction>(NextCmdDraw)},
+    {"vkCmdDrawIndexed", reinterpret_cast<PFN_vkVoidFunction>(NextCmdDrawIndexed)},
+    {"vkQueueSubmit", reinterpret_cast<PFN_vkVoidFunction>(NextQueueSubmit)},
+};
+
+static PFN_vkVoidFunction GetNextFunction(const char *name) {
+    for (const auto &next : next_functions) {
+        if (strcmp(next.name, name) == 0) {
+            return next.function;
+        }
+    }
+    return nullptr;
+}
+
+static VKAPI_ATTR PFN_vkVoidFunction VKAPI_CALL NextGetInstanceProcAddr(VkInstance instance, const char *pName) {
+    return GetNextFunction(pName);
+}
+
+static VKAPI_ATTR PFN_vkVoidFunction VKAPI_CALL NextGetDeviceProcAddr(VkDevice device, const char *pName) {
+    return GetNextFunction(pName);
+}
+
+// Entry points called by the benchmark, once through the layer and once directly
+struct EntryPoints {
+    PFN_vkCmdBindPipeline CmdBindPipeline;
+    PFN_vkCmdDraw CmdDraw;
+    PFN_vkCmdDrawIndexed CmdDrawIndexed;
+    PFN_vkQueueSubmit QueueSubmit;
+};
+
+static const EntryPoints layer_entry_points = {vulkan_layer_factory::CmdBindPipeline, vulkan_layer_factory::CmdDraw,
+                                               vulkan_layer_factory::CmdDrawIndexed, vulkan_layer_factory::QueueSubmit};
+static const EntryPoints next_entry_points = {NextCmdBindPipeline, NextCmdDraw, NextCmdDrawIndexed, NextQueueSubmit};
+
+// Returns the time per call in nanoseconds.
+static double Run(const EntryPoints &entry_points, uint32_t entry_point, uint64_t iterations) {
+    // Keep the compiler from calling the next layer directly
+    const EntryPoints *volatile pEntryPoints = &entry_points;
+    VkCommandBuffer command_buffer = reinterpret_cast<VkCommandBuffer>(&fake_command_buffer);
+    VkQueue queue = reinterpret_cast<VkQueue>(&fake_queue);
+
+    auto start = std::chrono::steady_clock::now();
+    for (uint64_t i = 0; i < iterations; i++) {
+        switch (entry_point) {
+            case 0:
+                pEntryPoints->CmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, VK_NULL_HANDLE);
+                break;
+            case 1:
+                pEntryPoints->CmdDraw(command_buffer, 3, 1, 0, 0);
+                break;
+            case 2:
+                pEntryPoints->CmdDrawIndexed(command_buffer, 3, 1, 0, 0, 0);
+                break;
+            default:
+                pEntryPoints->QueueSubmit(queue, 0, nullptr, VK_NULL_HANDLE);
+                break;
+        }
+    }
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / (double)iterations;
+}
+
+// Runs the entry point on thread_count threads at the same time and returns
+// the average time per call.
+static double RunThreads(const EntryPoints &entry_points, uint32_t entry_point, uint64_t iterations, uint32_t thread_count) {
+    std::vector<double> results(thread_count, 0.0);
+    std::vector<std::thread> threads;
+    for (uint32_t i = 0; i < thread_count; i++) {
+        threads.emplace_back([&, i] { results[i] = Run(entry_points, entry_point, iterations); });
+    }
+    double total = 0.0;
+    for (uint32_t i = 0; i < thread_count; i++) {
+        threads[i].join();
+        total += results[i];
+    }
+    return total / thread_count;
+}
+
+int main(int argc, char **argv) {
+    uint64_t iterations = (argc > 1) ? strtoull(argv[1], nullptr, 10) : 10000000;
+    uint32_t thread_count = (argc > 2) ? (uint32_t)strtoul(argv[2], nullptr, 10) : 1;
+    if (iterations == 0 || thread_count == 0) {
+        fprintf(stderr, "Usage: %s [iterations] [threads]\n", argv[0]);
+        return 1;
+    }
+
+    VkLayerInstanceLink instance_link = {};
+    instance_link.pfnNextGetInstanceProcAddr = NextGetInstanceProcAddr;
+    VkLayerInstanceCreateInfo instance_chain_info = {};
+    instance_chain_info.sType = VK_STRUCTURE_TYPE_LOADER_INSTANCE_CREATE_INFO;
+    instance_chain_info.function = VK_LAYER_LINK_INFO;
+    instance_chain_info.u.pLayerInfo = &instance_link;
+    VkApplicationInfo application_info = {};
+    application_info.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
+    application_info.pApplicationName = "vlf_dispatch_bench";
+    application_info.apiVersion = VK_API_VERSION_1_0;
+    VkInstanceCreateInfo instance_create_info = {};
+    instance_create_info.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
+    instance_create_info.pNext = &instance_chain_info;
+    instance_create_info.pApplicationInfo = &application_info;
+    VkInstance instance = VK_NULL_HANDLE;
+    if (vulkan_layer_factory::CreateInstance(&instance_create_info, nullptr, &instance) != VK_SUCCESS) {
+        fprintf(stderr, "The layer failed to create the instance.\n");
+        return 1;
+    }
+
+    VkLayerDeviceLink device_link = {};
+    device_link.pfnNextGetInstanceProcAddr = NextGetInstanceProcAddr;
+    device_link.pfnNextGetDeviceProcAddr = NextGetDeviceProcAddr;
+    VkLayerDeviceCreateInfo device_chain_info = {};
+    device_chain_info.sType = VK_STRUCTURE_TYPE_LOADER_DEVICE_CREATE_INFO;
+    device_chain_info.function = VK_LAYER_LINK_INFO;
+    device_chain_info.u.pLayerInfo = &device_link;
+    VkDeviceCreateInfo device_create_info = {};
+    device_create_info.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+    device_create_info.pNext = &device_chain_info;
+    VkDevice device = VK_NULL_HANDLE;
+    if (vulkan_layer_factory::CreateDevice(reinterpret_cast<VkPhysicalDevice>(&fake_physical_device), &device_create_info,
+                                           nullptr, &device) != VK_SUCCESS) {
+        fprintf(stderr, "The layer failed to create the device.\n");
+        return 1;
+    }
+
+    static const char *entry_point_names[] = {"vkCmdBindPipeline", "vkCmdDraw", "vkCmdDrawIndexed", "vkQueueSubmit"};
+    fprintf(stderr, "%" PRIu64 " calls per entry point on %u thread(s)\n", iterations, thread_count);
+    for (uint32_t i = 0; i < sizeof(entry_point_names) / sizeof(entry_point_names[0]); i++) {
+        double next = RunThreads(next_entry_points, i, iterations, thread_count);
+        double layer = RunThreads(layer_entry_points, i, iterations, thread_count);
+        fprintf(stderr, "%-18s %8.1f ns/call, %8.1f ns/call in the layer\n", entry_point_names[i], layer, layer - next);
+    }
+
+    vulkan_layer_factory::DestroyDevice(device, nullptr);
+    vulkan_layer_factory::DestroyInstance(instance, nullptr);
+    return 0;
+}
@@ -447,7 +447,31 @@ class ApiDumpSettings {
         }
     }
 
+    // The options of settings, with the output written to stream instead. vktracedump formats
+    // the parameters of packets on worker threads into per-packet buffers with it.
+    ApiDumpSettings(const ApiDumpSettings &settings, std::ostream &stream)
+        : use_cout(false),
+          output_dir(settings.output_dir),
+          output_format(settings.output_format),
+          show_params(settings.show_params),
+          show_address(settings.show_address),
+          should_flush(false),
+          show_timestamp(settings.show_timestamp),
+          show_type(settings.show_type),
+          indent_size(settings.indent_size),
+          name_size(settings.name_size),
+          type_size(settings.type_size),
+          use_spaces(settings.use_spaces),
+          show_shader(settings.show_shader),
+          show_thread_and_frame(settings.show_thread_and_frame),
+          use_conditional_output(settings.use_conditional_output),
+          condFrameOutput(settings.condFrameOutput),
+          redirect_stream(&stream) {}
+
     ~ApiDumpSettings() {
+        if (redirect_stream != nullptr) {
+            return;
+        }
         if (output_format == ApiDumpFormat::Html) {
             // Close off html
             stream() << "</div></body></html>";
@@ -555,7 +579,12 @@ class ApiDumpSettings {
 
     inline bool showThreadAndFrame() const { return show_thread_and_frame; }
 
-    inline std::ostream &stream() const { return use_cout ? std::cout : *(std::ofstream *)&output_stream; }
+    inline std::ostream &stream() const {
+        if (redirect_stream != nullptr) return *redirect_stream;
+        return use_cout ? std::cout : *(std::ofstream *)&output_stream;
+    }
+
+    inline bool isRedirected() const { return redirect_stream != nullptr; }
 
     inline std::string directory() const { return output_dir; }
 
@@ -674,6 +703,7 @@ class ApiDumpSettings {
 
     bool use_conditional_output = false;
     ConditionalFrameOutput condFrameOutput;
+    std::ostream *redirect_stream = nullptr;
 
     static const char *const SPACES;
     static const int MAX_SPACES = 144;
@@ -693,8 +723,11 @@ class ApiDumpInstance {
         program_start = std::chrono::system_clock::now();
     }
 
+    // Takes ownership of settings.
+    inline explicit ApiDumpInstance(ApiDumpSettings *settings) : ApiDumpInstance() { dump_settings = settings; }
+
     inline ~ApiDumpInstance() {
-        if (dump_settings && !first_func_call_on_frame) settings().closeFrameOutput();
+        if (dump_settings && !first_func_call_on_frame && !dump_settings->isRedirected()) settings().closeFrameOutput();
 
         if (dump_settings != NULL) delete dump_settings;
     }
@@ -40,6 +40,7 @@
 
 #include <assert.h>
 #include <stdarg.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <cinttypes>
@@ -53,6 +54,15 @@
 #include <mutex>
 #include <sstream>
 
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 #include <json/json.h>  // https://github.com/open-source-parsers/jsoncpp
 
 #include "vulkan/vk_layer.h"
@@ -75,6 +85,7 @@ struct StringSetting {
 };
 
 struct StringSetting inputFilename;
+struct StringSetting cacheDir;
 
 #if defined(__ANDROID__)
 #include <android/log.h>
@@ -229,7 +240,7 @@ namespace {
 // layersvt/{linux,windows}/VkLayer_device_simulation*.json
 
 const uint32_t kVersionDevsimMajor = 1;
-const uint32_t kVersionDevsimMinor = 3;
+const uint32_t kVersionDevsimMinor = 4;
 const uint32_t kVersionDevsimPatch = 0;
 const uint32_t kVersionDevsimImplementation = VK_MAKE_VERSION(kVersionDevsimMajor, kVersionDevsimMinor, kVersionDevsimPatch);
 
@@ -448,11 +459,13 @@ const char *const kEnvarDevsimFilename = "debug.vulkan.devsim.filepath";
 const char *const kEnvarDevsimDebugEnable = "debug.vulkan.devsim.debugenable";  // a non-zero integer will enable debugging output.
 const char *const kEnvarDevsimExitOnError = "debug.vulkan.devsim.exitonerror";  // a non-zero integer will enable exit-on-error.
 const char *const kEnvarDevsimCompatMode = "debug.vulkan.devsim.compatmode";    // a non-zero integer will enable compatible mode.
+const char *const kEnvarDevsimCacheDir = "debug.vulkan.devsim.cachedir";        // directory of the binary configuration cache.
 #else
 const char *const kEnvarDevsimFilename = "VK_DEVSIM_FILENAME";          // path of the configuration file(s) to load.
 const char *const kEnvarDevsimDebugEnable = "VK_DEVSIM_DEBUG_ENABLE";   // a non-zero integer will enable debugging output.
 const char *const kEnvarDevsimExitOnError = "VK_DEVSIM_EXIT_ON_ERROR";  // a non-zero integer will enable exit-on-error.
 const char *const kEnvarDevsimCompatMode = "VK_DEVSIM_COMPAT_MODE";     // a non-zero integer will enable compatible mode.
+const char *const kEnvarDevsimCacheDir = "VK_DEVSIM_CACHE_DIR";         // directory of the binary configuration cache.
 #endif
 
 const char *const kLayerSettingsDevsimFilename =
@@ -461,6 +474,8 @@ const char *const kLayerSettingsDevsimDebugEnable =
     "lunarg_device_simulation.debug_enable";  // vk_layer_settings.txt equivalent for kEnvarDevsimDebugEnable
 const char *const kLayerSettingsDevsimExitOnError =
     "lunarg_device_simulation.exit_on_error";  // vk_layer_settings.txt equivalent for kEnvarDevsimExitOnError
+const char *const kLayerSettingsDevsimCacheDir =
+    "lunarg_device_simulation.cache_dir";  // vk_layer_settings.txt equivalent for kEnvarDevsimCacheDir
 
 // Get all elements from a vkEnumerate*() lambda into a std::vector.
 template <typename T>
@@ -890,7 +905,8 @@ bool JsonLoader::LoadFiles() {
     return LoadFiles(filename_list);
 }
 
-bool JsonLoader::LoadFiles(const char *filename_list) {
+// Split a delimited list of configuration file names, skipping empty entries.
+std::vector<std::string> SplitFilenameList(const char *filename_list) {
 #if defined(_WIN32)
     const char delimiter = ';';
 #else
@@ -898,12 +914,20 @@ bool JsonLoader::LoadFiles(const char *filename_list) {
 #endif
     std::stringstream ss_list(filename_list);
     std::string filename;
+    std::vector<std::string> filenames;
 
     while (std::getline(ss_list, filename, delimiter)) {
         if (!filename.empty()) {
-            if (!LoadFile(filename.c_str())) {
-                return false;
-            }
+            filenames.push_back(filename);
+        }
+    }
+    return filenames;
+}
+
+bool JsonLoader::LoadFiles(const char *filename_list) {
+    for (const auto &filename : SplitFilenameList(filename_list)) {
+        if (!LoadFile(filename.c_str())) {
+            return false;
         }
     }
     return true;
@@ -1298,6 +1322,334 @@ void JsonLoader::GetValue(const Json::Value &parent, int index, VkExtensionPrope
 #undef GET_VALUE
 #undef GET_ARRAY
 
+// Binary cache of loaded configuration files ////////////////////////////////////////////////////////////////////////////////////
+
+// Parsing large configuration files is a noticeable part of every vkCreateInstance(), which adds up in test suites creating
+// many short-lived instances.  When a cache directory is set, the PDD values resulting from loading the configuration files
+// are saved to a binary file, and later instances map that file instead of parsing JSON.
+// Configuration files only override the values of the actual device, so the cache key hashes the contents of the files
+// together with the actual device's values and the layout of the cached structures.
+
+class ProfileCache {
+   public:
+    ProfileCache(PhysicalDeviceData &pdd) : pdd_(pdd) {}
+    ProfileCache() = delete;
+    ProfileCache(const ProfileCache &) = delete;
+    ProfileCache &operator=(const ProfileCache &) = delete;
+
+    // Compute the cache key from the configuration files and the PDD's current values.
+    // Return false if caching is disabled or a configuration file can't be read.
+    bool Init();
+    // Replace the PDD's values with those of the cache file.  Return false if there is no valid cache file.
+    bool Load();
+    // Save the PDD's values once the configuration files are loaded.
+    void Store() const;
+
+   private:
+    // Increment when the file layout changes.
+    static const uint32_t kCacheVersion = 1;
+
+    struct Header {
+        char magic[8];
+        uint32_t version;
+        uint32_t size;  // of the whole file
+        uint64_t key;
+    };
+
+    // Bounds-checked reads from the mapped file.
+    struct Reader {
+        const uint8_t *pos;
+        const uint8_t *end;
+
+        template <typename T>
+        bool Get(T *dest) {
+            if (static_cast<size_t>(end - pos) < sizeof(T)) {
+                return false;
+            }
+            memcpy(dest, pos, sizeof(T));
+            pos += sizeof(T);
+            return true;
+        }
+    };
+
+    template <typename T>
+    static void Put(std::vector<uint8_t> *dest, const T &value) {
+        const uint8_t *bytes = reinterpret_cast<const uint8_t *>(&value);
+        dest->insert(dest->end(), bytes, bytes + sizeof(T));
+    }
+
+    // 64-bit FNV-1a.
+    static uint64_t Hash(uint64_t hash, const void *data, size_t size) {
+        const uint8_t *bytes = static_cast<const uint8_t *>(data);
+        for (size_t i = 0; i < size; ++i) {
+            hash = (hash ^ bytes[i]) * 0x100000001b3ULL;
+        }
+        return hash;
+    }
+
+    static bool MapFile(const std::string &path, std::function<bool(const uint8_t *, size_t)> func);
+    bool Parse(const uint8_t *data, size_t size);
+
+    PhysicalDeviceData &pdd_;
+    std::string path_;
+    uint64_t key_ = 0;
+};
+
+const char kCacheMagic[8] = {'D', 'E', 'V', 'S', 'I', 'M', 'C', '\0'};
+
+bool ProfileCache::Init() {
+    if (cacheDir.str.empty() || inputFilename.str.empty()) {
+        return false;
+    }
+
+    const uint32_t layout[] = {kCacheVersion,
+                               kVersionDevsimImplementation,
+                               VK_HEADER_VERSION,
+                               sizeof(VkPhysicalDeviceProperties),
+                               sizeof(VkPhysicalDeviceFeatures),
+                               sizeof(VkPhysicalDeviceMemoryProperties),
+                               sizeof(ExtendedFeature),
+                               sizeof(ExtendedProperty)};
+    uint64_t key = Hash(0xcbf29ce484222325ULL, layout, sizeof(layout));
+    for (const auto &filename : SplitFilenameList(inputFilename.str.c_str())) {
+        std::ifstream file(filename, std::ios::binary);
+        if (!file) {
+            return false;  // JsonLoader reports the error.
+        }
+        std::stringstream contents;
+        contents << file.rdbuf();
+        const std::string bytes = contents.str();
+        const uint64_t size = bytes.size();
+        key = Hash(key, &size, sizeof(size));
+        key = Hash(key, bytes.data(), bytes.size());
+    }
+    key = Hash(key, &pdd_.physical_device_properties_, sizeof(pdd_.physical_device_properties_));
+    key = Hash(key, &pdd_.physical_device_features_, sizeof(pdd_.physical_device_features_));
+    key = Hash(key, &pdd_.physical_device_memory_properties_, sizeof(pdd_.physical_device_memory_properties_));
+
+    char name[32];
+    snprintf(name, sizeof(name), "devsim_%016" PRIx64 ".bin", key);
+    key_ = key;
+    path_ = cacheDir.str + "/" + name;
+    return true;
+}
+
+bool ProfileCache::MapFile(const std::string &path, std::function<bool(const uint8_t *, size_t)> func) {
+    bool result = false;
+#if defined(_WIN32)
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    LARGE_INTEGER size = {};
+    HANDLE mapping = nullptr;
+    if (GetFileSizeEx(file, &size) && size.QuadPart >= static_cast<LONGLONG>(sizeof(Header))) {
+        mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    }
+    if (mapping) {
+        const void *view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        if (view) {
+            result = func(static_cast<const uint8_t *>(view), static_cast<size_t>(size.QuadPart));
+            UnmapViewOfFile(view);
+        }
+        CloseHandle(mapping);
+    }
+    CloseHandle(file);
+#else
+    const int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st = {};
+    if (fstat(fd, &st) == 0 && st.st_size >= static_cast<off_t>(sizeof(Header))) {
+        void *view = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (view != MAP_FAILED) {
+            result = func(static_cast<const uint8_t *>(view), st.st_size);
+            munmap(view, st.st_size);
+        }
+    }
+    close(fd);
+#endif
+    return result;
+}
+
+bool ProfileCache::Load() {
+    const bool result = MapFile(path_, [this](const uint8_t *data, size_t size) { return Parse(data, size); });
+    DebugPrintf("ProfileCache::Load(\"%s\") %s\n", path_.c_str(), result ? "hit" : "miss");
+    return result;
+}
+
+bool ProfileCache::Parse(const uint8_t *data, size_t size) {
+    Reader reader = {data, data + size};
+    Header header;
+    if (!reader.Get(&header) || memcmp(header.magic, kCacheMagic, sizeof(kCacheMagic)) != 0 ||
+        header.version != kCacheVersion || header.size != size || header.key != key_) {
+        return false;
+    }
+
+    // Read everything before touching the PDD, so a truncated file leaves it as it was.
+    VkPhysicalDeviceProperties physical_device_properties;
+    VkPhysicalDeviceFeatures physical_device_features;
+    VkPhysicalDeviceMemoryProperties physical_device_memory_properties;
+    if (!reader.Get(&physical_device_properties) || !reader.Get(&physical_device_features) ||
+        !reader.Get(&physical_device_memory_properties)) {
+        return false;
+    }
+
+    uint32_t count = 0;
+    ArrayOfVkQueueFamilyProperties queue_family_properties;
+    if (!reader.Get(&count)) {
+        return false;
+    }
+    queue_family_properties.resize(count);
+    for (auto &properties : queue_family_properties) {
+        if (!reader.Get(&properties)) {
+            return false;
+        }
+    }
+
+    ArrayOfVkFormatProperties format_properties;
+    if (!reader.Get(&count)) {
+        return false;
+    }
+    for (uint32_t i = 0; i < count; ++i) {
+        uint32_t format = 0;
+        VkFormatProperties properties;
+        if (!reader.Get(&format) || !reader.Get(&properties)) {
+            return false;
+        }
+        format_properties[format] = properties;
+    }
+
+    ArrayOfVkLayerProperties layer_properties;
+    if (!reader.Get(&count)) {
+        return false;
+    }
+    layer_properties.resize(count);
+    for (auto &properties : layer_properties) {
+        if (!reader.Get(&properties)) {
+            return false;
+        }
+    }
+
+    ArrayOfVkExtensionProperties ext_properties;
+    if (!reader.Get(&count)) {
+        return false;
+    }
+    ext_properties.resize(count);
+    for (auto &properties : ext_properties) {
+        if (!reader.Get(&properties)) {
+            return false;
+        }
+    }
+
+    MapOfExtendedFeatures extended_features;
+    if (!reader.Get(&count)) {
+        return false;
+    }
+    for (uint32_t i = 0; i < count; ++i) {
+        uint32_t stype = 0;
+        ExtendedFeature feature;
+        if (!reader.Get(&stype) || !reader.Get(&feature)) {
+            return false;
+        }
+        feature.base.pNext = nullptr;
+        extended_features[stype] = feature;
+    }
+
+    MapOfExtendedProperties extended_properties;
+    if (!reader.Get(&count)) {
+        return false;
+    }
+    for (uint32_t i = 0; i < count; ++i) {
+        uint32_t stype = 0;
+        ExtendedProperty property;
+        if (!reader.Get(&stype) || !reader.Get(&property)) {
+            return false;
+        }
+        property.base.pNext = nullptr;
+        extended_properties[stype] = property;
+    }
+
+    if (reader.pos != reader.end) {
+        return false;
+    }
+
+    pdd_.physical_device_properties_ = physical_device_properties;
+    pdd_.physical_device_features_ = physical_device_features;
+    pdd_.physical_device_memory_properties_ = physical_device_memory_properties;
+    pdd_.arrayof_queue_family_properties_ = std::move(queue_family_properties);
+    pdd_.arrayof_format_properties_ = std::move(format_properties);
+    pdd_.arrayof_layer_properties_ = std::move(layer_properties);
+    pdd_.arrayof_ext_properties_ = std::move(ext_properties);
+    pdd_.mapof_extended_features_ = std::move(extended_features);
+    pdd_.mapof_extended_properties_ = std::move(extended_properties);
+    return true;
+}
+
+void ProfileCache::Store() const {
+    std::vector<uint8_t> data;
+    Header header = {};
+    memcpy(header.magic, kCacheMagic, sizeof(kCacheMagic));
+    header.version = kCacheVersion;
+    header.key = key_;
+    Put(&data, header);
+
+    Put(&data, pdd_.physical_device_properties_);
+    Put(&data, pdd_.physical_device_features_);
+    Put(&data, pdd_.physical_device_memory_properties_);
+    Put(&data, static_cast<uint32_t>(pdd_.arrayof_queue_family_properties_.size()));
+    for (const auto &properties : pdd_.arrayof_queue_family_properties_) {
+        Put(&data, properties);
+    }
+    Put(&data, static_cast<uint32_t>(pdd_.arrayof_format_properties_.size()));
+    for (const auto &format : pdd_.arrayof_format_properties_) {
+        Put(&data, format.first);
+        Put(&data, format.second);
+    }
+    Put(&data, static_cast<uint32_t>(pdd_.arrayof_layer_properties_.size()));
+    for (const auto &properties : pdd_.arrayof_layer_properties_) {
+        Put(&data, properties);
+    }
+    Put(&data, static_cast<uint32_t>(pdd_.arrayof_ext_properties_.size()));
+    for (const auto &properties : pdd_.arrayof_ext_properties_) {
+        Put(&data, properties);
+    }
+    Put(&data, static_cast<uint32_t>(pdd_.mapof_extended_features_.size()));
+    for (const auto &feature : pdd_.mapof_extended_features_) {
+        Put(&data, feature.first);
+        Put(&data, feature.second);
+    }
+    Put(&data, static_cast<uint32_t>(pdd_.mapof_extended_properties_.size()));
+    for (const auto &property : pdd_.mapof_extended_properties_) {
+        Put(&data, property.first);
+        Put(&data, property.second);
+    }
+    const uint32_t size = static_cast<uint32_t>(data.size());
+    memcpy(data.data() + offsetof(Header, size), &size, sizeof(size));
+
+    // Write to a file of our own and rename it, so concurrent instances never map a partially written cache file.
+#if defined(_WIN32)
+    const unsigned long pid = GetCurrentProcessId();
+#else
+    const unsigned long pid = getpid();
+#endif
+    const std::string temp_path = path_ + "." + std::to_string(pid) + ".tmp";
+    FILE *file = fopen(temp_path.c_str(), "wb");
+    if (!file) {
+        WarningPrintf("ProfileCache failed to create file \"%s\"\n", temp_path.c_str());
+        return;
+    }
+    const bool written = fwrite(data.data(), 1, data.size(), file) == data.size();
+    if (fclose(file) != 0 || !written || rename(temp_path.c_str(), path_.c_str()) != 0) {
+        // On Windows, rename() fails when another instance already stored the same file.
+        remove(temp_path.c_str());
+        return;
+    }
+    DebugPrintf("ProfileCache::Store(\"%s\") %u bytes\n", path_.c_str(), size);
+}
+
 // Layer-specific wrappers for Vulkan functions, accessed via vkGet*ProcAddr() ///////////////////////////////////////////////////
 
 // Fill the inputFilename variable with a value from either vk_layer_settings.txt or environment variables.
@@ -1346,12 +1698,25 @@ static void getDevSimErrorLevel() {
 #endif
 }
 
+// Fill the cacheDir variable with a value from either vk_layer_settings.txt or environment variables.
+// Environment variables get priority.
+static void getDevSimCacheDir() {
+    cacheDir.str = getLayerOption(kLayerSettingsDevsimCacheDir);
+    cacheDir.fromEnvVar = false;
+    std::string env_var = GetEnvarValue(kEnvarDevsimCacheDir);
+    if (!env_var.empty()) {
+        cacheDir.str = env_var;
+        cacheDir.fromEnvVar = true;
+    }
+}
+
 // Generic layer dispatch table setup, see [LALI].
 static VkResult LayerSetupCreateInstance(const VkInstanceCreateInfo *pCreateInfo, const VkAllocationCallbacks *pAllocator,
                                          VkInstance *pInstance) {
     getDevSimFilename();
     getDevSimDebugLevel();
     getDevSimErrorLevel();
+    getDevSimCacheDir();
 
     VkLayerInstanceCreateInfo *chain_info = get_chain_info(pCreateInfo, VK_LAYER_LINK_INFO);
     assert(chain_info->u.pLayerInfo);
@@ -1446,9 +1811,15 @@ VKAPI_ATTR VkResult VKAPI_CALL CreateInstance(const VkInstanceCreateInfo *pCreat
         dt->GetPhysicalDeviceFeatures(physical_device, &pdd.physical_device_features_);
         dt->GetPhysicalDeviceMemoryProperties(physical_device, &pdd.physical_device_memory_properties_);
 
-        // Override PDD members with values from configuration file(s).
-        JsonLoader json_loader(pdd);
-        json_loader.LoadFiles();
+        // Override PDD members with values from configuration file(s), or from their cache.
+        ProfileCache profile_cache(pdd);
+        const bool cacheable = profile_cache.Init();
+        if (!cacheable || !profile_cache.Load()) {
+            JsonLoader json_loader(pdd);
+            if (json_loader.LoadFiles() && cacheable) {
+                profile_cache.Store();
+            }
+        }
 
         EnableCompatMode(*pInstance, physical_device, pdd);
     }
@@ -33,6 +33,8 @@
 #include <vulkan/vk_layer.h>
 #include <vulkan/vulkan.h>
 
+#include "monitor_stats.h"
+
 #if defined(ANDROID)
 #include <android/log.h>
 #endif
@@ -138,6 +140,7 @@ VK_LAYER_EXPORT VKAPI_ATTR VkResult VKAPI_CALL vkCreateDevice(VkPhysicalDevice g
     my_device_data->lastFrame = 0;
     my_device_data->fps = 0.0;
     time(&my_device_data->lastTime);
+    monitor_stats_init();
 
     // Get our WSI hooks in
     VkLayerDispatchTable *pTable = my_device_data->device_dispatch_table;
@@ -189,6 +192,7 @@ VK_LAYER_EXPORT VKAPI_ATTR void VKAPI_CALL vkDestroyDevice(VkDevice device, cons
     monitor_layer_data *my_data = GetLayerDataPtr(key, layer_data_map);
     VkLayerDispatchTable *pTable = my_data->device_dispatch_table;
     pTable->DeviceWaitIdle(device);
+    monitor_stats_write_report();
     pTable->DestroyDevice(device, pAllocator);
     delete pTable;
     layer_data_map.erase(key);
@@ -285,6 +289,7 @@ VK_LAYER_EXPORT VKAPI_ATTR VkResult VKAPI_CALL vkQueuePresentKHR(VkQueue queue,
 #endif // defined(VK_USE_PLATFORM_ANDROID_KHR)
     }
     my_data->frame++;
+    monitor_stats_present();
 
     VkResult result = my_data->pfnQueuePresentKHR(queue, pPresentInfo);
     return result;
@@ -0,0 +1,301 @@
+/*
+ *
+ * Copyright (C) 2016-2024 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(_WIN32)
+#include <windows.h>
+#endif
+#if defined(ANDROID)
+#include <android/log.h>
+#include <sys/system_properties.h>
+#endif
+
+#include "monitor_stats.h"
+
+namespace {
+
+const uint64_t RING_SIZE = 1 << 16;
+const uint32_t HISTOGRAM_BINS = 100;  // 1 ms each, the last one also counts the longer frames
+// A frame is a hitch when it takes this many times the recent average frame time.
+const double HITCH_FACTOR = 2.0;
+
+// Written by the presenting thread, read by the reporter without locking.
+struct FrameStats {
+    std::atomic<uint64_t> samples[RING_SIZE];  // frame time << 32 | CPU time, in microseconds
+    std::atomic<uint64_t> frameCount;
+    std::atomic<uint64_t> hitchCount;
+    std::atomic<uint64_t> totalFrameUs;
+    std::atomic<uint64_t> totalCpuUs;
+    std::atomic<uint64_t> minFrameUs;
+    std::atomic<uint64_t> maxFrameUs;
+    std::atomic<uint64_t> histogram[HISTOGRAM_BINS];
+};
+
+FrameStats s_stats;
+bool s_enabled = false;
+std::string s_reportFile;
+
+// Only used by the presenting thread.
+bool s_started = false;
+std::chrono::steady_clock::time_point s_lastPresent;
+uint64_t s_lastCpuUs = 0;
+double s_averageFrameUs = 0;
+
+std::mutex s_writeLock;
+
+void log_msg(const char *message, const char *argument) {
+#if defined(ANDROID)
+    __android_log_print(ANDROID_LOG_INFO, "vkmonitor", message, argument);
+#else
+    fprintf(stderr, message, argument);
+    fprintf(stderr, "\n");
+#endif
+}
+
+std::string get_setting(const char *name, const char *property) {
+#if defined(ANDROID)
+    (void)name;
+    char value[PROP_VALUE_MAX] = {};
+    __system_property_get(property, value);
+    return value;
+#else
+    (void)property;
+    const char *value = getenv(name);
+    return value != nullptr ? value : "";
+#endif
+}
+
+uint64_t process_cpu_us() {
+#if defined(_WIN32)
+    FILETIME creation, exit, kernel, user;
+    if (!GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user)) {
+        return 0;
+    }
+    ULARGE_INTEGER k, u;
+    k.LowPart = kernel.dwLowDateTime;
+    k.HighPart = kernel.dwHighDateTime;
+    u.LowPart = user.dwLowDateTime;
+    u.HighPart = user.dwHighDateTime;
+    return (k.QuadPart + u.QuadPart) / 10;
+#else
+    timespec ts;
+    if (clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts) != 0) {
+        return 0;
+    }
+    return uint64_t(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+#endif
+}
+
+struct Summary {
+    double mean;
+    double min;
+    double max;
+    double p50;
+    double p95;
+    double p99;
+};
+
+// Nearest-rank percentile, values are reordered.
+double percentile(std::vector<uint64_t> &values, double p) {
+    if (values.empty()) {
+        return 0;
+    }
+    size_t rank = std::max<size_t>(1, size_t(p / 100.0 * values.size() + 0.5));
+    auto nth = values.begin() + std::min(rank, values.size()) - 1;
+    std::nth_element(values.begin(), nth, values.end());
+    return *nth / 1000.0;
+}
+
+void summarize(std::vector<uint64_t> &values, double mean, Summary *pSummary) {
+    pSummary->mean = mean;
+    pSummary->min = values.empty() ? 0 : *std::min_element(values.begin(), values.end()) / 1000.0;
+    pSummary->max = values.empty() ? 0 : *std::max_element(values.begin(), values.end()) / 1000.0;
+    pSummary->p50 = percentile(values, 50);
+    pSummary->p95 = percentile(values, 95);
+    pSummary->p99 = percentile(values, 99);
+}
+
+void write_summary_json(FILE *file, const char *name, const Summary &summary, bool last) {
+    fprintf(file, "  \"%s\": {\"mean\": %.3f, \"min\": %.3f, \"max\": %.3f, \"p50\": %.3f, \"p95\": %.3f, \"p99\": %.3f}%s\n", name,
+            summary.mean, summary.min, summary.max, summary.p50, summary.p95, summary.p99, last ? "" : ",");
+}
+
+void write_summary_csv(FILE *file, const char *name, const Summary &summary) {
+    fprintf(file, "%s_mean,%.3f\n%s_min,%.3f\n%s_max,%.3f\n", name, summary.mean, name, summary.min, name, summary.max);
+    fprintf(file, "%s_p50,%.3f\n%s_p95,%.3f\n%s_p99,%.3f\n", name, summary.p50, name, summary.p95, name, summary.p99);
+}
+
+// Writes a report every interval seconds until stopped, and a last one when
+// the process exits.
+struct Reporter {
+    std::mutex lock;
+    std::condition_variable cond;
+    bool exit = false;
+    std::thread thread;
+
+    void run(uint32_t interval) {
+        std::unique_lock<std::mutex> guard(lock);
+        while (!cond.wait_for(guard, std::chrono::seconds(interval), [this] { return exit; })) {
+            guard.unlock();
+            monitor_stats_write_report();
+            guard.lock();
+        }
+    }
+
+    ~Reporter() {
+        if (thread.joinable()) {
+            {
+                std::lock_guard<std::mutex> guard(lock);
+                exit = true;
+            }
+            cond.notify_all();
+            thread.join();
+        }
+        if (s_enabled && s_stats.frameCount.load(std::memory_order_acquire) > 0) {
+            monitor_stats_write_report();
+        }
+    }
+};
+
+Reporter s_reporter;
+
+}  // namespace
+
+void monitor_stats_init() {
+    static bool initialized = false;
+    if (initialized) {
+        return;
+    }
+    initialized = true;
+
+    s_reportFile = get_setting("VK_MONITOR_REPORT", "debug.vulkan.monitor.report");
+    s_enabled = !s_reportFile.empty();
+    if (!s_enabled) {
+        return;
+    }
+    int interval = atoi(get_setting("VK_MONITOR_REPORT_INTERVAL", "debug.vulkan.monitor.interval").c_str());
+    if (interval > 0) {
+        s_reporter.thread = std::thread(&Reporter::run, &s_reporter, uint32_t(interval));
+    }
+}
+
+void monitor_stats_present() {
+    if (!s_enabled) {
+        return;
+    }
+    auto now = std::chrono::steady_clock::now();
+    uint64_t cpuUs = process_cpu_us();
+    if (s_started) {
+        uint64_t frameUs = std::chrono::duration_cast<std::chrono::microseconds>(now - s_lastPresent).count();
+        uint64_t frameCpuUs = cpuUs - s_lastCpuUs;
+        uint64_t index = s_stats.frameCount.load(std::memory_order_relaxed);
+
+        s_stats.samples[index % RING_SIZE].store(std::min<uint64_t>(frameUs, UINT32_MAX) << 32 |
+                                                     std::min<uint64_t>(frameCpuUs, UINT32_MAX),
+                                                 std::memory_order_relaxed);
+        s_stats.totalFrameUs.fetch_add(frameUs, std::memory_order_relaxed);
+        s_stats.totalCpuUs.fetch_add(frameCpuUs, std::memory_order_relaxed);
+        if (index == 0 || frameUs < s_stats.minFrameUs.load(std::memory_order_relaxed)) {
+            s_stats.minFrameUs.store(frameUs, std::memory_order_relaxed);
+        }
+        if (frameUs > s_stats.maxFrameUs.load(std::memory_order_relaxed)) {
+            s_stats.maxFrameUs.store(frameUs, std::memory_order_relaxed);
+        }
+        s_stats.histogram[std::min<uint64_t>(frameUs / 1000, HISTOGRAM_BINS - 1)].fetch_add(1, std::memory_order_relaxed);
+        if (index > 0 && frameUs > HITCH_FACTOR * s_averageFrameUs) {
+            s_stats.hitchCount.fetch_add(1, std::memory_order_relaxed);
+        }
+        s_averageFrameUs = index == 0 ? frameUs : 0.9 * s_averageFrameUs + 0.1 * frameUs;
+
+        // Publishes the sample to the reporter.
+        s_stats.frameCount.store(index + 1, std::memory_order_release);
+    }
+    s_started = true;
+    s_lastPresent = now;
+    s_lastCpuUs = cpuUs;
+}
+
+void monitor_stats_write_report() {
+    if (!s_enabled) {
+        return;
+    }
+    std::lock_guard<std::mutex> guard(s_writeLock);
+
+    uint64_t frames = s_stats.frameCount.load(std::memory_order_acquire);
+    uint64_t window = std::min(frames, RING_SIZE);
+    std::vector<uint64_t> frameUs(window);
+    std::vector<uint64_t> cpuUs(window);
+    for (uint64_t i = 0; i < window; i++) {
+        uint64_t sample = s_stats.samples[(frames - window + i) % RING_SIZE].load(std::memory_order_relaxed);
+        frameUs[i] = sample >> 32;
+        cpuUs[i] = sample & UINT32_MAX;
+    }
+    double totalFrameMs = s_stats.totalFrameUs.load(std::memory_order_relaxed) / 1000.0;
+    double totalCpuMs = s_stats.totalCpuUs.load(std::memory_order_relaxed) / 1000.0;
+    Summary frameSummary, cpuSummary;
+    summarize(frameUs, frames ? totalFrameMs / frames : 0, &frameSummary);
+    summarize(cpuUs, frames ? totalCpuMs / frames : 0, &cpuSummary);
+    // The whole run, not only the frames in the ring.
+    frameSummary.min = s_stats.minFrameUs.load(std::memory_order_relaxed) / 1000.0;
+    frameSummary.max = s_stats.maxFrameUs.load(std::memory_order_relaxed) / 1000.0;
+    uint64_t hitches = s_stats.hitchCount.load(std::memory_order_relaxed);
+    double fps = totalFrameMs > 0 ? frames * 1000.0 / totalFrameMs : 0;
+
+    FILE *file = fopen(s_reportFile.c_str(), "w");
+    if (file == nullptr) {
+        log_msg("Failed to open monitor report file %s.", s_reportFile.c_str());
+        return;
+    }
+    size_t length = s_reportFile.size();
+    if (length >= 4 && s_reportFile.compare(length - 4, 4, ".csv") == 0) {
+        fprintf(file, "metric,value\n");
+        fprintf(file, "frames,%llu\nduration_s,%.3f\nfps,%.3f\n", (unsigned long long)frames, totalFrameMs / 1000.0, fps);
+        fprintf(file, "hitches,%llu\npercentile_frames,%llu\n", (unsigned long long)hitches, (unsigned long long)window);
+        write_summary_csv(file, "frame_time_ms", frameSummary);
+        write_summary_csv(file, "cpu_time_ms", cpuSummary);
+        for (uint32_t i = 0; i < HISTOGRAM_BINS; i++) {
+            fprintf(file, "histogram_%ums,%llu\n", i, (unsigned long long)s_stats.histogram[i].load(std::memory_order_relaxed));
+        }
+    } else {
+        fprintf(file, "{\n");
+        fprintf(file, "  \"frames\": %llu,\n  \"duration_s\": %.3f,\n  \"fps\": %.3f,\n", (unsigned long long)frames,
+                totalFrameMs / 1000.0, fps);
+        fprintf(file, "  \"hitches\": %llu,\n  \"hitch_factor\": %.1f,\n", (unsigned long long)hitches, HITCH_FACTOR);
+        fprintf(file, "  \"percentile_frames\": %llu,\n", (unsigned long long)window);
+        write_summary_json(file, "frame_time_ms", frameSummary, false);
+        write_summary_json(file, "cpu_time_ms", cpuSummary, false);
+        fprintf(file, "  \"histogram_bin_ms\": 1,\n  \"histogram\": [");
+        for (uint32_t i = 0; i < HISTOGRAM_BINS; i++) {
+            fprintf(file, "%s%llu", i ? ", " : "", (unsigned long long)s_stats.histogram[i].load(std::memory_order_relaxed));
+        }
+        fprintf(file, "]\n}\n");
+    }
+    fclose(file);
+}
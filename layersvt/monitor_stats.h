@@ -0,0 +1,37 @@
+/*
+ *
+ * Copyright (C) 2016-2024 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+// Frame pacing statistics of the monitor layer.
+//
+// Every present records the time since the previous present and the CPU time
+// the process used in between. The most recent frames are kept in a lock-free
+// ring the percentiles are computed from; the frame count, hitch count and
+// frame-time histogram cover the whole run. A report is written to the file
+// named by VK_MONITOR_REPORT (debug.vulkan.monitor.report on Android) when the
+// device is destroyed, at exit, and every VK_MONITOR_REPORT_INTERVAL seconds if
+// it is set. The report is CSV if the file name ends with ".csv", JSON otherwise.
+
+// Read the report settings. Nothing is recorded if no report file is set.
+void monitor_stats_init();
+
+// Record a frame. Presents are expected from one thread at a time.
+void monitor_stats_present();
+
+// Write the report now.
+void monitor_stats_write_report();
@@ -270,6 +270,7 @@ swapchain::swapchain(const VkAllocationCallbacks *pAllocator)
     , m_is_valid(false)
     , m_thread_sem_defined(false)
     , m_first_present(true)
+    , m_no_present(false)
     , m_pending_buffer_pool{ nullptr, 0, 0, 0 }
     , m_num_swapchain_images(0)
     , m_swapchain_images(nullptr)
@@ -684,6 +685,23 @@ VkResult swapchain::queue_present(VkQueue queue, const VkPresentInfoKHR *pPresen
                                 pPresentInfo->pWaitSemaphores, &pipelineStageFlags, 0, NULL, 0, NULL };
 
     assert(m_swapchain_images[imageIndex].status == swapchain_image::ACQUIRED);
+
+    /* Nothing is displayed, so nothing reads the image after the present: the wait
+     * semaphores are consumed on the queue and the image is free again at once. */
+    if (m_no_present)
+    {
+        if (pPresentInfo->waitSemaphoreCount > 0)
+        {
+            result = vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE);
+            if (result != VK_SUCCESS)
+            {
+                return result;
+            }
+        }
+        unpresent_image(imageIndex);
+        return descendantStartedPresenting ? VK_ERROR_OUT_OF_DATE_KHR : VK_SUCCESS;
+    }
+
     result = vkResetFences(m_device, 1, &m_swapchain_images[imageIndex].present_fence);
     if (result != VK_SUCCESS)
     {
@@ -152,6 +152,18 @@ public:
      */
     VkResult queue_present(VkQueue queue, const VkPresentInfoKHR *pPresentInfo, const uint32_t imageIndex);
 
+    /**
+     * @brief Turns presentation into a no-op for benchmarking.
+     *
+     * The present only waits for its semaphores on the queue and frees the image
+     * right away, so nothing goes through the page flip thread and
+     * acquire_next_image never blocks. Must be called before init().
+     */
+    void set_no_present(bool no_present)
+    {
+        m_no_present = no_present;
+    }
+
     /**
      * @brief Returns the creation info used during construction of this swapchain.
      */
@@ -264,6 +276,11 @@ protected:
      */
     bool m_first_present;
 
+    /**
+     * @brief A flag to skip presentation, see set_no_present().
+     */
+    bool m_no_present;
+
     /**
      * @brief In order to present the images in a FIFO order we implement
      * a ring buffer to hold the images queued for presentation. Since the
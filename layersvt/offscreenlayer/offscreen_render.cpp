@@ -25,6 +25,7 @@
 #include "vk_dispatch_table_helper.h"
 #include "vk_layer_dispatch_table.h"
 const char *imagecount_var = "debug.offscreen.imagecount";
+const char *nopresent_var = "debug.offscreen.nopresent";
 
 #if defined(__ANDROID__)
 
@@ -495,6 +496,10 @@ VKAPI_ATTR VkResult VKAPI_CALL CreateSwapchainKHR(VkDevice device, const VkSwapc
         VkSwapchainCreateInfoKHR *temp = const_cast<VkSwapchainCreateInfoKHR *>(pCreateInfo);
         temp->minImageCount = count;
     }
+    const char *nopresent = android_getenv(nopresent_var);
+    if (nopresent != nullptr && atoi(nopresent) != 0) {
+        pHeadlessSwapChain->set_no_present(true);
+    }
     result = pHeadlessSwapChain->init(device, pCreateInfo);
     *pSwapchain = reinterpret_cast<VkSwapchainKHR>(pHeadlessSwapChain);
 #else
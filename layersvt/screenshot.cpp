@@ -36,6 +36,10 @@
 #include <fstream>
 #include <iomanip>
 #include <math.h>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
 
 using namespace std;
 
@@ -48,6 +52,7 @@ using namespace std;
 #include <vk_loader_platform.h>
 
 #include "screenshot_parsing.h"
+#include "screenshot_writer.h"
 
 #ifdef ANDROID
 
@@ -70,18 +75,23 @@ const char *env_var_format = "debug.vulkan.screenshot.format";
 const char *env_var_dir = "debug.vulkan.screenshot.dir";
 // /path/to/snapshots/prefix- Must contain full path and a prefix
 const char *env_var_prefix = "debug.vulkan.screenshot.prefix";
+const char *env_var_output = "debug.vulkan.screenshot.output";
+const char *env_var_async = "debug.vulkan.screenshot.async";
 #else  // Linux or Windows
 const char *env_var_old = "_VK_SCREENSHOT";
 const char *env_var_frames = "VK_SCREENSHOT_FRAMES";
 const char *env_var_format = "VK_SCREENSHOT_FORMAT";
 const char *env_var_dir = "VK_SCREENSHOT_DIR";
 const char *env_var_prefix = "VK_SCREENSHOT_PREFIX";
+const char *env_var_output = "VK_SCREENSHOT_OUTPUT";
+const char *env_var_async = "VK_SCREENSHOT_ASYNC";
 #endif
 const char *env_var_dump_renderpass = "VK_SCREENSHOT_DUMP_RENDERPASS";
 
 const char *settings_option_frames = "lunarg_screenshot.frames";
 const char *settings_option_format = "lunarg_screenshot.format";
 const char *settings_option_dir = "lunarg_screenshot.dir";
+const char *settings_option_output = "lunarg_screenshot.output";
 
 #ifdef ANDROID
 char *android_exec(const char *cmd) {
@@ -182,6 +192,14 @@ static uint32_t dumpRenderPassIndex = UINT32_MAX;
 
 static std::string screenshotPrefix = "";
 
+static OutputFormat outputFormat = OUTPUT_PPM;
+
+// Number of readback slots the screenshots taken at present are copied to
+// asynchronously. 0 takes them synchronously.
+static const uint32_t CAPTURE_RING_SIZE_DEFAULT = 3;
+static const uint32_t CAPTURE_RING_SIZE_MAX = 16;
+static uint32_t captureRingSize = CAPTURE_RING_SIZE_DEFAULT;
+
 static std::set<VkImage> renderPassImages;
 static unordered_map<VkCommandBuffer, std::set<VkCommandBuffer>> commandBufferToCommandBuffers;
 static unordered_map<VkFramebuffer, std::set<VkImage>> framebufferToImages;
@@ -451,6 +469,33 @@ void readScreenShotPrefixENV(void) {
     local_free_getenv(vk_screenshot_prefix);
 }
 
+void readScreenShotOutputENV(void) {
+    const char *vk_screenshot_output = getLayerOption(settings_option_output);
+    const char *env_var = local_getenv(env_var_output);
+    if (env_var != NULL && strlen(env_var) > 0) {
+        vk_screenshot_output = env_var;
+    }
+    if (vk_screenshot_output != NULL && strlen(vk_screenshot_output) > 0 &&
+        !parseOutputFormat(vk_screenshot_output, &outputFormat)) {
+#ifdef ANDROID
+        __android_log_print(ANDROID_LOG_INFO, "screenshot", "Unknown output %s, use ppm, png, raw or hash. PPM files will be saved.",
+                            vk_screenshot_output);
+#else
+        fprintf(stderr, "Unknown output %s, use ppm, png, raw or hash. PPM files will be saved.\n", vk_screenshot_output);
+#endif
+        outputFormat = OUTPUT_PPM;
+    }
+    local_free_getenv(env_var);
+}
+
+void readScreenShotAsyncENV(void) {
+    const char *env_var = local_getenv(env_var_async);
+    if (env_var != NULL && strlen(env_var) > 0) {
+        captureRingSize = std::min<uint32_t>(atoi(env_var), CAPTURE_RING_SIZE_MAX);
+    }
+    local_free_getenv(env_var);
+}
+
 // detect if frameNumber reach or beyond the right edge for screenshot in the range.
 // return:
 //       if frameNumber is already the last screenshot frame of the range(mean no another screenshot frame number >frameNumber and
@@ -575,58 +620,15 @@ static void init_screenshot() {
     readScreenShotFrames();
     readScreenShotPrefixENV();
     readScreenShotRenderPassENV();
+    readScreenShotOutputENV();
+    readScreenShotAsyncENV();
 }
 
-// Save an image to a PPM image file.
-//
-// This function issues commands to copy/convert the swapchain image
-// from whatever compatible format the swapchain image uses
-// to a single format (VK_FORMAT_R8G8B8A8_UNORM) so that the converted
-// result can be easily written to a PPM file.
-//
-// Error handling: If there is a problem, this function should silently
-// fail without affecting the Present operation going on in the caller.
-// The numerous debug asserts are to catch programming errors and are not
-// expected to assert.  Recovery and clean up are implemented for image memory
-// allocation failures.
-// (TODO) It would be nice to pass any failure info to DebugReport or something.
-static bool preparePPM(VkCommandBuffer commandBuffer, VkImage image1, WritePPMCleanupData &data) {
-    VkResult err;
-    bool pass;
-    VkCommandBuffer cmdBuf = VK_NULL_HANDLE;
-
-    // Bail immediately if we can't find the image.
-    if (imageMap.empty() || imageMap.find(image1) == imageMap.end()) return false;
-
-    // Collect object info from maps.  This info is generally recorded
-    // by the other functions hooked in this layer.
-    VkDevice device = imageMap[image1]->device;
-    VkPhysicalDevice physicalDevice = deviceMap[device]->physicalDevice;
-    VkInstance instance = physDeviceMap[physicalDevice]->instance;
-    VkQueue queue = deviceMap[device]->queue;
-    DeviceMapStruct *devMap = get_dev_info(device);
-    if (NULL == devMap) {
-        assert(0);
-        return false;
-    }
-    VkLayerDispatchTable *pTableDevice = devMap->device_dispatch_table;
-    VkLayerDispatchTable *pTableQueue = get_dev_info(static_cast<VkDevice>(static_cast<void *>(queue)))->device_dispatch_table;
-    VkLayerInstanceDispatchTable *pInstanceTable;
-    pInstanceTable = instance_dispatch_table(instance);
-
-    // Gather incoming image info and check image format for compatibility with
-    // the target format.
-    // This function supports both 24-bit and 32-bit swapchain images.
-    uint32_t const width = imageMap[image1]->imageExtent.width;
-    uint32_t const height = imageMap[image1]->imageExtent.height;
-    VkFormat const format = imageMap[image1]->format;
+// Pick the format an image of the given format is converted to before it's
+// read back. *pPpmSupport is cleared if the result can only be saved as raw data.
+static VkFormat getDestFormat(VkFormat format, bool *pPpmSupport) {
     uint32_t const numChannels = FormatComponentCount(format);
 
-    // By DDK, the Stencil format could not be sampled
-    if (FormatIsStencilOnly(format)) {
-        return false;
-    }
-
     // Initial dest format is undefined as we will look for one
     VkFormat destformat = VK_FORMAT_UNDEFINED;
 
@@ -829,7 +831,7 @@ static bool preparePPM(VkCommandBuffer commandBuffer, VkImage image1, WritePPMCl
 #endif
             }
             destformat = format;
-            data.ppmSupport = false;
+            *pPpmSupport = false;
         }
     } else {
         if (FormatElementSize(format) != 4 || FormatComponentCount(format) != 4) {
@@ -840,41 +842,43 @@ static bool preparePPM(VkCommandBuffer commandBuffer, VkImage image1, WritePPMCl
             }
         }
     }
-    imageMap[image1]->destFormat = destformat;
-
-    // General Approach
-    //
-    // The idea here is to copy/convert the swapchain image into another image
-    // that can be mapped and read by the CPU to produce a PPM file.
-    // The image must be untiled and converted to a specific format for easy
-    // parsing.  The memory for the final image must be host-visible.
-    // Note that in Vulkan, a BLIT operation must be used to perform a format
-    // conversion.
-    //
-    // Devices vary in their ability to blit to/from linear and optimal tiling.
-    // So we must query the device properties to get this information.
-    //
-    // If the device cannot BLIT to a LINEAR image, then the operation must be
-    // done in two steps:
-    // 1) BLIT the swapchain image (image1) to a temp image (image2) that is
-    // created with TILING_OPTIMAL.
-    // 2) COPY image2 to another temp image (image3) that is created with
-    // TILING_LINEAR.
-    // 3) Map image 3 and write the PPM file.
-    //
-    // If the device can BLIT to a LINEAR image, then:
-    // 1) BLIT the swapchain image (image1) to a temp image (image2) that is
-    // created with TILING_LINEAR.
-    // 2) Map image 2 and write the PPM file.
-    //
-    // There seems to be no way to tell if the swapchain image (image1) is tiled
-    // or not.  We therefore assume that the BLIT operation can always read from
-    // both linear and optimal tiled (swapchain) images.
-    // There is therefore no point in looking at the BLIT_SRC properties.
-    //
-    // There is also the optimization where the incoming and target formats are
-    // the same.  In this case, just do a COPY.
+    return destformat;
+}
 
+// General Approach
+//
+// The idea here is to copy/convert the swapchain image into another image
+// that can be mapped and read by the CPU to produce a PPM file.
+// The image must be untiled and converted to a specific format for easy
+// parsing.  The memory for the final image must be host-visible.
+// Note that in Vulkan, a BLIT operation must be used to perform a format
+// conversion.
+//
+// Devices vary in their ability to blit to/from linear and optimal tiling.
+// So we must query the device properties to get this information.
+//
+// If the device cannot BLIT to a LINEAR image, then the operation must be
+// done in two steps:
+// 1) BLIT the swapchain image (image1) to a temp image (image2) that is
+// created with TILING_OPTIMAL.
+// 2) COPY image2 to another temp image (image3) that is created with
+// TILING_LINEAR.
+// 3) Map image 3 and write the PPM file.
+//
+// If the device can BLIT to a LINEAR image, then:
+// 1) BLIT the swapchain image (image1) to a temp image (image2) that is
+// created with TILING_LINEAR.
+// 2) Map image 2 and write the PPM file.
+//
+// There seems to be no way to tell if the swapchain image (image1) is tiled
+// or not.  We therefore assume that the BLIT operation can always read from
+// both linear and optimal tiled (swapchain) images.
+// There is therefore no point in looking at the BLIT_SRC properties.
+//
+// There is also the optimization where the incoming and target formats are
+// the same.  In this case, just do a COPY.
+static void getCopyMode(VkLayerInstanceDispatchTable *pInstanceTable, VkPhysicalDevice physicalDevice, VkFormat format,
+                        VkFormat destformat, bool *pCopyOnly, bool *pNeed2steps) {
     VkFormatProperties targetFormatProps;
     pInstanceTable->GetPhysicalDeviceFormatProperties(physicalDevice, destformat, &targetFormatProps);
     bool need2steps = false;
@@ -897,9 +901,20 @@ static bool preparePPM(VkCommandBuffer commandBuffer, VkImage image1, WritePPMCl
         }
         // Else bltLinear is available and only 1 step is needed.
     }
+    *pCopyOnly = copyOnly;
+    *pNeed2steps = need2steps;
+}
+
+// Create image2, and image3 if need2steps, which the image is blitted or
+// copied to. The last one is linear and host visible.
+static bool createReadbackImages(VkDevice device, VkLayerDispatchTable *pTableDevice, VkLayerInstanceDispatchTable *pInstanceTable,
+                                 VkPhysicalDevice physicalDevice, uint32_t width, uint32_t height, VkFormat destformat,
+                                 bool need2steps, WritePPMCleanupData &data) {
+    VkResult err;
+    bool pass;
 
-    // Put resources that need to be cleaned up in a struct with a destructor
-    // so that things get cleaned up when this function is exited.
+    // Everything created is recorded in data, CleanupData() releases it
+    // whether this function succeeds or not.
     data.device = device;
     data.pTableDevice = pTableDevice;
 
@@ -936,6 +951,8 @@ static bool preparePPM(VkCommandBuffer commandBuffer, VkImage image1, WritePPMCl
     };
     VkMemoryRequirements memRequirements;
     VkPhysicalDeviceMemoryProperties memoryProperties;
+    // The CPU reads every texel of the final image, cached memory makes that much faster.
+    const VkFlags readbackMemoryFlags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
 
     // Create image2 and allocate its memory.  It could be the intermediate or
     // final image.
@@ -945,14 +962,20 @@ static bool preparePPM(VkCommandBuffer commandBuffer, VkImage image1, WritePPMCl
     pTableDevice->GetImageMemoryRequirements(device, data.image2, &memRequirements);
     memAllocInfo.allocationSize = memRequirements.size;
     pInstanceTable->GetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
-    pass = memory_type_from_properties(&memoryProperties, memRequirements.memoryTypeBits,
-                                       need2steps ? VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT : VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
-                                       &memAllocInfo.memoryTypeIndex);
+    if (need2steps) {
+        pass = memory_type_from_properties(&memoryProperties, memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                                           &memAllocInfo.memoryTypeIndex);
+    } else {
+        pass = memory_type_from_properties(&memoryProperties, memRequirements.memoryTypeBits, readbackMemoryFlags,
+                                           &memAllocInfo.memoryTypeIndex) ||
+               memory_type_from_properties(&memoryProperties, memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+                                           &memAllocInfo.memoryTypeIndex);
+    }
     assert(pass);
     err = pTableDevice->AllocateMemory(device, &memAllocInfo, NULL, &data.mem2);
     assert(!err);
     if (VK_SUCCESS != err) return false;
-    err = pTableQueue->BindImageMemory(device, data.image2, data.mem2, 0);
+    err = pTableDevice->BindImageMemory(device, data.image2, data.mem2, 0);
     assert(!err);
     if (VK_SUCCESS != err) return false;
 
@@ -964,69 +987,68 @@ static bool preparePPM(VkCommandBuffer commandBuffer, VkImage image1, WritePPMCl
         pTableDevice->GetImageMemoryRequirements(device, data.image3, &memRequirements);
         memAllocInfo.allocationSize = memRequirements.size;
         pInstanceTable->GetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
-        pass = memory_type_from_properties(&memoryProperties, memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+        pass = memory_type_from_properties(&memoryProperties, memRequirements.memoryTypeBits, readbackMemoryFlags,
+                                           &memAllocInfo.memoryTypeIndex) ||
+               memory_type_from_properties(&memoryProperties, memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
                                            &memAllocInfo.memoryTypeIndex);
         assert(pass);
         err = pTableDevice->AllocateMemory(device, &memAllocInfo, NULL, &data.mem3);
         assert(!err);
         if (VK_SUCCESS != err) return false;
-        err = pTableQueue->BindImageMemory(device, data.image3, data.mem3, 0);
+        err = pTableDevice->BindImageMemory(device, data.image3, data.mem3, 0);
         assert(!err);
         if (VK_SUCCESS != err) return false;
     }
+    return true;
+}
 
-    VkLayerDispatchTable *pTableCommandBuffer;
-    if (commandBuffer == VK_NULL_HANDLE) {
-        // We want to create our own command pool to be sure we can use it from this thread
-        VkCommandPoolCreateInfo cmd_pool_info = {};
-        cmd_pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
-        cmd_pool_info.pNext = NULL;
-        auto it = queueIndexMap.find(queue);
-        assert(it != queueIndexMap.end());
-        cmd_pool_info.queueFamilyIndex = it->second;
-        cmd_pool_info.flags = 0;
-
-        err = pTableDevice->CreateCommandPool(device, &cmd_pool_info, NULL, &data.commandPool);
-        assert(!err);
+// Create a command pool for queueFamilyIndex and a command buffer the layer can
+// record from this thread.
+static bool createLayerCommandBuffer(VkDevice device, DeviceMapStruct *devMap, uint32_t queueFamilyIndex, WritePPMCleanupData &data) {
+    VkResult err;
+    VkLayerDispatchTable *pTableDevice = devMap->device_dispatch_table;
+    VkCommandPoolCreateInfo cmd_pool_info = {};
+    cmd_pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    cmd_pool_info.pNext = NULL;
+    cmd_pool_info.queueFamilyIndex = queueFamilyIndex;
+    cmd_pool_info.flags = 0;
 
-        // Set up the command buffer.
-        const VkCommandBufferAllocateInfo allocCommandBufferInfo = {VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO, NULL,
-                                                                    data.commandPool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, 1};
-        err = pTableDevice->AllocateCommandBuffers(device, &allocCommandBufferInfo, &data.commandBuffer);
-        assert(!err);
-        if (VK_SUCCESS != err) return false;
+    err = pTableDevice->CreateCommandPool(device, &cmd_pool_info, NULL, &data.commandPool);
+    assert(!err);
+    if (VK_SUCCESS != err) return false;
 
-        VkDevice cmdBufToDev = static_cast<VkDevice>(static_cast<void *>(data.commandBuffer));
-        if (deviceMap.find(cmdBufToDev) != deviceMap.end()) {
-            // Remove element with key cmdBufToDev from deviceMap so we can replace it
-            deviceMap.erase(cmdBufToDev);
-        }
-        deviceMap.emplace(cmdBufToDev, devMap);
-        pTableCommandBuffer = get_dev_info(cmdBufToDev)->device_dispatch_table;
+    // Set up the command buffer.
+    const VkCommandBufferAllocateInfo allocCommandBufferInfo = {VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO, NULL,
+                                                                data.commandPool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, 1};
+    err = pTableDevice->AllocateCommandBuffers(device, &allocCommandBufferInfo, &data.commandBuffer);
+    assert(!err);
+    if (VK_SUCCESS != err) return false;
 
-        // We have just created a dispatchable object, but the dispatch table has
-        // not been placed in the object yet.  When a "normal" application creates
-        // a command buffer, the dispatch table is installed by the top-level api
-        // binding (trampoline.c). But here, we have to do it ourselves.
-        if (!devMap->pfn_dev_init) {
-            *((const void **)data.commandBuffer) = *(void **)device;
-        } else {
-            err = devMap->pfn_dev_init(device, (void *)data.commandBuffer);
-            assert(!err);
-        }
+    VkDevice cmdBufToDev = static_cast<VkDevice>(static_cast<void *>(data.commandBuffer));
+    if (deviceMap.find(cmdBufToDev) != deviceMap.end()) {
+        // Remove element with key cmdBufToDev from deviceMap so we can replace it
+        deviceMap.erase(cmdBufToDev);
+    }
+    deviceMap.emplace(cmdBufToDev, devMap);
 
-        const VkCommandBufferBeginInfo commandBufferBeginInfo = {
-            VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO, NULL,
-            VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT, NULL
-        };
-        err = pTableCommandBuffer->BeginCommandBuffer(data.commandBuffer, &commandBufferBeginInfo);
-        assert(!err);
-        cmdBuf = data.commandBuffer;
+    // We have just created a dispatchable object, but the dispatch table has
+    // not been placed in the object yet.  When a "normal" application creates
+    // a command buffer, the dispatch table is installed by the top-level api
+    // binding (trampoline.c). But here, we have to do it ourselves.
+    if (!devMap->pfn_dev_init) {
+        *((const void **)data.commandBuffer) = *(void **)device;
     } else {
-        VkDevice cmdBufToDev = static_cast<VkDevice>(static_cast<void *>(commandBuffer));
-        pTableCommandBuffer = get_dev_info(cmdBufToDev)->device_dispatch_table;
-        cmdBuf = commandBuffer;
+        err = devMap->pfn_dev_init(device, (void *)data.commandBuffer);
+        assert(!err);
     }
+    return true;
+}
+
+// Record the commands which copy/convert image1 to the readback images of data.
+static void recordReadbackCommands(VkLayerDispatchTable *pTableCommandBuffer, VkCommandBuffer cmdBuf, VkImage image1,
+                                   VkFormat destformat, bool copyOnly, bool need2steps, const WritePPMCleanupData &data) {
+    uint32_t const width = imageMap[image1]->imageExtent.width;
+    uint32_t const height = imageMap[image1]->imageExtent.height;
 
     VkImageAspectFlags aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
     if (FormatIsDepthOnly(destformat)) {
@@ -1162,6 +1184,132 @@ static bool preparePPM(VkCommandBuffer commandBuffer, VkImage image1, WritePPMCl
     presentMemoryBarrier.dstAccessMask = 0;
     pTableCommandBuffer->CmdPipelineBarrier(cmdBuf, srcStages, dstStages, 0, 0, NULL, 0, NULL, 1,
                                             &presentMemoryBarrier);
+}
+
+// Map the last readback image of data and describe it in *pReadback.
+static bool mapReadbackImage(uint32_t width, uint32_t height, VkFormat format, VkFormat destformat, bool need2steps,
+                             WritePPMCleanupData &data, ReadbackImage *pReadback) {
+    VkResult err;
+    VkImageAspectFlags aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    if (FormatIsDepthOnly(destformat)) {
+        aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+    } else if (FormatIsStencilOnly(destformat)) {
+        aspectMask = VK_IMAGE_ASPECT_STENCIL_BIT;
+    } else if (FormatIsDepthAndStencil(destformat)) {
+        aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+    }
+
+    // Map the final image so that the CPU can read it.
+    const VkImageSubresource sr = {aspectMask, 0, 0};
+    VkSubresourceLayout srLayout;
+    const char *ptr = nullptr;
+    if (!need2steps) {
+        data.pTableDevice->GetImageSubresourceLayout(data.device, data.image2, &sr, &srLayout);
+        err = data.pTableDevice->MapMemory(data.device, data.mem2, 0, VK_WHOLE_SIZE, 0, (void **)&ptr);
+        assert(!err);
+        if (VK_SUCCESS != err) return false;
+        data.mem2mapped = true;
+    } else {
+        data.pTableDevice->GetImageSubresourceLayout(data.device, data.image3, &sr, &srLayout);
+        err = data.pTableDevice->MapMemory(data.device, data.mem3, 0, VK_WHOLE_SIZE, 0, (void **)&ptr);
+        assert(!err);
+        if (VK_SUCCESS != err) return false;
+        data.mem3mapped = true;
+    }
+
+    *pReadback = {ptr + srLayout.offset, srLayout.rowPitch, width, height, format, destformat, data.ppmSupport};
+    return true;
+}
+
+// Make the GPU writes to the mapped readback image visible, its memory may not be coherent.
+static void invalidateReadbackImage(bool need2steps, WritePPMCleanupData &data) {
+    VkMappedMemoryRange range = {VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE, NULL, need2steps ? data.mem3 : data.mem2, 0, VK_WHOLE_SIZE};
+    data.pTableDevice->InvalidateMappedMemoryRanges(data.device, 1, &range);
+}
+
+// Save an image to a PPM image file.
+//
+// This function issues commands to copy/convert the swapchain image
+// from whatever compatible format the swapchain image uses
+// to a single format (VK_FORMAT_R8G8B8A8_UNORM) so that the converted
+// result can be easily written to a PPM file.
+//
+// Error handling: If there is a problem, this function should silently
+// fail without affecting the Present operation going on in the caller.
+// The numerous debug asserts are to catch programming errors and are not
+// expected to assert.  Recovery and clean up are implemented for image memory
+// allocation failures.
+// (TODO) It would be nice to pass any failure info to DebugReport or something.
+static bool preparePPM(VkCommandBuffer commandBuffer, VkImage image1, WritePPMCleanupData &data) {
+    VkResult err;
+    VkCommandBuffer cmdBuf = VK_NULL_HANDLE;
+
+    // Bail immediately if we can't find the image.
+    if (imageMap.empty() || imageMap.find(image1) == imageMap.end()) return false;
+
+    // Collect object info from maps.  This info is generally recorded
+    // by the other functions hooked in this layer.
+    VkDevice device = imageMap[image1]->device;
+    VkPhysicalDevice physicalDevice = deviceMap[device]->physicalDevice;
+    VkInstance instance = physDeviceMap[physicalDevice]->instance;
+    VkQueue queue = deviceMap[device]->queue;
+    DeviceMapStruct *devMap = get_dev_info(device);
+    if (NULL == devMap) {
+        assert(0);
+        return false;
+    }
+    VkLayerDispatchTable *pTableDevice = devMap->device_dispatch_table;
+    VkLayerDispatchTable *pTableQueue = get_dev_info(static_cast<VkDevice>(static_cast<void *>(queue)))->device_dispatch_table;
+    VkLayerInstanceDispatchTable *pInstanceTable;
+    pInstanceTable = instance_dispatch_table(instance);
+
+    // Gather incoming image info and check image format for compatibility with
+    // the target format.
+    // This function supports both 24-bit and 32-bit swapchain images.
+    uint32_t const width = imageMap[image1]->imageExtent.width;
+    uint32_t const height = imageMap[image1]->imageExtent.height;
+    VkFormat const format = imageMap[image1]->format;
+
+    // By DDK, the Stencil format could not be sampled
+    if (FormatIsStencilOnly(format)) {
+        return false;
+    }
+
+    VkFormat destformat = getDestFormat(format, &data.ppmSupport);
+    imageMap[image1]->destFormat = destformat;
+
+    bool need2steps = false;
+    bool copyOnly = false;
+    getCopyMode(pInstanceTable, physicalDevice, format, destformat, &copyOnly, &need2steps);
+
+    if (!createReadbackImages(device, pTableDevice, pInstanceTable, physicalDevice, width, height, destformat, need2steps, data)) {
+        return false;
+    }
+
+    VkLayerDispatchTable *pTableCommandBuffer;
+    if (commandBuffer == VK_NULL_HANDLE) {
+        // We want to create our own command pool to be sure we can use it from this thread
+        auto it = queueIndexMap.find(queue);
+        assert(it != queueIndexMap.end());
+        if (!createLayerCommandBuffer(device, devMap, it->second, data)) {
+            return false;
+        }
+        pTableCommandBuffer = pTableDevice;
+
+        const VkCommandBufferBeginInfo commandBufferBeginInfo = {
+            VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO, NULL,
+            VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT, NULL
+        };
+        err = pTableCommandBuffer->BeginCommandBuffer(data.commandBuffer, &commandBufferBeginInfo);
+        assert(!err);
+        cmdBuf = data.commandBuffer;
+    } else {
+        VkDevice cmdBufToDev = static_cast<VkDevice>(static_cast<void *>(commandBuffer));
+        pTableCommandBuffer = get_dev_info(cmdBufToDev)->device_dispatch_table;
+        cmdBuf = commandBuffer;
+    }
+
+    recordReadbackCommands(pTableCommandBuffer, cmdBuf, image1, destformat, copyOnly, need2steps, data);
 
     if (commandBuffer == VK_NULL_HANDLE) {
         err = pTableCommandBuffer->EndCommandBuffer(data.commandBuffer);
@@ -1193,7 +1341,6 @@ static bool preparePPM(VkCommandBuffer commandBuffer, VkImage image1, WritePPMCl
 }
 
 static bool writePPM(const char *filename, VkImage image1, WritePPMCleanupData& data) {
-    VkResult err;
     // Bail immediately if we can't find the image.
     if (imageMap.empty() || imageMap.find(image1) == imageMap.end()) return false;
 
@@ -1206,157 +1353,266 @@ static bool writePPM(const char *filename, VkImage image1, WritePPMCleanupData&
     uint32_t const height = imageMap[image1]->imageExtent.height;
     VkFormat const format = imageMap[image1]->format;
     VkFormat const destformat = imageMap[image1]->destFormat;
-    uint32_t const numChannels = FormatComponentCount(format);
     DeviceMapStruct *devMap = get_dev_info(device);
     if (NULL == devMap) {
         assert(0);
         return false;
     }
 
-    VkFormatProperties targetFormatProps;
-    pInstanceTable->GetPhysicalDeviceFormatProperties(physicalDevice, destformat, &targetFormatProps);
     bool need2steps = false;
     bool copyOnly = false;
-    if (destformat == format) {
-        copyOnly = true;
-    } else {
-        bool const bltLinear = targetFormatProps.linearTilingFeatures & VK_FORMAT_FEATURE_BLIT_DST_BIT ? true : false;
-        bool const bltOptimal = targetFormatProps.optimalTilingFeatures & VK_FORMAT_FEATURE_BLIT_DST_BIT ? true : false;
-        if (!bltLinear && !bltOptimal) {
-            // Cannot blit to either target tiling type.  It should be pretty
-            // unlikely to have a device that cannot blit to either type.
-            // But punt by just doing a copy and possibly have the wrong
-            // colors.  This should be quite rare.
-            copyOnly = true;
-        } else if (!bltLinear && bltOptimal) {
-            // Cannot blit to a linear target but can blt to optimal, so copy
-            // after blit is needed.
-            need2steps = true;
-        }
-        // Else bltLinear is available and only 1 step is needed.
-    }
+    getCopyMode(pInstanceTable, physicalDevice, format, destformat, &copyOnly, &need2steps);
 
     if (copyOnly) {
         printf("Cannot blit to either target tiling type, so copy is needed! \n");
     }
 
-    VkLayerDispatchTable *pTableDevice = devMap->device_dispatch_table;
-    VkImageAspectFlags aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-    if (FormatIsDepthOnly(destformat)) {
-        aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
-    } else if (FormatIsStencilOnly(destformat)) {
-        aspectMask = VK_IMAGE_ASPECT_STENCIL_BIT;
-    } else if (FormatIsDepthAndStencil(destformat)) {
-        aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
-    }
-
-    // Map the final image so that the CPU can read it.
-    const VkImageSubresource sr = {aspectMask, 0, 0};
-    VkSubresourceLayout srLayout;
-    const char *ptr = nullptr;
-    if (!need2steps) {
-        pTableDevice->GetImageSubresourceLayout(device, data.image2, &sr, &srLayout);
-        err = pTableDevice->MapMemory(device, data.mem2, 0, VK_WHOLE_SIZE, 0, (void **)&ptr);
-        assert(!err);
-        if (VK_SUCCESS != err) return false;
-        data.mem2mapped = true;
-    } else {
-        pTableDevice->GetImageSubresourceLayout(device, data.image3, &sr, &srLayout);
-        err = pTableDevice->MapMemory(device, data.mem3, 0, VK_WHOLE_SIZE, 0, (void **)&ptr);
-        assert(!err);
-        if (VK_SUCCESS != err) return false;
-        data.mem3mapped = true;
+    ReadbackImage readback = {};
+    if (!mapReadbackImage(width, height, format, destformat, need2steps, data, &readback)) {
+        return false;
     }
+    invalidateReadbackImage(need2steps, data);
 
     string strFileName = filename;
     if (!imageMap[image1]->isSwapchainImage) {
         size_t pos = strFileName.find_last_of(".");
         if (pos != string::npos) {
             strFileName = strFileName.substr(0, pos);
-            strFileName += "_" + to_string(format) + "_" + to_string(destformat) + "_" + to_string(width) + "_" + to_string(height) + ".ppm";
+            strFileName += "_" + to_string(format) + "_" + to_string(destformat) + "_" + to_string(width) + "_" + to_string(height) + outputFormatExtension(outputFormat);
         }
     }
 
-    // Write the data to a PPM file.
-    ofstream file(strFileName.c_str(), ios::binary);
-    assert(file.is_open());
+    return writeScreenshotFile(strFileName, readback, outputFormat);
+}
+
+// Asynchronous screenshots at present.
+//
+// The presented image is copied to one of a ring of persistent readback images
+// by a submission which waits for the present semaphores, and the present
+// waits for that copy instead. A worker thread waits for the copy, converts
+// and writes the file, then hands the slot back. QueuePresentKHR only blocks
+// when every slot is still owned by the worker.
+struct CaptureSlot {
+    WritePPMCleanupData data;  // readback images and command buffer, kept between captures
+    uint32_t queueFamilyIndex;
+    uint32_t width;
+    uint32_t height;
+    VkFormat format;
+    VkFormat destFormat;
+    bool copyOnly;
+    bool need2steps;
+    VkFence fence;
+    VkSemaphore semaphore;
+    ReadbackImage readback;  // in the persistently mapped readback memory
+    string fileName;
+    bool busy;  // owned by the worker until the file is written
+};
+
+static std::mutex captureLock;
+static std::condition_variable captureCond;
+static std::deque<CaptureSlot *> captureQueue;
+static bool captureWorkerExit = false;
+static std::vector<CaptureSlot *> captureSlots;
+static uint32_t nextCaptureSlot = 0;
+
+static void captureWorker() {
+    std::unique_lock<std::mutex> lock(captureLock);
+    while (true) {
+        captureCond.wait(lock, [] { return captureWorkerExit || !captureQueue.empty(); });
+        if (captureWorkerExit) {
+            break;
+        }
+        CaptureSlot *slot = captureQueue.front();
+        captureQueue.pop_front();
+        lock.unlock();
 
-    if (!file.is_open()) {
+        slot->data.pTableDevice->WaitForFences(slot->data.device, 1, &slot->fence, VK_TRUE, UINT64_MAX);
+        invalidateReadbackImage(slot->need2steps, slot->data);
+        if (writeScreenshotFile(slot->fileName, slot->readback, outputFormat)) {
 #ifdef ANDROID
-        __android_log_print(ANDROID_LOG_DEBUG, "screenshot",
-                            "Failed to open output file: %s.  Be sure to grant read and write permissions.", strFileName.c_str());
+            __android_log_print(ANDROID_LOG_INFO, "screenshot", "QueuePresent Screen capture file is: %s", slot->fileName.c_str());
 #else
-        fprintf(stderr, "Failed to open output file:%s,  Be sure to grant read and write permissions\n", strFileName.c_str());
+            printf("QueuePresent Screen capture file is: %s \n", slot->fileName.c_str());
 #endif
-        return false;
+        } else {
+#ifdef ANDROID
+            __android_log_print(ANDROID_LOG_DEBUG, "screenshot", "Failed to save screenshot to file %s.", slot->fileName.c_str());
+#else
+            fprintf(stderr, "Failed to save screenshot to file %s.\n", slot->fileName.c_str());
+#endif
+        }
+
+        lock.lock();
+        slot->busy = false;
+        captureCond.notify_all();
     }
+}
 
-    if (data.ppmSupport) {
-        uint32_t bytesPerChannel = FormatElementSize(destformat) / FormatComponentCount(destformat);
-        uint32_t maxColorValue = pow(256, bytesPerChannel) - 1;
+// The worker is started with the first asynchronous screenshot. If the
+// application exits without destroying its device, the screenshots still
+// queued are dropped.
+struct CaptureThread {
+    std::thread thread;
+    ~CaptureThread() {
+        if (thread.joinable()) {
+            {
+                std::lock_guard<std::mutex> lock(captureLock);
+                captureWorkerExit = true;
+            }
+            captureCond.notify_all();
+            thread.join();
+        }
+    }
+};
+static CaptureThread captureThread;
 
-        file << "P6\n";
-        file << "# format: " << destformat << " " << string_VkFormat(destformat) << "\n";
-        file << "# srcFormat: " << format << " " << string_VkFormat(format) << "\n";
-        file << "# rowPitch: " << srLayout.rowPitch << "\n";
-        file << width << "\n";
-        file << height << "\n";
-        file << 255 << "\n";
+static void destroyCaptureSlot(CaptureSlot *slot) {
+    if (slot->data.device == VK_NULL_HANDLE) {
+        return;
+    }
+    if (slot->fence) slot->data.pTableDevice->DestroyFence(slot->data.device, slot->fence, NULL);
+    if (slot->semaphore) slot->data.pTableDevice->DestroySemaphore(slot->data.device, slot->semaphore, NULL);
+    slot->data.CleanupData();
+    slot->data = WritePPMCleanupData();
+    slot->fence = VK_NULL_HANDLE;
+    slot->semaphore = VK_NULL_HANDLE;
+}
+
+// Wait for the screenshots of device to be written, then release its slots.
+static void destroyCaptureSlots(VkDevice device) {
+    std::unique_lock<std::mutex> lock(captureLock);
+    for (auto it = captureSlots.begin(); it != captureSlots.end();) {
+        CaptureSlot *slot = *it;
+        if (slot->data.device != device) {
+            it++;
+            continue;
+        }
+        captureCond.wait(lock, [slot] { return !slot->busy; });
+        destroyCaptureSlot(slot);
+        delete slot;
+        it = captureSlots.erase(it);
+    }
+    nextCaptureSlot = 0;
+}
 
-        ptr += srLayout.offset;
-        for (uint32_t y = 0; y < height; y++) {
-            const char *row = (const char *)ptr;
-            for (uint32_t x = 0; x < width; x++) {
-                // ppm only supports 3 channels r, g, b
-                for (uint32_t i = 0; i < 3; i++) {
-                    char colorValue = 0;
-                    if (i >= numChannels) {
-                        file.write((const char *)&colorValue, 1);
-                    } else {
-                        const char *rawcolor = row + (i * bytesPerChannel);
-                        uint32_t factor = maxColorValue / 255;
-                        uint32_t tmpcolor = 0;
-                        memcpy(&tmpcolor, rawcolor, bytesPerChannel);
-                        tmpcolor = tmpcolor / factor;
-                        colorValue = tmpcolor;
-                        file.write((const char *)&colorValue, 1);
-                    }
-                }
-                row = row + FormatElementSize(destformat);
-            }
-            ptr += srLayout.rowPitch;
+// (Re)create the readback resources of slot for image1 presented on a queue of queueFamilyIndex.
+static bool createCaptureSlot(CaptureSlot *slot, VkImage image1, uint32_t queueFamilyIndex) {
+    VkResult err;
+    VkDevice device = imageMap[image1]->device;
+    DeviceMapStruct *devMap = get_dev_info(device);
+    VkPhysicalDevice physicalDevice = devMap->physicalDevice;
+    VkLayerDispatchTable *pTableDevice = devMap->device_dispatch_table;
+    VkLayerInstanceDispatchTable *pInstanceTable = instance_dispatch_table(physDeviceMap[physicalDevice]->instance);
+
+    destroyCaptureSlot(slot);
+    slot->queueFamilyIndex = queueFamilyIndex;
+    slot->width = imageMap[image1]->imageExtent.width;
+    slot->height = imageMap[image1]->imageExtent.height;
+    slot->format = imageMap[image1]->format;
+    slot->destFormat = getDestFormat(slot->format, &slot->data.ppmSupport);
+    getCopyMode(pInstanceTable, physicalDevice, slot->format, slot->destFormat, &slot->copyOnly, &slot->need2steps);
+
+    bool pass = createReadbackImages(device, pTableDevice, pInstanceTable, physicalDevice, slot->width, slot->height,
+                                     slot->destFormat, slot->need2steps, slot->data) &&
+                createLayerCommandBuffer(device, devMap, queueFamilyIndex, slot->data) &&
+                mapReadbackImage(slot->width, slot->height, slot->format, slot->destFormat, slot->need2steps, slot->data,
+                                 &slot->readback);
+    if (pass) {
+        VkFenceCreateInfo fenceInfo = {VK_STRUCTURE_TYPE_FENCE_CREATE_INFO, NULL, 0};
+        err = pTableDevice->CreateFence(device, &fenceInfo, NULL, &slot->fence);
+        pass = (err == VK_SUCCESS);
+    }
+    if (pass) {
+        VkSemaphoreCreateInfo semaphoreInfo = {VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO, NULL, 0};
+        err = pTableDevice->CreateSemaphore(device, &semaphoreInfo, NULL, &slot->semaphore);
+        pass = (err == VK_SUCCESS);
+    }
+    if (!pass) {
+        destroyCaptureSlot(slot);
+    }
+    return pass;
+}
+
+// Copy image1, presented with *pPresentInfo on queue, to the next slot of the
+// ring and queue it for the worker. On success *pCapturePresentInfo is the
+// present info which waits for the copy. Return false if the screenshot has
+// to be taken synchronously instead.
+static bool captureAsync(VkQueue queue, const VkPresentInfoKHR *pPresentInfo, VkImage image1, const string &fileName,
+                         VkPresentInfoKHR *pCapturePresentInfo) {
+    VkResult err;
+    auto queueIt = queueIndexMap.find(queue);
+    if (queueIt == queueIndexMap.end() || imageMap.find(image1) == imageMap.end()) {
+        return false;
+    }
+    VkDevice device = imageMap[image1]->device;
+    if (FormatIsStencilOnly(imageMap[image1]->format)) {
+        return false;
+    }
+
+    if (captureSlots.size() < captureRingSize) {
+        captureSlots.push_back(new CaptureSlot());
+        nextCaptureSlot = captureSlots.size() - 1;
+    }
+    CaptureSlot *slot = captureSlots[nextCaptureSlot];
+    nextCaptureSlot = (nextCaptureSlot + 1) % captureRingSize;
+    {
+        std::unique_lock<std::mutex> lock(captureLock);
+        captureCond.wait(lock, [slot] { return !slot->busy; });
+    }
+
+    // The slot is reused as is while the presented images don't change.
+    if (slot->data.device != device || slot->queueFamilyIndex != queueIt->second ||
+        slot->width != imageMap[image1]->imageExtent.width || slot->height != imageMap[image1]->imageExtent.height ||
+        slot->format != imageMap[image1]->format) {
+        if (!createCaptureSlot(slot, image1, queueIt->second)) {
+            return false;
         }
     } else {
-        if (FormatElementSize(destformat) > 8) {
-#ifdef ANDROID
-            __android_log_print(ANDROID_LOG_DEBUG, "screenshot", "Format %s NOT supported yet!\n", string_VkFormat(destformat));
-#else
-            fprintf(stderr, "Format %s NOT supported yet!\n", string_VkFormat(destformat));
-#endif
-        } else {
-            file << "# format: " << destformat << " " << string_VkFormat(destformat) << "\n";
-            file << "# srcFormat: " << format << " " << string_VkFormat(format) << "\n";
-            file << "# rowPitch: " << srLayout.rowPitch << "\n";
-            file << "# width: " << width << "\n";
-            file << "# height: " << height << "\n";
-
-            uint32_t pitch = FormatElementSize(destformat);
-
-            ptr += srLayout.offset;
-            for (uint32_t y = 0; y < height; y++) {
-                const char *row = (const char *)ptr;
-                for (uint32_t x = 0; x < width; x++) {
-                    uint64_t pixelValue = 0;
-                    memcpy(&pixelValue, row, pitch);
-                    file.write((const char *)&pixelValue, pitch);
-                    row = row + pitch;
-                }
-                ptr += srLayout.rowPitch;
-            }
-        }
+        err = slot->data.pTableDevice->ResetFences(device, 1, &slot->fence);
+        assert(!err);
+        err = slot->data.pTableDevice->ResetCommandPool(device, slot->data.commandPool, 0);
+        assert(!err);
     }
 
-    file.close();
+    VkLayerDispatchTable *pTableDevice = slot->data.pTableDevice;
+    const VkCommandBufferBeginInfo commandBufferBeginInfo = {VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO, NULL,
+                                                             VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT, NULL};
+    err = pTableDevice->BeginCommandBuffer(slot->data.commandBuffer, &commandBufferBeginInfo);
+    assert(!err);
+    recordReadbackCommands(pTableDevice, slot->data.commandBuffer, image1, slot->destFormat, slot->copyOnly, slot->need2steps,
+                           slot->data);
+    err = pTableDevice->EndCommandBuffer(slot->data.commandBuffer);
+    assert(!err);
+
+    std::vector<VkPipelineStageFlags> waitStages(pPresentInfo->waitSemaphoreCount, VK_PIPELINE_STAGE_TRANSFER_BIT);
+    VkSubmitInfo submitInfo = {};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.waitSemaphoreCount = pPresentInfo->waitSemaphoreCount;
+    submitInfo.pWaitSemaphores = pPresentInfo->pWaitSemaphores;
+    submitInfo.pWaitDstStageMask = waitStages.data();
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &slot->data.commandBuffer;
+    submitInfo.signalSemaphoreCount = 1;
+    submitInfo.pSignalSemaphores = &slot->semaphore;
+    err = pTableDevice->QueueSubmit(queue, 1, &submitInfo, slot->fence);
+    if (err != VK_SUCCESS) {
+        // The fence was reset and won't be signaled, make the slot recreated next time.
+        destroyCaptureSlot(slot);
+        return false;
+    }
+
+    *pCapturePresentInfo = *pPresentInfo;
+    pCapturePresentInfo->waitSemaphoreCount = 1;
+    pCapturePresentInfo->pWaitSemaphores = &slot->semaphore;
+
+    std::lock_guard<std::mutex> lock(captureLock);
+    slot->fileName = fileName;
+    slot->busy = true;
+    captureQueue.push_back(slot);
+    if (!captureThread.thread.joinable()) {
+        captureThread.thread = std::thread(captureWorker);
+    }
+    captureCond.notify_all();
     return true;
 }
 
@@ -1491,6 +1747,9 @@ VKAPI_ATTR void VKAPI_CALL DestroyDevice(VkDevice device, const VkAllocationCall
     DeviceMapStruct *devMap = get_dev_info(device);
     assert(devMap);
     VkLayerDispatchTable *pDisp = devMap->device_dispatch_table;
+    loader_platform_thread_lock_mutex(&globalLock);
+    destroyCaptureSlots(device);
+    loader_platform_thread_unlock_mutex(&globalLock);
     pDisp->DestroyDevice(device, pAllocator);
 
     if (vk_screenshot_dir_used_env_var) {
@@ -1688,6 +1947,7 @@ VKAPI_ATTR VkResult VKAPI_CALL QueuePresentKHR(VkQueue queue, const VkPresentInf
     DeviceMapStruct *devMap = get_dev_info((VkDevice)queue);
     assert(devMap);
     VkLayerDispatchTable *pDisp = devMap->device_dispatch_table;
+    VkPresentInfoKHR capturePresentInfo;
     loader_platform_thread_lock_mutex(&globalLock);
 
     if (!screenshotFrames.empty() || screenShotFrameRange.valid) {
@@ -1701,44 +1961,49 @@ VKAPI_ATTR VkResult VKAPI_CALL QueuePresentKHR(VkQueue queue, const VkPresentInf
             string fileName;
 
             if (vk_screenshot_dir == NULL || strlen(vk_screenshot_dir) == 0) {
-                fileName = to_string(g_frameNumber) + ".ppm";
+                fileName = to_string(g_frameNumber) + outputFormatExtension(outputFormat);
             } else {
                 fileName = vk_screenshot_dir;
-                fileName += "/" + to_string(g_frameNumber) + ".ppm";
+                fileName += "/" + to_string(g_frameNumber) + outputFormatExtension(outputFormat);
             }
 
             char buffer[64];
             snprintf(buffer, sizeof(buffer), "%d", g_frameNumber);
             std::string base(buffer);
-            fileName = screenshotPrefix + base + ".ppm";
+            fileName = screenshotPrefix + base + outputFormatExtension(outputFormat);
 
             VkImage image;
             VkSwapchainKHR swapchain;
             // We'll dump only one image: the first
             swapchain = pPresentInfo->pSwapchains[0];
             image = swapchainMap[swapchain]->imageList[pPresentInfo->pImageIndices[0]];
-            if (devMap->queue != queue) {
-                // Multiple queues are used
-                pDisp->QueueWaitIdle(queue);
-            }
+            if (captureRingSize > 0 && captureAsync(queue, pPresentInfo, image, fileName, &capturePresentInfo)) {
+                // The worker writes the file, the present waits for the copy.
+                pPresentInfo = &capturePresentInfo;
+            } else {
+                if (devMap->queue != queue) {
+                    // Multiple queues are used
+                    pDisp->QueueWaitIdle(queue);
+                }
 
-            WritePPMCleanupData copyImageData;
-            bool ret = preparePPM(VK_NULL_HANDLE, image, copyImageData);
-            ret |= writePPM(fileName.c_str(), image, copyImageData);
-            if (ret) {
+                WritePPMCleanupData copyImageData;
+                bool ret = preparePPM(VK_NULL_HANDLE, image, copyImageData);
+                ret |= writePPM(fileName.c_str(), image, copyImageData);
+                if (ret) {
 #ifdef ANDROID
-                __android_log_print(ANDROID_LOG_INFO, "screenshot", "QueuePresent Screen capture file is: %s", fileName.c_str());
+                    __android_log_print(ANDROID_LOG_INFO, "screenshot", "QueuePresent Screen capture file is: %s", fileName.c_str());
 #else
-                printf("QueuePresent Screen capture file is: %s \n", fileName.c_str());
+                    printf("QueuePresent Screen capture file is: %s \n", fileName.c_str());
 #endif
-            } else {
+                } else {
 #ifdef ANDROID
-                __android_log_print(ANDROID_LOG_DEBUG, "screenshot", "Failed to save screenshot to file %s.", fileName.c_str());
+                    __android_log_print(ANDROID_LOG_DEBUG, "screenshot", "Failed to save screenshot to file %s.", fileName.c_str());
 #else
-                fprintf(stderr, "Failed to save screenshot to file %s.\n", fileName.c_str());
+                    fprintf(stderr, "Failed to save screenshot to file %s.\n", fileName.c_str());
 #endif
+                }
+                copyImageData.CleanupData();
             }
-            copyImageData.CleanupData();
             if (inScreenShotFrames) {
                 screenshotFrames.erase(it);
             }
@@ -2294,7 +2559,7 @@ VkResult OverrideQueueSubmit(VkQueue queue, uint32_t submitCount, const VkSubmit
                             string fileName;
                             // std::to_string is not supported currently on Android
                             std::string base(commandBufferToImages[*cmdBufferIter][i].dumpFileName);
-                            fileName = screenshotPrefix + base + ".ppm";
+                            fileName = screenshotPrefix + base + outputFormatExtension(outputFormat);
 
                             bool ret = writePPM(fileName.c_str(), commandBufferToImages[*cmdBufferIter][i].renderpassImage, commandBufferToImages[*cmdBufferIter][i].copyBufData);
                             if (ret) {
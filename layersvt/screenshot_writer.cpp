@@ -0,0 +1,293 @@
+/*
+ *
+ * Copyright (C) 2016-2024 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include <fstream>
+#include <vector>
+
+#include "vk_layer_utils.h"
+#include "vk_enum_string_helper.h"
+
+#include "screenshot_writer.h"
+
+#ifdef ANDROID
+#include <android/log.h>
+#endif
+
+using namespace std;
+
+namespace screenshot {
+
+static void logError(const char *message, const char *argument) {
+#ifdef ANDROID
+    __android_log_print(ANDROID_LOG_DEBUG, "screenshot", message, argument);
+#else
+    fprintf(stderr, message, argument);
+    fprintf(stderr, "\n");
+#endif
+}
+
+bool parseOutputFormat(const char *name, OutputFormat *pFormat) {
+    if (strcmp(name, "ppm") == 0) {
+        *pFormat = OUTPUT_PPM;
+    } else if (strcmp(name, "png") == 0) {
+        *pFormat = OUTPUT_PNG;
+    } else if (strcmp(name, "raw") == 0) {
+        *pFormat = OUTPUT_RAW;
+    } else if (strcmp(name, "hash") == 0) {
+        *pFormat = OUTPUT_HASH;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+const char *outputFormatExtension(OutputFormat format) {
+    switch (format) {
+        case OUTPUT_PNG:
+            return ".png";
+        case OUTPUT_RAW:
+            return ".raw";
+        case OUTPUT_HASH:
+            return ".hash";
+        default:
+            return ".ppm";
+    }
+}
+
+// Call rowFunc(y, rgb) for every row of the image converted to 8-bit RGB.
+// Each channel is scaled down to 8 bits, channels the source format doesn't
+// have are 0 and alpha is dropped.
+template <typename RowFunc>
+static void forEachRgbRow(const ReadbackImage &image, RowFunc rowFunc) {
+    uint32_t const numChannels = FormatComponentCount(image.format);
+    uint32_t const elementSize = FormatElementSize(image.destFormat);
+    uint32_t const bytesPerChannel = elementSize / FormatComponentCount(image.destFormat);
+    uint32_t const maxColorValue = pow(256, bytesPerChannel) - 1;
+    uint32_t const factor = maxColorValue / 255;
+
+    vector<uint8_t> rgb(image.width * 3, 0);
+    const char *ptr = image.data;
+    for (uint32_t y = 0; y < image.height; y++) {
+        const char *texel = ptr;
+        uint8_t *out = rgb.data();
+        for (uint32_t x = 0; x < image.width; x++) {
+            for (uint32_t i = 0; i < 3; i++) {
+                uint32_t color = 0;
+                if (i < numChannels) {
+                    memcpy(&color, texel + i * bytesPerChannel, bytesPerChannel);
+                    color /= factor;
+                }
+                *out++ = (uint8_t)color;
+            }
+            texel += elementSize;
+        }
+        rowFunc(y, rgb.data());
+        ptr += image.rowPitch;
+    }
+}
+
+static void writeHeader(ofstream &file, const ReadbackImage &image) {
+    file << "# format: " << image.destFormat << " " << string_VkFormat(image.destFormat) << "\n";
+    file << "# srcFormat: " << image.format << " " << string_VkFormat(image.format) << "\n";
+    file << "# rowPitch: " << image.rowPitch << "\n";
+}
+
+static void writePpm(ofstream &file, const ReadbackImage &image) {
+    file << "P6\n";
+    writeHeader(file, image);
+    file << image.width << "\n";
+    file << image.height << "\n";
+    file << 255 << "\n";
+    forEachRgbRow(image, [&](uint32_t, const uint8_t *rgb) { file.write((const char *)rgb, image.width * 3); });
+}
+
+static void writeRaw(ofstream &file, const ReadbackImage &image) {
+    writeHeader(file, image);
+    file << "# width: " << image.width << "\n";
+    file << "# height: " << image.height << "\n";
+
+    uint32_t const rowSize = image.width * FormatElementSize(image.destFormat);
+    const char *ptr = image.data;
+    for (uint32_t y = 0; y < image.height; y++) {
+        file.write(ptr, rowSize);
+        ptr += image.rowPitch;
+    }
+}
+
+static uint32_t crc32(uint32_t crc, const uint8_t *data, size_t size) {
+    static const vector<uint32_t> table = [] {
+        vector<uint32_t> t(256);
+        for (uint32_t n = 0; n < 256; n++) {
+            uint32_t c = n;
+            for (int k = 0; k < 8; k++) {
+                c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+            }
+            t[n] = c;
+        }
+        return t;
+    }();
+    crc = ~crc;
+    for (size_t i = 0; i < size; i++) {
+        crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+static uint32_t adler32(const uint8_t *data, size_t size) {
+    uint32_t a = 1, b = 0;
+    while (size > 0) {
+        // 5552 bytes is the most that can be summed before b overflows.
+        size_t n = std::min<size_t>(size, 5552);
+        for (size_t i = 0; i < n; i++) {
+            a += data[i];
+            b += a;
+        }
+        a %= 65521;
+        b %= 65521;
+        data += n;
+        size -= n;
+    }
+    return (b << 16) | a;
+}
+
+static void putBE32(uint8_t *dst, uint32_t value) {
+    dst[0] = value >> 24;
+    dst[1] = value >> 16;
+    dst[2] = value >> 8;
+    dst[3] = value;
+}
+
+static void writePngChunk(ofstream &file, const char *type, const uint8_t *data, uint32_t size) {
+    uint8_t header[8];
+    putBE32(header, size);
+    memcpy(header + 4, type, 4);
+    file.write((const char *)header, 8);
+    file.write((const char *)data, size);
+    uint8_t crc[4];
+    putBE32(crc, crc32(crc32(0, header + 4, 4), data, size));
+    file.write((const char *)crc, 4);
+}
+
+// 8-bit RGB PNG. The image data is put in stored (uncompressed) deflate
+// blocks: the files are as big as a PPM but encoding costs no more than a copy.
+static void writePng(ofstream &file, const ReadbackImage &image) {
+    static const uint8_t signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+    file.write((const char *)signature, 8);
+
+    uint8_t ihdr[13];
+    putBE32(ihdr, image.width);
+    putBE32(ihdr + 4, image.height);
+    ihdr[8] = 8;   // bit depth
+    ihdr[9] = 2;   // truecolor
+    ihdr[10] = 0;  // deflate
+    ihdr[11] = 0;  // adaptive filtering
+    ihdr[12] = 0;  // no interlace
+    writePngChunk(file, "IHDR", ihdr, sizeof(ihdr));
+
+    // Every scanline starts with its filter type, 0 is none.
+    size_t const lineSize = 1 + (size_t)image.width * 3;
+    vector<uint8_t> scanlines(lineSize * image.height);
+    forEachRgbRow(image, [&](uint32_t y, const uint8_t *rgb) {
+        scanlines[y * lineSize] = 0;
+        memcpy(&scanlines[y * lineSize + 1], rgb, image.width * 3);
+    });
+
+    size_t const maxBlock = 65535;
+    size_t const blockCount = std::max<size_t>(1, (scanlines.size() + maxBlock - 1) / maxBlock);
+    vector<uint8_t> zlib;
+    zlib.reserve(2 + blockCount * 5 + scanlines.size() + 4);
+    zlib.push_back(0x78);
+    zlib.push_back(0x01);
+    size_t pos = 0;
+    do {
+        size_t const len = std::min(maxBlock, scanlines.size() - pos);
+        zlib.push_back(pos + len == scanlines.size() ? 1 : 0);
+        zlib.push_back(len & 0xff);
+        zlib.push_back(len >> 8);
+        zlib.push_back(~len & 0xff);
+        zlib.push_back((~len >> 8) & 0xff);
+        zlib.insert(zlib.end(), scanlines.begin() + pos, scanlines.begin() + pos + len);
+        pos += len;
+    } while (pos < scanlines.size());
+    uint8_t adler[4];
+    putBE32(adler, adler32(scanlines.data(), scanlines.size()));
+    zlib.insert(zlib.end(), adler, adler + 4);
+    writePngChunk(file, "IDAT", zlib.data(), zlib.size());
+
+    writePngChunk(file, "IEND", nullptr, 0);
+}
+
+// 64-bit difference hash. The image is reduced to 9x8 luminance cells and
+// every bit tells if a cell is brighter than its right neighbour, so similar
+// images get hashes with a small Hamming distance.
+static uint64_t perceptualHash(const ReadbackImage &image) {
+    const uint32_t cols = 9, rows = 8;
+    double sum[rows][cols] = {};
+    uint32_t count[rows][cols] = {};
+    forEachRgbRow(image, [&](uint32_t y, const uint8_t *rgb) {
+        uint32_t const cy = y * rows / image.height;
+        for (uint32_t x = 0; x < image.width; x++) {
+            uint32_t const cx = x * cols / image.width;
+            sum[cy][cx] += 0.299 * rgb[x * 3] + 0.587 * rgb[x * 3 + 1] + 0.114 * rgb[x * 3 + 2];
+            count[cy][cx]++;
+        }
+    });
+
+    uint64_t hash = 0;
+    for (uint32_t y = 0; y < rows; y++) {
+        for (uint32_t x = 0; x < cols - 1; x++) {
+            double const left = count[y][x] ? sum[y][x] / count[y][x] : 0;
+            double const right = count[y][x + 1] ? sum[y][x + 1] / count[y][x + 1] : 0;
+            hash = (hash << 1) | (left > right ? 1 : 0);
+        }
+    }
+    return hash;
+}
+
+bool writeScreenshotFile(const string &fileName, const ReadbackImage &image, OutputFormat format) {
+    if (format == OUTPUT_HASH && !image.ppmSupport) {
+        logError("Format %s can't be hashed!", string_VkFormat(image.destFormat));
+        return false;
+    }
+
+    ofstream file(fileName.c_str(), ios::binary);
+    if (!file.is_open()) {
+        logError("Failed to open output file: %s. Be sure to grant read and write permissions.", fileName.c_str());
+        return false;
+    }
+
+    if (!image.ppmSupport || format == OUTPUT_RAW) {
+        writeRaw(file, image);
+    } else if (format == OUTPUT_PNG) {
+        writePng(file, image);
+    } else if (format == OUTPUT_HASH) {
+        char hash[20];
+        snprintf(hash, sizeof(hash), "%016llx\n", (unsigned long long)perceptualHash(image));
+        file << hash;
+    } else {
+        writePpm(file, image);
+    }
+
+    file.close();
+    return !file.fail();
+}
+
+}  // namespace screenshot
@@ -0,0 +1,54 @@
+/*
+ *
+ * Copyright (C) 2016-2024 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vulkan/vulkan.h>
+
+namespace screenshot {
+
+// The file types a screenshot can be saved as.
+typedef enum OutputFormat {
+    OUTPUT_PPM = 0,
+    OUTPUT_PNG = 1,
+    OUTPUT_RAW = 2,   // the pixels of the readback format, without row padding
+    OUTPUT_HASH = 3,  // only a 64-bit perceptual hash of the image, as hex text
+} OutputFormat;
+
+// An image read back to host memory.
+typedef struct {
+    const char *data;  // first texel, the subresource offset is already applied
+    VkDeviceSize rowPitch;
+    uint32_t width;
+    uint32_t height;
+    VkFormat format;      // format of the captured image
+    VkFormat destFormat;  // format of data
+    bool ppmSupport;      // false if data can't be converted to 8-bit RGB, it's then saved as raw data
+} ReadbackImage;
+
+// Parse "ppm", "png", "raw" or "hash". Return false for anything else.
+bool parseOutputFormat(const char *name, OutputFormat *pFormat);
+
+// File extension of the output format, including the dot.
+const char *outputFormatExtension(OutputFormat format);
+
+// Encode image as format and write it to fileName.
+bool writeScreenshotFile(const std::string &fileName, const ReadbackImage &image, OutputFormat format);
+
+}  // namespace screenshot
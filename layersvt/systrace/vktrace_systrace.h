@@ -17,6 +17,8 @@
 
 #pragma once
 
+#include <cinttypes>
+
 #if defined(__ANDROID__)
 #include <android/log.h>
 #endif
@@ -25,3 +27,64 @@
 #define printf(...) __android_log_print(ANDROID_LOG_DEBUG, "SYSTRACE: ", __VA_ARGS__);
 #endif
 
+// Backends the begin/end events of the Vulkan calls are sent to. Selected
+// with VK_SYSTRACE_BACKEND (debug.vulkan.systrace.backend on Android):
+//
+//   atrace  ATrace_beginSection/ATrace_endSection, default on Android.
+//   ftrace  "B|pid|name" / "E|pid" lines written to the tracefs trace_marker,
+//           default on Linux. The events land in the kernel ftrace buffer, so
+//           a Perfetto or trace-cmd capture shows them next to the scheduling
+//           data of the same threads.
+//   file    Events are kept in per-thread buffers in memory and written as
+//           Chrome JSON trace events to VK_SYSTRACE_FILE (default
+//           systrace.json), which the Perfetto UI opens directly. This is the
+//           cheapest backend, an event is a clock read and a store.
+//   none    Pass the calls through.
+//
+// VK_SYSTRACE_ARGS=1 (debug.vulkan.systrace.args) adds a short summary of the
+// arguments of some calls, e.g. the draw, dispatch and submit counts.
+namespace systrace {
+
+enum Backend { BACKEND_NONE = 0, BACKEND_ATRACE, BACKEND_FTRACE, BACKEND_FILE };
+
+extern Backend g_backend;
+extern bool g_args;
+
+// Selects the backend on the first call. Called by vkCreateInstance, calls
+// made before are not traced.
+void Init();
+void Flush();
+void BeginSection(const char* name);
+void BeginSectionArgs(const char* name, const char* format, ...)
+#if defined(__GNUC__)
+    __attribute__((format(printf, 2, 3)))
+#endif
+    ;
+void EndSection();
+
+}  // namespace systrace
+
+#define SYSTRACE_BEGIN(name)                                       \
+    do {                                                           \
+        if (systrace::g_backend != systrace::BACKEND_NONE) {       \
+            systrace::BeginSection(name);                          \
+        }                                                          \
+    } while (0)
+
+#define SYSTRACE_BEGIN_ARGS(name, ...)                             \
+    do {                                                           \
+        if (systrace::g_backend != systrace::BACKEND_NONE) {       \
+            if (systrace::g_args) {                                \
+                systrace::BeginSectionArgs(name, __VA_ARGS__);     \
+            } else {                                               \
+                systrace::BeginSection(name);                      \
+            }                                                      \
+        }                                                          \
+    } while (0)
+
+#define SYSTRACE_END()                                             \
+    do {                                                           \
+        if (systrace::g_backend != systrace::BACKEND_NONE) {       \
+            systrace::EndSection();                                \
+        }                                                          \
+    } while (0)
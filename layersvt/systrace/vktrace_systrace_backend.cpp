@@ -0,0 +1,414 @@
+/*
+ * (C) COPYRIGHT 2024 ARM Limited
+ * ALL RIGHTS RESERVED
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     LICENSE-2.0" target="_blank" rel="nofollow">http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#if defined(__ANDROID__)
+#include <android/trace.h>
+#include <sys/system_properties.h>
+#endif
+
+#include "vktrace_systrace.h"
+
+namespace systrace {
+
+Backend g_backend = BACKEND_NONE;
+bool g_args = false;
+
+// Size of the formatted "B|pid|name args" lines and of the argument summaries.
+static const size_t kMaxEventLength = 256;
+// Number of events a thread buffers before handing them to the writer thread.
+static const uint32_t kEventsPerChunk = 16 * 1024;
+// Bytes of argument summaries a chunk holds.
+static const size_t kArgsPerChunk = 256 * 1024;
+
+static int s_markerFd = -1;
+static pid_t s_pid = 0;
+
+static std::string GetSetting(const char* envName, const char* propertyName) {
+#if defined(__ANDROID__)
+    char value[PROP_VALUE_MAX] = {};
+    if (__system_property_get(propertyName, value) > 0) {
+        return value;
+    }
+#else
+    (void)propertyName;
+#endif
+    const char* value = getenv(envName);
+    return value ? value : "";
+}
+
+static uint64_t GetTime() {
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return (uint64_t)time.tv_sec * 1000000000ull + time.tv_nsec;
+}
+
+// ---------------------------------------------------------------------------
+// file backend
+//
+// Every thread appends its events to its own chunk without taking a lock. A
+// full chunk is handed over to a writer thread, which formats the events and
+// writes them to the file, so the traced threads never wait for the disk.
+
+struct Event {
+    uint64_t time;
+    const char* name;    // the generated code only passes string literals
+    uint32_t argOffset;  // offset + 1 in Chunk::args, 0 if there is no summary
+    char type;           // 'B' or 'E'
+};
+
+// Only the owning thread writes to a chunk. It stores an event and its
+// summary first and then publishes it with a release store of committed, so
+// the exit handler can read the events of a chunk that is still in use up to
+// an acquire load of committed. The storage never moves.
+struct Chunk {
+    explicit Chunk(uint32_t threadId)
+        : tid(threadId), events(new Event[kEventsPerChunk]), args(new char[kArgsPerChunk]), argsSize(0), committed(0) {}
+
+    uint32_t tid;
+    std::unique_ptr<Event[]> events;
+    std::unique_ptr<char[]> args;
+    size_t argsSize;  // only used by the owning thread
+    std::atomic<uint32_t> committed;
+};
+
+class ThreadBuffer;
+
+// s_mutex guards the chunk queue, the list of thread buffers, the chunk
+// pointers of the thread buffers and s_file being closed.
+static std::mutex s_mutex;
+static std::condition_variable s_chunkCondition;
+static std::deque<Chunk*> s_fullChunks;
+static std::vector<ThreadBuffer*> s_threadBuffers;
+static bool s_flushRequested = false;
+static bool s_exiting = false;
+static std::thread s_writerThread;
+static FILE* s_file = nullptr;  // nullptr again once the exit handler has closed it
+
+// Writes a string without its quotes, escaped as JSON requires.
+static void WriteJsonString(const char* str) {
+    for (const char* c = str; *c != '\0'; c++) {
+        unsigned char ch = (unsigned char)*c;
+        if (ch == '"' || ch == '\\') {
+            fputc('\\', s_file);
+            fputc(ch, s_file);
+        } else if (ch < 0x20) {
+            fprintf(s_file, "\\u%04x", ch);
+        } else {
+            fputc(ch, s_file);
+        }
+    }
+}
+
+static void WriteChunk(const Chunk& chunk, uint32_t count) {
+    for (uint32_t i = 0; i < count; i++) {
+        const Event& event = chunk.events[i];
+        fputs("{\"name\":\"", s_file);
+        if (event.type == 'B') {
+            WriteJsonString(event.name);
+        }
+        fprintf(s_file, "\",\"ph\":\"%c\",\"ts\":%" PRIu64 ".%03u,\"pid\":%d,\"tid\":%u", event.type, event.time / 1000,
+                (uint32_t)(event.time % 1000), (int)s_pid, chunk.tid);
+        if (event.argOffset > 0) {
+            fputs(",\"args\":{\"summary\":\"", s_file);
+            WriteJsonString(chunk.args.get() + event.argOffset - 1);
+            fputs("\"}", s_file);
+        }
+        fputs("},\n", s_file);
+    }
+}
+
+class ThreadBuffer {
+   public:
+    ThreadBuffer() : m_tid((uint32_t)syscall(SYS_gettid)), m_pChunk(new Chunk(m_tid)) {
+        std::lock_guard<std::mutex> lock(s_mutex);
+        s_threadBuffers.push_back(this);
+    }
+
+    ~ThreadBuffer() {
+        std::lock_guard<std::mutex> lock(s_mutex);
+        if (s_file != nullptr) {
+            s_fullChunks.push_back(m_pChunk);
+            s_chunkCondition.notify_one();
+        } else {
+            delete m_pChunk;
+        }
+        m_pChunk = nullptr;
+        for (auto it = s_threadBuffers.begin(); it != s_threadBuffers.end(); ++it) {
+            if (*it == this) {
+                s_threadBuffers.erase(it);
+                break;
+            }
+        }
+    }
+
+    void Add(char type, const char* name, const char* args = nullptr) {
+        uint32_t argOffset = 0;
+        if (args != nullptr) {
+            size_t length = strlen(args) + 1;
+            if (m_pChunk->argsSize + length > kArgsPerChunk) {
+                HandOver(false);
+            }
+            argOffset = (uint32_t)m_pChunk->argsSize + 1;
+            memcpy(m_pChunk->args.get() + m_pChunk->argsSize, args, length);
+            m_pChunk->argsSize += length;
+        }
+        uint32_t index = m_pChunk->committed.load(std::memory_order_relaxed);
+        m_pChunk->events[index] = {GetTime(), name, argOffset, type};
+        m_pChunk->committed.store(index + 1, std::memory_order_release);
+        if (index + 1 >= kEventsPerChunk) {
+            HandOver(false);
+        }
+    }
+
+    // Give the current chunk to the writer thread.
+    void HandOver(bool flush) {
+        Chunk* pChunk = new Chunk(m_tid);
+        std::lock_guard<std::mutex> lock(s_mutex);
+        if (s_file == nullptr) {
+            // The file is closed at exit, drop the events.
+            delete pChunk;
+            m_pChunk->argsSize = 0;
+            m_pChunk->committed.store(0, std::memory_order_relaxed);
+            return;
+        }
+        s_fullChunks.push_back(m_pChunk);
+        m_pChunk = pChunk;
+        s_flushRequested |= flush;
+        s_chunkCondition.notify_one();
+    }
+
+    // s_mutex must be held.
+    const Chunk* GetChunkLocked() const { return m_pChunk; }
+
+   private:
+    uint32_t m_tid;
+    Chunk* m_pChunk;
+};
+
+static ThreadBuffer& GetThreadBuffer() {
+    static thread_local ThreadBuffer buffer;
+    return buffer;
+}
+
+static void WriterThread() {
+    std::unique_lock<std::mutex> lock(s_mutex);
+    while (true) {
+        s_chunkCondition.wait(lock, [] { return s_exiting || s_flushRequested || !s_fullChunks.empty(); });
+        while (!s_fullChunks.empty()) {
+            Chunk* pChunk = s_fullChunks.front();
+            s_fullChunks.pop_front();
+            lock.unlock();
+            WriteChunk(*pChunk, pChunk->committed.load(std::memory_order_acquire));
+            delete pChunk;
+            lock.lock();
+        }
+        if (s_flushRequested) {
+            fflush(s_file);
+            s_flushRequested = false;
+        }
+        if (s_exiting) {
+            break;
+        }
+    }
+}
+
+// Writes what is left in the buffers when the process exits. Other threads
+// may still be adding events to their chunks, only the published events are
+// written.
+static struct FileCloser {
+    ~FileCloser() {
+        if (!s_writerThread.joinable()) {
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(s_mutex);
+            s_exiting = true;
+        }
+        s_chunkCondition.notify_one();
+        s_writerThread.join();
+
+        std::lock_guard<std::mutex> lock(s_mutex);
+        for (Chunk* pChunk : s_fullChunks) {
+            WriteChunk(*pChunk, pChunk->committed.load(std::memory_order_acquire));
+            delete pChunk;
+        }
+        s_fullChunks.clear();
+        for (ThreadBuffer* buffer : s_threadBuffers) {
+            const Chunk* pChunk = buffer->GetChunkLocked();
+            WriteChunk(*pChunk, pChunk->committed.load(std::memory_order_acquire));
+        }
+        fclose(s_file);
+        s_file = nullptr;
+    }
+} s_fileCloser;
+
+// ---------------------------------------------------------------------------
+
+static bool OpenTraceMarker() {
+    static const char* kPaths[] = {"/sys/kernel/tracing/trace_marker", "/sys/kernel/debug/tracing/trace_marker"};
+    for (const char* path : kPaths) {
+        s_markerFd = open(path, O_WRONLY | O_CLOEXEC);
+        if (s_markerFd >= 0) {
+            return true;
+        }
+    }
+    printf("Cannot open trace_marker, is tracefs mounted and writable? Vulkan calls are not traced.\n");
+    return false;
+}
+
+static bool OpenFile() {
+    std::string path = GetSetting("VK_SYSTRACE_FILE", "debug.vulkan.systrace.file");
+    if (path.empty()) {
+#if defined(__ANDROID__)
+        path = "/sdcard/systrace.json";
+#else
+        path = "systrace.json";
+#endif
+    }
+    s_file = fopen(path.c_str(), "w");
+    if (s_file == nullptr) {
+        printf("Cannot open %s, Vulkan calls are not traced.\n", path.c_str());
+        return false;
+    }
+    // The JSON trace format allows the closing bracket to be missing, so
+    // threads can append their events at any time.
+    fputs("[\n", s_file);
+    s_writerThread = std::thread(WriterThread);
+    return true;
+}
+
+void Init() {
+    static std::once_flag once;
+    std::call_once(once, [] {
+        s_pid = getpid();
+        g_args = (GetSetting("VK_SYSTRACE_ARGS", "debug.vulkan.systrace.args") == "1");
+
+        std::string backend = GetSetting("VK_SYSTRACE_BACKEND", "debug.vulkan.systrace.backend");
+        if (backend.empty()) {
+#if defined(__ANDROID__)
+            backend = "atrace";
+#else
+            backend = "ftrace";
+#endif
+        }
+        if (backend == "ftrace") {
+            g_backend = OpenTraceMarker() ? BACKEND_FTRACE : BACKEND_NONE;
+        } else if (backend == "file") {
+            g_backend = OpenFile() ? BACKEND_FILE : BACKEND_NONE;
+#if defined(__ANDROID__)
+        } else if (backend == "atrace") {
+            g_backend = BACKEND_ATRACE;
+#endif
+        } else {
+            if (backend != "none") {
+                printf("Unknown systrace backend %s, Vulkan calls are not traced.\n", backend.c_str());
+            }
+            g_backend = BACKEND_NONE;
+        }
+    });
+}
+
+void Flush() {
+    if (g_backend == BACKEND_FILE) {
+        GetThreadBuffer().HandOver(true);
+    }
+}
+
+static void Begin(const char* name, const char* args) {
+    switch (g_backend) {
+        case BACKEND_FILE:
+            GetThreadBuffer().Add('B', name, args);
+            break;
+        case BACKEND_FTRACE: {
+            char line[kMaxEventLength];
+            int length = args ? snprintf(line, sizeof(line), "B|%d|%s %s", (int)s_pid, name, args)
+                              : snprintf(line, sizeof(line), "B|%d|%s", (int)s_pid, name);
+            if (length > 0) {
+                ssize_t written __attribute__((unused)) = write(s_markerFd, line, std::min((size_t)length, sizeof(line) - 1));
+            }
+            break;
+        }
+#if defined(__ANDROID__)
+        case BACKEND_ATRACE:
+            if (args) {
+                char section[kMaxEventLength];
+                snprintf(section, sizeof(section), "%s %s", name, args);
+                ATrace_beginSection(section);
+            } else {
+                ATrace_beginSection(name);
+            }
+            break;
+#endif
+        default:
+            break;
+    }
+}
+
+void BeginSection(const char* name) { Begin(name, nullptr); }
+
+void BeginSectionArgs(const char* name, const char* format, ...) {
+    char args[kMaxEventLength];
+    va_list ap;
+    va_start(ap, format);
+    vsnprintf(args, sizeof(args), format, ap);
+    va_end(ap);
+    Begin(name, args);
+}
+
+void EndSection() {
+    switch (g_backend) {
+        case BACKEND_FILE:
+            GetThreadBuffer().Add('E', nullptr);
+            break;
+        case BACKEND_FTRACE: {
+            char line[32];
+            int length = snprintf(line, sizeof(line), "E|%d", (int)s_pid);
+            if (length > 0) {
+                ssize_t written __attribute__((unused)) = write(s_markerFd, line, (size_t)length);
+            }
+            break;
+        }
+#if defined(__ANDROID__)
+        case BACKEND_ATRACE:
+            ATrace_endSection();
+            break;
+#endif
+        default:
+            break;
+    }
+}
+
+}  // namespace systrace
@@ -2022,6 +2022,7 @@ bool is_union(const char *t)
 
 //========================= Function Implementations ========================//
 
+// Set by the heads, so that the bodies can be formatted on other threads.
 static bool needFuncComma = false;
 
 @foreach function where(not '{funcName}' in ['vkGetDeviceProcAddr', 'vkGetInstanceProcAddr'])
@@ -2033,6 +2034,7 @@ std::ostream& dump_json_head_{funcName}(ApiDumpInstance& dump_inst, {funcTypedPa
         needFuncComma = false;
 
     if (needFuncComma) settings.stream() << ",\\n";
+    needFuncComma = true;
 
     // Display apicall name
     settings.stream() << settings.indentation(2) << "{{\\n";
@@ -2065,6 +2067,7 @@ std::ostream& dump_json_head_{funcName}Remap{postfixName}(ApiDumpInstance& dump_
         needFuncComma = false;
 
     if (needFuncComma) settings.stream() << ",\\n";
+    needFuncComma = true;
 
     // Display apicall name
     settings.stream() << settings.indentation(2) << "{{\\n";
@@ -2097,6 +2100,7 @@ std::ostream& dump_json_head_{funcName}Remap(ApiDumpInstance& dump_inst, {funcTy
         needFuncComma = false;
 
     if (needFuncComma) settings.stream() << ",\\n";
+    needFuncComma = true;
 
     // Display apicall name
     settings.stream() << settings.indentation(2) << "{{\\n";
@@ -2128,6 +2132,7 @@ std::ostream& dump_json_head_{funcName}RemapAsInstanceSGHandle(ApiDumpInstance&
         needFuncComma = false;
 
     if (needFuncComma) settings.stream() << ",\\n";
+    needFuncComma = true;
 
     // Display apicall name
     settings.stream() << settings.indentation(2) << "{{\\n";
@@ -2159,6 +2164,7 @@ std::ostream& dump_json_head_{funcName}RemapAsInstanceSGHandle(ApiDumpInstance&
         needFuncComma = false;
 
     if (needFuncComma) settings.stream() << ",\\n";
+    needFuncComma = true;
 
     // Display apicall name
     settings.stream() << settings.indentation(2) << "{{\\n";
@@ -2249,7 +2255,6 @@ std::ostream& dump_json_body_{funcName}(ApiDumpInstance& dump_inst, {funcTypedPa
         settings.stream() << "\\n" << settings.indentation(3) << "]\\n";
     }}
     settings.stream() << settings.indentation(2) << "}}";
-    needFuncComma = true;
     if (settings.shouldFlush()) settings.stream().flush();
     return settings.stream();
 }}
@@ -163,7 +163,11 @@ class LayerFactoryOutputGenerator(OutputGenerator):
  */
 
 #include <string.h>
+#include <atomic>
 #include <mutex>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
 
 #define VALIDATION_ERROR_MAP_IMPL
 
@@ -181,6 +185,8 @@ debug_report_data *vlf_report_data = VK_NULL_HANDLE;
 
 #include "layer_factory.h"
 
+vlf_interceptor_masks vlf_masks[VLF_ENTRY_POINT_COUNT];
+
 struct instance_layer_data {
     VkLayerInstanceDispatchTable dispatch_table;
     VkInstance instance = VK_NULL_HANDLE;
@@ -199,8 +205,93 @@ struct device_layer_data {
     instance_layer_data *instance_data = nullptr;
 };
 
-static std::unordered_map<void *, device_layer_data *> device_layer_data_map;
-static std::unordered_map<void *, instance_layer_data *> instance_layer_data_map;
+// Layer data of the dispatchable handles, keyed by their dispatch key. There
+// are rarely more than a few instances and devices, so the data is also kept
+// in a small array which the entry points scan without taking a lock. Only
+// the first lookup of a key and FreeLayerDataPtr() lock the map.
+template <typename DATA_T>
+class layer_data_map_t {
+   public:
+    DATA_T *Get(void *key) {
+        for (auto &slot : cache_) {
+            if (slot.key.load(std::memory_order_acquire) == key) {
+                DATA_T *data = slot.data.load(std::memory_order_relaxed);
+                if (data != nullptr) return data;
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        DATA_T *&data = map_[key];
+        if (data == nullptr) {
+            data = new DATA_T;
+        }
+        // The cache is only modified with the lock held, so the key is not in it
+        for (auto &slot : cache_) {
+            if (slot.key.load(std::memory_order_relaxed) == nullptr) {
+                slot.data.store(data, std::memory_order_relaxed);
+                slot.key.store(key, std::memory_order_release);
+                break;
+            }
+        }
+        return data;
+    }
+
+    void Free(void *key) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (auto &slot : cache_) {
+            if (slot.key.load(std::memory_order_relaxed) == key) {
+                slot.key.store(nullptr, std::memory_order_relaxed);
+                slot.data.store(nullptr, std::memory_order_relaxed);
+                break;
+            }
+        }
+        auto got = map_.find(key);
+        if (got != map_.end()) {
+            delete got->second;
+            map_.erase(got);
+        }
+    }
+
+   private:
+    struct cache_slot {
+        std::atomic<void *> key{nullptr};
+        std::atomic<DATA_T *> data{nullptr};
+    };
+
+    cache_slot cache_[16];
+    std::mutex mutex_;
+    std::unordered_map<void *, DATA_T *> map_;
+};
+
+template <typename DATA_T>
+DATA_T *GetLayerDataPtr(void *data_key, layer_data_map_t<DATA_T> &layer_data_map) {
+    return layer_data_map.Get(data_key);
+}
+
+template <typename DATA_T>
+void FreeLayerDataPtr(void *data_key, layer_data_map_t<DATA_T> &layer_data_map) {
+    layer_data_map.Free(data_key);
+}
+
+static layer_data_map_t<device_layer_data> device_layer_data_map;
+static layer_data_map_t<instance_layer_data> instance_layer_data_map;
+
+// Calls hook for the interceptors whose bit is set in mask, i.e. for those
+// which may override the hook. See layer_factory::HookNotOverridden().
+template <typename HOOK>
+static inline void CallInterceptors(const std::atomic<uint64_t> &mask, HOOK hook) {
+    uint64_t bits = mask.load(std::memory_order_relaxed);
+    while (bits) {
+#if defined(_MSC_VER)
+        unsigned long index;
+        _BitScanForward64(&index, bits);
+#else
+        uint32_t index = __builtin_ctzll(bits);
+#endif
+        bits &= bits - 1;
+        hook(global_interceptor_list[index]);
+    }
+}
 
 #include "interceptor_objects.h"
 
@@ -497,6 +588,7 @@ VK_LAYER_EXPORT VKAPI_ATTR VkResult VKAPI_CALL vkNegotiateLoaderLayerInterfaceVe
         # Internal state - accumulators for different inner block text
         self.sections = dict([(section, []) for section in self.ALL_SECTIONS])
         self.intercepts = []
+        self.entry_points = []                      # Enumerants of the entry points with hooks
         self.layer_factory = ''                     # String containing base layer factory class definition
 
     # Check if the parameter passed in is a pointer to an array
@@ -541,7 +633,11 @@ VK_LAYER_EXPORT VKAPI_ATTR VkResult VKAPI_CALL vkNegotiateLoaderLayerInterfaceVe
                 for s in genOpts.prefixText:
                     write(s, file=self.outFile)
             write('#include "vulkan/vk_layer.h"', file=self.outFile)
-            write('#include <unordered_map>\n', file=self.outFile)
+            write('#include <atomic>', file=self.outFile)
+            write('#include <cstdio>', file=self.outFile)
+            write('#include <cstdlib>', file=self.outFile)
+            write('#include <unordered_map>', file=self.outFile)
+            write('#include <vector>\n', file=self.outFile)
             write('class layer_factory;', file=self.outFile)
             write('extern std::vector<layer_factory *> global_interceptor_list;', file=self.outFile)
             write('extern debug_report_data *vlf_report_data;\n', file=self.outFile)
@@ -554,11 +650,39 @@ VK_LAYER_EXPORT VKAPI_ATTR VkResult VKAPI_CALL vkNegotiateLoaderLayerInterfaceVe
         self.layer_factory += 'class layer_factory {\n'
         self.layer_factory += '    public:\n'
         self.layer_factory += '        layer_factory() {\n'
+        self.layer_factory += '            // The bits of the interceptors in vlf_masks are 64 bit masks, a further interceptor would\n'
+        self.layer_factory += '            // never be called.\n'
+        self.layer_factory += '            if (global_interceptor_list.size() >= vlf_max_interceptors) {\n'
+        self.layer_factory += '                fprintf(stderr, "Layer factory: a layer can have at most %zu interceptors, aborting.\\n", vlf_max_interceptors);\n'
+        self.layer_factory += '                abort();\n'
+        self.layer_factory += '            }\n'
+        self.layer_factory += '            interceptor_bit = 1ull << global_interceptor_list.size();\n'
         self.layer_factory += '            global_interceptor_list.emplace_back(this);\n'
+        self.layer_factory += '            // Until a hook turns out not to be overridden, the interceptor is called for it\n'
+        self.layer_factory += '            for (auto &masks : vlf_masks) {\n'
+        self.layer_factory += '                masks.pre_call.fetch_or(interceptor_bit, std::memory_order_relaxed);\n'
+        self.layer_factory += '                masks.post_call.fetch_or(interceptor_bit, std::memory_order_relaxed);\n'
+        self.layer_factory += '            }\n'
         self.layer_factory += '        };\n'
         self.layer_factory += '\n'
         self.layer_factory += '        std::string layer_name = "VLF";\n'
         self.layer_factory += '\n'
+        self.layer_factory += '        // Bit of this interceptor in vlf_masks\n'
+        self.layer_factory += '        uint64_t interceptor_bit = 0;\n'
+        self.layer_factory += '        // Set when the default PreCallApiFunction/PostCallApiFunction hooks are called\n'
+        self.layer_factory += '        std::atomic<bool> default_pre_call_api_function{false};\n'
+        self.layer_factory += '        std::atomic<bool> default_post_call_api_function{false};\n'
+        self.layer_factory += '        std::atomic<bool> default_post_call_api_function_result{false};\n'
+        self.layer_factory += '\n'
+        self.layer_factory += '        // Called by the default hooks. Unless the interceptor overrides the global intercept helper\n'
+        self.layer_factory += '        // as well, its bit is cleared and the entry point stops calling the hook. Overrides must\n'
+        self.layer_factory += '        // therefore not call the default hook of the base class.\n'
+        self.layer_factory += '        void HookNotOverridden(std::atomic<uint64_t> &mask, const std::atomic<bool> &default_api_function) {\n'
+        self.layer_factory += '            if (default_api_function.load(std::memory_order_relaxed)) {\n'
+        self.layer_factory += '                mask.fetch_and(~interceptor_bit, std::memory_order_relaxed);\n'
+        self.layer_factory += '            }\n'
+        self.layer_factory += '        }\n'
+        self.layer_factory += '\n'
         self.layer_factory += '        bool log_msg(const debug_report_data *debug_data, VkFlags msg_flags, VkObjectType object_type,\n'
         self.layer_factory += '                                   uint64_t src_object, const std::string &vuid_text, const char *format, ...) {\n'
         self.layer_factory += '            if (!debug_data) return false;\n'
@@ -614,10 +738,10 @@ VK_LAYER_EXPORT VKAPI_ATTR VkResult VKAPI_CALL vkNegotiateLoaderLayerInterfaceVe
         self.layer_factory += '#endif\n'
         self.layer_factory += '        }\n'
         self.layer_factory += '\n'
-        self.layer_factory += '        virtual void PreCallApiFunction(const char *api_name) {};\n'
-        self.layer_factory += '        virtual void PostCallApiFunction(const char *api_name) {};\n'
+        self.layer_factory += '        virtual void PreCallApiFunction(const char *api_name) { default_pre_call_api_function = true; };\n'
+        self.layer_factory += '        virtual void PostCallApiFunction(const char *api_name) { default_post_call_api_function = true; };\n'
         self.layer_factory += '        virtual void PreCallApiFunction(const char *api_name, VkResult result) {};\n'
-        self.layer_factory += '        virtual void PostCallApiFunction(const char *api_name, VkResult result) {};\n'
+        self.layer_factory += '        virtual void PostCallApiFunction(const char *api_name, VkResult result) { default_post_call_api_function_result = true; };\n'
         self.layer_factory += '\n'
         self.layer_factory += '        // Pre/post hook point declarations\n'
     #
@@ -634,6 +758,19 @@ VK_LAYER_EXPORT VKAPI_ATTR VkResult VKAPI_CALL vkNegotiateLoaderLayerInterfaceVe
         write('} // namespace vulkan_layer_factory', file=self.outFile)
         if self.header:
             self.newline()
+            # Output the entry point indices and the interceptor masks
+            write('// Entry points with pre/post call hooks', file=self.outFile)
+            write('enum vlf_entry_point {', file=self.outFile)
+            write('\n'.join(self.entry_points), file=self.outFile)
+            write('    VLF_ENTRY_POINT_COUNT', file=self.outFile)
+            write('};\n', file=self.outFile)
+            write('// Bit i of a mask is set while global_interceptor_list[i] may override the hook', file=self.outFile)
+            write('struct vlf_interceptor_masks {', file=self.outFile)
+            write('    std::atomic<uint64_t> pre_call;', file=self.outFile)
+            write('    std::atomic<uint64_t> post_call;', file=self.outFile)
+            write('};\n', file=self.outFile)
+            write('static const size_t vlf_max_interceptors = 64;', file=self.outFile)
+            write('extern vlf_interceptor_masks vlf_masks[VLF_ENTRY_POINT_COUNT];\n', file=self.outFile)
             # Output Layer Factory Class Definitions
             self.layer_factory += '};\n'
             write(self.layer_factory, file=self.outFile)
@@ -713,25 +850,27 @@ VK_LAYER_EXPORT VKAPI_ATTR VkResult VKAPI_CALL vkNegotiateLoaderLayerInterfaceVe
         # Add default implementation: This map contains the default function definitions for the return types of Vulkan Commands.
         # If any new return types are required, they'll need to be added to this dict.
         return_map = {
-            'PFN_vkVoidFunction': ' { return nullptr; };',
-            'uint32_t': ' { return 0; };',
-            'uint64_t': ' { return 0; };',
-            'VkBool32': ' { return VK_TRUE; };',
-            'VkDeviceAddress': '{ return 0; };',
-            'VkResult': ' { return VK_SUCCESS; };',
-            'VkDeviceSize': ' { return 0; };',
-            'void': ' {};',
+            'PFN_vkVoidFunction': 'return nullptr; ',
+            'uint32_t': 'return 0; ',
+            'uint64_t': 'return 0; ',
+            'VkBool32': 'return VK_TRUE; ',
+            'VkDeviceAddress': 'return 0; ',
+            'VkResult': 'return VK_SUCCESS; ',
+            'VkDeviceSize': 'return 0; ',
+            'void': '',
             }
         return_type = result.split(" ")[1]
-        default_def = return_map[return_type]
-        result = result.replace(';', default_def, 1)
+        default_return = return_map[return_type]
+        result = result.replace(';', '', 1)
         pre_call = result.replace("VKAPI_PTR *PFN_vk", "PreCall")
-        pre_call_function = '{ PreCallApiFunction("%s");' % name
-        pre_call = pre_call.replace("{", pre_call_function)
-        post_call = pre_call.replace("PreCall", "PostCall")
+        post_call = result.replace("VKAPI_PTR *PFN_vk", "PostCall")
+        # The default hooks call the global intercept helpers and take the interceptor off the entry point
+        pre_call += ' { PreCallApiFunction("%s"); HookNotOverridden(vlf_masks[VLF_%s].pre_call, default_pre_call_api_function); %s};' % (name, name[2:], default_return)
         if return_type == 'VkResult':
             post_call = post_call.replace(')', ', VkResult result)', 1)
-            post_call = post_call.replace(');', ', result);', 1);
+            post_call += ' { PostCallApiFunction("%s", result); HookNotOverridden(vlf_masks[VLF_%s].post_call, default_post_call_api_function_result); %s};' % (name, name[2:], default_return)
+        else:
+            post_call += ' { PostCallApiFunction("%s"); HookNotOverridden(vlf_masks[VLF_%s].post_call, default_post_call_api_function); %s};' % (name, name[2:], default_return)
         return '        %s\n        %s\n' % (pre_call, post_call)
     #
     # Command generation
@@ -748,13 +887,16 @@ VK_LAYER_EXPORT VKAPI_ATTR VkResult VKAPI_CALL vkNegotiateLoaderLayerInterfaceVe
             self.appendSection('command', self.makeCDecls(cmdinfo.elem)[0])
             if (self.featureExtraProtect is not None):
                 self.intercepts += [ '#ifdef %s' % self.featureExtraProtect ]
+                self.entry_points += [ '#ifdef %s' % self.featureExtraProtect ]
                 self.layer_factory += '#ifdef %s\n' % self.featureExtraProtect
             # Update base class with virtual function declarations
             self.layer_factory += self.BaseClassCdecl(cmdinfo.elem, name)
             # Update function intercepts
             self.intercepts += [ '    {"%s", (void*)%s},' % (name,name[2:]) ]
+            self.entry_points += [ '    VLF_%s,' % name[2:] ]
             if (self.featureExtraProtect is not None):
                 self.intercepts += [ '#endif' ]
+                self.entry_points += [ '#endif' ]
                 self.layer_factory += '#endif\n'
             return
 
@@ -809,9 +951,9 @@ VK_LAYER_EXPORT VKAPI_ATTR VkResult VKAPI_CALL vkNegotiateLoaderLayerInterfaceVe
         API = api_function_name.replace('vk','%s_data->dispatch_table.' % (device_or_instance),1)
 
         # Generate pre-call object processing source code
-        self.appendSection('command', '    for (auto intercept : global_interceptor_list) {')
+        self.appendSection('command', '    CallInterceptors(vlf_masks[VLF_%s].pre_call, [&](layer_factory *intercept) {' % api_function_name[2:])
         self.appendSection('command', '        intercept->PreCall%s(%s);' % (api_function_name[2:], paramstext))
-        self.appendSection('command', '    }')
+        self.appendSection('command', '    });')
 
         # Declare result variable, if any.
         resulttype = cmdinfo.elem.find('proto/type')
@@ -828,9 +970,9 @@ VK_LAYER_EXPORT VKAPI_ATTR VkResult VKAPI_CALL vkNegotiateLoaderLayerInterfaceVe
         returnParam = ''
         if (resulttype is not None and resulttype.text == 'VkResult'):
             returnParam = ', result'
-        self.appendSection('command', '    for (auto intercept : global_interceptor_list) {')
+        self.appendSection('command', '    CallInterceptors(vlf_masks[VLF_%s].post_call, [&](layer_factory *intercept) {' % api_function_name[2:])
         self.appendSection('command', '        intercept->PostCall%s(%s%s);' % (api_function_name[2:], paramstext, returnParam))
-        self.appendSection('command', '    }')
+        self.appendSection('command', '    });')
 
         # Return result variable, if any.
         if (resulttype is not None):
@@ -11,6 +11,51 @@ from generator import *
 from collections import namedtuple
 from common_codegen import *
 
+# Device calls whose begin event carries a short summary of their arguments
+# when VK_SYSTRACE_ARGS is set: name -> (format, arguments).
+SUMMARY_FUNCTIONS = {
+    'vkQueueSubmit': ('submitCount=%u', 'submitCount'),
+    'vkQueueSubmit2': ('submitCount=%u', 'submitCount'),
+    'vkQueueSubmit2KHR': ('submitCount=%u', 'submitCount'),
+    'vkCmdDraw': ('vertexCount=%u instanceCount=%u', 'vertexCount, instanceCount'),
+    'vkCmdDrawIndexed': ('indexCount=%u instanceCount=%u', 'indexCount, instanceCount'),
+    'vkCmdDrawIndirect': ('drawCount=%u', 'drawCount'),
+    'vkCmdDrawIndexedIndirect': ('drawCount=%u', 'drawCount'),
+    'vkCmdDispatch': ('groupCount=%ux%ux%u', 'groupCountX, groupCountY, groupCountZ'),
+    'vkCmdCopyBuffer': ('regionCount=%u', 'regionCount'),
+    'vkCmdCopyBufferToImage': ('regionCount=%u', 'regionCount'),
+    'vkCmdUpdateBuffer': ('dataSize=%" PRIu64 "', '(uint64_t)dataSize'),
+    'vkAllocateMemory': ('allocationSize=%" PRIu64 "', '(uint64_t)pAllocateInfo->allocationSize'),
+    'vkCreateBuffer': ('size=%" PRIu64 "', '(uint64_t)pCreateInfo->size'),
+    'vkCreateGraphicsPipelines': ('createInfoCount=%u', 'createInfoCount'),
+    'vkCreateComputePipelines': ('createInfoCount=%u', 'createInfoCount'),
+    'vkUpdateDescriptorSets': ('descriptorWriteCount=%u', 'descriptorWriteCount'),
+}
+SUMMARY_FUNCTION_NAMES = str(sorted(SUMMARY_FUNCTIONS.keys()))
+
+SUMMARY_CODEGEN = ''
+for name, (fmt, args) in sorted(SUMMARY_FUNCTIONS.items()):
+    SUMMARY_CODEGEN += """
+@foreach function where('{funcName}' == '%s' and '{funcReturn}' != 'void')
+VK_LAYER_EXPORT VKAPI_ATTR {funcReturn} VKAPI_CALL {funcName}({funcTypedParams})
+{{
+    SYSTRACE_BEGIN_ARGS("{funcName}", "%s", %s);
+    {funcReturn} result = device_dispatch_table({funcDispatchParam})->{funcShortName}({funcNamedParams});
+    SYSTRACE_END();
+    return result;
+}}
+@end function
+
+@foreach function where('{funcName}' == '%s' and '{funcReturn}' == 'void')
+VK_LAYER_EXPORT VKAPI_ATTR {funcReturn} VKAPI_CALL {funcName}({funcTypedParams})
+{{
+    SYSTRACE_BEGIN_ARGS("{funcName}", "%s", %s);
+    device_dispatch_table({funcDispatchParam})->{funcShortName}({funcNamedParams});
+    SYSTRACE_END();
+}}
+@end function
+""" % (name, fmt, args, name, fmt, args)
+
 SYSTRACE_CODEGEN = """
 /*
  * (C) COPYRIGHT 2020 ARM Limited
@@ -28,7 +73,6 @@ SYSTRACE_CODEGEN = """
  * See the License for the specific language governing permissions and
  * limitations under the License.
  */
-#include <android/trace.h>
 #include "vk_loader_platform.h"
 #include "vulkan/vk_layer.h"
 #include "vk_layer_config.h"
@@ -54,11 +98,14 @@ VK_LAYER_EXPORT VKAPI_ATTR {funcReturn} VKAPI_CALL {funcName}({funcTypedParams})
         return VK_ERROR_INITIALIZATION_FAILED;
     }}
 
+    // The backend is set up on the first instance, the layer is traced from here on.
+    systrace::Init();
+
     // Call the function and create the dispatch table
     chain_info->u.pLayerInfo = chain_info->u.pLayerInfo->pNext;
-    ATrace_beginSection("{funcName}");
+    SYSTRACE_BEGIN("{funcName}");
     {funcReturn} result = fpCreateInstance({funcNamedParams});
-    ATrace_endSection();
+    SYSTRACE_END();
     if(result == VK_SUCCESS) {{
         initInstanceTable(*pInstance, fpGetInstanceProcAddr);
     }}
@@ -71,10 +118,11 @@ VK_LAYER_EXPORT VKAPI_ATTR {funcReturn} VKAPI_CALL {funcName}({funcTypedParams})
 {{
     // Destroy the dispatch table
     dispatch_key key = get_dispatch_key({funcDispatchParam});
-    ATrace_beginSection("{funcName}");
+    SYSTRACE_BEGIN("{funcName}");
     instance_dispatch_table({funcDispatchParam})->DestroyInstance({funcNamedParams});
-    ATrace_endSection();
+    SYSTRACE_END();
     destroy_instance_dispatch_table(key);
+    systrace::Flush();
 }}
 @end function
 
@@ -93,9 +141,9 @@ VK_LAYER_EXPORT VKAPI_ATTR {funcReturn} VKAPI_CALL {funcName}({funcTypedParams})
 
     // Call the function and create the dispatch table
     chain_info->u.pLayerInfo = chain_info->u.pLayerInfo->pNext;
-    ATrace_beginSection("{funcName}");
+    SYSTRACE_BEGIN("{funcName}");
     {funcReturn} result = fpCreateDevice({funcNamedParams});
-    ATrace_endSection();
+    SYSTRACE_END();
     if(result == VK_SUCCESS) {{
         initDeviceTable(*pDevice, fpGetDeviceProcAddr);
     }}
@@ -109,9 +157,9 @@ VK_LAYER_EXPORT VKAPI_ATTR {funcReturn} VKAPI_CALL {funcName}({funcTypedParams})
 {{
     // Destroy the dispatch table
     dispatch_key key = get_dispatch_key({funcDispatchParam});
-    ATrace_beginSection("{funcName}");
+    SYSTRACE_BEGIN("{funcName}");
     device_dispatch_table({funcDispatchParam})->DestroyDevice({funcNamedParams});
-    ATrace_endSection();
+    SYSTRACE_END();
     destroy_device_dispatch_table(key);
 }}
 @end function
@@ -119,9 +167,9 @@ VK_LAYER_EXPORT VKAPI_ATTR {funcReturn} VKAPI_CALL {funcName}({funcTypedParams})
 @foreach function where('{funcName}' == 'vkEnumerateInstanceExtensionProperties')
 VK_LAYER_EXPORT VKAPI_ATTR {funcReturn} VKAPI_CALL {funcName}({funcTypedParams})
 {{
-    ATrace_beginSection("{funcName}");
+    SYSTRACE_BEGIN("{funcName}");
     {funcReturn} result = util_GetExtensionProperties(0, NULL, pPropertyCount, pProperties);
-    ATrace_endSection();
+    SYSTRACE_END();
     return result;
 }}
 @end function
@@ -137,9 +185,9 @@ VK_LAYER_EXPORT VKAPI_ATTR {funcReturn} VKAPI_CALL {funcName}({funcTypedParams})
             "layer: systrace",
         }}
     }};
-    ATrace_beginSection("{funcName}");
+    SYSTRACE_BEGIN("{funcName}");
     {funcReturn} result = util_GetLayerProperties(ARRAY_SIZE(layerProperties), layerProperties, pPropertyCount, pProperties);
-    ATrace_endSection();
+    SYSTRACE_END();
     return result;
 }}
 @end function
@@ -155,9 +203,9 @@ VK_LAYER_EXPORT VKAPI_ATTR {funcReturn} VKAPI_CALL {funcName}({funcTypedParams})
             "layer: systrace",
         }}
     }};
-    ATrace_beginSection("{funcName}");
+    SYSTRACE_BEGIN("{funcName}");
     {funcReturn} result = util_GetLayerProperties(ARRAY_SIZE(layerProperties), layerProperties, pPropertyCount, pProperties);
-    ATrace_endSection();
+    SYSTRACE_END();
     return result;
 }}
 @end function
@@ -165,21 +213,22 @@ VK_LAYER_EXPORT VKAPI_ATTR {funcReturn} VKAPI_CALL {funcName}({funcTypedParams})
 @foreach function where('{funcName}' == 'vkQueuePresentKHR')
 VK_LAYER_EXPORT VKAPI_ATTR {funcReturn} VKAPI_CALL {funcName}({funcTypedParams})
 {{
-    ATrace_beginSection("{funcName}");
+    SYSTRACE_BEGIN_ARGS("{funcName}", "swapchainCount=%u", pPresentInfo->swapchainCount);
     {funcReturn} result = device_dispatch_table({funcDispatchParam})->{funcShortName}({funcNamedParams});
-    ATrace_endSection();
+    SYSTRACE_END();
     return result;
 }}
 @end function
 
+""" + SUMMARY_CODEGEN + """
 // Autogen instance functions
 
 @foreach function where('{funcDispatchType}' == 'instance' and '{funcReturn}' != 'void' and '{funcName}' not in ['vkCreateInstance', 'vkDestroyInstance', 'vkCreateDevice', 'vkGetInstanceProcAddr', 'vkEnumerateDeviceExtensionProperties', 'vkEnumerateDeviceLayerProperties'])
 VK_LAYER_EXPORT VKAPI_ATTR {funcReturn} VKAPI_CALL {funcName}({funcTypedParams})
 {{
-    ATrace_beginSection("{funcName}");
+    SYSTRACE_BEGIN("{funcName}");
     {funcReturn} result = instance_dispatch_table({funcDispatchParam})->{funcShortName}({funcNamedParams});
-    ATrace_endSection();
+    SYSTRACE_END();
     return result;
 }}
 @end function
@@ -187,30 +236,30 @@ VK_LAYER_EXPORT VKAPI_ATTR {funcReturn} VKAPI_CALL {funcName}({funcTypedParams})
 @foreach function where('{funcDispatchType}' == 'instance' and '{funcReturn}' == 'void' and '{funcName}' not in ['vkCreateInstance', 'vkDestroyInstance', 'vkCreateDevice', 'vkGetInstanceProcAddr', 'vkEnumerateDeviceExtensionProperties', 'vkEnumerateDeviceLayerProperties'])
 VK_LAYER_EXPORT VKAPI_ATTR {funcReturn} VKAPI_CALL {funcName}({funcTypedParams})
 {{
-    ATrace_beginSection("{funcName}");
+    SYSTRACE_BEGIN("{funcName}");
     instance_dispatch_table({funcDispatchParam})->{funcShortName}({funcNamedParams});
-    ATrace_endSection();
+    SYSTRACE_END();
 }}
 @end function
 
 // Autogen device functions
 
-@foreach function where('{funcDispatchType}' == 'device' and '{funcReturn}' != 'void' and '{funcName}' not in ['vkDestroyDevice', 'vkEnumerateInstanceExtensionProperties', 'vkEnumerateInstanceLayerProperties', 'vkQueuePresentKHR', 'vkGetDeviceProcAddr'])
+@foreach function where('{funcDispatchType}' == 'device' and '{funcReturn}' != 'void' and '{funcName}' not in ['vkDestroyDevice', 'vkEnumerateInstanceExtensionProperties', 'vkEnumerateInstanceLayerProperties', 'vkQueuePresentKHR', 'vkGetDeviceProcAddr'] + """ + SUMMARY_FUNCTION_NAMES + """)
 VK_LAYER_EXPORT VKAPI_ATTR {funcReturn} VKAPI_CALL {funcName}({funcTypedParams})
 {{
-    ATrace_beginSection("{funcName}");
+    SYSTRACE_BEGIN("{funcName}");
     {funcReturn} result = device_dispatch_table({funcDispatchParam})->{funcShortName}({funcNamedParams});
-    ATrace_endSection();
+    SYSTRACE_END();
     return result;
 }}
 @end function
 
-@foreach function where('{funcDispatchType}' == 'device' and '{funcReturn}' == 'void' and '{funcName}' not in ['vkDestroyDevice', 'vkEnumerateInstanceExtensionProperties', 'vkEnumerateInstanceLayerProperties', 'vkGetDeviceProcAddr'])
+@foreach function where('{funcDispatchType}' == 'device' and '{funcReturn}' == 'void' and '{funcName}' not in ['vkDestroyDevice', 'vkEnumerateInstanceExtensionProperties', 'vkEnumerateInstanceLayerProperties', 'vkGetDeviceProcAddr'] + """ + SUMMARY_FUNCTION_NAMES + """)
 VK_LAYER_EXPORT VKAPI_ATTR {funcReturn} VKAPI_CALL {funcName}({funcTypedParams})
 {{
-    ATrace_beginSection("{funcName}");
+    SYSTRACE_BEGIN("{funcName}");
     device_dispatch_table({funcDispatchParam})->{funcShortName}({funcNamedParams});
-    ATrace_endSection();
+    SYSTRACE_END();
 }}
 @end function
 
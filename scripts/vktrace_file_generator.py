@@ -197,6 +197,45 @@ api_exclusions = [
                 'GetQueueCheckpointData2NV',
                 'GetAndroidHardwareBufferPropertiesANDROID'
                 ]
+# Handle types which need to be premapped, the object mapper keeps the replay handle
+# of a trace handle at a fixed address once the handle is premapped
+premapped_object_types = [
+                'VkDevice',
+                'VkBufferView',
+                'VkImageView',
+                'VkSampler',
+                'VkDescriptorSet',
+                'VkCommandBuffer',
+                'VkPipelineLayout',
+            ]
+# Premapped handle types whose replay handle is a member of an object of the object mapper
+premapped_remapped_object_types = {
+                'VkDeviceMemory': ('devicememoryObj', 'replayDeviceMemory'),
+                'VkBuffer': ('bufferObj', 'replayBuffer'),
+            }
+# Commands whose premapping and premapped replay are written by hand
+manually_premapped_funcs = [
+                'FlushMappedMemoryRanges',
+                'UpdateDescriptorSets',
+                'CmdBindDescriptorSets',
+                'CmdBindVertexBuffers',
+                'QueueSubmit',
+                'QueueSubmit2',
+                'QueueSubmit2KHR',
+            ]
+# Commands the generated premapping skips because replay() has special code for them
+premap_exclusions = [
+                'CmdBindPipeline',
+                'CmdBlitImage',
+                'CmdCopyBuffer',
+                'CmdCopyBuffer2',
+                'CmdCopyBuffer2KHR',
+                'CmdCopyImage',
+                'CmdDebugMarkerBeginEXT',
+                'CmdDebugMarkerEndEXT',
+                'CmdExecuteCommands',
+                'CmdResolveImage',
+            ]
 api_remap = [
                 'CmdCopyBufferRemapAS',
                 'CmdCopyBufferRemapBuffer',
@@ -597,7 +636,8 @@ class VkTraceFileOutputGenerator(OutputGenerator):
         replay_objmapper_header += '#include <list>\n'
         replay_objmapper_header += '#include <vector>\n'
         replay_objmapper_header += '#include <string>\n'
-        replay_objmapper_header += '#include <mutex>\n\n'
+        replay_objmapper_header += '#include <mutex>\n'
+        replay_objmapper_header += '#include <functional>\n\n'
         replay_objmapper_header += '#include "vulkan/vulkan.h"\n'
         replay_objmapper_header += '#include "vktrace_pageguard_memorycopy.h"\n'
         replay_objmapper_header += '\n'
@@ -607,22 +647,9 @@ class VkTraceFileOutputGenerator(OutputGenerator):
         additional_remap_fifo = {}
         additional_remap_fifo['pImageIndex'] = "uint32_t"
 
-        premapped_object_types = []                  # List of all handle types which need to be premapped
-        premapped_object_types.append('VkDevice')
-        premapped_object_types.append('VkBufferView')
-        premapped_object_types.append('VkImageView')
-        premapped_object_types.append('VkSampler')
-        premapped_object_types.append('VkDescriptorSet')
-        premapped_object_types.append('VkCommandBuffer')
-        premapped_object_types.append('VkPipelineLayout')
-
         no_null_assertion_types = []
         no_null_assertion_types.append('VkDescriptorSet')
 
-        premapped_remapped_object_types = []
-        premapped_remapped_object_types.append('VkDeviceMemory')
-        premapped_remapped_object_types.append('VkBuffer')
-
         # Output function to clear object maps
         replay_objmapper_header += '    void clear_all_map_handles() {\n'
         for item in self.object_types:
@@ -675,6 +702,8 @@ class VkTraceFileOutputGenerator(OutputGenerator):
             replay_objmapper_header += '    %s remap_%s(const %s& value) {\n' % (item, map_name, item)
             if item != 'VkAccelerationStructureKHR':
                 replay_objmapper_header += '        if (value == 0) { return 0; }\n'
+            if item == 'VkPipeline':
+                replay_objmapper_header += '        if (m_resolveAsyncPipeline) { m_resolveAsyncPipeline(value); }\n'
             if item in remapped_objects:
                 replay_objmapper_header += '        std::unordered_map<%s, %s>::const_iterator q = %s.find(value);\n' % (item, obj_name, mangled_name)
                 if item == 'VkDeviceMemory':
@@ -1239,6 +1268,7 @@ class VkTraceFileOutputGenerator(OutputGenerator):
                                  'WriteMicromapsPropertiesEXT',
                                  'CmdWriteMicromapsPropertiesEXT',
                                  'QueueSubmit2',
+                                 'QueueSubmit2KHR',
                                  'GetMicromapBuildSizesEXT',
                                  'GetSemaphoreFdKHR',
                                  'ImportSemaphoreFdKHR'
@@ -1307,6 +1337,9 @@ class VkTraceFileOutputGenerator(OutputGenerator):
         replay_gen_source += 'vktrace_replay::VKTRACE_REPLAY_RESULT vkReplay::replay(vktrace_trace_packet_header *packet) { \n'
         replay_gen_source += '    vktrace_replay::VKTRACE_REPLAY_RESULT returnValue = vktrace_replay::VKTRACE_REPLAY_SUCCESS;\n'
         replay_gen_source += '    VkResult replayResult = VK_SUCCESS;\n'
+        replay_gen_source += '    if (m_asyncPipelineCompiler != nullptr) {\n'
+        replay_gen_source += '        sync_async_pipelines(packet);\n'
+        replay_gen_source += '    }\n'
         replay_gen_source += '    switch (packet->packet_id) {\n'
         replay_gen_source += '        case VKTRACE_TPI_VK_vkApiVersion:\n'
         replay_gen_source += '            // Ignore api version packets\n'
@@ -1351,6 +1384,12 @@ class VkTraceFileOutputGenerator(OutputGenerator):
                 replay_gen_source += '                break;\n'
                 replay_gen_source += '            }\n'
 
+            if cmdname == 'AcquireNextImage2KHR':
+                replay_gen_source += '            if (g_pReplaySettings->noPresent) {\n'
+                replay_gen_source += '                replayResult = acquire_without_present(pPacket->device, pPacket->pAcquireInfo->semaphore, pPacket->pAcquireInfo->fence, *(pPacket->pImageIndex));\n'
+                replay_gen_source += '                CHECK_RETURN_VALUE(vkAcquireNextImage2KHR);\n'
+                replay_gen_source += '                break;\n'
+                replay_gen_source += '            }\n'
             if cmdname in manually_replay_funcs:
                 if cmdname in "vkWaitForFences":
                     replay_gen_source += '            if ((replaySettings.skipGetFenceStatus > 1) && m_inSkipFenceRange) {\n'
@@ -1528,6 +1567,8 @@ class VkTraceFileOutputGenerator(OutputGenerator):
                     replay_gen_source += '            }\n'
                 elif 'GetDeviceQueue2' in cmdname:
                     replay_gen_source += '            vkreplay_process_pnext_structs(pPacket->header, (void *)pPacket->pQueueInfo);\n'
+                    replay_gen_source += '            traceQueueToDevice[*(pPacket->pQueue)] = pPacket->device;\n'
+                    replay_gen_source += '            traceQueueToFamilyIndex[*(pPacket->pQueue)] = pPacket->pQueueInfo->queueFamilyIndex;\n'
                 elif 'CmdTraceRaysIndirectKHR' == cmdname or 'CmdTraceRaysKHR' == cmdname:
                     replay_gen_source += '            if (pPacket->pRaygenShaderBindingTable != nullptr) {\n'
                     replay_gen_source += '                const_cast<VkStridedDeviceAddressRegionKHR*>(pPacket->pRaygenShaderBindingTable)->deviceAddress = traceDeviceAddrToReplayDeviceAddr4Buf[pPacket->pRaygenShaderBindingTable->deviceAddress].replayDeviceAddr;\n'
@@ -1550,6 +1591,7 @@ class VkTraceFileOutputGenerator(OutputGenerator):
                     replay_gen_source += '            }\n'
                 elif 'GetDeviceQueue' in cmdname:
                     replay_gen_source += '            traceQueueToDevice[*(pPacket->pQueue)] = pPacket->device;\n'
+                    replay_gen_source += '            traceQueueToFamilyIndex[*(pPacket->pQueue)] = pPacket->queueFamilyIndex;\n'
                 elif 'CopyAccelerationStructureKHR' in cmdname and 'Cmd' not in cmdname:
                     replay_gen_source += '            remappeddeferredOperation = VK_NULL_HANDLE;\n'
                     replay_gen_source += '            const_cast<VkCopyAccelerationStructureInfoKHR*>(pPacket->pInfo)->src = m_objMapper.remap_accelerationstructurekhrs(pPacket->pInfo->src);\n'
@@ -1593,6 +1635,7 @@ class VkTraceFileOutputGenerator(OutputGenerator):
                     replay_gen_source += '                }\n'
                     replay_gen_source += '            }\n'
                 elif 'DestroyPipelineCache' in cmdname:
+                    replay_gen_source += '            m_prewarmMergedPipelineCaches.erase(remappedpipelineCache);\n'
                     replay_gen_source += '            if (g_pReplaySettings->enablePipelineCache) {\n'
                     replay_gen_source += '                size_t datasize = 0;\n'
                     replay_gen_source += '                assert(nullptr != m_pipelinecache_accessor);\n'
@@ -1657,6 +1700,9 @@ class VkTraceFileOutputGenerator(OutputGenerator):
                     replay_gen_source += '            uint64_t traceASHandle = (uint64_t)(pPacket->pInfo->accelerationStructure);\n'
                     replay_gen_source += '            const_cast<VkAccelerationStructureDeviceAddressInfoKHR*>(pPacket->pInfo)->accelerationStructure = m_objMapper.remap_accelerationstructurekhrs(pPacket->pInfo->accelerationStructure);\n'
                 elif 'DestroyDevice' in cmdname:
+                    replay_gen_source += '            release_prewarm_pipeline_cache(remappeddevice);\n'
+                    replay_gen_source += '            release_gpu_timestamps(remappeddevice);\n'
+                    replay_gen_source += '            memory_stats_remove_device(remappeddevice);\n'
                     replay_gen_source += '            while (!fsiiSemaphoresAndFences.empty()) {\n'
                     replay_gen_source += '                m_vkDeviceFuncs.DestroySemaphore(remappeddevice, fsiiSemaphoresAndFences.front().first, NULL);\n'
                     replay_gen_source += '                fsiiSemaphoresAndFences.pop();\n'
@@ -1784,6 +1830,7 @@ class VkTraceFileOutputGenerator(OutputGenerator):
                     replay_gen_source += '            auto it = traceQueueToDevice.begin();\n'
                     replay_gen_source += '            while (it != traceQueueToDevice.end()) {\n'
                     replay_gen_source += '                if (it->second == pPacket->device) {\n'
+                    replay_gen_source += '                    traceQueueToFamilyIndex.erase(it->first);\n'
                     replay_gen_source += '                    it = traceQueueToDevice.erase(it);\n'
                     replay_gen_source += '                } else {\n'
                     replay_gen_source += '                    it++;\n'
@@ -1926,30 +1973,34 @@ class VkTraceFileOutputGenerator(OutputGenerator):
             replay_gen_source += '        }\n'
             if protect == "VK_USE_PLATFORM_XLIB_XRANDR_EXT":
                 replay_gen_source += '#endif // %s\n' % protect
-        replay_gen_source += '        case VKTRACE_TPI_VK_vkFlushMappedMemoryRanges + PREMAP_SHIFT: {\n'
-        replay_gen_source += '            packet_vkFlushMappedMemoryRanges* pPacket = (packet_vkFlushMappedMemoryRanges*)(packet->pBody);\n'
-        replay_gen_source += '            if (callFailedDuringTrace(pPacket->result, packet->packet_id)) {\n'
-        replay_gen_source += '                break;\n'
-        replay_gen_source += '            }\n'
-        replay_gen_source += '            replayResult = manually_replay_vkFlushMappedMemoryRangesPremapped(pPacket);\n'
-        replay_gen_source += '            CHECK_RETURN_VALUE(vkFlushMappedMemoryRanges + PREMAP_SHIFT);\n'
-        replay_gen_source += '            break;\n'
-        replay_gen_source += '        }\n'
-        replay_gen_source += '        case VKTRACE_TPI_VK_vkUpdateDescriptorSets + PREMAP_SHIFT: {\n'
-        replay_gen_source += '            packet_vkUpdateDescriptorSets* pPacket = (packet_vkUpdateDescriptorSets*)(packet->pBody);\n'
-        replay_gen_source += '            manually_replay_vkUpdateDescriptorSetsPremapped(pPacket);\n'
-        replay_gen_source += '            break;\n'
-        replay_gen_source += '        }\n'
-        replay_gen_source += '        case VKTRACE_TPI_VK_vkCmdBindDescriptorSets + PREMAP_SHIFT: {\n'
-        replay_gen_source += '            packet_vkCmdBindDescriptorSets* pPacket = (packet_vkCmdBindDescriptorSets*)(packet->pBody);\n'
-        replay_gen_source += '            manually_replay_vkCmdBindDescriptorSetsPremapped(pPacket);\n'
-        replay_gen_source += '            break;\n'
-        replay_gen_source += '        }\n'
-        replay_gen_source += '        case VKTRACE_TPI_VK_vkCmdDrawIndexed + PREMAP_SHIFT: {\n'
-        replay_gen_source += '            packet_vkCmdDrawIndexed* pPacket = (packet_vkCmdDrawIndexed*)(packet->pBody);\n'
-        replay_gen_source += '            manually_replay_vkCmdDrawIndexedPremapped(pPacket);\n'
-        replay_gen_source += '            break;\n'
-        replay_gen_source += '        }\n'
+        # Replay the premapped packets, see premap()
+        premap_cmds = []
+        for api in self.cmdMembers:
+            cmdname = api.name[2:]
+            if not isSupportedCmd(api, cmd_extension_dict) or cmdname in api_remap:
+                continue
+            if cmdname in manually_premapped_funcs:
+                premap_cmds.append((cmdname, None))
+            elif cmdname not in manually_replay_funcs and cmdname not in custom_body_dict \
+                 and cmd_info_dict[api.name].elem.find('proto/type').text == 'void' and cmd_protect_dict[api.name] is None \
+                 and self.IsPremappableCmd(cmdname, cmd_member_dict[api.name]):
+                premap_cmds.append((cmdname, cmd_member_dict[api.name]))
+        for (cmdname, params) in premap_cmds:
+            replay_gen_source += '        case VKTRACE_TPI_VK_vk%s + PREMAP_SHIFT: {\n' % cmdname
+            replay_gen_source += '            packet_vk%s* pPacket = (packet_vk%s*)(packet->pBody);\n' % (cmdname, cmdname)
+            if params is None:
+                if cmd_info_dict['vk' + cmdname].elem.find('proto/type').text == 'VkResult':
+                    replay_gen_source += '            if (callFailedDuringTrace(pPacket->result, packet->packet_id)) {\n'
+                    replay_gen_source += '                break;\n'
+                    replay_gen_source += '            }\n'
+                    replay_gen_source += '            replayResult = manually_replay_vk%sPremapped(pPacket);\n' % cmdname
+                    replay_gen_source += '            CHECK_RETURN_VALUE(vk%s + PREMAP_SHIFT);\n' % cmdname
+                else:
+                    replay_gen_source += '            manually_replay_vk%sPremapped(pPacket);\n' % cmdname
+            else:
+                replay_gen_source += self.GenReplayPremappedCmd(cmdname, params)
+            replay_gen_source += '            break;\n'
+            replay_gen_source += '        }\n'
         replay_gen_source += '        case VKTRACE_TPI_VK_vkCmdCopyBufferRemapBuffer:\n'
         replay_gen_source += '        case VKTRACE_TPI_VK_vkCmdCopyBufferRemapAS:\n'
         replay_gen_source += '        case VKTRACE_TPI_VK_vkCmdCopyBufferRemapASandBuffer: {\n'
@@ -1985,7 +2036,26 @@ class VkTraceFileOutputGenerator(OutputGenerator):
         replay_gen_source += '    if (replayResult < 0) {\n'
         replay_gen_source += '        vktrace_LogError("gid = %llu, API %s return result = %d", packet->global_packet_index, vktrace_vk_packet_id_name((VKTRACE_TRACE_PACKET_ID_VK)packet->packet_id), replayResult);\n'
         replay_gen_source += '    }\n'
+        replay_gen_source += '    if (m_asyncPipelineCompiler != nullptr) {\n'
+        replay_gen_source += '        returnValue = async_pipelines_replayed(packet, returnValue);\n'
+        replay_gen_source += '    }\n'
         replay_gen_source += '    return returnValue;\n'
+        replay_gen_source += '}\n\n'
+        # Called on the preload thread, it only adds the premapped handles to the object mapper
+        replay_gen_source += 'bool vkReplay::premap(vktrace_trace_packet_header* pHeader) {\n'
+        replay_gen_source += '    switch (pHeader->packet_id) {\n'
+        for (cmdname, params) in premap_cmds:
+            replay_gen_source += '        case VKTRACE_TPI_VK_vk%s: {\n' % cmdname
+            if params is None:
+                replay_gen_source += '            return premap_%s(pHeader);\n' % cmdname
+            else:
+                replay_gen_source += '            packet_vk%s* pPacket = (packet_vk%s*)(pHeader->pBody);\n' % (cmdname, cmdname)
+                replay_gen_source += self.GenPremapCmd(params)
+                replay_gen_source += '            return true;\n'
+            replay_gen_source += '        }\n'
+        replay_gen_source += '        default:\n'
+        replay_gen_source += '            return false;\n'
+        replay_gen_source += '    }\n'
         replay_gen_source += '}\n'
         replay_gen_source += '}\n'
         return replay_gen_source
@@ -2051,6 +2121,76 @@ class VkTraceFileOutputGenerator(OutputGenerator):
                 return result
         return '            // No need to remap %s\n' % (param.name)
     #
+    # Return True if the generated code can premap the packets of a vkCmd* command: the handles of
+    # the command are passed by value, and replay() has no special code for it
+    def IsPremappableCmd(self, funcName, params):
+        if not funcName.startswith('Cmd') or funcName in premap_exclusions:
+            return False
+        if True in [name in funcName for name in ['AccelerationStructure', 'Micromap', 'TraceRays']]:
+            return False
+        for p in params:
+            cleanParamType = p.type.strip('*').replace('const ', '')
+            if p.ispointer and (p.handle is not None or self.StructContainsHandle(cleanParamType)):
+                return False
+        return True
+    #
+    # Check if a structure or one of the structures it points to has a handle member
+    def StructContainsHandle(self, typeName, visited=None):
+        if typeName not in self.structNames:
+            return False
+        visited = set() if visited is None else visited
+        if typeName in visited:
+            return False
+        visited.add(typeName)
+        member_index = next((i for i, v in enumerate(self.structMembers) if v[0] == typeName), None)
+        if member_index is None:
+            return False
+        for item in self.structMembers[member_index].members:
+            if item.handle is not None or self.StructContainsHandle(item.type, visited):
+                return True
+        return False
+    #
+    # Premap the handles of the premapped types of a vkCmd* packet, see IsPremappableCmd()
+    def GenPremapCmd(self, params):
+        premap = ''
+        for p in params:
+            if p.type in premapped_object_types:
+                slot_type = '%s*' % p.type
+            elif p.type in premapped_remapped_object_types:
+                slot_type = '%s*' % premapped_remapped_object_types[p.type][0]
+            else:
+                continue
+            map_name = p.type[2:].lower() + 's'
+            indent = '            '
+            if p.type != 'VkCommandBuffer':
+                premap += '            if (pPacket->%s != VK_NULL_HANDLE) {\n' % p.name
+                indent += '    '
+            premap += '%s%s p%s = m_objMapper.add_null_to_%s_map(pPacket->%s);\n' % (indent, slot_type, p.name, map_name, p.name)
+            premap += '%spPacket->%s = reinterpret_cast<%s>(p%s);\n' % (indent, p.name, p.type, p.name)
+            if p.type != 'VkCommandBuffer':
+                premap += '            }\n'
+        return premap
+    #
+    # Replay a premapped vkCmd* packet. The packet keeps the premapped handles, so it can be replayed again
+    def GenReplayPremappedCmd(self, funcName, params):
+        replay = ''
+        for p in params:
+            if p.type in premapped_object_types:
+                replay += '            %s remapped%s = pPacket->%s != VK_NULL_HANDLE ? *reinterpret_cast<%s*>(pPacket->%s) : VK_NULL_HANDLE;\n' % (p.type, p.name, p.name, p.type, p.name)
+            elif p.type in premapped_remapped_object_types:
+                (obj_type, member) = premapped_remapped_object_types[p.type]
+                replay += '            %s remapped%s = pPacket->%s != VK_NULL_HANDLE ? reinterpret_cast<%s*>(pPacket->%s)->%s : VK_NULL_HANDLE;\n' % (p.type, p.name, p.name, obj_type, p.name, member)
+            else:
+                if p.handle is not None:
+                    replay += self.RemapPacketParam(funcName, p, '')
+                continue
+            replay += '            if (pPacket->%s != VK_NULL_HANDLE && remapped%s == VK_NULL_HANDLE) {\n' % (p.name, p.name)
+            replay += '                vktrace_LogError("Error detected in %sPremapped() due to invalid remapped %s.");\n' % (funcName, p.type)
+            replay += '                return vktrace_replay::VKTRACE_REPLAY_ERROR;\n'
+            replay += '            }\n'
+        replay += '            m_vkDeviceFuncs.%s(%s);\n' % (funcName, ', '.join([self.GetPacketParam(funcName, p.type, p.name) for p in params if p.name != '']))
+        return replay
+    #
     # Return correct remapping prefix
     def GetPacketParam(self, funcName, paramType, paramName):
         # List of types that require remapping
@@ -2195,7 +2335,7 @@ class VkTraceFileOutputGenerator(OutputGenerator):
         #
         # Construct packet id stringify helper function
         trace_pkt_id_hdr += 'static const char *vktrace_stringify_vk_packet_id(const VKTRACE_TRACE_PACKET_ID_VK id, const vktrace_trace_packet_header* pHeader) {\n'
-        trace_pkt_id_hdr += '    static char str[1024];\n'
+        trace_pkt_id_hdr += '    static VKTRACE_THREAD_LOCAL char str[1024];\n'
         trace_pkt_id_hdr += '    switch(id) {\n'
         trace_pkt_id_hdr += '        case VKTRACE_TPI_VK_vkApiVersion: {\n'
         trace_pkt_id_hdr += '            packet_vkApiVersion* pPacket = (packet_vkApiVersion*)(pHeader->pBody);\n'
@@ -3037,7 +3177,7 @@ class VkTraceFileOutputGenerator(OutputGenerator):
             trim_instructions.append("        if (pInfo != NULL) {")
             trim_instructions.append("            pInfo->ObjectInfo.Image.mostRecentLayout = dstImageLayout;")
             trim_instructions.append("        }")
-            trim_instructions.append("        trim::add_CommandBuffer_call(commandBuffer, trim::copy_packet(pHeader));")
+            trim_instructions.append("        trim::add_CommandBuffer_call(commandBuffer, pHeader);")
             trim_instructions.append('        if (g_trimIsInTrim) {')
             if 'vkCmdCopyBufferToImage' == proto.name:
                 trim_instructions.append("            trim::mark_Buffer_reference(srcBuffer);")
@@ -3055,7 +3195,7 @@ class VkTraceFileOutputGenerator(OutputGenerator):
             trim_instructions.append("        if (pInfo != NULL) {")
             trim_instructions.append("            pInfo->ObjectInfo.Image.mostRecentLayout = imageLayout;")
             trim_instructions.append("        }")
-            trim_instructions.append("        trim::add_CommandBuffer_call(commandBuffer, trim::copy_packet(pHeader));")
+            trim_instructions.append("        trim::add_CommandBuffer_call(commandBuffer, pHeader);")
             trim_instructions.append('        if (g_trimIsInTrim) {')
             trim_instructions.append("            trim::mark_Image_reference(image);")
             trim_instructions.append('            trim::write_packet(pHeader);')
@@ -3072,7 +3212,7 @@ class VkTraceFileOutputGenerator(OutputGenerator):
             trim_instructions.append('                }')
             trim_instructions.append('            }')
             trim_instructions.append('        }')
-            trim_instructions.append("        trim::add_CommandBuffer_call(commandBuffer, trim::copy_packet(pHeader));")
+            trim_instructions.append("        trim::add_CommandBuffer_call(commandBuffer, pHeader);")
             trim_instructions.append('        if (g_trimIsInTrim) {')
             trim_instructions.append('            trim::write_packet(pHeader);')
             trim_instructions.append('        } else {')
@@ -3106,7 +3246,7 @@ class VkTraceFileOutputGenerator(OutputGenerator):
               'vkCmdSetEvent' == proto.name or
               'vkCmdResetEvent' == proto.name or
               'vkCmdNextSubpass' == proto.name):
-            trim_instructions.append("        trim::add_CommandBuffer_call(commandBuffer, trim::copy_packet(pHeader));")
+            trim_instructions.append("        trim::add_CommandBuffer_call(commandBuffer, pHeader);")
             trim_instructions.append('        if (g_trimIsInTrim) {')
             if 'vkCmdBindDescriptorSets' == proto.name:
                 trim_instructions.append('            for (uint32_t i = 0; i < descriptorSetCount; i++) {')
@@ -3128,7 +3268,7 @@ class VkTraceFileOutputGenerator(OutputGenerator):
             trim_instructions.append('            vktrace_delete_trace_packet(&pHeader);')
             trim_instructions.append('        }')
         elif ('vkCmdBindPipeline' == proto.name):
-            trim_instructions.append("        trim::add_CommandBuffer_call(commandBuffer, trim::copy_packet(pHeader));")
+            trim_instructions.append("        trim::add_CommandBuffer_call(commandBuffer, pHeader);")
             trim_instructions.append("        trim::add_CommandBuffer_to_binding_Pipeline(commandBuffer, pipeline);")
             trim_instructions.append("        trim::add_binding_Pipeline_to_CommandBuffer(commandBuffer, pipeline);")
             trim_instructions.append('        if (g_trimIsInTrim) {')
@@ -3528,7 +3668,7 @@ class VkTraceFileOutputGenerator(OutputGenerator):
             trim_instructions.append("                pInfo->ObjectInfo.QueryPool.pResultsAvailable[i] = false;")
             trim_instructions.append("            }")
             trim_instructions.append("        }")
-            trim_instructions.append("        trim::add_CommandBuffer_call(commandBuffer, trim::copy_packet(pHeader));")
+            trim_instructions.append("        trim::add_CommandBuffer_call(commandBuffer, pHeader);")
             trim_instructions.append('        if (g_trimIsInTrim) {')
             trim_instructions.append('            g_queryCmdStatus[commandBuffer][queryPool] = QueryCmd_Reset;')
             trim_instructions.append('            trim::mark_QueryPool_reference(queryPool);')
@@ -3537,7 +3677,7 @@ class VkTraceFileOutputGenerator(OutputGenerator):
             trim_instructions.append('            vktrace_delete_trace_packet(&pHeader);')
             trim_instructions.append('        }')
         elif 'vkCmdBeginQuery' == proto.name:
-            trim_instructions.append("        trim::add_CommandBuffer_call(commandBuffer, trim::copy_packet(pHeader));")
+            trim_instructions.append("        trim::add_CommandBuffer_call(commandBuffer, pHeader);")
             trim_instructions.append('        if (g_trimIsInTrim) {')
             trim_instructions.append('            g_queryCmdStatus[commandBuffer][queryPool] = QueryCmd_Begin; ')
             trim_instructions.append('            trim::mark_QueryPool_reference(queryPool);')
@@ -3552,7 +3692,7 @@ class VkTraceFileOutputGenerator(OutputGenerator):
             trim_instructions.append("            pInfo->ObjectInfo.QueryPool.commandBuffer = commandBuffer;")
             trim_instructions.append("            pInfo->ObjectInfo.QueryPool.pResultsAvailable[query] = true;")
             trim_instructions.append("        }")
-            trim_instructions.append("        trim::add_CommandBuffer_call(commandBuffer, trim::copy_packet(pHeader));")
+            trim_instructions.append("        trim::add_CommandBuffer_call(commandBuffer, pHeader);")
             trim_instructions.append('        if (g_trimIsInTrim) {')
             trim_instructions.append('            trim::mark_QueryPool_reference(queryPool);')
             trim_instructions.append('            trim::write_packet(pHeader);')
@@ -3560,7 +3700,7 @@ class VkTraceFileOutputGenerator(OutputGenerator):
             trim_instructions.append('            vktrace_delete_trace_packet(&pHeader);')
             trim_instructions.append('        }')
         elif 'vkCmdCopyQueryPoolResults' == proto.name:
-            trim_instructions.append("        trim::add_CommandBuffer_call(commandBuffer, trim::copy_packet(pHeader));")
+            trim_instructions.append("        trim::add_CommandBuffer_call(commandBuffer, pHeader);")
             trim_instructions.append('        if (g_trimIsInTrim) {')
             trim_instructions.append('            trim::mark_QueryPool_reference(queryPool);')
             trim_instructions.append('            trim::mark_Buffer_reference(dstBuffer);')
@@ -3652,7 +3792,7 @@ class VkTraceFileOutputGenerator(OutputGenerator):
             trim_instructions.append('        }')
         else:
             if proto.name.startswith('vkCmd'):
-                trim_instructions.append("        trim::add_CommandBuffer_call(commandBuffer, trim::copy_packet(pHeader));")
+                trim_instructions.append("        trim::add_CommandBuffer_call(commandBuffer, pHeader);")
                 trim_instructions.append('        if (g_trimIsInTrim) {')
                 trim_instructions.append('            trim::write_packet(pHeader);')
                 trim_instructions.append('        } else {')
@@ -3686,9 +3826,33 @@ class VkTraceFileOutputGenerator(OutputGenerator):
         dump_gen_source += '    }\n'
         dump_gen_source += '}\n'
         dump_gen_source += '\n'
+        dump_gen_source += 'struct packet_body_formatter {\n'
+        dump_gen_source += '    explicit packet_body_formatter(const ApiDumpSettings& settings) : dump_inst(new ApiDumpSettings(settings, stream)) {}\n'
+        dump_gen_source += '\n'
+        dump_gen_source += '    // dump_inst writes to stream, so stream is declared first.\n'
+        dump_gen_source += '    std::ostringstream stream;\n'
+        dump_gen_source += '    ApiDumpInstance dump_inst;\n'
+        dump_gen_source += '};\n'
+        dump_gen_source += '\n'
+        dump_gen_source += 'packet_body_formatter* create_packet_body_formatter() {\n'
+        dump_gen_source += '    return new packet_body_formatter(ApiDumpInstance::current().settings());\n'
+        dump_gen_source += '}\n'
+        dump_gen_source += '\n'
+        dump_gen_source += 'void destroy_packet_body_formatter(packet_body_formatter* formatter) { delete formatter; }\n'
+        dump_gen_source += '\n'
         dump_gen_source += 'void dump_packet(const vktrace_trace_packet_header* packet) {\n'
         dump_gen_source += '    switch (packet->packet_id) {\n'
 
+        body_source  = '\n'
+        body_source += 'bool dump_packet_body(packet_body_formatter* formatter, const vktrace_trace_packet_header* packet, std::string& body) {\n'
+        body_source += '    ApiDumpInstance& dump_inst = formatter->dump_inst;\n'
+        body_source += '    formatter->stream.str("");\n'
+        body_source += '    switch (packet->packet_id) {\n'
+
+        formatted_source  = '\n'
+        formatted_source += 'void dump_packet(const vktrace_trace_packet_header* packet, const std::string& body) {\n'
+        formatted_source += '    switch (packet->packet_id) {\n'
+
         for api in self.cmdMembers:
             if not isSupportedCmd(api, cmd_extension_dict):
                 continue
@@ -3708,9 +3872,10 @@ class VkTraceFileOutputGenerator(OutputGenerator):
                 ret_value = False
 
             params = cmd_member_dict[vk_cmdname]
-            dump_gen_source += '        case VKTRACE_TPI_VK_vk%s: { \n' % cmdname
+            case_line = '        case VKTRACE_TPI_VK_vk%s: { \n' % cmdname
+            dump_gen_source += case_line
             if cmdname != 'GetInstanceProcAddr' and cmdname != 'GetDeviceProcAddr':
-                dump_gen_source += '            packet_vk%s* pPacket = (packet_vk%s*)(packet->pBody);\n' % (cmdname, cmdname)
+                packet_line = '            packet_vk%s* pPacket = (packet_vk%s*)(packet->pBody);\n' % (cmdname, cmdname)
 
                 # Build the call to the "dump_" entrypoint
                 param_string = ''
@@ -3724,180 +3889,214 @@ class VkTraceFileOutputGenerator(OutputGenerator):
                 param_string = '%s);' % param_string[:-2]
                 param_string_no_result = '%s);' % param_string_no_result[:-2]
 
+                fixup = ''
                 if cmdname == 'CreateDescriptorSetLayout':
-                    dump_gen_source += '            VkDescriptorSetLayoutCreateInfo *pInfo = (VkDescriptorSetLayoutCreateInfo *)pPacket->pCreateInfo;\n'
-                    dump_gen_source += '            if (pInfo != NULL) {\n'
-                    dump_gen_source += '                if (pInfo->pBindings != NULL) {\n'
-                    dump_gen_source += '                    pInfo->pBindings = (VkDescriptorSetLayoutBinding *)vktrace_trace_packet_interpret_buffer_pointer(\n'
-                    dump_gen_source += '                        pPacket->header, (intptr_t)pInfo->pBindings);\n'
-                    dump_gen_source += '                    for (unsigned int i = 0; i < pInfo->bindingCount; i++) {\n'
-                    dump_gen_source += '                        VkDescriptorSetLayoutBinding *pBindings = (VkDescriptorSetLayoutBinding *)&pInfo->pBindings[i];\n'
-                    dump_gen_source += '                        if (pBindings->pImmutableSamplers != NULL) {\n'
-                    dump_gen_source += '                            pBindings->pImmutableSamplers = (const VkSampler *)vktrace_trace_packet_interpret_buffer_pointer(\n'
-                    dump_gen_source += '                                pPacket->header, (intptr_t)pBindings->pImmutableSamplers);\n'
-                    dump_gen_source += '                        }\n'
-                    dump_gen_source += '                    }\n'
-                    dump_gen_source += '                }\n'
-                    dump_gen_source += '            }\n'
+                    fixup += '            VkDescriptorSetLayoutCreateInfo *pInfo = (VkDescriptorSetLayoutCreateInfo *)pPacket->pCreateInfo;\n'
+                    fixup += '            if (pInfo != NULL) {\n'
+                    fixup += '                if (pInfo->pBindings != NULL) {\n'
+                    fixup += '                    pInfo->pBindings = (VkDescriptorSetLayoutBinding *)vktrace_trace_packet_interpret_buffer_pointer(\n'
+                    fixup += '                        pPacket->header, (intptr_t)pInfo->pBindings);\n'
+                    fixup += '                    for (unsigned int i = 0; i < pInfo->bindingCount; i++) {\n'
+                    fixup += '                        VkDescriptorSetLayoutBinding *pBindings = (VkDescriptorSetLayoutBinding *)&pInfo->pBindings[i];\n'
+                    fixup += '                        if (pBindings->pImmutableSamplers != NULL) {\n'
+                    fixup += '                            pBindings->pImmutableSamplers = (const VkSampler *)vktrace_trace_packet_interpret_buffer_pointer(\n'
+                    fixup += '                                pPacket->header, (intptr_t)pBindings->pImmutableSamplers);\n'
+                    fixup += '                        }\n'
+                    fixup += '                    }\n'
+                    fixup += '                }\n'
+                    fixup += '            }\n'
                 elif cmdname == 'QueueBindSparse':
-                    dump_gen_source += '            VkSparseImageMemoryBindInfo *sIMBinf = NULL;\n'
-                    dump_gen_source += '            VkSparseBufferMemoryBindInfo *sBMBinf = NULL;\n'
-                    dump_gen_source += '            VkSparseImageOpaqueMemoryBindInfo *sIMOBinf = NULL;\n'
-                    dump_gen_source += '            VkSparseImageMemoryBind *pLocalIMs = NULL;\n'
-                    dump_gen_source += '            VkSparseMemoryBind *pLocalBMs = NULL;\n'
-                    dump_gen_source += '            VkSparseMemoryBind *pLocalIOMs = NULL;\n'
-                    dump_gen_source += '            VkBindSparseInfo *pLocalBIs = VKTRACE_NEW_ARRAY(VkBindSparseInfo, pPacket->bindInfoCount);\n'
-                    dump_gen_source += '            memcpy((void *)pLocalBIs, (void *)(pPacket->pBindInfo), sizeof(VkBindSparseInfo) * pPacket->bindInfoCount);\n'
-                    dump_gen_source += '            for (uint32_t i = 0; i < pPacket->bindInfoCount; i++) {\n'
-                    dump_gen_source += '                vkreplay_process_pnext_structs(pPacket->header, (void *)&pLocalBIs[i]);\n'
-                    dump_gen_source += '                if (pLocalBIs[i].pBufferBinds) {\n'
-                    dump_gen_source += '                    sBMBinf = VKTRACE_NEW_ARRAY(VkSparseBufferMemoryBindInfo, pLocalBIs[i].bufferBindCount);\n'
-                    dump_gen_source += '                    pLocalBIs[i].pBufferBinds =\n'
-                    dump_gen_source += '                        (const VkSparseBufferMemoryBindInfo *)(vktrace_trace_packet_interpret_buffer_pointer(\n'
-                    dump_gen_source += '                            pPacket->header, (intptr_t)pLocalBIs[i].pBufferBinds));\n'
-                    dump_gen_source += '                    memcpy((void *)sBMBinf, (void *)pLocalBIs[i].pBufferBinds,\n'
-                    dump_gen_source += '                        sizeof(VkSparseBufferMemoryBindInfo) * pLocalBIs[i].bufferBindCount);\n'
-                    dump_gen_source += '                    if (pLocalBIs[i].pBufferBinds->bindCount > 0 && pLocalBIs[i].pBufferBinds->pBinds) {\n'
-                    dump_gen_source += '                        pLocalBMs  = (VkSparseMemoryBind *)(vktrace_trace_packet_interpret_buffer_pointer(\n'
-                    dump_gen_source += '                            pPacket->header, (intptr_t)pLocalBIs[i].pBufferBinds->pBinds));\n'
-                    dump_gen_source += '                    }\n'
-                    dump_gen_source += '                    sBMBinf->pBinds = pLocalBMs;\n'
-                    dump_gen_source += '                    pLocalBIs[i].pBufferBinds = sBMBinf;\n'
-                    dump_gen_source += '                }\n'
-                    dump_gen_source += '                if (pLocalBIs[i].pImageBinds) {\n'
-                    dump_gen_source += '                    sIMBinf = VKTRACE_NEW_ARRAY(VkSparseImageMemoryBindInfo, pLocalBIs[i].imageBindCount);\n'
-                    dump_gen_source += '                    pLocalBIs[i].pImageBinds =\n'
-                    dump_gen_source += '                        (const VkSparseImageMemoryBindInfo *)(vktrace_trace_packet_interpret_buffer_pointer(\n'
-                    dump_gen_source += '                            pPacket->header, (intptr_t)pLocalBIs[i].pImageBinds));\n'
-                    dump_gen_source += '                    memcpy((void *)sIMBinf, (void *)pLocalBIs[i].pImageBinds,\n'
-                    dump_gen_source += '                        sizeof(VkSparseImageMemoryBindInfo) * pLocalBIs[i].imageBindCount);\n'
-                    dump_gen_source += '                    if (pLocalBIs[i].pImageBinds->bindCount > 0 && pLocalBIs[i].pImageBinds->pBinds) {\n'
-                    dump_gen_source += '                        pLocalIMs  = (VkSparseImageMemoryBind *)(vktrace_trace_packet_interpret_buffer_pointer(\n'
-                    dump_gen_source += '                            pPacket->header, (intptr_t)pLocalBIs[i].pImageBinds->pBinds));\n'
-                    dump_gen_source += '                    }\n'
-                    dump_gen_source += '                    sIMBinf->pBinds = pLocalIMs;\n'
-                    dump_gen_source += '                    pLocalBIs[i].pImageBinds = sIMBinf;\n'
-                    dump_gen_source += '                }\n'
-                    dump_gen_source += '                if (pLocalBIs[i].pImageOpaqueBinds) {\n'
-                    dump_gen_source += '                    sIMOBinf = VKTRACE_NEW_ARRAY(VkSparseImageOpaqueMemoryBindInfo, pLocalBIs[i].imageOpaqueBindCount);\n'
-                    dump_gen_source += '                    pLocalBIs[i].pImageOpaqueBinds =\n'
-                    dump_gen_source += '                        (const VkSparseImageOpaqueMemoryBindInfo *)(vktrace_trace_packet_interpret_buffer_pointer(\n'
-                    dump_gen_source += '                            pPacket->header, (intptr_t)pLocalBIs[i].pImageOpaqueBinds));\n'
-                    dump_gen_source += '                    memcpy((void *)sIMOBinf, (void *)pLocalBIs[i].pImageOpaqueBinds,\n'
-                    dump_gen_source += '                        sizeof(VkSparseImageOpaqueMemoryBindInfo) * pLocalBIs[i].imageOpaqueBindCount);\n'
-                    dump_gen_source += '                    if (pLocalBIs[i].pImageOpaqueBinds->bindCount > 0 && pLocalBIs[i].pImageOpaqueBinds->pBinds) {\n'
-                    dump_gen_source += '                        pLocalIOMs = (VkSparseMemoryBind *)(vktrace_trace_packet_interpret_buffer_pointer(\n'
-                    dump_gen_source += '                            pPacket->header, (intptr_t)pLocalBIs[i].pImageOpaqueBinds->pBinds));\n'
-                    dump_gen_source += '                    }\n'
-                    dump_gen_source += '                    sIMOBinf->pBinds = pLocalIOMs;\n'
-                    dump_gen_source += '                    pLocalBIs[i].pImageOpaqueBinds = sIMOBinf;\n'
-                    dump_gen_source += '                }\n'
-                    dump_gen_source += '            }\n'
-                    dump_gen_source += '            pPacket->pBindInfo = pLocalBIs;\n'
+                    fixup += '            VkSparseImageMemoryBindInfo *sIMBinf = NULL;\n'
+                    fixup += '            VkSparseBufferMemoryBindInfo *sBMBinf = NULL;\n'
+                    fixup += '            VkSparseImageOpaqueMemoryBindInfo *sIMOBinf = NULL;\n'
+                    fixup += '            VkSparseImageMemoryBind *pLocalIMs = NULL;\n'
+                    fixup += '            VkSparseMemoryBind *pLocalBMs = NULL;\n'
+                    fixup += '            VkSparseMemoryBind *pLocalIOMs = NULL;\n'
+                    fixup += '            VkBindSparseInfo *pLocalBIs = VKTRACE_NEW_ARRAY(VkBindSparseInfo, pPacket->bindInfoCount);\n'
+                    fixup += '            memcpy((void *)pLocalBIs, (void *)(pPacket->pBindInfo), sizeof(VkBindSparseInfo) * pPacket->bindInfoCount);\n'
+                    fixup += '            for (uint32_t i = 0; i < pPacket->bindInfoCount; i++) {\n'
+                    fixup += '                vkreplay_process_pnext_structs(pPacket->header, (void *)&pLocalBIs[i]);\n'
+                    fixup += '                if (pLocalBIs[i].pBufferBinds) {\n'
+                    fixup += '                    sBMBinf = VKTRACE_NEW_ARRAY(VkSparseBufferMemoryBindInfo, pLocalBIs[i].bufferBindCount);\n'
+                    fixup += '                    pLocalBIs[i].pBufferBinds =\n'
+                    fixup += '                        (const VkSparseBufferMemoryBindInfo *)(vktrace_trace_packet_interpret_buffer_pointer(\n'
+                    fixup += '                            pPacket->header, (intptr_t)pLocalBIs[i].pBufferBinds));\n'
+                    fixup += '                    memcpy((void *)sBMBinf, (void *)pLocalBIs[i].pBufferBinds,\n'
+                    fixup += '                        sizeof(VkSparseBufferMemoryBindInfo) * pLocalBIs[i].bufferBindCount);\n'
+                    fixup += '                    if (pLocalBIs[i].pBufferBinds->bindCount > 0 && pLocalBIs[i].pBufferBinds->pBinds) {\n'
+                    fixup += '                        pLocalBMs  = (VkSparseMemoryBind *)(vktrace_trace_packet_interpret_buffer_pointer(\n'
+                    fixup += '                            pPacket->header, (intptr_t)pLocalBIs[i].pBufferBinds->pBinds));\n'
+                    fixup += '                    }\n'
+                    fixup += '                    sBMBinf->pBinds = pLocalBMs;\n'
+                    fixup += '                    pLocalBIs[i].pBufferBinds = sBMBinf;\n'
+                    fixup += '                }\n'
+                    fixup += '                if (pLocalBIs[i].pImageBinds) {\n'
+                    fixup += '                    sIMBinf = VKTRACE_NEW_ARRAY(VkSparseImageMemoryBindInfo, pLocalBIs[i].imageBindCount);\n'
+                    fixup += '                    pLocalBIs[i].pImageBinds =\n'
+                    fixup += '                        (const VkSparseImageMemoryBindInfo *)(vktrace_trace_packet_interpret_buffer_pointer(\n'
+                    fixup += '                            pPacket->header, (intptr_t)pLocalBIs[i].pImageBinds));\n'
+                    fixup += '                    memcpy((void *)sIMBinf, (void *)pLocalBIs[i].pImageBinds,\n'
+                    fixup += '                        sizeof(VkSparseImageMemoryBindInfo) * pLocalBIs[i].imageBindCount);\n'
+                    fixup += '                    if (pLocalBIs[i].pImageBinds->bindCount > 0 && pLocalBIs[i].pImageBinds->pBinds) {\n'
+                    fixup += '                        pLocalIMs  = (VkSparseImageMemoryBind *)(vktrace_trace_packet_interpret_buffer_pointer(\n'
+                    fixup += '                            pPacket->header, (intptr_t)pLocalBIs[i].pImageBinds->pBinds));\n'
+                    fixup += '                    }\n'
+                    fixup += '                    sIMBinf->pBinds = pLocalIMs;\n'
+                    fixup += '                    pLocalBIs[i].pImageBinds = sIMBinf;\n'
+                    fixup += '                }\n'
+                    fixup += '                if (pLocalBIs[i].pImageOpaqueBinds) {\n'
+                    fixup += '                    sIMOBinf = VKTRACE_NEW_ARRAY(VkSparseImageOpaqueMemoryBindInfo, pLocalBIs[i].imageOpaqueBindCount);\n'
+                    fixup += '                    pLocalBIs[i].pImageOpaqueBinds =\n'
+                    fixup += '                        (const VkSparseImageOpaqueMemoryBindInfo *)(vktrace_trace_packet_interpret_buffer_pointer(\n'
+                    fixup += '                            pPacket->header, (intptr_t)pLocalBIs[i].pImageOpaqueBinds));\n'
+                    fixup += '                    memcpy((void *)sIMOBinf, (void *)pLocalBIs[i].pImageOpaqueBinds,\n'
+                    fixup += '                        sizeof(VkSparseImageOpaqueMemoryBindInfo) * pLocalBIs[i].imageOpaqueBindCount);\n'
+                    fixup += '                    if (pLocalBIs[i].pImageOpaqueBinds->bindCount > 0 && pLocalBIs[i].pImageOpaqueBinds->pBinds) {\n'
+                    fixup += '                        pLocalIOMs = (VkSparseMemoryBind *)(vktrace_trace_packet_interpret_buffer_pointer(\n'
+                    fixup += '                            pPacket->header, (intptr_t)pLocalBIs[i].pImageOpaqueBinds->pBinds));\n'
+                    fixup += '                    }\n'
+                    fixup += '                    sIMOBinf->pBinds = pLocalIOMs;\n'
+                    fixup += '                    pLocalBIs[i].pImageOpaqueBinds = sIMOBinf;\n'
+                    fixup += '                }\n'
+                    fixup += '            }\n'
+                    fixup += '            pPacket->pBindInfo = pLocalBIs;\n'
                 elif cmdname == 'CreateComputePipelines':
-                    dump_gen_source += '            VkComputePipelineCreateInfo *pLocalCIs = VKTRACE_NEW_ARRAY(VkComputePipelineCreateInfo, pPacket->createInfoCount);\n'
-                    dump_gen_source += '            memcpy((void *)pLocalCIs, (void *)(pPacket->pCreateInfos), sizeof(VkComputePipelineCreateInfo) * pPacket->createInfoCount);\n'
-                    dump_gen_source += '            for (uint32_t i = 0; i < pPacket->createInfoCount; i++) {\n'
-                    dump_gen_source += '                vkreplay_process_pnext_structs(pPacket->header, (void *)&pLocalCIs[i]);\n'
-                    dump_gen_source += '            }\n'
-                    dump_gen_source += '            pPacket->pCreateInfos = pLocalCIs;\n'
+                    fixup += '            VkComputePipelineCreateInfo *pLocalCIs = VKTRACE_NEW_ARRAY(VkComputePipelineCreateInfo, pPacket->createInfoCount);\n'
+                    fixup += '            memcpy((void *)pLocalCIs, (void *)(pPacket->pCreateInfos), sizeof(VkComputePipelineCreateInfo) * pPacket->createInfoCount);\n'
+                    fixup += '            for (uint32_t i = 0; i < pPacket->createInfoCount; i++) {\n'
+                    fixup += '                vkreplay_process_pnext_structs(pPacket->header, (void *)&pLocalCIs[i]);\n'
+                    fixup += '            }\n'
+                    fixup += '            pPacket->pCreateInfos = pLocalCIs;\n'
                 elif cmdname == 'CreateGraphicsPipelines':
-                    dump_gen_source += '            VkGraphicsPipelineCreateInfo *pLocalCIs = VKTRACE_NEW_ARRAY(VkGraphicsPipelineCreateInfo, pPacket->createInfoCount);\n'
-                    dump_gen_source += '            for (uint32_t i = 0; i < pPacket->createInfoCount; i++) {\n'
-                    dump_gen_source += '                memcpy((void *)&(pLocalCIs[i]), (void *)&(pPacket->pCreateInfos[i]), sizeof(VkGraphicsPipelineCreateInfo));\n'
-                    dump_gen_source += '                vkreplay_process_pnext_structs(pPacket->header, (void *)&pLocalCIs[i]);\n'
-                    dump_gen_source += '                vkreplay_process_pnext_structs(pPacket->header, (void *)pLocalCIs[i].pStages);\n'
-                    dump_gen_source += '                vkreplay_process_pnext_structs(pPacket->header, (void *)pLocalCIs[i].pVertexInputState);\n'
-                    dump_gen_source += '                vkreplay_process_pnext_structs(pPacket->header, (void *)pLocalCIs[i].pInputAssemblyState);\n'
-                    dump_gen_source += '                vkreplay_process_pnext_structs(pPacket->header, (void *)pLocalCIs[i].pTessellationState);\n'
-                    dump_gen_source += '                vkreplay_process_pnext_structs(pPacket->header, (void *)pLocalCIs[i].pViewportState);\n'
-                    dump_gen_source += '                vkreplay_process_pnext_structs(pPacket->header, (void *)pLocalCIs[i].pRasterizationState);\n'
-                    dump_gen_source += '                vkreplay_process_pnext_structs(pPacket->header, (void *)pLocalCIs[i].pMultisampleState);\n'
-                    dump_gen_source += '                vkreplay_process_pnext_structs(pPacket->header, (void *)pLocalCIs[i].pDepthStencilState);\n'
-                    dump_gen_source += '                vkreplay_process_pnext_structs(pPacket->header, (void *)pLocalCIs[i].pColorBlendState);\n'
-                    dump_gen_source += '                vkreplay_process_pnext_structs(pPacket->header, (void *)pLocalCIs[i].pDynamicState);\n'
-                    dump_gen_source += '                if (pLocalCIs[i].pViewportState != NULL) {\n'
-                    dump_gen_source += '                    ((VkPipelineViewportStateCreateInfo *)pLocalCIs[i].pViewportState)->pViewports =\n'
-                    dump_gen_source += '                        (VkViewport *)vktrace_trace_packet_interpret_buffer_pointer(\n'
-                    dump_gen_source += '                        pPacket->header, (intptr_t)pPacket->pCreateInfos[i].pViewportState->pViewports);\n'
-                    dump_gen_source += '                    ((VkPipelineViewportStateCreateInfo *)pLocalCIs[i].pViewportState)->pScissors =\n'
-                    dump_gen_source += '                        (VkRect2D *)vktrace_trace_packet_interpret_buffer_pointer(pPacket->header,\n'
-                    dump_gen_source += '                        (intptr_t)pPacket->pCreateInfos[i].pViewportState->pScissors);\n'
-                    dump_gen_source += '                }\n'
-                    dump_gen_source += '                if (pLocalCIs[i].pMultisampleState != NULL) {\n'
-                    dump_gen_source += '                    ((VkPipelineMultisampleStateCreateInfo *)pLocalCIs[i].pMultisampleState)->pSampleMask =\n'
-                    dump_gen_source += '                        (VkSampleMask *)vktrace_trace_packet_interpret_buffer_pointer(\n'
-                    dump_gen_source += '                        pPacket->header, (intptr_t)pPacket->pCreateInfos[i].pMultisampleState->pSampleMask);\n'
-                    dump_gen_source += '                }\n'
-                    dump_gen_source += '            }\n'
-                    dump_gen_source += '            pPacket->pCreateInfos = pLocalCIs;\n'
-                dump_gen_source += '            ApiDumpInstance& dump_inst = ApiDumpInstance::current();\n'
-                dump_gen_source += '            const ApiDumpSettings& settings(dump_inst.settings());\n'
-                dump_gen_source += '            dump_inst.setThreadID(packet->thread_id);\n'
-                dump_gen_source += '            if (!settings.isFrameInRange(dump_inst.frameCount())) {\n'
+                    fixup += '            VkGraphicsPipelineCreateInfo *pLocalCIs = VKTRACE_NEW_ARRAY(VkGraphicsPipelineCreateInfo, pPacket->createInfoCount);\n'
+                    fixup += '            for (uint32_t i = 0; i < pPacket->createInfoCount; i++) {\n'
+                    fixup += '                memcpy((void *)&(pLocalCIs[i]), (void *)&(pPacket->pCreateInfos[i]), sizeof(VkGraphicsPipelineCreateInfo));\n'
+                    fixup += '                vkreplay_process_pnext_structs(pPacket->header, (void *)&pLocalCIs[i]);\n'
+                    fixup += '                vkreplay_process_pnext_structs(pPacket->header, (void *)pLocalCIs[i].pStages);\n'
+                    fixup += '                vkreplay_process_pnext_structs(pPacket->header, (void *)pLocalCIs[i].pVertexInputState);\n'
+                    fixup += '                vkreplay_process_pnext_structs(pPacket->header, (void *)pLocalCIs[i].pInputAssemblyState);\n'
+                    fixup += '                vkreplay_process_pnext_structs(pPacket->header, (void *)pLocalCIs[i].pTessellationState);\n'
+                    fixup += '                vkreplay_process_pnext_structs(pPacket->header, (void *)pLocalCIs[i].pViewportState);\n'
+                    fixup += '                vkreplay_process_pnext_structs(pPacket->header, (void *)pLocalCIs[i].pRasterizationState);\n'
+                    fixup += '                vkreplay_process_pnext_structs(pPacket->header, (void *)pLocalCIs[i].pMultisampleState);\n'
+                    fixup += '                vkreplay_process_pnext_structs(pPacket->header, (void *)pLocalCIs[i].pDepthStencilState);\n'
+                    fixup += '                vkreplay_process_pnext_structs(pPacket->header, (void *)pLocalCIs[i].pColorBlendState);\n'
+                    fixup += '                vkreplay_process_pnext_structs(pPacket->header, (void *)pLocalCIs[i].pDynamicState);\n'
+                    fixup += '                if (pLocalCIs[i].pViewportState != NULL) {\n'
+                    fixup += '                    ((VkPipelineViewportStateCreateInfo *)pLocalCIs[i].pViewportState)->pViewports =\n'
+                    fixup += '                        (VkViewport *)vktrace_trace_packet_interpret_buffer_pointer(\n'
+                    fixup += '                        pPacket->header, (intptr_t)pPacket->pCreateInfos[i].pViewportState->pViewports);\n'
+                    fixup += '                    ((VkPipelineViewportStateCreateInfo *)pLocalCIs[i].pViewportState)->pScissors =\n'
+                    fixup += '                        (VkRect2D *)vktrace_trace_packet_interpret_buffer_pointer(pPacket->header,\n'
+                    fixup += '                        (intptr_t)pPacket->pCreateInfos[i].pViewportState->pScissors);\n'
+                    fixup += '                }\n'
+                    fixup += '                if (pLocalCIs[i].pMultisampleState != NULL) {\n'
+                    fixup += '                    ((VkPipelineMultisampleStateCreateInfo *)pLocalCIs[i].pMultisampleState)->pSampleMask =\n'
+                    fixup += '                        (VkSampleMask *)vktrace_trace_packet_interpret_buffer_pointer(\n'
+                    fixup += '                        pPacket->header, (intptr_t)pPacket->pCreateInfos[i].pMultisampleState->pSampleMask);\n'
+                    fixup += '                }\n'
+                    fixup += '            }\n'
+                    fixup += '            pPacket->pCreateInfos = pLocalCIs;\n'
+                state = ''
+                state += '            ApiDumpInstance& dump_inst = ApiDumpInstance::current();\n'
+                state += '            const ApiDumpSettings& settings(dump_inst.settings());\n'
+                state += '            dump_inst.setThreadID(packet->thread_id);\n'
+                state += '            if (!settings.isFrameInRange(dump_inst.frameCount())) {\n'
                 if cmdname == 'QueuePresentKHR':
-                    dump_gen_source += '                dump_inst.nextFrame();\n'
+                    state += '                dump_inst.nextFrame();\n'
                 elif cmdname == 'AllocateCommandBuffers':
-                    dump_gen_source += '                dump_inst.addCmdBuffers(pPacket->device,\n'
-                    dump_gen_source += '                                    pPacket->pAllocateInfo->commandPool,\n'
-                    dump_gen_source += '                                    std::vector<VkCommandBuffer>(pPacket->pCommandBuffers, pPacket->pCommandBuffers + pPacket->pAllocateInfo->commandBufferCount),\n'
-                    dump_gen_source += '                                    pPacket->pAllocateInfo->level);\n'
+                    state += '                dump_inst.addCmdBuffers(pPacket->device,\n'
+                    state += '                                    pPacket->pAllocateInfo->commandPool,\n'
+                    state += '                                    std::vector<VkCommandBuffer>(pPacket->pCommandBuffers, pPacket->pCommandBuffers + pPacket->pAllocateInfo->commandBufferCount),\n'
+                    state += '                                    pPacket->pAllocateInfo->level);\n'
                 elif cmdname == 'DestroyCommandPool':
-                    dump_gen_source += '                dump_inst.eraseCmdBufferPool(pPacket->device, pPacket->commandPool);\n'
+                    state += '                dump_inst.eraseCmdBufferPool(pPacket->device, pPacket->commandPool);\n'
                 elif cmdname == 'FreeCommandBuffers':
-                    dump_gen_source += '                dump_inst.eraseCmdBuffers(pPacket->device,\n'
-                    dump_gen_source += '                                      pPacket->commandPool,\n'
-                    dump_gen_source += '                                      std::vector<VkCommandBuffer>(pPacket->pCommandBuffers, pPacket->pCommandBuffers + pPacket->commandBufferCount));\n'
-                dump_gen_source += '                break;\n'
-                dump_gen_source += '            }\n'
-                dump_gen_source += '            if (dump_inst.settings().format() == ApiDumpFormat::Text) {\n'
-                dump_gen_source += '                settings.stream() << \"GlobalPacketIndex \" << packet->global_packet_index << \", \";\n'
-                dump_gen_source += '            }\n'
+                    state += '                dump_inst.eraseCmdBuffers(pPacket->device,\n'
+                    state += '                                      pPacket->commandPool,\n'
+                    state += '                                      std::vector<VkCommandBuffer>(pPacket->pCommandBuffers, pPacket->pCommandBuffers + pPacket->commandBufferCount));\n'
+                state += '                break;\n'
+                state += '            }\n'
+                state += '            if (dump_inst.settings().format() == ApiDumpFormat::Text) {\n'
+                state += '                settings.stream() << \"GlobalPacketIndex \" << packet->global_packet_index << \", \";\n'
+                state += '            }\n'
                 if cmdname == 'AllocateCommandBuffers':
-                    dump_gen_source += '            dump_inst.addCmdBuffers(pPacket->device,\n'
-                    dump_gen_source += '                                    pPacket->pAllocateInfo->commandPool,\n'
-                    dump_gen_source += '                                    std::vector<VkCommandBuffer>(pPacket->pCommandBuffers, pPacket->pCommandBuffers + pPacket->pAllocateInfo->commandBufferCount),\n'
-                    dump_gen_source += '                                    pPacket->pAllocateInfo->level);\n'
+                    state += '            dump_inst.addCmdBuffers(pPacket->device,\n'
+                    state += '                                    pPacket->pAllocateInfo->commandPool,\n'
+                    state += '                                    std::vector<VkCommandBuffer>(pPacket->pCommandBuffers, pPacket->pCommandBuffers + pPacket->pAllocateInfo->commandBufferCount),\n'
+                    state += '                                    pPacket->pAllocateInfo->level);\n'
                 elif cmdname == 'DestroyCommandPool':
-                    dump_gen_source += '            dump_inst.eraseCmdBufferPool(pPacket->device, pPacket->commandPool);\n'
+                    state += '            dump_inst.eraseCmdBufferPool(pPacket->device, pPacket->commandPool);\n'
                 elif cmdname == 'FreeCommandBuffers':
-                    dump_gen_source += '            dump_inst.eraseCmdBuffers(pPacket->device,\n'
-                    dump_gen_source += '                                      pPacket->commandPool,\n'
-                    dump_gen_source += '                                      std::vector<VkCommandBuffer>(pPacket->pCommandBuffers, pPacket->pCommandBuffers + pPacket->commandBufferCount));\n'
-                dump_gen_source += '            switch(dump_inst.settings().format()) {\n'
+                    state += '            dump_inst.eraseCmdBuffers(pPacket->device,\n'
+                    state += '                                      pPacket->commandPool,\n'
+                    state += '                                      std::vector<VkCommandBuffer>(pPacket->pCommandBuffers, pPacket->pCommandBuffers + pPacket->commandBufferCount));\n'
                 cmdname_removeRemap = cmdname
                 if cmdname in api_remap:
                     cmdname_removeRemap = cmdname[:cmdname.find('Remap')]
-                dump_gen_source += '            case ApiDumpFormat::Text:\n'
-                dump_gen_source += '                dump_text_head_vk%s(dump_inst, ' % cmdname
-                dump_gen_source += '%s\n' %param_string_no_result
-                dump_gen_source += '                dump_text_body_vk%s(dump_inst, ' % cmdname_removeRemap
-                dump_gen_source += '%s\n' % param_string
-                dump_gen_source += '                break;\n'
-                dump_gen_source += '            case ApiDumpFormat::Html:\n'
-                dump_gen_source += '                dump_html_head_vk%s(dump_inst, ' % cmdname
-                dump_gen_source += '%s\n' %param_string_no_result
-                dump_gen_source += '                dump_html_body_vk%s(dump_inst, ' % cmdname_removeRemap
-                dump_gen_source += '%s\n' % param_string
-                dump_gen_source += '                break;\n'
-                dump_gen_source += '            case ApiDumpFormat::Json:\n'
-                dump_gen_source += '                dump_json_head_vk%s(dump_inst, ' % cmdname
-                dump_gen_source += '%s\n' %param_string_no_result
-                dump_gen_source += '                dump_json_body_vk%s(dump_inst, ' % cmdname_removeRemap
-                dump_gen_source += '%s\n' % param_string
-                dump_gen_source += '                break;\n'
-                dump_gen_source += '            }\n'
+                heads = ''
+                bodies = ''
+                calls = ''
+                post = ''
+                cleanup = ''
+                for fmt, fmtname in [('text', 'Text'), ('html', 'Html'), ('json', 'Json')]:
+                    heads += '            case ApiDumpFormat::%s:\n' % fmtname
+                    heads += '                dump_%s_head_vk%s(dump_inst, %s\n' % (fmt, cmdname, param_string_no_result)
+                    heads += '                break;\n'
+                    bodies += '            case ApiDumpFormat::%s:\n' % fmtname
+                    bodies += '                dump_%s_body_vk%s(dump_inst, %s\n' % (fmt, cmdname_removeRemap, param_string)
+                    bodies += '                break;\n'
+                    calls += '            case ApiDumpFormat::%s:\n' % fmtname
+                    calls += '                dump_%s_head_vk%s(dump_inst, %s\n' % (fmt, cmdname, param_string_no_result)
+                    calls += '                dump_%s_body_vk%s(dump_inst, %s\n' % (fmt, cmdname_removeRemap, param_string)
+                    calls += '                break;\n'
                 if cmdname == 'QueuePresentKHR':
-                    dump_gen_source += '            dump_inst.nextFrame();\n'
+                    post += '            dump_inst.nextFrame();\n'
                 elif cmdname == 'QueueBindSparse':
-                    dump_gen_source += '            VKTRACE_DELETE(pLocalBIs);\n'
-                    dump_gen_source += '            VKTRACE_DELETE(sIMBinf);\n'
-                    dump_gen_source += '            VKTRACE_DELETE(sBMBinf);\n'
-                    dump_gen_source += '            VKTRACE_DELETE(sIMOBinf);\n'
+                    cleanup += '            VKTRACE_DELETE(pLocalBIs);\n'
+                    cleanup += '            VKTRACE_DELETE(sIMBinf);\n'
+                    cleanup += '            VKTRACE_DELETE(sBMBinf);\n'
+                    cleanup += '            VKTRACE_DELETE(sIMOBinf);\n'
                 elif cmdname == 'CreateComputePipelines':
-                    dump_gen_source += '            VKTRACE_DELETE(pLocalCIs);\n'
+                    cleanup += '            VKTRACE_DELETE(pLocalCIs);\n'
                 elif cmdname == 'CreateGraphicsPipelines':
-                    dump_gen_source += '            VKTRACE_DELETE(pLocalCIs);\n'
+                    cleanup += '            VKTRACE_DELETE(pLocalCIs);\n'
+
+                dump_gen_source += packet_line + fixup + state
+                dump_gen_source += '            switch(dump_inst.settings().format()) {\n' + calls + '            }\n'
+                dump_gen_source += post + cleanup
+
+                # vkBeginCommandBuffer needs the levels of the command buffers allocated before it.
+                if cmdname != 'BeginCommandBuffer':
+                    if protect is not None:
+                        body_source += '#ifdef %s\n' % protect
+                        formatted_source += '#ifdef %s\n' % protect
+                    body_source += case_line + packet_line
+                    if cmdname in ['CmdDraw', 'CmdDrawIndexed', 'CmdDrawIndirect', 'CmdDrawIndexedIndirect']:
+                        # The html body counts the draw calls.
+                        body_source += '            if (dump_inst.settings().format() == ApiDumpFormat::Html) {\n'
+                        body_source += '                return false;\n'
+                        body_source += '            }\n'
+                    elif cmdname == 'CreateShaderModule':
+                        # The text body numbers the shader files it writes.
+                        body_source += '            if (dump_inst.settings().format() == ApiDumpFormat::Text && dump_inst.settings().showShader()) {\n'
+                        body_source += '                return false;\n'
+                        body_source += '            }\n'
+                    body_source += fixup
+                    body_source += '            switch(dump_inst.settings().format()) {\n' + bodies + '            }\n'
+                    body_source += cleanup
+                    body_source += '            break;\n'
+                    body_source += '        }\n'
+
+                    formatted_source += case_line + packet_line + state
+                    formatted_source += '            switch(dump_inst.settings().format()) {\n' + heads + '            }\n'
+                    formatted_source += '            settings.stream() << body;\n'
+                    formatted_source += post
+                    formatted_source += '            break;\n'
+                    formatted_source += '        }\n'
+                    if protect is not None:
+                        body_source += '#endif // %s\n' % protect
+                        formatted_source += '#endif // %s\n' % protect
             dump_gen_source += '            break;\n'
             dump_gen_source += '        }\n'
             if protect is not None:
@@ -3949,7 +4148,20 @@ class VkTraceFileOutputGenerator(OutputGenerator):
         dump_gen_source += '    }\n'
         dump_gen_source += '    return;\n'
         dump_gen_source += '}\n'
-        return dump_gen_source
+
+        body_source += '        default:\n'
+        body_source += '            return false;\n'
+        body_source += '    }\n'
+        body_source += '    body = formatter->stream.str();\n'
+        body_source += '    return true;\n'
+        body_source += '}\n'
+
+        formatted_source += '        default:\n'
+        formatted_source += '            dump_packet(packet);\n'
+        formatted_source += '            break;\n'
+        formatted_source += '    }\n'
+        formatted_source += '}\n'
+        return dump_gen_source + body_source + formatted_source
 
 
     #
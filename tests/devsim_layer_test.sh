@@ -108,6 +108,31 @@ jq -S $JSON_SECTIONS $FILENAME_02_TEMP1 > $FILENAME_02_TEMP2
 #jq --slurp  --exit-status '.[0] == .[1]' devsim_test2_gold.json $FILENAME_02_TEMP2 > /dev/null
 #[ $? -eq 0 ] || fail_msg "test2 jq comparison"
 
+#############################################################################
+# Test 3: Verify devsim results are the same when loaded from the configuration cache.
+
+CACHE_DIR_03="devsim_test3_cache"
+FILENAME_03_TEMP1="devsim_test3_temp1.json"
+FILENAME_03_TEMP2="devsim_test3_temp2.json"
+rm -rf $CACHE_DIR_03 $FILENAME_03_TEMP1 $FILENAME_03_TEMP2
+mkdir $CACHE_DIR_03
+
+export VK_DEVSIM_CACHE_DIR="$CACHE_DIR_03"
+"$VULKANINFO" -j > /dev/null 2> /dev/null
+[ $? -eq 0 ] || fail_msg "test3 vulkaninfo storing the cache"
+ls $CACHE_DIR_03/devsim_*.bin > /dev/null 2>&1
+[ $? -eq 0 ] || fail_msg "test3 cache file creation"
+
+"$VULKANINFO" -j > $FILENAME_03_TEMP1 2> /dev/null
+[ $? -eq 0 ] || fail_msg "test3 vulkaninfo loading the cache"
+unset VK_DEVSIM_CACHE_DIR
+
+jq -S $JSON_SECTIONS $FILENAME_03_TEMP1 > $FILENAME_03_TEMP2
+[ $? -eq 0 ] || fail_msg "test3 jq extraction"
+
+diff $FILENAME_02_TEMP2 $FILENAME_03_TEMP2 > /dev/null
+[ $? -eq 0 ] || fail_msg "test3 diff comparison"
+
 #############################################################################
 
 printf "$GREEN[  PASSED  ]$NC $0\n"
@@ -0,0 +1,77 @@
+#!/bin/bash
+
+# vkreplay_gpu_timestamps_test.sh
+# This script replays a trace with the GPU timestamps enabled. The replay must not report
+# errors, and every measured frame in vktrace_result.json must have a GPU time which is not
+# zero and not larger than the sum of the GPU time of its submissions. Run it from the tests
+# directory of the build with VK_ICD_FILENAMES pointing at lavapipe.
+#
+# Usage: vkreplay_gpu_timestamps_test.sh -t <trace file>
+
+TRACE=""
+
+while [[ $# -gt 0 ]]
+do
+   KEY="$1"
+   case $KEY in
+      -t|--trace)
+      TRACE="$2"
+      shift
+      shift
+      ;;
+      *)
+      echo "ERROR: $0:$LINENO"
+      echo "Unrecognized command-line argument: $1"
+      exit 1
+      ;;
+   esac
+done
+
+if [ -z "$TRACE" ]; then
+   echo "ERROR: $0:$LINENO"
+   echo "The trace file is undefined, use the -t|--trace <file> command line option."
+   exit 1
+fi
+
+if [ -t 1 ] ; then
+    RED='\033[0;31m'
+    GREEN='\033[0;32m'
+    NC='\033[0m' # No Color
+else
+    RED=''
+    GREEN=''
+    NC=''
+fi
+
+printf "$GREEN[ RUN      ]$NC $0\n"
+
+VKTRACE_DIR=${PWD}/../vktrace
+export VK_LAYER_PATH=${PWD}/../layersvt
+
+fail() {
+    printf "$RED[  FAILED  ]$NC $1\n"
+    printf "TEST FAILED\n"
+    exit 1
+}
+
+rm -f vktrace_result.json
+OUT=$("$VKTRACE_DIR/vkreplay" -o "$TRACE" -gts true 2>&1)
+if [ $? -ne 0 ] || echo "$OUT" | grep -qi "error\|Failed to read the timestamps"; then
+    echo "$OUT" | grep -i "error\|Failed to read the timestamps" | head -10
+    fail "Replay of $TRACE failed."
+fi
+[ -f vktrace_result.json ] || fail "vktrace_result.json not written."
+
+python3 - <<'PYEOF' || fail "The GPU times in vktrace_result.json are wrong."
+import json, sys
+result = json.load(open("vktrace_result.json"))["result"]
+frames = result.get("gpu_frames", [])
+if not frames:
+    sys.exit("no frame measured")
+for frame in frames:
+    if frame["gpu_time"] <= 0 or frame["gpu_time"] > sum(frame["submits"]) * (1 + 1e-9):
+        sys.exit("frame %d: gpu_time %g, submits %s" % (frame["frame"], frame["gpu_time"], frame["submits"]))
+PYEOF
+
+printf "$GREEN[  PASSED  ]$NC $0\n"
+exit 0
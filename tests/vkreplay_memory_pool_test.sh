@@ -0,0 +1,84 @@
+#!/bin/bash
+
+# vkreplay_memory_pool_test.sh
+# This script replays a trace which names or tags its device memory allocations with the memory
+# pool enabled. The handles of the pooled allocations are not driver objects, the replay must not
+# pass them to the driver. The replay must not report errors or corrupt the heap, checked with the
+# glibc malloc checks, and vktrace_result.json must report pooled allocations. Run it from the tests
+# directory of the build with VK_ICD_FILENAMES pointing at lavapipe.
+#
+# Usage: vkreplay_memory_pool_test.sh -t <trace file> [-m <memoryPoolThreshold in KB>]
+
+TRACE=""
+THRESHOLD=1024
+
+while [[ $# -gt 0 ]]
+do
+   KEY="$1"
+   case $KEY in
+      -t|--trace)
+      TRACE="$2"
+      shift
+      shift
+      ;;
+      -m|--threshold)
+      THRESHOLD="$2"
+      shift
+      shift
+      ;;
+      *)
+      echo "ERROR: $0:$LINENO"
+      echo "Unrecognized command-line argument: $1"
+      exit 1
+      ;;
+   esac
+done
+
+if [ -z "$TRACE" ]; then
+   echo "ERROR: $0:$LINENO"
+   echo "The trace file is undefined, use the -t|--trace <file> command line option."
+   exit 1
+fi
+
+if [ -t 1 ] ; then
+    RED='\033[0;31m'
+    GREEN='\033[0;32m'
+    NC='\033[0m' # No Color
+else
+    RED=''
+    GREEN=''
+    NC=''
+fi
+
+printf "$GREEN[ RUN      ]$NC $0\n"
+
+VKTRACE_DIR=${PWD}/../vktrace
+export VK_LAYER_PATH=${PWD}/../layersvt
+
+fail() {
+    printf "$RED[  FAILED  ]$NC $1\n"
+    printf "TEST FAILED\n"
+    exit 1
+}
+
+"$VKTRACE_DIR/vktracedump" -o "$TRACE" -f memory_pool_test_dump.txt || fail "vktracedump of $TRACE failed."
+grep -q "VK_OBJECT_TYPE_DEVICE_MEMORY\|VK_DEBUG_REPORT_OBJECT_TYPE_DEVICE_MEMORY_EXT" memory_pool_test_dump.txt ||
+    fail "$TRACE doesn't name or tag device memory."
+
+rm -f vktrace_result.json
+OUT=$(MALLOC_CHECK_=3 MALLOC_PERTURB_=165 "$VKTRACE_DIR/vkreplay" -o "$TRACE" -mpt $THRESHOLD 2>&1)
+if [ $? -ne 0 ] || echo "$OUT" | grep -qi "error\|corrupt"; then
+    echo "$OUT" | grep -i "error\|corrupt" | head -10
+    fail "Replay of $TRACE with the memory pool failed."
+fi
+[ -f vktrace_result.json ] || fail "vktrace_result.json not written."
+
+python3 - <<'PYEOF' || fail "No allocation of $TRACE was pooled."
+import json, sys
+pool = json.load(open("vktrace_result.json"))["result"].get("memory_pool", {})
+if pool.get("pooled_allocations", 0) == 0:
+    sys.exit("memory_pool: %s" % pool)
+PYEOF
+
+printf "$GREEN[  PASSED  ]$NC $0\n"
+exit 0
@@ -0,0 +1,103 @@
+#!/bin/bash
+
+# vkreplay_parallel_record_test.sh
+# This script replays a trace with the command buffers recorded on the replay thread and
+# again with them recorded on parallel recording threads. Both replays must report the same
+# errors and warnings, and unless --no-screenshot is given, the screenshots of the frame must
+# match. Run it from the tests directory of the build with VK_ICD_FILENAMES pointing at
+# lavapipe, or at an emptydriver ICD together with --no-screenshot.
+#
+# Usage: vkreplay_parallel_record_test.sh -t <trace file> [-f <frame>] [-j <threads>] [--no-screenshot]
+
+TRACE=""
+FRAME=2
+THREADS=4
+SCREENSHOT=1
+
+while [[ $# -gt 0 ]]
+do
+   KEY="$1"
+   case $KEY in
+      -t|--trace)
+      TRACE="$2"
+      shift
+      shift
+      ;;
+      -f|--frame)
+      FRAME="$2"
+      shift
+      shift
+      ;;
+      -j|--threads)
+      THREADS="$2"
+      shift
+      shift
+      ;;
+      --no-screenshot)
+      SCREENSHOT=0
+      shift
+      ;;
+      *)
+      echo "ERROR: $0:$LINENO"
+      echo "Unrecognized command-line argument: $1"
+      exit 1
+      ;;
+   esac
+done
+
+if [ -z "$TRACE" ]; then
+   echo "ERROR: $0:$LINENO"
+   echo "The trace file is undefined, use the -t|--trace <file> command line option."
+   exit 1
+fi
+
+if [ -t 1 ] ; then
+    RED='\033[0;31m'
+    GREEN='\033[0;32m'
+    NC='\033[0m' # No Color
+else
+    RED=''
+    GREEN=''
+    NC=''
+fi
+
+printf "$GREEN[ RUN      ]$NC $0\n"
+
+VKTRACE_DIR=${PWD}/../vktrace
+export VK_LAYER_PATH=${PWD}/../layersvt
+
+fail() {
+    printf "$RED[  FAILED  ]$NC $1\n"
+    printf "TEST FAILED\n"
+    exit 1
+}
+
+# replay <threads> <name>: keeps the errors and warnings in <name>.log and the screenshot in <name>.ppm.
+# The messages are sorted, the recording threads log them out of order.
+replay() {
+    ARGS=(-o "$TRACE" -pltf true -prt $1)
+    if [ $SCREENSHOT -eq 1 ]; then
+        rm -f $FRAME.ppm
+        ARGS+=(-s $FRAME)
+    fi
+    "$VKTRACE_DIR/vkreplay" "${ARGS[@]}" 2>&1 | grep -i "error\|warning" | sort > $2.log
+    [ ${PIPESTATUS[0]} -eq 0 ] || return 1
+    if [ $SCREENSHOT -eq 1 ]; then
+        [ -f $FRAME.ppm ] || return 1
+        mv $FRAME.ppm $2.ppm
+    fi
+    return 0
+}
+
+replay 0 parallel_record_test.serial || fail "Serial replay of $TRACE failed."
+replay $THREADS parallel_record_test.parallel || fail "Parallel recording replay of $TRACE failed."
+
+if ! diff parallel_record_test.serial.log parallel_record_test.parallel.log; then
+    fail "The errors and warnings of the replays do not match."
+fi
+if [ $SCREENSHOT -eq 1 ]; then
+    cmp -s parallel_record_test.serial.ppm parallel_record_test.parallel.ppm || fail "Screenshots of frame $FRAME do not match."
+fi
+
+printf "$GREEN[  PASSED  ]$NC $0\n"
+exit 0
@@ -0,0 +1,100 @@
+#!/bin/bash
+
+# vktracedump_threads_test.sh
+# This script dumps a trace with vktracedump on one thread and on several threads, and checks
+# that the dumps are byte-identical. The brief dump and the full dump as text, HTML and JSON are
+# compared, each once into a single file and once split into one file per frame with -fn 1.
+# The full dumps are taken with -na, the addresses of the parameters differ from run to run.
+# The trace needs at least two frames. Run it from the tests directory of the build.
+#
+# Usage: vktracedump_threads_test.sh -t <trace file> [-j <threads, default 4>]
+
+TRACE=""
+THREADS=4
+
+while [[ $# -gt 0 ]]
+do
+   KEY="$1"
+   case $KEY in
+      -t|--trace)
+      TRACE="$2"
+      shift
+      shift
+      ;;
+      -j|--threads)
+      THREADS="$2"
+      shift
+      shift
+      ;;
+      *)
+      echo "ERROR: $0:$LINENO"
+      echo "Unrecognized command-line argument: $1"
+      exit 1
+      ;;
+   esac
+done
+
+if [ -z "$TRACE" ]; then
+   echo "ERROR: $0:$LINENO"
+   echo "The trace file is undefined, use the -t|--trace <file> command line option."
+   exit 1
+fi
+
+if [ -t 1 ] ; then
+    RED='\033[0;31m'
+    GREEN='\033[0;32m'
+    NC='\033[0m' # No Color
+else
+    RED=''
+    GREEN=''
+    NC=''
+fi
+
+printf "$GREEN[ RUN      ]$NC $0\n"
+
+VKTRACE_DIR=${PWD}/../vktrace
+TRACE=$(readlink -f "$TRACE")
+WORK_DIR=${PWD}/vktracedump_threads_test.tmp
+
+fail() {
+    printf "$RED[  FAILED  ]$NC $1\n"
+    printf "TEST FAILED\n"
+    exit 1
+}
+
+# dump_and_compare <dump file> <vktracedump options>
+# Dumps the trace with -t 1 and -t $THREADS into their own directories, vktracedump writes its
+# settings file into the working directory, and compares every file of the two dumps.
+dump_and_compare() {
+    FILE="$1"
+    shift
+    rm -rf "$WORK_DIR"
+    for T in 1 $THREADS; do
+        mkdir -p "$WORK_DIR/t$T"
+        (cd "$WORK_DIR/t$T" && "$VKTRACE_DIR/vktracedump" -o "$TRACE" "$@" "$FILE" -t $T > /dev/null) ||
+            fail "vktracedump $* $FILE -t $T failed."
+    done
+    COUNT=0
+    for DUMP in "$WORK_DIR/t1/"*; do
+        NAME=$(basename "$DUMP")
+        cmp "$DUMP" "$WORK_DIR/t$THREADS/$NAME" || fail "$NAME of vktracedump $* differs with -t 1 and -t $THREADS."
+        COUNT=$((COUNT + 1))
+    done
+    [ $COUNT -ne 0 ] || fail "vktracedump $* wrote no dump."
+    [ $(ls "$WORK_DIR/t$THREADS" | wc -l) -eq $COUNT ] ||
+        fail "vktracedump $* wrote $(ls "$WORK_DIR/t$THREADS" | wc -l) files with -t $THREADS and $COUNT with -t 1."
+    echo "vktracedump $* $FILE: $COUNT file(s) identical with -t 1 and -t $THREADS"
+}
+
+for SPLIT in "" "-fn 1"; do
+    dump_and_compare brief.txt $SPLIT -s
+    dump_and_compare full.txt $SPLIT -na -f
+    dump_and_compare full.html $SPLIT -na -dh -f
+    dump_and_compare full.json $SPLIT -na -dj -f
+done
+[ $COUNT -gt 1 ] || fail "$TRACE has less than two frames, the per frame dumps are not compared."
+
+rm -rf "$WORK_DIR"
+
+printf "$GREEN[  PASSED  ]$NC $0\n"
+exit 0
@@ -0,0 +1,96 @@
+#!/bin/bash
+
+# vktracerqpp_frames_test.sh
+# This script extracts a frame range of a trace with the vktracerqpp frames command and
+# replays the extracted trace. The replay must not report errors, and unless --no-screenshot
+# is given, the screenshot of the first extracted frame must match the screenshot of the same
+# frame in the replay of the whole trace. Run it from the tests directory of the build with
+# VK_ICD_FILENAMES pointing at lavapipe, or at an emptydriver ICD together with --no-screenshot.
+#
+# Usage: vktracerqpp_frames_test.sh -t <trace file> [-f <start frame>] [--no-screenshot]
+
+TRACE=""
+START=2
+SCREENSHOT=1
+
+while [[ $# -gt 0 ]]
+do
+   KEY="$1"
+   case $KEY in
+      -t|--trace)
+      TRACE="$2"
+      shift
+      shift
+      ;;
+      -f|--frame)
+      START="$2"
+      shift
+      shift
+      ;;
+      --no-screenshot)
+      SCREENSHOT=0
+      shift
+      ;;
+      *)
+      echo "ERROR: $0:$LINENO"
+      echo "Unrecognized command-line argument: $1"
+      exit 1
+      ;;
+   esac
+done
+
+if [ -z "$TRACE" ]; then
+   echo "ERROR: $0:$LINENO"
+   echo "The trace file is undefined, use the -t|--trace <file> command line option."
+   exit 1
+fi
+
+if [ -t 1 ] ; then
+    RED='\033[0;31m'
+    GREEN='\033[0;32m'
+    NC='\033[0m' # No Color
+else
+    RED=''
+    GREEN=''
+    NC=''
+fi
+
+printf "$GREEN[ RUN      ]$NC $0\n"
+
+VKTRACE_DIR=${PWD}/../vktrace
+export VK_LAYER_PATH=${PWD}/../layersvt
+EXTRACTED=frames_test.vktrace
+END=$((START + 1))
+
+fail() {
+    printf "$RED[  FAILED  ]$NC $1\n"
+    printf "TEST FAILED\n"
+    exit 1
+}
+
+replay() {
+    OUT=$("$VKTRACE_DIR/vkreplay" "$@" 2>&1)
+    if [ $? -ne 0 ] || echo "$OUT" | grep -qi "error"; then
+        echo "$OUT" | grep -i "error" | head -10
+        return 1
+    fi
+    return 0
+}
+
+"$VKTRACE_DIR/vktracerqpp" frames -in "$TRACE" -o $EXTRACTED -f $START-$END || fail "vktracerqpp frames failed."
+
+if [ $SCREENSHOT -eq 1 ]; then
+    rm -f $START.ppm 0.ppm
+    replay -o "$TRACE" -s $START || fail "Replay of $TRACE failed."
+    [ -f $START.ppm ] || fail "Screenshot not taken while replaying $TRACE."
+    mv $START.ppm frames_test.trace.ppm
+    replay -o $EXTRACTED -s 0 || fail "Replay of the extracted frames failed."
+    [ -f 0.ppm ] || fail "Screenshot not taken while replaying the extracted frames."
+    mv 0.ppm frames_test.extracted.ppm
+    cmp -s frames_test.trace.ppm frames_test.extracted.ppm || fail "Screenshots of frame $START do not match."
+else
+    replay -o $EXTRACTED || fail "Replay of the extracted frames failed."
+fi
+
+printf "$GREEN[  PASSED  ]$NC $0\n"
+exit 0
@@ -20,6 +20,9 @@
 #include <iostream>
 #include <sstream>
 #include <cstring>
+#include <algorithm>
+#include <chrono>
+#include <functional>
 #include <map>
 
 #include <time.h>
@@ -29,6 +32,7 @@
 
 ViaSystem::ViaSystem() {
     _generate_unique_file = false;
+    _run_benchmark = false;
     _html_file = "";
     _directory_symbol = '/';
     _home_path = "~/";
@@ -42,6 +46,8 @@ bool ViaSystem::Init(int argc, char** argv) {
         for (int iii = 1; iii < argc; iii++) {
             if (0 == strcmp("--unique_output", argv[iii])) {
                 _generate_unique_file = true;
+            } else if (0 == strcmp("--benchmark", argv[iii])) {
+                _run_benchmark = true;
             } else if (0 == strcmp("--output_path", argv[iii]) && argc > (iii + 1)) {
                 output_path = argv[iii + 1];
                 ++iii;
@@ -49,7 +55,7 @@ bool ViaSystem::Init(int argc, char** argv) {
                 std::cout << "Usage of " << argv[0] << ":" << std::endl
                           << "    " << argv[0]
                           << " [--unique_output] "
-                             "[--output_path <path>]"
+                             "[--output_path <path>] [--benchmark]"
                           << std::endl
                           << "          [--unique_output] Optional "
                              "parameter to generate a unique html"
@@ -63,6 +69,12 @@ bool ViaSystem::Init(int argc, char** argv) {
                           << std::endl
                           << "                               "
                              "  a given path"
+                          << std::endl
+                          << "          [--benchmark] Optional parameter to "
+                             "measure the latency and bandwidth"
+                          << std::endl
+                          << "                        "
+                             "of common Vulkan operations on every device"
                           << std::endl;
                 return false;
             }
@@ -150,6 +162,12 @@ bool ViaSystem::GenerateInfo() {
     if (results != VIA_SUCCESSFUL) {
         goto print_results;
     }
+    if (_run_benchmark) {
+        results = GenerateBenchmarkInfo();
+        if (results != VIA_SUCCESSFUL) {
+            goto print_results;
+        }
+    }
     results = GenerateTestInfo();
     if (results != VIA_SUCCESSFUL) {
         goto print_results;
@@ -1935,4 +1953,429 @@ ViaSystem::ViaResults ViaSystem::GenerateTestInfo(void) {
     EndSection();
 
     return res;
-}
\ No newline at end of file
+}
+
+// Number of times each benchmarked operation is repeated.
+static const uint32_t kBenchmarkInstanceIterations = 10;
+static const uint32_t kBenchmarkDeviceIterations = 5;
+static const uint32_t kBenchmarkMapIterations = 100;
+static const uint32_t kBenchmarkBandwidthIterations = 10;
+static const uint32_t kBenchmarkSubmitIterations = 1000;
+static const uint32_t kBenchmarkPipelineIterations = 20;
+
+// Largest allocation used to measure the bandwidth of a memory type.
+static const VkDeviceSize kBenchmarkMemorySize = 16 * 1024 * 1024;
+
+// SPIR-V of an empty compute shader:
+//     #version 450
+//     layout(local_size_x = 1) in;
+//     void main() {}
+static const uint32_t kBenchmarkComputeShader[] = {
+    0x07230203, 0x00010000, 0x00000000, 0x00000005, 0x00000000,              // header, bound = 5
+    0x00020011, 0x00000001,                                                  // OpCapability Shader
+    0x0003000e, 0x00000000, 0x00000001,                                      // OpMemoryModel Logical GLSL450
+    0x0005000f, 0x00000005, 0x00000001, 0x6e69616d, 0x00000000,              // OpEntryPoint GLCompute %1 "main"
+    0x00060010, 0x00000001, 0x00000011, 0x00000001, 0x00000001, 0x00000001,  // OpExecutionMode %1 LocalSize 1 1 1
+    0x00020013, 0x00000002,                                                  // %2 = OpTypeVoid
+    0x00030021, 0x00000003, 0x00000002,                                      // %3 = OpTypeFunction %2
+    0x00050036, 0x00000002, 0x00000001, 0x00000000, 0x00000003,              // %1 = OpFunction %2 None %3
+    0x000200f8, 0x00000004,                                                  // %4 = OpLabel
+    0x000100fd,                                                              // OpReturn
+    0x00010038,                                                              // OpFunctionEnd
+};
+
+static double ElapsedMicroseconds(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Repeat an operation which reports its own duration, so that any setup or
+// cleanup it needs isn't measured.  Stops at the first failure.
+static void MeasureRepeated(uint32_t iterations, const std::function<bool(double*)>& operation, double* mean_us, double* min_us,
+                            uint32_t* count) {
+    double total_us = 0;
+    *min_us = 0;
+    *count = 0;
+    for (uint32_t iter = 0; iter < iterations; ++iter) {
+        double elapsed_us = 0;
+        if (!operation(&elapsed_us)) {
+            break;
+        }
+        total_us += elapsed_us;
+        *min_us = (*count == 0) ? elapsed_us : std::min(*min_us, elapsed_us);
+        (*count)++;
+    }
+    *mean_us = (*count > 0) ? total_us / *count : 0;
+}
+
+static std::string FormatDuration(double us) {
+    char generic_string[64];
+    if (us >= 1000.0) {
+        snprintf(generic_string, 63, "%.3f ms", us / 1000.0);
+    } else {
+        snprintf(generic_string, 63, "%.3f us", us);
+    }
+    return generic_string;
+}
+
+static std::string FormatBandwidth(VkDeviceSize bytes, double us) {
+    char generic_string[64];
+    snprintf(generic_string, 63, "%.2f GB/s", (us > 0) ? bytes / (us * 1000.0) : 0.0);
+    return generic_string;
+}
+
+static std::string MemoryPropertyFlagsString(VkMemoryPropertyFlags flags) {
+    static const std::pair<VkMemoryPropertyFlagBits, const char*> flag_names[] = {
+        {VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, "DEVICE_LOCAL"},
+        {VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, "HOST_VISIBLE"},
+        {VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, "HOST_COHERENT"},
+        {VK_MEMORY_PROPERTY_HOST_CACHED_BIT, "HOST_CACHED"},
+    };
+    std::string flags_str = "";
+    for (const auto& flag_name : flag_names) {
+        if (flags & flag_name.first) {
+            if (!flags_str.empty()) {
+                flags_str += " | ";
+            }
+            flags_str += flag_name.second;
+        }
+    }
+    return flags_str;
+}
+
+void ViaSystem::PrintBenchmarkTimings(const std::string& operation, const BenchmarkTimings& timings, VkResult status,
+                                      VkDeviceSize bytes) {
+    char generic_string[1024];
+
+    PrintBeginTableRow();
+    PrintTableElement(operation);
+    if (timings.count == 0) {
+        snprintf(generic_string, 1023, "FAILED : VkResult code = 0x%x", status);
+        PrintTableElement(generic_string);
+        PrintTableElement("");
+    } else if (bytes > 0) {
+        // The fastest run gives the best bandwidth
+        PrintTableElement("mean " + FormatBandwidth(bytes, timings.mean_us), VIA_ALIGN_RIGHT);
+        snprintf(generic_string, 1023, "best %s over %d runs", FormatBandwidth(bytes, timings.min_us).c_str(), timings.count);
+        PrintTableElement(generic_string);
+    } else {
+        PrintTableElement("mean " + FormatDuration(timings.mean_us), VIA_ALIGN_RIGHT);
+        snprintf(generic_string, 1023, "min %s over %d runs", FormatDuration(timings.min_us).c_str(), timings.count);
+        PrintTableElement(generic_string);
+    }
+    PrintEndTableRow();
+}
+
+// Measure the latency and bandwidth of common Vulkan operations with a
+// Vulkan 1.0 instance of our own, and on every physical device it exposes.
+ViaSystem::ViaResults ViaSystem::GenerateBenchmarkInfo(void) {
+    ViaResults res = VIA_SUCCESSFUL;
+    VkInstance instance = VK_NULL_HANDLE;
+    VkResult status = VK_SUCCESS;
+    BenchmarkTimings timings;
+    uint32_t gpu_count = 0;
+    std::vector<VkPhysicalDevice> phys_devices;
+
+    BeginSection("Benchmark");
+    LogInfo("Running benchmark");
+
+    VkApplicationInfo app_info = {};
+    app_info.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
+    app_info.pApplicationName = "via";
+    app_info.applicationVersion = 1;
+    app_info.pEngineName = "via";
+    app_info.engineVersion = 1;
+    app_info.apiVersion = VK_API_VERSION_1_0;
+
+    VkInstanceCreateInfo inst_info = {};
+    inst_info.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
+    inst_info.pApplicationInfo = &app_info;
+
+    PrintBeginTable("Instance", 3);
+    MeasureRepeated(kBenchmarkInstanceIterations,
+                    [&](double* elapsed_us) {
+                        auto start = std::chrono::steady_clock::now();
+                        status = vkCreateInstance(&inst_info, NULL, &instance);
+                        *elapsed_us = ElapsedMicroseconds(start);
+                        if (VK_SUCCESS != status) {
+                            return false;
+                        }
+                        vkDestroyInstance(instance, NULL);
+                        return true;
+                    },
+                    &timings.mean_us, &timings.min_us, &timings.count);
+    PrintBenchmarkTimings("vkCreateInstance [1.0]", timings, status);
+    PrintEndTable();
+
+    // Keep an instance for the device benchmarks
+    if (VK_SUCCESS == status) {
+        status = vkCreateInstance(&inst_info, NULL, &instance);
+    }
+    if (VK_SUCCESS != status) {
+        res = (VK_ERROR_OUT_OF_HOST_MEMORY == status) ? VIA_VULKAN_FAILED_OUT_OF_MEM : VIA_VULKAN_FAILED_CREATE_INSTANCE;
+        goto out;
+    }
+
+    status = vkEnumeratePhysicalDevices(instance, &gpu_count, NULL);
+    if (VK_SUCCESS == status && gpu_count > 0) {
+        phys_devices.resize(gpu_count);
+        status = vkEnumeratePhysicalDevices(instance, &gpu_count, phys_devices.data());
+    }
+    if (VK_SUCCESS != status || gpu_count == 0) {
+        PrintStandardText("No physical devices to benchmark");
+    } else {
+        for (uint32_t dev = 0; dev < gpu_count; dev++) {
+            GenerateDeviceBenchmarkInfo(phys_devices[dev], dev);
+        }
+    }
+
+    vkDestroyInstance(instance, NULL);
+
+out:
+    EndSection();
+
+    return res;
+}
+
+// Benchmark one physical device.  Failures are reported in the table, but
+// don't fail the analysis.
+void ViaSystem::GenerateDeviceBenchmarkInfo(VkPhysicalDevice phys_dev, uint32_t dev_index) {
+    VkPhysicalDeviceProperties props;
+    VkPhysicalDeviceMemoryProperties mem_props;
+    std::vector<VkQueueFamilyProperties> queue_fam_props;
+    uint32_t queue_fam_count = 0;
+    uint32_t queue_fam_index = 0;
+    VkDevice device = VK_NULL_HANDLE;
+    VkQueue queue = VK_NULL_HANDLE;
+    VkFence fence = VK_NULL_HANDLE;
+    VkShaderModule shader_module = VK_NULL_HANDLE;
+    VkPipelineLayout pipeline_layout = VK_NULL_HANDLE;
+    VkPipeline pipeline = VK_NULL_HANDLE;
+    VkResult status = VK_SUCCESS;
+    BenchmarkTimings timings;
+    char generic_string[1024];
+
+    vkGetPhysicalDeviceProperties(phys_dev, &props);
+    vkGetPhysicalDeviceMemoryProperties(phys_dev, &mem_props);
+    vkGetPhysicalDeviceQueueFamilyProperties(phys_dev, &queue_fam_count, NULL);
+    queue_fam_props.resize(queue_fam_count);
+    vkGetPhysicalDeviceQueueFamilyProperties(phys_dev, &queue_fam_count, queue_fam_props.data());
+
+    // Any queue can take empty submits, but prefer one the compute pipeline could run on.
+    for (uint32_t fam = 0; fam < queue_fam_count; fam++) {
+        if (0 != (queue_fam_props[fam].queueFlags & VK_QUEUE_COMPUTE_BIT)) {
+            queue_fam_index = fam;
+            break;
+        }
+    }
+
+    snprintf(generic_string, 1023, "Device [%d] %s", dev_index, props.deviceName);
+    PrintBeginTable(generic_string, 3);
+
+    float queue_priority = 0;
+    VkDeviceQueueCreateInfo queue_create_info = {};
+    queue_create_info.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+    queue_create_info.queueFamilyIndex = queue_fam_index;
+    queue_create_info.queueCount = 1;
+    queue_create_info.pQueuePriorities = &queue_priority;
+
+    VkDeviceCreateInfo device_create_info = {};
+    device_create_info.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+    device_create_info.queueCreateInfoCount = 1;
+    device_create_info.pQueueCreateInfos = &queue_create_info;
+
+    MeasureRepeated(kBenchmarkDeviceIterations,
+                    [&](double* elapsed_us) {
+                        auto start = std::chrono::steady_clock::now();
+                        status = vkCreateDevice(phys_dev, &device_create_info, NULL, &device);
+                        *elapsed_us = ElapsedMicroseconds(start);
+                        if (VK_SUCCESS != status) {
+                            return false;
+                        }
+                        vkDestroyDevice(device, NULL);
+                        return true;
+                    },
+                    &timings.mean_us, &timings.min_us, &timings.count);
+    PrintBenchmarkTimings("vkCreateDevice", timings, status);
+    if (VK_SUCCESS == status) {
+        status = vkCreateDevice(phys_dev, &device_create_info, NULL, &device);
+    }
+    if (VK_SUCCESS != status) {
+        PrintEndTable();
+        return;
+    }
+    vkGetDeviceQueue(device, queue_fam_index, 0, &queue);
+
+    // Mapping and CPU access bandwidth of every memory type the host can see
+    for (uint32_t type = 0; type < mem_props.memoryTypeCount; type++) {
+        const VkMemoryType& mem_type = mem_props.memoryTypes[type];
+        if (0 == (mem_type.propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)) {
+            continue;
+        }
+        const bool coherent = 0 != (mem_type.propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+        VkDeviceSize size = std::min(kBenchmarkMemorySize, mem_props.memoryHeaps[mem_type.heapIndex].size / 4);
+        size -= size % sizeof(uint64_t);
+
+        snprintf(generic_string, 1023, "Memory type %d [%s]", type, MemoryPropertyFlagsString(mem_type.propertyFlags).c_str());
+        const std::string type_str = generic_string;
+
+        VkMemoryAllocateInfo alloc_info = {};
+        alloc_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        alloc_info.allocationSize = size;
+        alloc_info.memoryTypeIndex = type;
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        status = (size > 0) ? vkAllocateMemory(device, &alloc_info, NULL, &memory) : VK_ERROR_OUT_OF_DEVICE_MEMORY;
+        if (VK_SUCCESS != status) {
+            timings = {};
+            PrintBenchmarkTimings(type_str + " vkAllocateMemory", timings, status);
+            continue;
+        }
+
+        void* data = NULL;
+        MeasureRepeated(kBenchmarkMapIterations,
+                        [&](double* elapsed_us) {
+                            auto start = std::chrono::steady_clock::now();
+                            status = vkMapMemory(device, memory, 0, VK_WHOLE_SIZE, 0, &data);
+                            *elapsed_us = ElapsedMicroseconds(start);
+                            if (VK_SUCCESS != status) {
+                                return false;
+                            }
+                            vkUnmapMemory(device, memory);
+                            return true;
+                        },
+                        &timings.mean_us, &timings.min_us, &timings.count);
+        PrintBenchmarkTimings(type_str + " vkMapMemory", timings, status);
+        if (VK_SUCCESS == status) {
+            status = vkMapMemory(device, memory, 0, VK_WHOLE_SIZE, 0, &data);
+        }
+        if (VK_SUCCESS == status) {
+            VkMappedMemoryRange range = {};
+            range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+            range.memory = memory;
+            range.size = VK_WHOLE_SIZE;
+
+            // Writes include the flush, reads the invalidate, needed to make them visible.
+            uint32_t iteration = 0;
+            MeasureRepeated(kBenchmarkBandwidthIterations,
+                            [&](double* elapsed_us) {
+                                auto start = std::chrono::steady_clock::now();
+                                memset(data, static_cast<int>(++iteration), static_cast<size_t>(size));
+                                if (!coherent) {
+                                    status = vkFlushMappedMemoryRanges(device, 1, &range);
+                                }
+                                *elapsed_us = ElapsedMicroseconds(start);
+                                return VK_SUCCESS == status;
+                            },
+                            &timings.mean_us, &timings.min_us, &timings.count);
+            PrintBenchmarkTimings(type_str + " write", timings, status, size);
+
+            volatile uint64_t checksum = 0;
+            MeasureRepeated(kBenchmarkBandwidthIterations,
+                            [&](double* elapsed_us) {
+                                auto start = std::chrono::steady_clock::now();
+                                if (!coherent) {
+                                    status = vkInvalidateMappedMemoryRanges(device, 1, &range);
+                                }
+                                const uint64_t* words = static_cast<const uint64_t*>(data);
+                                uint64_t sum = 0;
+                                for (VkDeviceSize word = 0; word < size / sizeof(uint64_t); word++) {
+                                    sum += words[word];
+                                }
+                                checksum = sum;
+                                *elapsed_us = ElapsedMicroseconds(start);
+                                return VK_SUCCESS == status;
+                            },
+                            &timings.mean_us, &timings.min_us, &timings.count);
+            PrintBenchmarkTimings(type_str + " read", timings, status, size);
+
+            vkUnmapMemory(device, memory);
+        }
+        vkFreeMemory(device, memory, NULL);
+    }
+
+    // Submission overhead, and the time for the CPU to see the GPU signal a fence
+    VkFenceCreateInfo fence_create_info = {};
+    fence_create_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+    status = vkCreateFence(device, &fence_create_info, NULL, &fence);
+    if (VK_SUCCESS == status) {
+        VkSubmitInfo submit_info = {};
+        submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+
+        MeasureRepeated(kBenchmarkSubmitIterations,
+                        [&](double* elapsed_us) {
+                            auto start = std::chrono::steady_clock::now();
+                            status = vkQueueSubmit(queue, 1, &submit_info, VK_NULL_HANDLE);
+                            *elapsed_us = ElapsedMicroseconds(start);
+                            return VK_SUCCESS == status;
+                        },
+                        &timings.mean_us, &timings.min_us, &timings.count);
+        vkQueueWaitIdle(queue);
+        PrintBenchmarkTimings("vkQueueSubmit (empty)", timings, status);
+
+        MeasureRepeated(kBenchmarkSubmitIterations,
+                        [&](double* elapsed_us) {
+                            auto start = std::chrono::steady_clock::now();
+                            status = vkQueueSubmit(queue, 1, &submit_info, fence);
+                            if (VK_SUCCESS == status) {
+                                status = vkWaitForFences(device, 1, &fence, VK_TRUE, UINT64_MAX);
+                            }
+                            *elapsed_us = ElapsedMicroseconds(start);
+                            if (VK_SUCCESS != status) {
+                                return false;
+                            }
+                            status = vkResetFences(device, 1, &fence);
+                            return VK_SUCCESS == status;
+                        },
+                        &timings.mean_us, &timings.min_us, &timings.count);
+        vkQueueWaitIdle(queue);
+        vkDestroyFence(device, fence, NULL);
+    } else {
+        timings = {};
+        PrintBenchmarkTimings("vkQueueSubmit (empty)", timings, status);
+    }
+    PrintBenchmarkTimings("Fence round-trip", timings, status);
+
+    // Pipeline creation without a pipeline cache, so the compiler runs every time
+    VkShaderModuleCreateInfo shader_create_info = {};
+    shader_create_info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+    shader_create_info.codeSize = sizeof(kBenchmarkComputeShader);
+    shader_create_info.pCode = kBenchmarkComputeShader;
+    status = vkCreateShaderModule(device, &shader_create_info, NULL, &shader_module);
+    if (VK_SUCCESS == status) {
+        VkPipelineLayoutCreateInfo layout_create_info = {};
+        layout_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        status = vkCreatePipelineLayout(device, &layout_create_info, NULL, &pipeline_layout);
+    }
+    timings = {};
+    if (VK_SUCCESS == status) {
+        VkComputePipelineCreateInfo pipeline_create_info = {};
+        pipeline_create_info.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+        pipeline_create_info.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        pipeline_create_info.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+        pipeline_create_info.stage.module = shader_module;
+        pipeline_create_info.stage.pName = "main";
+        pipeline_create_info.layout = pipeline_layout;
+
+        MeasureRepeated(kBenchmarkPipelineIterations,
+                        [&](double* elapsed_us) {
+                            auto start = std::chrono::steady_clock::now();
+                            status = vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &pipeline_create_info, NULL, &pipeline);
+                            *elapsed_us = ElapsedMicroseconds(start);
+                            if (VK_SUCCESS != status) {
+                                return false;
+                            }
+                            vkDestroyPipeline(device, pipeline, NULL);
+                            return true;
+                        },
+                        &timings.mean_us, &timings.min_us, &timings.count);
+    }
+    PrintBenchmarkTimings("vkCreateComputePipelines", timings, status);
+    if (VK_NULL_HANDLE != pipeline_layout) {
+        vkDestroyPipelineLayout(device, pipeline_layout, NULL);
+    }
+    if (VK_NULL_HANDLE != shader_module) {
+        vkDestroyShaderModule(device, shader_module, NULL);
+    }
+
+    vkDestroyDevice(device, NULL);
+    PrintEndTable();
+}
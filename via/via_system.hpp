@@ -117,6 +117,8 @@ class ViaSystem {
     ViaResults GenerateSystemInfo();
     ViaResults GenerateVulkanInfo();
     ViaResults GenerateTestInfo();
+    ViaResults GenerateBenchmarkInfo();
+    void GenerateDeviceBenchmarkInfo(VkPhysicalDevice phys_dev, uint32_t dev_index);
     void GenerateSettingsFileJsonInfo(const std::string& settings_file);
     void GenerateExplicitLayerJsonInfo(const char* layer_json_filename, Json::Value root);
     void GenerateImplicitLayerJsonInfo(const char* layer_json_filename, Json::Value root, std::vector<std::string>& override_paths);
@@ -145,6 +147,16 @@ class ViaSystem {
         std::vector<VkDevice> vk_logical_devices;
     };
 
+    // Timings of a repeated operation, in microseconds.
+    struct BenchmarkTimings {
+        double mean_us;
+        double min_us;
+        uint32_t count;
+    };
+
+    void PrintBenchmarkTimings(const std::string& operation, const BenchmarkTimings& timings, VkResult status,
+                               VkDeviceSize bytes = 0);
+
     struct VulkanSettingPair {
         std::string name;
         std::string value;
@@ -167,6 +179,9 @@ class ViaSystem {
     bool _is_system_installed_sdk;
     bool _ran_tests;
 
+    // Benchmark items
+    bool _run_benchmark;
+
     // Table-specific items
     bool _outputting_to_odd_row;
 
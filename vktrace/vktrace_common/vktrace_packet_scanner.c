@@ -0,0 +1,137 @@
+/**************************************************************************
+ *
+ * Copyright (C) 2016-2024 ARM Limited
+ * All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ **************************************************************************/
+#include "vktrace_packet_scanner.h"
+#include "vktrace_tracelog.h"
+#include <assert.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+#if !defined(WIN32)
+#include <unistd.h>
+#endif
+
+// Size of the read which follows a packet that was larger than the buffer.
+#define VKTRACE_PACKET_SCANNER_SKIP_READ_SIZE (64 * 1024)
+
+// ------------------------------------------------------------------------------------------------
+static uint64_t vktrace_PacketScanner_read_at(FileLike* pFile, uint64_t offset, uint8_t* pBytes, uint64_t length) {
+    uint64_t bytesRead = 0;
+#if defined(WIN32)
+    uint64_t originalPosition = Ftell(pFile->mFile);
+    if (Fseek(pFile->mFile, offset, SEEK_SET) == 0) {
+        bytesRead = fread(pBytes, 1, (size_t)length, pFile->mFile);
+    }
+    Fseek(pFile->mFile, originalPosition, SEEK_SET);
+#else
+    int fd = fileno(pFile->mFile);
+    while (bytesRead < length) {
+        ssize_t result = pread(fd, pBytes + bytesRead, (size_t)(length - bytesRead), (off_t)(offset + bytesRead));
+        if (result <= 0) {
+            break;
+        }
+        bytesRead += (uint64_t)result;
+    }
+#endif
+    return bytesRead;
+}
+
+// ------------------------------------------------------------------------------------------------
+vktrace_PacketScanner* vktrace_PacketScanner_create(FileLike* pFile, uint64_t firstPacketOffset, uint64_t bufferSize) {
+    vktrace_PacketScanner* pScanner = NULL;
+    assert(pFile != NULL && pFile->mMode == File);
+    if (bufferSize < VKTRACE_PACKET_SCANNER_SKIP_READ_SIZE) {
+        bufferSize = (bufferSize == 0) ? VKTRACE_PACKET_SCANNER_DEFAULT_BUFFER_SIZE : VKTRACE_PACKET_SCANNER_SKIP_READ_SIZE;
+    }
+    pScanner = VKTRACE_NEW(vktrace_PacketScanner);
+    if (pScanner == NULL) {
+        return NULL;
+    }
+    memset(pScanner, 0, sizeof(vktrace_PacketScanner));
+    pScanner->pBuffer = (uint8_t*)vktrace_malloc((size_t)bufferSize);
+    if (pScanner->pBuffer == NULL) {
+        vktrace_LogError("Cannot allocate %" PRIu64 " bytes for the packet scanner.", bufferSize);
+        VKTRACE_DELETE(pScanner);
+        return NULL;
+    }
+    pScanner->pFile = pFile;
+    pScanner->position = firstPacketOffset;
+    pScanner->bufferSize = bufferSize;
+    return pScanner;
+}
+
+// ------------------------------------------------------------------------------------------------
+BOOL vktrace_PacketScanner_next(vktrace_PacketScanner* pScanner, vktrace_trace_packet_header* pHeader, uint64_t* pPosition) {
+    const uint64_t headerSize = sizeof(vktrace_trace_packet_header);
+    uint64_t fileLength = pScanner->pFile->mFileLen;
+    if (pScanner->position + headerSize > fileLength) {
+        return FALSE;
+    }
+
+    if (pScanner->position < pScanner->bufferStart ||
+        pScanner->position + headerSize > pScanner->bufferStart + pScanner->bufferLength) {
+        // Packets larger than the buffer are skipped with a small read, so large
+        // uploads are not read from the disk.
+        uint64_t readSize = (pScanner->headersInBuffer <= 1) ? VKTRACE_PACKET_SCANNER_SKIP_READ_SIZE : pScanner->bufferSize;
+        if (readSize > fileLength - pScanner->position) {
+            readSize = fileLength - pScanner->position;
+        }
+        pScanner->bufferStart = pScanner->position;
+        pScanner->bufferLength = vktrace_PacketScanner_read_at(pScanner->pFile, pScanner->position, pScanner->pBuffer, readSize);
+        pScanner->headersInBuffer = 0;
+        if (pScanner->bufferLength < headerSize) {
+            vktrace_LogError("Cannot read the packet header at offset %" PRIu64 ".", pScanner->position);
+            return FALSE;
+        }
+    }
+
+    memcpy(pHeader, pScanner->pBuffer + (pScanner->position - pScanner->bufferStart), (size_t)headerSize);
+    if (pHeader->size < headerSize || pHeader->size > fileLength - pScanner->position) {
+        vktrace_LogWarning("Packet at offset %" PRIu64 " is truncated, stop scanning.", pScanner->position);
+        return FALSE;
+    }
+    pScanner->headersInBuffer++;
+    pScanner->packetPosition = pScanner->position;
+    pScanner->packetSize = pHeader->size;
+    *pPosition = pScanner->position;
+    pScanner->position += pHeader->size;
+    return TRUE;
+}
+
+// ------------------------------------------------------------------------------------------------
+BOOL vktrace_PacketScanner_read_body(vktrace_PacketScanner* pScanner, uint64_t offset, void* pBytes, uint64_t length) {
+    const uint64_t headerSize = sizeof(vktrace_trace_packet_header);
+    uint64_t position = pScanner->packetPosition + headerSize + offset;
+    if (pScanner->packetSize < headerSize || offset + length > pScanner->packetSize - headerSize) {
+        return FALSE;
+    }
+    if (position >= pScanner->bufferStart && position + length <= pScanner->bufferStart + pScanner->bufferLength) {
+        memcpy(pBytes, pScanner->pBuffer + (position - pScanner->bufferStart), (size_t)length);
+        return TRUE;
+    }
+    return vktrace_PacketScanner_read_at(pScanner->pFile, position, (uint8_t*)pBytes, length) == length;
+}
+
+// ------------------------------------------------------------------------------------------------
+void vktrace_PacketScanner_delete(vktrace_PacketScanner** ppScanner) {
+    if (ppScanner == NULL || *ppScanner == NULL) {
+        return;
+    }
+    vktrace_free((*ppScanner)->pBuffer);
+    VKTRACE_DELETE(*ppScanner);
+    *ppScanner = NULL;
+}
@@ -0,0 +1,65 @@
+/**************************************************************************
+ *
+ * Copyright (C) 2016-2024 ARM Limited
+ * All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ **************************************************************************/
+#pragma once
+
+#include "vktrace_common.h"
+#include "vktrace_filelike.h"
+#include "vktrace_trace_packet_identifiers.h"
+
+// Walks the packets of a trace file and only reads their headers. The bodies
+// are skipped, so nothing is decompressed or allocated per packet. Headers are
+// read from a large read-ahead buffer, and packets larger than the buffer are
+// skipped with a small read. The scanner reads with its own file offset and
+// does not move the position of the FileLike.
+typedef struct vktrace_PacketScanner {
+    FileLike* pFile;
+    uint64_t position;      // file offset of the next packet
+    uint64_t bufferStart;   // file offset of pBuffer[0]
+    uint64_t bufferLength;  // number of valid bytes in pBuffer
+    uint64_t bufferSize;
+    uint64_t headersInBuffer;
+    uint64_t packetPosition;  // file offset of the packet last returned by vktrace_PacketScanner_next
+    uint64_t packetSize;
+    uint8_t* pBuffer;
+} vktrace_PacketScanner;
+
+#define VKTRACE_PACKET_SCANNER_DEFAULT_BUFFER_SIZE (4 * 1024 * 1024)
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+// Start scanning at firstPacketOffset, which is usually vktrace_trace_file_header::first_packet_offset.
+// A bufferSize of 0 selects VKTRACE_PACKET_SCANNER_DEFAULT_BUFFER_SIZE.
+vktrace_PacketScanner* vktrace_PacketScanner_create(FileLike* pFile, uint64_t firstPacketOffset, uint64_t bufferSize);
+
+// Copy the header of the next packet to pHeader and its file offset to pPosition.
+// Returns FALSE at the end of the file or when the packet is truncated. pHeader->pBody
+// is not valid.
+BOOL vktrace_PacketScanner_next(vktrace_PacketScanner* pScanner, vktrace_trace_packet_header* pHeader, uint64_t* pPosition);
+
+// Copy length bytes at offset in the body of the packet last returned by vktrace_PacketScanner_next,
+// e.g. the vktrace_trace_packet_header_compression_ext of a compressed packet. Returns FALSE if the
+// bytes are not inside the packet.
+BOOL vktrace_PacketScanner_read_body(vktrace_PacketScanner* pScanner, uint64_t offset, void* pBytes, uint64_t length);
+
+void vktrace_PacketScanner_delete(vktrace_PacketScanner** ppScanner);
+
+#if defined(__cplusplus)
+}
+#endif
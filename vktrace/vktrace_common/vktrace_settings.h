@@ -114,6 +114,17 @@ typedef struct vkreplayer_settings {
     BOOL fDevBuild2HostBuild;
     BOOL useTraceSurfaceTransformFlagBit;
     char* insertDeviceExtension;
+    unsigned int asyncPipelineThreads;
+    unsigned int memoryPoolThreshold;
+    char* checkpointFrames;
+    char* checkpointFile;
+    unsigned int prewarmPipelineThreads;
+    unsigned int preloadMemoryBudget;
+    unsigned int parallelRecordingThreads;
+    BOOL gpuTimestamps;
+    unsigned int memoryStatsInterval;
+    BOOL noPresent;
+    BOOL enableVscAlias;
 } vkreplayer_settings;
 
 int vktrace_SettingGroup_init(vktrace_SettingGroup* pSettingGroup, FILE* pSettingsFile, int argc, char* argv[],
@@ -33,7 +33,8 @@
 #define VKTRACE_TRACE_FILE_VERSION_9  0x0009  // Add tracer version in the file header
 #define VKTRACE_TRACE_FILE_VERSION_10 0x000A  // Add tracer enabled features and meta data for injected calls in the file header
 #define VKTRACE_TRACE_FILE_VERSION_11 0x000B  // Add ray query support
-#define VKTRACE_TRACE_FILE_VERSION VKTRACE_TRACE_FILE_VERSION_11
+#define VKTRACE_TRACE_FILE_VERSION_12 0x000C  // Add VKTRACE_TPI_BLOB packets of deduplicated payloads
+#define VKTRACE_TRACE_FILE_VERSION VKTRACE_TRACE_FILE_VERSION_12
 
 // vkreplay can replay version 6 (the last Vulkan 1.0 format)
 #define VKTRACE_TRACE_FILE_VERSION_MINIMUM_COMPATIBLE VKTRACE_TRACE_FILE_VERSION_6
@@ -570,7 +571,7 @@ typedef enum _VKTRACE_TRACE_PACKET_ID_VK {
     VKTRACE_TPI_VK_vkCmdCopyBufferRemapAS = 0xFFEF,             // non-standard API derived from vkCmdCopyBuffer
     VKTRACE_TPI_VK_vkCmdCopyBufferRemapASandBuffer = 0xFFF0,    // non-standard API derived from vkCmdCopyBuffer
     VKTRACE_TPI_META_DATA = 0xFFF1,
-    VKTRACE_TPI_RESERVED_ID_1 = 0xFFF2,
+    VKTRACE_TPI_BLOB = 0xFFF2,                                  // A payload which is shared by the packets referencing it
     VKTRACE_TPI_RESERVED_ID_2 = 0xFFF3,
     VKTRACE_TPI_RESERVED_ID_3 = 0xFFF4,
     // Reserved ID for the special packets
@@ -614,9 +615,14 @@ typedef enum VKTRACE_TRACER_FEATURE {
 
 typedef enum VKTRACE_FILE_HEADER_FLAG {
     VKTRACE_USE_ACCELERATION_STRUCTURE_API_BIT        = 0x1,
-    VKTRACE_RQ_POSTPROCESSED_BIT                      = 0x2             // This trace file is post-processed by vktrace_rq_pp
+    VKTRACE_RQ_POSTPROCESSED_BIT                      = 0x2,            // This trace file is post-processed by vktrace_rq_pp
+    VKTRACE_BLOBS_DEDUPLICATED_BIT                    = 0x4             // Repeated payloads are stored once in VKTRACE_TPI_BLOB packets
 } VKTRACE_FILE_HEADER_FLAG;
 
+// The readers reject trace files with flags they don't know, so add new flags here.
+#define VKTRACE_KNOWN_FILE_HEADER_FLAGS \
+    (VKTRACE_USE_ACCELERATION_STRUCTURE_API_BIT | VKTRACE_RQ_POSTPROCESSED_BIT | VKTRACE_BLOBS_DEDUPLICATED_BIT)
+
 typedef enum VKTRACE_VKBUFFER_USAGE_FLAG {
     VK_BUFFER_USAGE_EXTRA_MARK_ASBUFFER = 0x1,
     VK_BUFFER_USAGE_EXTRA_MARK_SCRATCH  = 0x2,
@@ -682,6 +688,16 @@ typedef struct {
     ALIGN8 uintptr_t pBody;             // points to the compressed packet data
 } vktrace_trace_packet_header_compression_ext;
 
+// The body of a VKTRACE_TPI_BLOB packet, the payload follows it. A packet which
+// references the blob stores VKTRACE_BLOB_REFERENCE_BIT | blob_id in place of the
+// offset of its own copy of the payload.
+typedef struct {
+    ALIGN8 uint64_t blob_id;
+    ALIGN8 uint64_t size;
+} vktrace_trace_packet_blob;
+
+#define VKTRACE_BLOB_REFERENCE_BIT ((uintptr_t)1 << (sizeof(uintptr_t) * 8 - 1))
+
 typedef struct {
     vktrace_trace_packet_header* pHeader;
     VktraceLogLevel type;
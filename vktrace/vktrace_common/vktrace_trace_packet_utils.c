@@ -719,10 +719,75 @@ void* vktrace_trace_packet_interpret_buffer_pointer(vktrace_trace_packet_header*
     // if the offset is 0, then we know the pointer to the buffer was NULL, so no buffer exists and we return NULL.
     if (offset == 0) return NULL;
 
+    if (offset & VKTRACE_BLOB_REFERENCE_BIT) return (void*)vktrace_get_blob(offset & ~(uint64_t)VKTRACE_BLOB_REFERENCE_BIT);
+
     buffer_location = (char*)(pHeader->pBody) + offset;
     return buffer_location;
 }
 
+// The blobs are kept in pages which are never moved, so a blob can be looked up
+// while another one is registered.
+#define VKTRACE_BLOB_PAGE_SIZE 4096
+#define VKTRACE_BLOB_PAGE_COUNT 16384
+static void** s_blobPages[VKTRACE_BLOB_PAGE_COUNT];
+
+BOOL vktrace_register_blob(const vktrace_trace_packet_header* pHeader) {
+    const vktrace_trace_packet_blob* pBlob = (const vktrace_trace_packet_blob*)pHeader->pBody;
+    if (pHeader->packet_id != VKTRACE_TPI_BLOB || pHeader->tracer_id == VKTRACE_TID_VULKAN_COMPRESSED ||
+        pHeader->size < sizeof(vktrace_trace_packet_header) + sizeof(vktrace_trace_packet_blob) ||
+        pBlob->size > pHeader->size - sizeof(vktrace_trace_packet_header) - sizeof(vktrace_trace_packet_blob) ||
+        pBlob->blob_id >= (uint64_t)VKTRACE_BLOB_PAGE_SIZE * VKTRACE_BLOB_PAGE_COUNT) {
+        vktrace_LogError("Invalid blob packet %llu.", pHeader->global_packet_index);
+        return FALSE;
+    }
+
+    void*** ppPage = &s_blobPages[pBlob->blob_id / VKTRACE_BLOB_PAGE_SIZE];
+    if (*ppPage == NULL) {
+        *ppPage = (void**)vktrace_malloc(VKTRACE_BLOB_PAGE_SIZE * sizeof(void*));
+        if (*ppPage == NULL) {
+            vktrace_LogError("Failed to allocate the blob table.");
+            return FALSE;
+        }
+        memset(*ppPage, 0, VKTRACE_BLOB_PAGE_SIZE * sizeof(void*));
+    }
+    void** ppData = &(*ppPage)[pBlob->blob_id % VKTRACE_BLOB_PAGE_SIZE];
+    if (*ppData != NULL) {
+        // Registered in a previous loop of the replay.
+        return TRUE;
+    }
+    void* pData = vktrace_malloc(pBlob->size ? (size_t)pBlob->size : 1);
+    if (pData == NULL) {
+        vktrace_LogError("Failed to allocate blob %llu of %llu bytes.", pBlob->blob_id, pBlob->size);
+        return FALSE;
+    }
+    memcpy(pData, pBlob + 1, (size_t)pBlob->size);
+    *ppData = pData;
+    return TRUE;
+}
+
+const void* vktrace_get_blob(uint64_t blobId) {
+    void** pPage = (blobId < (uint64_t)VKTRACE_BLOB_PAGE_SIZE * VKTRACE_BLOB_PAGE_COUNT)
+                       ? s_blobPages[blobId / VKTRACE_BLOB_PAGE_SIZE]
+                       : NULL;
+    if (pPage == NULL || pPage[blobId % VKTRACE_BLOB_PAGE_SIZE] == NULL) {
+        vktrace_LogError("Blob %llu is referenced before it is registered.", blobId);
+        return NULL;
+    }
+    return pPage[blobId % VKTRACE_BLOB_PAGE_SIZE];
+}
+
+void vktrace_free_blobs() {
+    for (uint32_t i = 0; i < VKTRACE_BLOB_PAGE_COUNT; i++) {
+        if (s_blobPages[i] != NULL) {
+            for (uint32_t j = 0; j < VKTRACE_BLOB_PAGE_SIZE; j++) {
+                vktrace_free(s_blobPages[i][j]);
+            }
+            vktrace_free(s_blobPages[i]);
+            s_blobPages[i] = NULL;
+        }
+    }
+}
+
 int getVertexIndexStride(VkIndexType type) {
     int stride = 0;
     switch(type) {
@@ -164,6 +164,14 @@ void vktrace_delete_trace_packet_no_lock(vktrace_trace_packet_header** ppHeader)
 // converts a pointer variable that is currently byte offset into a pointer to the actual offset location
 void* vktrace_trace_packet_interpret_buffer_pointer(vktrace_trace_packet_header* pHeader, intptr_t ptr_variable);
 
+// Blobs are the payloads which a deduplicated trace stores once in VKTRACE_TPI_BLOB packets.
+// A blob packet must be registered before the packets referencing it are interpreted, the
+// payload is copied and kept until vktrace_free_blobs. Registering is not thread safe, but
+// looking up the registered blobs is.
+BOOL vktrace_register_blob(const vktrace_trace_packet_header* pHeader);
+const void* vktrace_get_blob(uint64_t blobId);
+void vktrace_free_blobs();
+
 // Adding to packets TODO: Move to codegen
 void add_VkApplicationInfo_to_packet(vktrace_trace_packet_header* pHeader, VkApplicationInfo** ppStruct, const VkApplicationInfo* pInStruct);
 void add_VkDebugUtilsLabelEXT_to_packet(vktrace_trace_packet_header* pHeader, VkDebugUtilsLabelEXT** ppStruct, const VkDebugUtilsLabelEXT* pInStruct);
@@ -20,11 +20,19 @@
 #include <cstdio>
 #include <cstring>
 
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
 #include <unordered_map>
+#include <vector>
 
 #include "vktrace_common.h"
 #include "vktrace_tracelog.h"
 #include "vktrace_filelike.h"
+#include "vktrace_packet_scanner.h"
 #include "vktrace_trace_packet_utils.h"
 #include "vktrace_vk_packet_id.h"
 #include "decompressor.h"
@@ -37,12 +45,14 @@ struct vktracedump_params {
     const char* traceFile = NULL;
     const char* simpleDumpFile = NULL;
     const char* fullDumpFile = NULL;
+    const char* packetListFile = NULL;
     const char* dumpFileFrameNum = nullptr;
     bool onlyHeaderInfo = false;
     bool noAddr = false;
     bool dumpShader = false;
     bool saveAsHtml = false;
     bool saveAsJson = false;
+    uint32_t threadCount = 1;
 } g_params;
 
 char g_dump_file_name[1024] = {0};
@@ -51,6 +61,9 @@ const char* FULL_DUMP_FILE_UNSET = "full_dump_file_unset";
 const char* SEPARATOR = " : ";
 const char* SPACES = "               ";
 const uint32_t COLUMN_WIDTH = 26;
+// A batch ends after this many packets or bytes, whichever comes first.
+const size_t PACKETS_PER_BATCH = 256;
+const uint64_t BYTES_PER_BATCH = 8 * 1024 * 1024;
 
 static void print_usage() {
     cout << "vktracedump available options:" << endl;
@@ -62,6 +75,10 @@ static void print_usage() {
     cout << "    -f <fullDumpFile>     (Optional) The file to save the outputs of full/detailed API dump. Use 'stdout' to send "
             "outputs to stdout."
          << endl;
+    cout << "    -l <packetListFile>   (Optional) The file to save a list of the packets which is read from the packet headers "
+            "only. It is much faster than the simple dump, but does not show the parameters. Use 'stdout' to send outputs to "
+            "stdout."
+         << endl;
     cout << "    -fn <dumpFileFrameNum>   (Optional) Set dump file frame number, The default is 0."
          << endl;
     cout << "    -ds                   Dump the shader binary code in pCode to shader dump files shader_<index>.hex (when "
@@ -79,6 +96,9 @@ static void print_usage() {
     cout << "    -na                   Dump string \"address\" in place of hex addresses. (Default is false)  Only works with \"-f "
             "<fullDumpFile>\" option."
          << endl;
+    cout << "    -t <threads>          Number of threads which decompress, decode and format the packets. The packets are still dumped in "
+            "order and the output is the same as with one thread. (Default is 1)"
+         << endl;
 }
 
 static int parse_args(int argc, char** argv) {
@@ -94,6 +114,9 @@ static int parse_args(int argc, char** argv) {
         } else if (arg.compare("-f") == 0) {
             g_params.fullDumpFile = argv[i + 1];
             i = i + 2;
+        } else if (arg.compare("-l") == 0) {
+            g_params.packetListFile = argv[i + 1];
+            i = i + 2;
         } else if (arg.compare("-fn") == 0) {
             g_params.dumpFileFrameNum = argv[i + 1];
             i = i + 2;
@@ -109,6 +132,13 @@ static int parse_args(int argc, char** argv) {
         } else if (arg.compare("-na") == 0) {
             g_params.noAddr = true;
             i++;
+        } else if (arg.compare("-t") == 0 && i + 1 < argc) {
+            int threadCount = atoi(argv[i + 1]);
+            if (threadCount < 1) {
+                return -1;
+            }
+            g_params.threadCount = threadCount;
+            i = i + 2;
         } else if (arg.compare("-hd") == 0) {
             g_params.onlyHeaderInfo = true;
             i++;
@@ -131,8 +161,218 @@ static int parse_args(int argc, char** argv) {
     return 0;
 }
 
+// A packet read from the trace file, decompressed and interpreted.
+struct decoded_packet {
+    vktrace_trace_packet_header* packet = nullptr;
+    vktrace_trace_packet_header* pInterpretedHeader = nullptr;
+    uint64_t position = 0;
+    int decompressResult = 0;
+    // The API call of the brief dump, only set when the packet is decoded by a worker thread.
+    string apiCall;
+    // The body of the full dump, only set when the packet is decoded by a worker thread and
+    // dump_packet_body() could format it.
+    string fullDumpBody;
+    bool fullDumpBodyFormatted = false;
+};
+
+// Reads the packets of the trace file in order. With more than one thread the
+// packets are read in batches, and the worker threads decompress, interpret and
+// stringify whole batches while the main thread dumps the previous ones. For the
+// full dump the workers format the parameters of the packets into per-packet
+// buffers, the main thread writes the parts which depend on the packets before,
+// like the frame and the separators, and the buffers. The batches are handed
+// out in file order, so the dump does not change.
+class packet_decoder {
+   public:
+    packet_decoder(FileLike* traceFile, VKTRACE_COMPRESS_TYPE compressType, uint32_t threadCount, bool stringify,
+                   bool fullDump)
+        : m_traceFile(traceFile),
+          m_compressType(compressType),
+          m_threadCount(threadCount),
+          m_stringify(stringify),
+          m_fullDump(fullDump) {}
+
+    ~packet_decoder() {
+        {
+            lock_guard<mutex> lock(m_mutex);
+            m_stop = true;
+        }
+        m_condition.notify_all();
+        for (auto& worker : m_workers) {
+            worker.join();
+        }
+        for (auto& batch : m_batches) {
+            for (auto& decoded : batch->packets) {
+                vktrace_delete_trace_packet_no_lock(&decoded.packet);
+            }
+        }
+        for (auto decomp : m_decompressors) {
+            delete decomp;
+        }
+        for (auto formatter : m_formatters) {
+            destroy_packet_body_formatter(formatter);
+        }
+        vktrace_free_blobs();
+    }
+
+    bool init() {
+        uint32_t decompressorCount = (m_threadCount > 1) ? m_threadCount : 1;
+        if (m_compressType != VKTRACE_COMPRESS_TYPE_NONE) {
+            for (uint32_t i = 0; i < decompressorCount; i++) {
+                decompressor* decomp = create_decompressor(m_compressType);
+                if (decomp == nullptr) {
+                    vktrace_LogError("Create decompressor error.");
+                    return false;
+                }
+                m_decompressors.push_back(decomp);
+            }
+        }
+        if (m_threadCount > 1) {
+            if (m_fullDump) {
+                for (uint32_t i = 0; i < m_threadCount; i++) {
+                    m_formatters.push_back(create_packet_body_formatter());
+                }
+            }
+            for (uint32_t i = 0; i < m_threadCount; i++) {
+                m_workers.emplace_back(&packet_decoder::worker, this, i);
+            }
+        }
+        return true;
+    }
+
+    // Returns false at the end of the file. The caller owns decoded.packet.
+    bool next(decoded_packet& decoded) {
+        if (m_threadCount <= 1) {
+            decoded.position = vktrace_FileLike_GetCurrentPosition(m_traceFile);
+            decoded.packet = vktrace_read_trace_packet(m_traceFile);
+            if (decoded.packet == nullptr) {
+                return false;
+            }
+            decode(decoded, m_decompressors.empty() ? nullptr : m_decompressors[0], false, nullptr);
+            register_blob(decoded);
+            return true;
+        }
+
+        unique_lock<mutex> lock(m_mutex);
+        while (!m_batches.empty() && m_batches.front()->next == m_batches.front()->packets.size()) {
+            m_batches.pop_front();
+            m_condition.notify_all();
+        }
+        m_condition.wait(lock, [this] { return (!m_batches.empty() && m_batches.front()->decoded) || (m_batches.empty() && m_endOfFile); });
+        if (m_batches.empty()) {
+            return false;
+        }
+        packet_batch& batch = *m_batches.front();
+        decoded = move(batch.packets[batch.next]);
+        batch.packets[batch.next].packet = nullptr;
+        batch.next++;
+        return true;
+    }
+
+   private:
+    struct packet_batch {
+        vector<decoded_packet> packets;
+        size_t next = 0;
+        bool decoded = false;
+    };
+
+    void decode(decoded_packet& decoded, decompressor* decomp, bool stringify, packet_body_formatter* formatter) {
+        if (decoded.packet->tracer_id == VKTRACE_TID_VULKAN_COMPRESSED) {
+            decoded.decompressResult = decompress_packet(decomp, decoded.packet);
+            if (decoded.decompressResult != 0) {
+                return;
+            }
+        }
+        if (decoded.packet->packet_id >= VKTRACE_TPI_VK_vkApiVersion && decoded.packet->packet_id < VKTRACE_TPI_META_DATA) {
+            decoded.pInterpretedHeader = interpret_trace_packet_vk(decoded.packet);
+            if (stringify && decoded.pInterpretedHeader != nullptr &&
+                decoded.pInterpretedHeader->packet_id != VKTRACE_TPI_VK_vkGetInstanceProcAddr &&
+                decoded.pInterpretedHeader->packet_id != VKTRACE_TPI_VK_vkGetDeviceProcAddr) {
+                const char* apiCall = vktrace_stringify_vk_packet_id(
+                    (VKTRACE_TRACE_PACKET_ID_VK)decoded.pInterpretedHeader->packet_id, decoded.pInterpretedHeader);
+                if (apiCall != nullptr) {
+                    decoded.apiCall = apiCall;
+                }
+            }
+            if (formatter != nullptr && decoded.pInterpretedHeader != nullptr) {
+                decoded.fullDumpBodyFormatted = dump_packet_body(formatter, decoded.pInterpretedHeader, decoded.fullDumpBody);
+            }
+        }
+    }
+
+    void register_blob(const decoded_packet& decoded) {
+        if (decoded.decompressResult == 0 && decoded.packet->packet_id == VKTRACE_TPI_BLOB) {
+            vktrace_register_blob(decoded.packet);
+        }
+    }
+
+    void worker(uint32_t index) {
+        decompressor* decomp = m_decompressors.empty() ? nullptr : m_decompressors[index];
+        packet_body_formatter* formatter = m_formatters.empty() ? nullptr : m_formatters[index];
+        unique_lock<mutex> lock(m_mutex);
+        while (true) {
+            // The file is read under the lock, so the batches are queued in file order.
+            m_condition.wait(lock, [this] { return m_stop || m_endOfFile || m_batches.size() < 2 * m_threadCount; });
+            if (m_stop || m_endOfFile) {
+                break;
+            }
+            shared_ptr<packet_batch> batch = make_shared<packet_batch>();
+            uint64_t batchBytes = 0;
+            while (batch->packets.size() < PACKETS_PER_BATCH && batchBytes < BYTES_PER_BATCH) {
+                decoded_packet decoded;
+                decoded.position = vktrace_FileLike_GetCurrentPosition(m_traceFile);
+                decoded.packet = vktrace_read_trace_packet(m_traceFile);
+                if (decoded.packet == nullptr) {
+                    m_endOfFile = true;
+                    break;
+                }
+                if (decoded.packet->packet_id == VKTRACE_TPI_BLOB) {
+                    // Registered under the lock, so it is registered before any later packet is decoded.
+                    decode(decoded, decomp, false, nullptr);
+                    register_blob(decoded);
+                }
+                batchBytes += decoded.packet->size;
+                batch->packets.push_back(move(decoded));
+            }
+            if (batch->packets.empty()) {
+                m_condition.notify_all();
+                break;
+            }
+            m_batches.push_back(batch);
+            lock.unlock();
+
+            for (auto& decoded : batch->packets) {
+                decode(decoded, decomp, m_stringify, formatter);
+                if (decoded.decompressResult != 0) {
+                    // The dump stops at this packet, the rest of the batch is freed unread.
+                    break;
+                }
+            }
+
+            lock.lock();
+            batch->decoded = true;
+            m_condition.notify_all();
+        }
+    }
+
+    FileLike* m_traceFile;
+    VKTRACE_COMPRESS_TYPE m_compressType;
+    uint32_t m_threadCount;
+    bool m_stringify;
+    bool m_fullDump;
+    vector<decompressor*> m_decompressors;
+    vector<packet_body_formatter*> m_formatters;
+    vector<thread> m_workers;
+    // m_mutex guards the trace file and the members below.
+    mutex m_mutex;
+    condition_variable m_condition;
+    deque<shared_ptr<packet_batch>> m_batches;
+    bool m_endOfFile = false;
+    bool m_stop = false;
+};
+
 static void dump_packet_brief(ostream& dumpFile, uint32_t frameNumber, vktrace_trace_packet_header* packet,
-                              uint64_t currentPosition) {
+                              uint64_t currentPosition, const string& apiCall) {
     static size_t index = 0;
     static bool skipApi = false;
     if (index == 0) {
@@ -147,7 +387,9 @@ static void dump_packet_brief(ostream& dumpFile, uint32_t frameNumber, vktrace_t
                  << SEPARATOR << setw(COLUMN_WIDTH) << dec << index << SEPARATOR << setw(COLUMN_WIDTH) << dec
                  << packet->global_packet_index << SEPARATOR << setw(COLUMN_WIDTH) << dec << currentPosition << SEPARATOR
                  << setw(COLUMN_WIDTH) << dec << packet->size << SEPARATOR
-                 << vktrace_stringify_vk_packet_id((VKTRACE_TRACE_PACKET_ID_VK)packet->packet_id, packet) << endl;
+                 << (apiCall.empty() ? vktrace_stringify_vk_packet_id((VKTRACE_TRACE_PACKET_ID_VK)packet->packet_id, packet)
+                                     : apiCall.c_str())
+                 << endl;
     } else {
         if (!skipApi) {
             dumpFile << setw(COLUMN_WIDTH) << dec << frameNumber << SEPARATOR << SPACES << SEPARATOR << SPACES << SEPARATOR
@@ -159,6 +401,50 @@ static void dump_packet_brief(ostream& dumpFile, uint32_t frameNumber, vktrace_t
     index++;
 }
 
+// Lists the packets from their headers, without reading or decompressing the bodies.
+static bool list_packet_headers(ostream& listFile, FileLike* traceFile, uint64_t firstPacketOffset, uint32_t& frameNumber) {
+    vktrace_PacketScanner* pScanner = vktrace_PacketScanner_create(traceFile, firstPacketOffset, 0);
+    if (pScanner == nullptr) {
+        return false;
+    }
+    listFile << setw(COLUMN_WIDTH) << "frame" << SEPARATOR << setw(COLUMN_WIDTH) << "thread id" << SEPARATOR << setw(COLUMN_WIDTH)
+             << "global pack id" << SEPARATOR << setw(COLUMN_WIDTH) << "pack position" << SEPARATOR << setw(COLUMN_WIDTH)
+             << "pack byte size" << SEPARATOR << setw(COLUMN_WIDTH) << "call time (ns)" << SEPARATOR << "API Call" << endl;
+    vktrace_trace_packet_header header;
+    uint64_t position = 0;
+    while (vktrace_PacketScanner_next(pScanner, &header, &position)) {
+        const char* name = nullptr;
+        if (header.packet_id >= VKTRACE_TPI_VK_vkApiVersion && header.packet_id < VKTRACE_TPI_META_DATA) {
+            name = vktrace_vk_packet_id_name((VKTRACE_TRACE_PACKET_ID_VK)header.packet_id);
+        } else if (header.packet_id == VKTRACE_TPI_META_DATA) {
+            name = "Meta Data";
+        } else if (header.packet_id == VKTRACE_TPI_PORTABILITY_TABLE) {
+            name = "Portability Table";
+        }
+        listFile << setw(COLUMN_WIDTH) << dec << frameNumber << SEPARATOR << setw(COLUMN_WIDTH) << header.thread_id << SEPARATOR
+                 << setw(COLUMN_WIDTH) << header.global_packet_index << SEPARATOR << setw(COLUMN_WIDTH) << position << SEPARATOR
+                 << setw(COLUMN_WIDTH) << header.size << SEPARATOR << setw(COLUMN_WIDTH)
+                 << (header.entrypoint_end_time - header.entrypoint_begin_time) << SEPARATOR;
+        if (name != nullptr) {
+            listFile << name << endl;
+        } else {
+            listFile << "Packet id " << header.packet_id << endl;
+        }
+        switch (header.packet_id) {
+#if VK_ANDROID_frame_boundary
+            case VKTRACE_TPI_VK_vkFrameBoundaryANDROID:
+#endif
+            case VKTRACE_TPI_VK_vkQueuePresentKHR:
+                frameNumber++;
+                break;
+            default:
+                break;
+        }
+    }
+    vktrace_PacketScanner_delete(&pScanner);
+    return true;
+}
+
 static void dump_full_setup() {
     if (g_params.fullDumpFile) {
         // Remove existing dump setting file before creating a new one
@@ -215,7 +501,8 @@ static void dump_full_setup() {
             settingFile << "lunarg_api_dump.file = TRUE" << endl;
         }
         settingFile << "lunarg_api_dump.log_filename = " << g_dump_file_name << endl;
-        settingFile << "lunarg_api_dump.flush = TRUE" << endl;
+        // The dump file is flushed when it is closed, flushing every call only slows the dump down.
+        settingFile << "lunarg_api_dump.flush = FALSE" << endl;
         settingFile << "lunarg_api_dump.indent_size = 4" << endl;
         settingFile << "lunarg_api_dump.show_types = TRUE" << endl;
         settingFile << "lunarg_api_dump.name_size = 32" << endl;
@@ -362,6 +649,10 @@ int main(int argc, char** argv) {
             cout << "\"" << g_params.traceFile << "\" "
                  << "is not a vktrace file !" << endl;
             ret = -1;
+        } else if (fileHeader.bit_flags & ~VKTRACE_KNOWN_FILE_HEADER_FLAGS) {
+            cout << "Error: trace file has unknown flags 0x" << hex << (fileHeader.bit_flags & ~VKTRACE_KNOWN_FILE_HEADER_FLAGS)
+                 << dec << ", it cannot be parsed by this vktracedump!" << endl;
+            ret = -1;
         } else if (sizeof(void*) != fileHeader.ptrsize) {
             cout << "Error: " << fileHeader.ptrsize * 8 << "bit trace file cannot be parsed by " << sizeof(void*) * 8
                  << "bit vktracedump!" << endl;
@@ -389,7 +680,9 @@ int main(int argc, char** argv) {
             bool hideBriefInfo = false;
             if ((g_params.fullDumpFile && (!strcmp(g_params.fullDumpFile, "STDOUT") || !strcmp(g_params.fullDumpFile, "stdout"))) ||
                 (g_params.simpleDumpFile &&
-                 (!strcmp(g_params.simpleDumpFile, "STDOUT") || !strcmp(g_params.simpleDumpFile, "stdout")))) {
+                 (!strcmp(g_params.simpleDumpFile, "STDOUT") || !strcmp(g_params.simpleDumpFile, "stdout"))) ||
+                (g_params.packetListFile &&
+                 (!strcmp(g_params.packetListFile, "STDOUT") || !strcmp(g_params.packetListFile, "stdout")))) {
                 hideBriefInfo = true;
             }
             if (!hideBriefInfo) {
@@ -451,7 +744,21 @@ int main(int argc, char** argv) {
                 }
                 vktrace_FileLike_SetCurrentPosition(traceFile, originalFilePos);
             }
-            if (ret > -1 && !g_params.onlyHeaderInfo) {
+            if (ret > -1 && !g_params.onlyHeaderInfo && g_params.packetListFile) {
+                uint32_t frameNumber = 0;
+                ofstream listOutput;
+                bool listToStdout = !strcmp(g_params.packetListFile, "STDOUT") || !strcmp(g_params.packetListFile, "stdout");
+                if (!listToStdout) {
+                    listOutput.open(g_params.packetListFile);
+                }
+                if (!list_packet_headers(listToStdout ? cout : listOutput, traceFile, fileHeader.first_packet_offset, frameNumber)) {
+                    ret = -1;
+                } else if (!hideBriefInfo && !listToStdout && !g_params.simpleDumpFile && !g_params.fullDumpFile) {
+                    cout << setw(COLUMN_WIDTH) << left << "Frames:" << dec << frameNumber << endl;
+                }
+            }
+            // The packet list alone does not need the packet bodies.
+            if (ret > -1 && !g_params.onlyHeaderInfo && (g_params.simpleDumpFile || g_params.fullDumpFile || !g_params.packetListFile)) {
                 uint32_t frameNumber = 0;
                 uint32_t deviceApiVersion = UINT32_MAX;
                 uint32_t appApiVersion = UINT32_MAX;
@@ -460,39 +767,37 @@ int main(int argc, char** argv) {
                 char* pEngineName = NULL;
                 uint32_t engineVersion = 0;
                 char deviceName[VK_MAX_PHYSICAL_DEVICE_NAME_SIZE] = "";
-                decompressor* decomp = nullptr;
-                if (fileHeader.compress_type != VKTRACE_COMPRESS_TYPE_NONE) {
-                    decomp = create_decompressor((VKTRACE_COMPRESS_TYPE)fileHeader.compress_type);
-                    if (decomp == nullptr) {
-                        vktrace_LogError("Create decompressor error.");
-                        fclose(tracefp);
-                        vktrace_free(traceFile);
-                        if (tmpfile) {
-                            remove(tmpfile);
-                        }
-                        return -1;
+                packet_decoder decoder(traceFile, (VKTRACE_COMPRESS_TYPE)fileHeader.compress_type, g_params.threadCount,
+                                       g_params.simpleDumpFile != nullptr, g_params.fullDumpFile != nullptr);
+                if (!decoder.init()) {
+                    fclose(tracefp);
+                    vktrace_free(traceFile);
+                    if (tmpfile) {
+                        remove(tmpfile);
                     }
+                    return -1;
                 }
                 while (true) {
-                    uint64_t currentPosition = vktrace_FileLike_GetCurrentPosition(traceFile);
-                    vktrace_trace_packet_header* packet = vktrace_read_trace_packet(traceFile);
-                    if (!packet) break;
-
-                    if (packet->tracer_id == VKTRACE_TID_VULKAN_COMPRESSED) {
-                        ret = decompress_packet(decomp,packet);
-                        if (ret != 0) {
-                            vktrace_LogError("Decompress packet error.");
-                            break;
-                        }
+                    decoded_packet decoded;
+                    if (!decoder.next(decoded)) break;
+                    vktrace_trace_packet_header* packet = decoded.packet;
+
+                    if (decoded.decompressResult != 0) {
+                        ret = decoded.decompressResult;
+                        vktrace_LogError("Decompress packet error.");
+                        vktrace_delete_trace_packet_no_lock(&packet);
+                        break;
                     }
 
                     if (packet->packet_id >= VKTRACE_TPI_VK_vkApiVersion && packet->packet_id < VKTRACE_TPI_META_DATA) {
-                        vktrace_trace_packet_header* pInterpretedHeader = interpret_trace_packet_vk(packet);
+                        vktrace_trace_packet_header* pInterpretedHeader = decoded.pInterpretedHeader;
                         if (pInterpretedHeader != nullptr) {
                             if (g_params.simpleDumpFile) {
-                                dump_packet_brief(*pSimpleDumpFile, frameNumber, pInterpretedHeader, currentPosition);
+                                dump_packet_brief(*pSimpleDumpFile, frameNumber, pInterpretedHeader, decoded.position, decoded.apiCall);
                             }
-                            if (g_params.fullDumpFile) {
+                            if (g_params.fullDumpFile && decoded.fullDumpBodyFormatted) {
+                                dump_packet(pInterpretedHeader, decoded.fullDumpBody);
+                            } else if (g_params.fullDumpFile) {
                                 dump_packet(pInterpretedHeader);
                             }
                             switch (pInterpretedHeader->packet_id) {
@@ -560,9 +865,6 @@ int main(int argc, char** argv) {
                     }
                     vktrace_delete_trace_packet_no_lock(&packet);
                 }
-                if (decomp != nullptr) {
-                    delete decomp;
-                }
                 if (!hideBriefInfo) {
                     if (deviceApiVersion != UINT32_MAX) {
                         cout << setw(COLUMN_WIDTH) << left << "Device Name:" << deviceName << endl;
@@ -16,5 +16,17 @@
 
 #pragma once
 
+#include <string>
+
 void dump_packet(const vktrace_trace_packet_header* packet);
-void reset_dump_file_name(const char* dump_file_name);
\ No newline at end of file
+void reset_dump_file_name(const char* dump_file_name);
+
+// Formats the full dump of packets on a worker thread, each worker thread has its own.
+struct packet_body_formatter;
+packet_body_formatter* create_packet_body_formatter();
+void destroy_packet_body_formatter(packet_body_formatter* formatter);
+// Formats the part of the full dump of packet which doesn't depend on the packets before it,
+// the parameters, into body. Returns false if the packet has to be dumped by dump_packet().
+bool dump_packet_body(packet_body_formatter* formatter, const vktrace_trace_packet_header* packet, std::string& body);
+// Dumps packet like dump_packet(), with the body formatted by dump_packet_body().
+void dump_packet(const vktrace_trace_packet_header* packet, const std::string& body);
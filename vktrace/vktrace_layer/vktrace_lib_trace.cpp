@@ -404,6 +404,9 @@ void endFrame()
             }
         }
     }
+    if (g_trimEnabled && g_trimIsPreTrim && (g_trimFrameCounter % 1000) == 0) {
+        trim::log_state_tracker_memory_footprint(false);
+    }
     if (g_trimFrameCounter > getCheckHandlerFrames()) {
         disableHandlerCheck();
     }
@@ -3164,8 +3167,8 @@ VKTRACER_EXPORT VKAPI_ATTR VkResult VKAPI_CALL __HOOKED_vkBeginCommandBuffer(VkC
     } else {
         vktrace_finalize_trace_packet(pHeader);
 
-        trim::remove_CommandBuffer_calls(commandBuffer);
-        trim::add_CommandBuffer_call(commandBuffer, trim::copy_packet(pHeader));
+        trim::reset_CommandBuffer_calls(commandBuffer);
+        trim::add_CommandBuffer_call(commandBuffer, pHeader);
         trim::ClearImageTransitions(commandBuffer);
         trim::ClearBufferTransitions(commandBuffer);
         trim::clear_binding_Pipelines_from_CommandBuffer(commandBuffer);
@@ -4803,7 +4806,7 @@ VKTRACER_EXPORT VKAPI_ATTR void VKAPI_CALL __HOOKED_vkCmdTraceRaysKHR(
         FINISH_TRACE_PACKET();
     } else {
         vktrace_finalize_trace_packet(pHeader);
-        trim::add_CommandBuffer_call(commandBuffer, trim::copy_packet(pHeader));
+        trim::add_CommandBuffer_call(commandBuffer, pHeader);
         if (g_trimIsInTrim) {
             trim::write_packet(pHeader);
         } else {
@@ -4845,7 +4848,7 @@ VKTRACER_EXPORT VKAPI_ATTR void VKAPI_CALL __HOOKED_vkCmdTraceRaysIndirectKHR(
         FINISH_TRACE_PACKET();
     } else {
         vktrace_finalize_trace_packet(pHeader);
-        trim::add_CommandBuffer_call(commandBuffer, trim::copy_packet(pHeader));
+        trim::add_CommandBuffer_call(commandBuffer, pHeader);
         if (g_trimIsInTrim) {
             trim::write_packet(pHeader);
         } else {
@@ -7249,7 +7252,7 @@ VKTRACER_EXPORT VKAPI_ATTR void VKAPI_CALL __HOOKED_vkCmdWaitEvents(
             }
         }
 
-        trim::add_CommandBuffer_call(commandBuffer, trim::copy_packet(pHeader));
+        trim::add_CommandBuffer_call(commandBuffer, pHeader);
 
         if (g_trimIsInTrim) {
             for (uint32_t i = 0; i < bufferMemoryBarrierCount; i++) {
@@ -7356,7 +7359,7 @@ VKTRACER_EXPORT VKAPI_ATTR void VKAPI_CALL __HOOKED_vkCmdPipelineBarrier(
             }
         }
 
-        trim::add_CommandBuffer_call(commandBuffer, trim::copy_packet(pHeader));
+        trim::add_CommandBuffer_call(commandBuffer, pHeader);
         if (g_trimIsInTrim) {
             trim::write_packet(pHeader);
         } else {
@@ -7400,7 +7403,7 @@ VKTRACER_EXPORT VKAPI_ATTR void VKAPI_CALL __HOOKED_vkCmdPipelineBarrier2KHR(
         FINISH_TRACE_PACKET();
     } else {
         vktrace_finalize_trace_packet(pHeader);
-        trim::add_CommandBuffer_call(commandBuffer, trim::copy_packet(pHeader));
+        trim::add_CommandBuffer_call(commandBuffer, pHeader);
         if (g_trimIsInTrim) {
             trim::write_packet(pHeader);
         } else {
@@ -7444,7 +7447,7 @@ VKTRACER_EXPORT VKAPI_ATTR void VKAPI_CALL __HOOKED_vkCmdPipelineBarrier2(
         FINISH_TRACE_PACKET();
     } else {
         vktrace_finalize_trace_packet(pHeader);
-        trim::add_CommandBuffer_call(commandBuffer, trim::copy_packet(pHeader));
+        trim::add_CommandBuffer_call(commandBuffer, pHeader);
         if (g_trimIsInTrim) {
             trim::write_packet(pHeader);
         } else {
@@ -7475,7 +7478,7 @@ VKTRACER_EXPORT VKAPI_ATTR void VKAPI_CALL __HOOKED_vkCmdPushConstants(VkCommand
         FINISH_TRACE_PACKET();
     } else {
         vktrace_finalize_trace_packet(pHeader);
-        trim::add_CommandBuffer_call(commandBuffer, trim::copy_packet(pHeader));
+        trim::add_CommandBuffer_call(commandBuffer, pHeader);
         if (g_trimIsInTrim) {
             trim::write_packet(pHeader);
         } else {
@@ -7513,7 +7516,7 @@ VKTRACER_EXPORT VKAPI_ATTR void VKAPI_CALL __HOOKED_vkCmdExecuteCommands(VkComma
         FINISH_TRACE_PACKET();
     } else {
         vktrace_finalize_trace_packet(pHeader);
-        trim::add_CommandBuffer_call(commandBuffer, trim::copy_packet(pHeader));
+        trim::add_CommandBuffer_call(commandBuffer, pHeader);
         if (g_trimIsInTrim) {
             trim::write_packet(pHeader);
             trim::mark_CommandBuffer_reference(commandBuffer);
@@ -7854,7 +7857,7 @@ VKTRACER_EXPORT VKAPI_ATTR void VKAPI_CALL __HOOKED_vkCmdBeginRenderPass(VkComma
     } else {
         vktrace_finalize_trace_packet(pHeader);
 
-        trim::add_CommandBuffer_call(commandBuffer, trim::copy_packet(pHeader));
+        trim::add_CommandBuffer_call(commandBuffer, pHeader);
         trim::add_CommandBuffer_to_begin_renderpass(commandBuffer, pRenderPassBegin->renderPass);
         trim::add_CommandBuffer_to_begin_framebuffer(commandBuffer, pRenderPassBegin->framebuffer);
         trim::ObjectInfo* pCommandBuffer = trim::get_CommandBuffer_objectInfo(commandBuffer);
@@ -7917,7 +7920,7 @@ VKTRACER_EXPORT VKAPI_ATTR void VKAPI_CALL __HOOKED_vkCmdBeginRenderPass2(
     } else {
         vktrace_finalize_trace_packet(pHeader);
 
-        trim::add_CommandBuffer_call(commandBuffer, trim::copy_packet(pHeader));
+        trim::add_CommandBuffer_call(commandBuffer, pHeader);
         trim::add_CommandBuffer_to_begin_renderpass(commandBuffer, pRenderPassBegin->renderPass);
         trim::add_CommandBuffer_to_begin_framebuffer(commandBuffer, pRenderPassBegin->framebuffer);
         trim::ObjectInfo* pCommandBuffer = trim::get_CommandBuffer_objectInfo(commandBuffer);
@@ -7980,7 +7983,7 @@ VKTRACER_EXPORT VKAPI_ATTR void VKAPI_CALL __HOOKED_vkCmdBeginRenderPass2KHR(
     } else {
         vktrace_finalize_trace_packet(pHeader);
 
-        trim::add_CommandBuffer_call(commandBuffer, trim::copy_packet(pHeader));
+        trim::add_CommandBuffer_call(commandBuffer, pHeader);
         trim::add_CommandBuffer_to_begin_renderpass(commandBuffer, pRenderPassBegin->renderPass);
         trim::add_CommandBuffer_to_begin_framebuffer(commandBuffer, pRenderPassBegin->framebuffer);
         trim::ObjectInfo* pCommandBuffer = trim::get_CommandBuffer_objectInfo(commandBuffer);
@@ -8065,7 +8068,7 @@ VKTRACER_EXPORT VKAPI_ATTR void VKAPI_CALL __HOOKED_vkCmdBeginRenderingKHR(
     } else {
         // NOT TEST
         vktrace_finalize_trace_packet(pHeader);
-        trim::add_CommandBuffer_call(commandBuffer, trim::copy_packet(pHeader));
+        trim::add_CommandBuffer_call(commandBuffer, pHeader);
         if (g_trimIsInTrim) {
             trim::write_packet(pHeader);
         } else {
@@ -8122,7 +8125,7 @@ VKTRACER_EXPORT VKAPI_ATTR void VKAPI_CALL __HOOKED_vkCmdBeginRendering(
     } else {
         // NOT TEST
         vktrace_finalize_trace_packet(pHeader);
-        trim::add_CommandBuffer_call(commandBuffer, trim::copy_packet(pHeader));
+        trim::add_CommandBuffer_call(commandBuffer, pHeader);
         if (g_trimIsInTrim) {
             trim::write_packet(pHeader);
         } else {
@@ -8145,7 +8148,7 @@ VKTRACER_EXPORT VKAPI_ATTR void VKAPI_CALL __HOOKED_vkCmdEndRendering(
         FINISH_TRACE_PACKET();
     } else {
         vktrace_finalize_trace_packet(pHeader);
-        trim::add_CommandBuffer_call(commandBuffer, trim::copy_packet(pHeader));
+        trim::add_CommandBuffer_call(commandBuffer, pHeader);
         if (g_trimIsInTrim) {
             trim::write_packet(pHeader);
         } else {
@@ -10684,7 +10687,7 @@ VKTRACER_EXPORT VKAPI_ATTR void VKAPI_CALL __HOOKED_vkCmdPushDescriptorSetKHR(Vk
         FINISH_TRACE_PACKET();
     } else {
         vktrace_finalize_trace_packet(pHeader);
-        trim::add_CommandBuffer_call(commandBuffer, trim::copy_packet(pHeader));
+        trim::add_CommandBuffer_call(commandBuffer, pHeader);
         for (uint32_t i = 0; i < descriptorWriteCount; i++) {
             if (g_trimIsInTrim) {
                 trim::mark_DescriptorSet_reference(pDescriptorWrites[i].dstSet);
@@ -10762,7 +10765,7 @@ VKTRACER_EXPORT VKAPI_ATTR void VKAPI_CALL __HOOKED_vkCmdPushDescriptorSetWithTe
         FINISH_TRACE_PACKET();
     } else {
         vktrace_finalize_trace_packet(pHeader);
-        trim::add_CommandBuffer_call(commandBuffer, trim::copy_packet(pHeader));
+        trim::add_CommandBuffer_call(commandBuffer, pHeader);
         if (g_trimIsInTrim) {
             trim::write_packet(pHeader);
         } else {
@@ -10798,7 +10801,7 @@ VKTRACER_EXPORT VKAPI_ATTR void VKAPI_CALL __HOOKED_vkCmdCopyImageToBuffer(VkCom
         FINISH_TRACE_PACKET();
     } else {
         vktrace_finalize_trace_packet(pHeader);
-        trim::add_CommandBuffer_call(commandBuffer, trim::copy_packet(pHeader));
+        trim::add_CommandBuffer_call(commandBuffer, pHeader);
         if (g_trimIsInTrim) {
             trim::mark_Buffer_reference(dstBuffer);
             trim::mark_Image_reference(srcImage);
@@ -11068,7 +11071,7 @@ VKTRACER_EXPORT VKAPI_ATTR void VKAPI_CALL __HOOKED_vkCmdCopyBuffer(
         FINISH_TRACE_PACKET();
     } else {
         vktrace_finalize_trace_packet(pHeader);
-        trim::add_CommandBuffer_call(commandBuffer, trim::copy_packet(pHeader));
+        trim::add_CommandBuffer_call(commandBuffer, pHeader);
         if (g_trimIsInTrim) {
             trim::mark_Buffer_reference(srcBuffer);
             trim::mark_Buffer_reference(dstBuffer);
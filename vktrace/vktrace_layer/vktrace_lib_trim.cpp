@@ -238,6 +238,7 @@ VkDeviceSize getImageSubResourceOffset(VkImage image, uint32_t mipLevel) {
 void start() {
     g_trimIsPreTrim = false;
     g_trimIsInTrim = true;
+    log_state_tracker_memory_footprint(true);
     snapshot_state_tracker();
 
     if (!g_trimPostProcess) {
@@ -1257,6 +1258,8 @@ void generateMapUnmap(bool makeCalls, VkDevice device, VkDeviceMemory memory, Vk
 }
 
 void delete_redundant_package(StateTracker &stateTracker) {
+    // The recorded packets are owned by the command buffer packet arenas,
+    // redundant ones only need to be dropped from the list.
     cb_delete_packet.clear();
     for (auto& cmdBuffer : stateTracker.m_cmdBufferPackets) {
         bool bDelete = false;
@@ -1279,7 +1282,6 @@ void delete_redundant_package(StateTracker &stateTracker) {
                                 pFramebuffer = trim::get_Framebuffer_objectInfo(pInheritanceInfo->framebuffer);
                             }
                             if (pFramebuffer == nullptr) {
-                                vktrace_delete_trace_packet(&pHeader);
                                 packet = packet_list.erase(packet);
                                 ObjectInfo *cmdbufferInfo = get_CommandBuffer_objectInfo(cmdBuffer.first);
                                 cb_delete_packet[cmdBuffer.first] = cmdbufferInfo;
@@ -1294,7 +1296,6 @@ void delete_redundant_package(StateTracker &stateTracker) {
                 break;
             case VKTRACE_TPI_VK_vkCmdBeginRenderPass:
                 if (bDelete) {
-                    vktrace_delete_trace_packet(&pHeader);
                     packet = packet_list.erase(packet);
                 } else {
                     const VkRenderPassBeginInfo* pRenderPassBegin =
@@ -1310,7 +1311,6 @@ void delete_redundant_package(StateTracker &stateTracker) {
                         }
 
                         if (pFramebuffer == nullptr || pRenderPass == nullptr) {
-                            vktrace_delete_trace_packet(&pHeader);
                             packet = packet_list.erase(packet);
                             ObjectInfo *cmdbufferInfo = get_CommandBuffer_objectInfo(cmdBuffer.first);
                             cb_delete_packet[cmdBuffer.first] = cmdbufferInfo;
@@ -1324,7 +1324,6 @@ void delete_redundant_package(StateTracker &stateTracker) {
                 break;
             case VKTRACE_TPI_VK_vkCmdBindDescriptorSets:
                 if (bDelete) {
-                    vktrace_delete_trace_packet(&pHeader);
                     packet = packet_list.erase(packet);
                 } else {
                     bool bRedundant = false;
@@ -1334,7 +1333,6 @@ void delete_redundant_package(StateTracker &stateTracker) {
                         for (uint32_t i = 0; i < ((packet_vkCmdBindDescriptorSets*)pHeader->pBody)->descriptorSetCount; i++) {
                             trim::ObjectInfo* descriptorSetInfo = trim::get_DescriptorSet_objectInfo(pDescriptorSets[i]);
                             if (descriptorSetInfo == nullptr) {
-                                vktrace_delete_trace_packet(&pHeader);
                                 packet = packet_list.erase(packet);
                                 bRedundant = true;
                                 break;
@@ -1348,7 +1346,6 @@ void delete_redundant_package(StateTracker &stateTracker) {
                 break;
             case VKTRACE_TPI_VK_vkCmdBindVertexBuffers:
                 if (bDelete) {
-                    vktrace_delete_trace_packet(&pHeader);
                     packet = packet_list.erase(packet);
                 } else {
                     bool bRedundant = false;
@@ -1358,7 +1355,6 @@ void delete_redundant_package(StateTracker &stateTracker) {
                         for (uint32_t i = 0; i < ((packet_vkCmdBindVertexBuffers*)pHeader->pBody)->bindingCount; i++) {
                             trim::ObjectInfo* bufferInfo = trim::get_Buffer_objectInfo(pBuffers[i]);
                             if (bufferInfo == nullptr) {
-                                vktrace_delete_trace_packet(&pHeader);
                                 packet = packet_list.erase(packet);
                                 bRedundant = true;
                                 break;
@@ -1372,7 +1368,6 @@ void delete_redundant_package(StateTracker &stateTracker) {
                 break;
             case VKTRACE_TPI_VK_vkCmdEndRenderPass:
                 if (bDelete) {
-                    vktrace_delete_trace_packet(&pHeader);
                     packet = packet_list.erase(packet);
                     if (delBeginPktId == VKTRACE_TPI_VK_vkCmdBeginRenderPass) {
                         bDelete = false;
@@ -1383,7 +1378,6 @@ void delete_redundant_package(StateTracker &stateTracker) {
                 break;
             case VKTRACE_TPI_VK_vkCmdCopyBufferToImage:
                 if (bDelete) {
-                    vktrace_delete_trace_packet(&pHeader);
                     packet = packet_list.erase(packet);
                 } else {
                     bool bRedundant = false;
@@ -1393,7 +1387,6 @@ void delete_redundant_package(StateTracker &stateTracker) {
                     trim::ObjectInfo* imageInfo = trim::get_Image_objectInfo(pPacket->dstImage);
                     if (bufferInfo == nullptr || imageInfo == nullptr) {
                         vktrace_delete_trace_packet(&pDelHeader);
-                        vktrace_delete_trace_packet(&pHeader);
                         packet = packet_list.erase(packet);
                         bRedundant = true;
                         break;
@@ -1406,7 +1399,6 @@ void delete_redundant_package(StateTracker &stateTracker) {
                 break;
             case VKTRACE_TPI_VK_vkCmdCopyBuffer:
                 if (bDelete) {
-                    vktrace_delete_trace_packet(&pHeader);
                     packet = packet_list.erase(packet);
                 } else {
                     bool bRedundant = false;
@@ -1416,7 +1408,6 @@ void delete_redundant_package(StateTracker &stateTracker) {
                     trim::ObjectInfo* bufferInfo2 = trim::get_Buffer_objectInfo(pPacket->dstBuffer);
                     if (bufferInfo1 == nullptr || bufferInfo2 == nullptr) {
                         vktrace_delete_trace_packet(&pDelHeader);
-                        vktrace_delete_trace_packet(&pHeader);
                         packet = packet_list.erase(packet);
                         bRedundant = true;
                         break;
@@ -1430,7 +1421,6 @@ void delete_redundant_package(StateTracker &stateTracker) {
             case VKTRACE_TPI_VK_vkCmdCopyBuffer2:
             case VKTRACE_TPI_VK_vkCmdCopyBuffer2KHR:
                 if (bDelete) {
-                    vktrace_delete_trace_packet(&pHeader);
                     packet = packet_list.erase(packet);
                 } else {
                     bool bRedundant = false;
@@ -1440,7 +1430,6 @@ void delete_redundant_package(StateTracker &stateTracker) {
                     trim::ObjectInfo* bufferInfo2 = trim::get_Buffer_objectInfo(pPacket->pCopyBufferInfo->dstBuffer);
                     if (bufferInfo1 == nullptr || bufferInfo2 == nullptr) {
                         vktrace_delete_trace_packet(&pDelHeader);
-                        vktrace_delete_trace_packet(&pHeader);
                         packet = packet_list.erase(packet);
                         bRedundant = true;
                         break;
@@ -1453,7 +1442,6 @@ void delete_redundant_package(StateTracker &stateTracker) {
                 break;
             case VKTRACE_TPI_VK_vkCmdCopyImage:
                 if (bDelete) {
-                    vktrace_delete_trace_packet(&pHeader);
                     packet = packet_list.erase(packet);
                 } else {
                     bool bRedundant = false;
@@ -1463,7 +1451,6 @@ void delete_redundant_package(StateTracker &stateTracker) {
                     trim::ObjectInfo* imageInfo2 = trim::get_Image_objectInfo(pPacket->dstImage);
                     if (imageInfo1 == nullptr || imageInfo2 == nullptr) {
                         vktrace_delete_trace_packet(&pDelHeader);
-                        vktrace_delete_trace_packet(&pHeader);
                         packet = packet_list.erase(packet);
                         bRedundant = true;
                         break;
@@ -1477,7 +1464,6 @@ void delete_redundant_package(StateTracker &stateTracker) {
             case VKTRACE_TPI_VK_vkCmdCopyImage2:
             case VKTRACE_TPI_VK_vkCmdCopyImage2KHR:
                 if (bDelete) {
-                    vktrace_delete_trace_packet(&pHeader);
                     packet = packet_list.erase(packet);
                 } else {
                     bool bRedundant = false;
@@ -1487,7 +1473,6 @@ void delete_redundant_package(StateTracker &stateTracker) {
                     trim::ObjectInfo* imageInfo2 = trim::get_Image_objectInfo(pPacket->pCopyImageInfo->dstImage);
                     if (imageInfo1 == nullptr || imageInfo2 == nullptr) {
                         vktrace_delete_trace_packet(&pDelHeader);
-                        vktrace_delete_trace_packet(&pHeader);
                         packet = packet_list.erase(packet);
                         bRedundant = true;
                         break;
@@ -1500,7 +1485,6 @@ void delete_redundant_package(StateTracker &stateTracker) {
                 break;
             case VKTRACE_TPI_VK_vkCmdBlitImage:
                 if (bDelete) {
-                    vktrace_delete_trace_packet(&pHeader);
                     packet = packet_list.erase(packet);
                 } else {
                     bool bRedundant = false;
@@ -1510,7 +1494,6 @@ void delete_redundant_package(StateTracker &stateTracker) {
                     trim::ObjectInfo* imageInfo2 = trim::get_Image_objectInfo(pPacket->dstImage);
                     if (imageInfo1 == nullptr || imageInfo2 == nullptr) {
                         vktrace_delete_trace_packet(&pDelHeader);
-                        vktrace_delete_trace_packet(&pHeader);
                         packet = packet_list.erase(packet);
                         bRedundant = true;
                         break;
@@ -1523,7 +1506,6 @@ void delete_redundant_package(StateTracker &stateTracker) {
                 break;
             case VKTRACE_TPI_VK_vkCmdResolveImage:
                 if (bDelete) {
-                    vktrace_delete_trace_packet(&pHeader);
                     packet = packet_list.erase(packet);
                 } else {
                     bool bRedundant = false;
@@ -1533,7 +1515,6 @@ void delete_redundant_package(StateTracker &stateTracker) {
                     trim::ObjectInfo* imageInfo2 = trim::get_Image_objectInfo(pPacket->dstImage);
                     if (imageInfo1 == nullptr || imageInfo2 == nullptr) {
                         vktrace_delete_trace_packet(&pDelHeader);
-                        vktrace_delete_trace_packet(&pHeader);
                         packet = packet_list.erase(packet);
                         bRedundant = true;
                         break;
@@ -1546,7 +1527,6 @@ void delete_redundant_package(StateTracker &stateTracker) {
                 break;
             case VKTRACE_TPI_VK_vkCmdFillBuffer:
                 if (bDelete) {
-                    vktrace_delete_trace_packet(&pHeader);
                     packet = packet_list.erase(packet);
                 } else {
                     bool bRedundant = false;
@@ -1555,7 +1535,6 @@ void delete_redundant_package(StateTracker &stateTracker) {
                     trim::ObjectInfo* bufferInfo = trim::get_Buffer_objectInfo(pPacket->dstBuffer);
                     if (bufferInfo == nullptr) {
                         vktrace_delete_trace_packet(&pDelHeader);
-                        vktrace_delete_trace_packet(&pHeader);
                         packet = packet_list.erase(packet);
                         bRedundant = true;
                         break;
@@ -1568,7 +1547,6 @@ void delete_redundant_package(StateTracker &stateTracker) {
                 break;
             case VKTRACE_TPI_VK_vkCmdUpdateBuffer:
                 if (bDelete) {
-                    vktrace_delete_trace_packet(&pHeader);
                     packet = packet_list.erase(packet);
                 } else {
                     bool bRedundant = false;
@@ -1577,7 +1555,6 @@ void delete_redundant_package(StateTracker &stateTracker) {
                     trim::ObjectInfo* bufferInfo = trim::get_Buffer_objectInfo(pPacket->dstBuffer);
                     if (bufferInfo == nullptr) {
                         vktrace_delete_trace_packet(&pDelHeader);
-                        vktrace_delete_trace_packet(&pHeader);
                         packet = packet_list.erase(packet);
                         bRedundant = true;
                         break;
@@ -1590,7 +1567,6 @@ void delete_redundant_package(StateTracker &stateTracker) {
                 break;
             case VKTRACE_TPI_VK_vkCmdClearColorImage:
                 if (bDelete) {
-                    vktrace_delete_trace_packet(&pHeader);
                     packet = packet_list.erase(packet);
                 } else {
                     bool bRedundant = false;
@@ -1599,7 +1575,6 @@ void delete_redundant_package(StateTracker &stateTracker) {
                     trim::ObjectInfo* imageInfo = trim::get_Image_objectInfo(pPacket->image);
                     if (imageInfo == nullptr) {
                         vktrace_delete_trace_packet(&pDelHeader);
-                        vktrace_delete_trace_packet(&pHeader);
                         packet = packet_list.erase(packet);
                         bRedundant = true;
                         break;
@@ -1612,7 +1587,6 @@ void delete_redundant_package(StateTracker &stateTracker) {
                 break;
             case VKTRACE_TPI_VK_vkCmdClearDepthStencilImage:
                 if (bDelete) {
-                    vktrace_delete_trace_packet(&pHeader);
                     packet = packet_list.erase(packet);
                 } else {
                     bool bRedundant = false;
@@ -1621,7 +1595,6 @@ void delete_redundant_package(StateTracker &stateTracker) {
                     trim::ObjectInfo* imageInfo = trim::get_Image_objectInfo(pPacket->image);
                     if (imageInfo == nullptr) {
                         vktrace_delete_trace_packet(&pDelHeader);
-                        vktrace_delete_trace_packet(&pHeader);
                         packet = packet_list.erase(packet);
                         bRedundant = true;
                         break;
@@ -1634,7 +1607,6 @@ void delete_redundant_package(StateTracker &stateTracker) {
                 break;
             case VKTRACE_TPI_VK_vkCmdPipelineBarrier:
                 if (bDelete) {
-                    vktrace_delete_trace_packet(&pHeader);
                     packet = packet_list.erase(packet);
                 } else {
                     const VkBufferMemoryBarrier *pBufferMemoryBarriers =
@@ -1648,7 +1620,6 @@ void delete_redundant_package(StateTracker &stateTracker) {
                             }
 
                             if (bufferInfo == nullptr) {
-                                vktrace_delete_trace_packet(&pHeader);
                                 packet = packet_list.erase(packet);
                                 ObjectInfo *cmdbufferInfo = get_CommandBuffer_objectInfo(cmdBuffer.first);
                                 cb_delete_packet[cmdBuffer.first] = cmdbufferInfo;
@@ -1672,7 +1643,6 @@ void delete_redundant_package(StateTracker &stateTracker) {
                             }
 
                             if (imageInfo == nullptr) {
-                                vktrace_delete_trace_packet(&pHeader);
                                 packet = packet_list.erase(packet);
                                 ObjectInfo *cmdbufferInfo = get_CommandBuffer_objectInfo(cmdBuffer.first);
                                 cb_delete_packet[cmdBuffer.first] = cmdbufferInfo;
@@ -1690,7 +1660,6 @@ void delete_redundant_package(StateTracker &stateTracker) {
                 break;
             default:
                 if (bDelete) {
-                    vktrace_delete_trace_packet(&pHeader);
                     packet = packet_list.erase(packet);
                 } else {
                     packet++;
@@ -1701,6 +1670,30 @@ void delete_redundant_package(StateTracker &stateTracker) {
     }
 }
 
+//=============================================================================
+// Report how much memory the recorded command buffer packets of the global
+// state tracker take.
+//=============================================================================
+void log_state_tracker_memory_footprint(bool always) {
+    vktrace_enter_critical_section(&trimCommandBufferPacketLock);
+    PacketMemoryFootprint footprint = s_trimGlobalStateTracker.get_PacketMemoryFootprint();
+    vktrace_leave_critical_section(&trimCommandBufferPacketLock);
+
+    const char *format =
+        "Trim state tracker at frame %" PRIu64 ": %" PRIu64 " command buffers, %" PRIu64 " packets, %" PRIu64
+        " arenas (%" PRIu64 " shared), %" PRIu64 " bytes used, %" PRIu64 " bytes reserved (%" PRIu64
+        " bytes in all arenas).";
+    if (always) {
+        vktrace_LogAlways(format, g_trimFrameCounter, footprint.commandBufferCount, footprint.packetCount, footprint.arenaCount,
+                          footprint.sharedArenaCount, footprint.usedBytes, footprint.reservedBytes,
+                          PacketArena::get_TotalReservedBytes());
+    } else {
+        vktrace_LogDebug(format, g_trimFrameCounter, footprint.commandBufferCount, footprint.packetCount, footprint.arenaCount,
+                         footprint.sharedArenaCount, footprint.usedBytes, footprint.reservedBytes,
+                         PacketArena::get_TotalReservedBytes());
+    }
+}
+
 //=============================================================================
 // Use this to snapshot the global state tracker at the start of the trim
 // frames.
@@ -6845,9 +6838,8 @@ void recreate_allocated_command_buffers(StateTracker &stateTracker) {
             for (std::list<vktrace_trace_packet_header *>::iterator packet = packets.begin(); packet != packets.end(); ++packet) {
                 vktrace_trace_packet_header *pHeader = *packet;
                 vktrace_write_trace_packet(pHeader, vktrace_trace_get_trace_file());
-                vktrace_delete_trace_packet_no_lock(&pHeader);
             }
-            packets.clear();
+            stateTracker.remove_CommandBuffer_calls((VkCommandBuffer)cmdBuffer->first);
         }
     }
     // 2. Go through primary command buffers
@@ -6865,9 +6857,8 @@ void recreate_allocated_command_buffers(StateTracker &stateTracker) {
                     continue;
                 }
                 vktrace_write_trace_packet(pHeader, vktrace_trace_get_trace_file());
-                vktrace_delete_trace_packet_no_lock(&pHeader);
             }
-            packets.clear();
+            stateTracker.remove_CommandBuffer_calls((VkCommandBuffer)cmdBuffer->first);
         }
     }
     vktrace_leave_critical_section(&trimCommandBufferPacketLock);
@@ -7432,7 +7423,7 @@ uint32_t get_RenderPassVersion(VkRenderPass renderPass) {
 }
 
 //=========================================================================
-void add_CommandBuffer_call(VkCommandBuffer commandBuffer, vktrace_trace_packet_header *pHeader) {
+void add_CommandBuffer_call(VkCommandBuffer commandBuffer, const vktrace_trace_packet_header *pHeader) {
     if (pHeader != NULL) {
         vktrace_enter_critical_section(&trimCommandBufferPacketLock);
         s_trimGlobalStateTracker.add_CommandBuffer_call(commandBuffer, pHeader);
@@ -7440,6 +7431,16 @@ void add_CommandBuffer_call(VkCommandBuffer commandBuffer, vktrace_trace_packet_
     }
 }
 
+//=========================================================================
+void reset_CommandBuffer_calls(VkCommandBuffer commandBuffer) {
+    vktrace_enter_critical_section(&trimCommandBufferPacketLock);
+    s_trimGlobalStateTracker.reset_CommandBuffer_calls(commandBuffer);
+    if (g_trimIsInTrim) {
+        mark_CommandBuffer_reference(commandBuffer);
+    }
+    vktrace_leave_critical_section(&trimCommandBufferPacketLock);
+}
+
 //=========================================================================
 void remove_CommandBuffer_calls(VkCommandBuffer commandBuffer) {
     vktrace_enter_critical_section(&trimCommandBufferPacketLock);
@@ -186,6 +186,10 @@ VkDeviceSize getImageSubResourceOffset(VkImage image, uint32_t mipLevel);
 // frames.
 void snapshot_state_tracker();
 
+// Log the memory held by recorded command buffer packets, at debug level
+// unless always is set.
+void log_state_tracker_memory_footprint(bool always);
+
 void start();
 void stop();
 
@@ -200,7 +204,8 @@ uint32_t get_RenderPassVersion(VkRenderPass renderPass);
 
 //-----------------------
 // the following calls are pass-through to the StateTracker
-void add_CommandBuffer_call(VkCommandBuffer commandBuffer, vktrace_trace_packet_header *pHeader);
+void add_CommandBuffer_call(VkCommandBuffer commandBuffer, const vktrace_trace_packet_header *pHeader);
+void reset_CommandBuffer_calls(VkCommandBuffer commandBuffer);
 void remove_CommandBuffer_calls(VkCommandBuffer commandBuffer);
 
 #if TRIM_USE_ORDERED_IMAGE_CREATION
@@ -0,0 +1,107 @@
+/*
+ *
+ * Copyright (C) 2016-2024 ARM Limited
+ * All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include "vktrace_lib_trim_packetarena.h"
+
+#include <atomic>
+
+namespace trim {
+
+static std::atomic<uint64_t> s_totalReservedBytes(0);
+
+//-------------------------------------------------------------------------
+PacketArena::PacketArena() : m_nextChunkSize(kInitialChunkSize), m_reservedBytes(0), m_usedBytes(0) {}
+
+PacketArena::~PacketArena() {
+    for (auto &chunk : m_chunks) {
+        free(chunk.pData);
+    }
+    s_totalReservedBytes -= m_reservedBytes;
+}
+
+//-------------------------------------------------------------------------
+void *PacketArena::allocate(size_t size) {
+    // Keep every packet 8 byte aligned, packet bodies contain ALIGN8 members.
+    size = (size + 7) & ~static_cast<size_t>(7);
+    if (m_chunks.empty() || m_chunks.back().size - m_chunks.back().used < size) {
+        Chunk chunk;
+        chunk.size = (size > m_nextChunkSize) ? size : m_nextChunkSize;
+        chunk.used = 0;
+        chunk.pData = static_cast<char *>(malloc(chunk.size));
+        if (chunk.pData == nullptr) {
+            return nullptr;
+        }
+        m_chunks.push_back(chunk);
+        m_reservedBytes += chunk.size;
+        s_totalReservedBytes += chunk.size;
+        if (m_nextChunkSize < kMaxChunkSize) {
+            m_nextChunkSize *= 2;
+        }
+    }
+    Chunk &chunk = m_chunks.back();
+    void *pMemory = chunk.pData + chunk.used;
+    chunk.used += size;
+    m_usedBytes += size;
+    return pMemory;
+}
+
+//-------------------------------------------------------------------------
+vktrace_trace_packet_header *PacketArena::copy_packet(const vktrace_trace_packet_header *pHeader) {
+    if (pHeader == nullptr) {
+        return nullptr;
+    }
+    vktrace_trace_packet_header *pCopy = static_cast<vktrace_trace_packet_header *>(allocate((size_t)pHeader->size));
+    if (pCopy != nullptr) {
+        memcpy(pCopy, pHeader, (size_t)pHeader->size);
+        pCopy->pBody = (uintptr_t)(((char *)pCopy) + sizeof(vktrace_trace_packet_header));
+        m_packets.push_back(pCopy);
+    }
+    return pCopy;
+}
+
+//-------------------------------------------------------------------------
+void PacketArena::reset() {
+    m_packets.clear();
+    m_usedBytes = 0;
+    if (m_chunks.empty()) {
+        return;
+    }
+    // The command buffer is about to be recorded again, keep the largest
+    // chunk so a recording of the same size mostly fits in it.
+    size_t largest = 0;
+    for (size_t i = 1; i < m_chunks.size(); i++) {
+        if (m_chunks[i].size > m_chunks[largest].size) {
+            largest = i;
+        }
+    }
+    for (size_t i = 0; i < m_chunks.size(); i++) {
+        if (i != largest) {
+            free(m_chunks[i].pData);
+            m_reservedBytes -= m_chunks[i].size;
+            s_totalReservedBytes -= m_chunks[i].size;
+        }
+    }
+    m_chunks[0] = m_chunks[largest];
+    m_chunks.resize(1);
+    m_chunks[0].used = 0;
+}
+
+//-------------------------------------------------------------------------
+uint64_t PacketArena::get_TotalReservedBytes() { return s_totalReservedBytes; }
+
+}  // namespace trim
@@ -0,0 +1,85 @@
+/*
+ *
+ * Copyright (C) 2016-2024 ARM Limited
+ * All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#pragma once
+
+#include <memory>
+#include <vector>
+#include "vktrace_trace_packet_utils.h"
+
+namespace trim {
+
+// Bump allocator holding the packets recorded into one command buffer.
+// Packets are never freed individually, the whole arena is reset when the
+// command buffer is re-begun, so steady-state re-recording reuses the same
+// chunk instead of going through malloc/free for every vkCmd*.
+//
+// Chunks start small and double up to kMaxChunkSize, a command buffer holding
+// a handful of commands doesn't pin a full size chunk.
+class PacketArena {
+   public:
+    static const size_t kInitialChunkSize = 1024;
+    static const size_t kMaxChunkSize = 64 * 1024;
+
+    PacketArena();
+    ~PacketArena();
+
+    PacketArena(const PacketArena &) = delete;
+    PacketArena &operator=(const PacketArena &) = delete;
+
+    // Copy pHeader into the arena and return the copy, pBody is fixed up to
+    // point into the copy. The caller keeps ownership of pHeader.
+    vktrace_trace_packet_header *copy_packet(const vktrace_trace_packet_header *pHeader);
+
+    // Drop all packets but keep the largest chunk for reuse.
+    void reset();
+
+    const std::vector<vktrace_trace_packet_header *> &get_Packets() const { return m_packets; }
+    uint64_t get_ReservedBytes() const { return m_reservedBytes; }
+    uint64_t get_UsedBytes() const { return m_usedBytes; }
+
+    // Process wide statistics of all arenas.
+    static uint64_t get_TotalReservedBytes();
+
+   private:
+    struct Chunk {
+        char *pData;
+        size_t size;
+        size_t used;
+    };
+
+    void *allocate(size_t size);
+
+    size_t m_nextChunkSize;
+    std::vector<Chunk> m_chunks;
+    std::vector<vktrace_trace_packet_header *> m_packets;
+    uint64_t m_reservedBytes;
+    uint64_t m_usedBytes;
+};
+
+// Memory held by the packets of the command buffers tracked by a StateTracker.
+struct PacketMemoryFootprint {
+    uint64_t commandBufferCount;
+    uint64_t arenaCount;
+    uint64_t sharedArenaCount;
+    uint64_t packetCount;
+    uint64_t reservedBytes;
+    uint64_t usedBytes;
+};
+
+}  // namespace trim
@@ -77,25 +77,76 @@ StateTracker::StateTracker(const StateTracker &other) { *this = other; }
 StateTracker::~StateTracker() { clear(); }
 
 //-------------------------------------------------------------------------
-void StateTracker::add_CommandBuffer_call(VkCommandBuffer commandBuffer, vktrace_trace_packet_header *pHeader) {
-    if (pHeader != NULL) {
-        m_cmdBufferPackets[commandBuffer].push_back(pHeader);
+void StateTracker::add_CommandBuffer_call(VkCommandBuffer commandBuffer, const vktrace_trace_packet_header *pHeader) {
+    if (pHeader == NULL) {
+        return;
     }
+
+    std::shared_ptr<PacketArena> &arena = m_cmdBufferArenas[commandBuffer];
+    std::list<vktrace_trace_packet_header *> &packets = m_cmdBufferPackets[commandBuffer];
+    if (arena == nullptr) {
+        arena = std::make_shared<PacketArena>();
+    } else if (arena.use_count() > 1) {
+        // A trim snapshot still references these packets, move what we have
+        // into a private arena before recording more.
+        std::shared_ptr<PacketArena> privateArena = std::make_shared<PacketArena>();
+        for (auto packet = packets.begin(); packet != packets.end(); ++packet) {
+            *packet = privateArena->copy_packet(*packet);
+        }
+        arena = privateArena;
+    }
+
+    vktrace_trace_packet_header *pCopy = arena->copy_packet(pHeader);
+    if (pCopy == nullptr) {
+        vktrace_LogError("Failed to allocate trim command buffer packet, packet_id = %hu.", pHeader->packet_id);
+        return;
+    }
+    packets.push_back(pCopy);
 }
 
 //-------------------------------------------------------------------------
-void StateTracker::remove_CommandBuffer_calls(VkCommandBuffer commandBuffer) {
-    std::unordered_map<VkCommandBuffer, std::list<vktrace_trace_packet_header *>>::iterator cmdBufferMap =
-        m_cmdBufferPackets.find(commandBuffer);
-    if (cmdBufferMap != m_cmdBufferPackets.end()) {
-        for (auto packet = cmdBufferMap->second.begin(); packet != cmdBufferMap->second.end(); ++packet) {
-            vktrace_trace_packet_header *pHeader = *packet;
-            vktrace_delete_trace_packet(&pHeader);
+void StateTracker::reset_CommandBuffer_calls(VkCommandBuffer commandBuffer) {
+    m_cmdBufferPackets.erase(commandBuffer);
+
+    auto arenaIter = m_cmdBufferArenas.find(commandBuffer);
+    if (arenaIter != m_cmdBufferArenas.end()) {
+        if (arenaIter->second.use_count() == 1) {
+            // Nobody else sees these packets, keep the memory for the new
+            // recording of this command buffer.
+            arenaIter->second->reset();
+        } else {
+            m_cmdBufferArenas.erase(arenaIter);
         }
-        cmdBufferMap->second.clear();
+    }
+}
 
-        m_cmdBufferPackets.erase(commandBuffer);
+//-------------------------------------------------------------------------
+void StateTracker::remove_CommandBuffer_calls(VkCommandBuffer commandBuffer) {
+    m_cmdBufferPackets.erase(commandBuffer);
+    m_cmdBufferArenas.erase(commandBuffer);
+}
+
+//-------------------------------------------------------------------------
+PacketMemoryFootprint StateTracker::get_PacketMemoryFootprint() const {
+    PacketMemoryFootprint footprint = {};
+    footprint.commandBufferCount = m_cmdBufferPackets.size();
+    for (auto iter = m_cmdBufferPackets.cbegin(); iter != m_cmdBufferPackets.cend(); ++iter) {
+        footprint.packetCount += iter->second.size();
+    }
+    std::unordered_set<const PacketArena *> countedArenas;
+    for (auto iter = m_cmdBufferArenas.cbegin(); iter != m_cmdBufferArenas.cend(); ++iter) {
+        const PacketArena *pArena = iter->second.get();
+        if (pArena == nullptr || !countedArenas.insert(pArena).second) {
+            continue;
+        }
+        footprint.arenaCount++;
+        if (iter->second.use_count() > 1) {
+            footprint.sharedArenaCount++;
+        }
+        footprint.reservedBytes += pArena->get_ReservedBytes();
+        footprint.usedBytes += pArena->get_UsedBytes();
     }
+    return footprint;
 }
 
 void StateTracker::AddMemBufferBinding(VkDeviceMemory mem, VkBuffer buf) {
@@ -270,15 +321,8 @@ void StateTracker::clear() {
     }
     WriteMicromapsProperties.clear();
 
-    for (auto iter = m_cmdBufferPackets.begin(); iter != m_cmdBufferPackets.end(); ++iter) {
-        std::list<vktrace_trace_packet_header *> &packets = iter->second;
-        for (auto packetIter = iter->second.begin(); packetIter != iter->second.end(); ++packetIter) {
-            vktrace_trace_packet_header *pHeader = *packetIter;
-            vktrace_delete_trace_packet(&pHeader);
-        }
-        packets.clear();
-    }
     m_cmdBufferPackets.clear();
+    m_cmdBufferArenas.clear();
 
     for (auto packet = m_image_calls.begin(); packet != m_image_calls.end(); ++packet) {
         vktrace_trace_packet_header *pHeader = *packet;
@@ -568,13 +612,10 @@ StateTracker &StateTracker::operator=(const StateTracker &other) {
         }
     }
 
-    for (auto iter = other.m_cmdBufferPackets.cbegin(); iter != other.m_cmdBufferPackets.cend(); ++iter) {
-        std::list<vktrace_trace_packet_header *> packets;
-        for (auto packetIter = iter->second.cbegin(); packetIter != iter->second.cend(); ++packetIter) {
-            packets.push_back(copy_packet(*packetIter));
-        }
-        m_cmdBufferPackets[iter->first] = packets;
-    }
+    // The copy only reads the recorded packets and writes them out, share the
+    // arenas instead of duplicating every packet.
+    m_cmdBufferPackets = other.m_cmdBufferPackets;
+    m_cmdBufferArenas = other.m_cmdBufferArenas;
 
     for (auto packet = other.m_image_calls.cbegin(); packet != other.m_image_calls.cend(); ++packet) {
         m_image_calls.push_back(copy_packet(*packet));
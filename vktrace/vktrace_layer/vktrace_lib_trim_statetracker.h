@@ -21,6 +21,7 @@
 #include <vector>
 #include <set>
 #include "vktrace_trace_packet_utils.h"
+#include "vktrace_lib_trim_packetarena.h"
 
 // Create / Destroy all image resources in the order performed by the
 // application.
@@ -458,8 +459,16 @@ class StateTracker {
     void AddBufferTransition(VkCommandBuffer commandBuffer, BufferTransition transition);
     void ClearBufferTransitions(VkCommandBuffer commandBuffer);
 
-    void add_CommandBuffer_call(VkCommandBuffer commandBuffer, vktrace_trace_packet_header *pHeader);
+    // pHeader is copied into the command buffer's packet arena, the caller
+    // keeps ownership of pHeader.
+    void add_CommandBuffer_call(VkCommandBuffer commandBuffer, const vktrace_trace_packet_header *pHeader);
+    // Drop the packets of a command buffer which is about to be recorded
+    // again, its arena is kept for the new recording.
+    void reset_CommandBuffer_calls(VkCommandBuffer commandBuffer);
+    // Drop the packets and the arena of a command buffer, the arena is freed
+    // when no other state tracker still references it.
     void remove_CommandBuffer_calls(VkCommandBuffer commandBuffer);
+    PacketMemoryFootprint get_PacketMemoryFootprint() const;
 
     void add_RenderPassCreateInfo(VkRenderPass renderPass, const VkApplicationInfo *pCreateInfo);
     VkApplicationInfo *get_RenderPassCreateInfo(VkRenderPass renderPass, uint32_t version);
@@ -622,8 +631,15 @@ class StateTracker {
 
     // Map relating a command buffer object to all the calls that have been
     // made on that command buffer since it was started or last reset.
+    // The packets themselves live in m_cmdBufferArenas, they must not be
+    // deleted one by one.
     std::unordered_map<VkCommandBuffer, std::list<vktrace_trace_packet_header *>> m_cmdBufferPackets;
 
+    // Arena owning the packets in m_cmdBufferPackets. A copied state tracker
+    // shares the arenas of the original instead of copying every packet, the
+    // original moves to a private arena before recording into a shared one.
+    std::unordered_map<VkCommandBuffer, std::shared_ptr<PacketArena>> m_cmdBufferArenas;
+
     // Map to keep track of older RenderPass versions so that we can recreate
     // pipelines.
     std::unordered_map<VkRenderPass, std::vector<VkApplicationInfo *>> m_renderPassVersions;
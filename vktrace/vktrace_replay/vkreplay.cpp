@@ -83,6 +83,17 @@ static vkreplayer_settings s_defaultVkReplaySettings = {
                                                             .fDevBuild2HostBuild = FALSE,
                                                             .useTraceSurfaceTransformFlagBit = FALSE,
                                                             .insertDeviceExtension = NULL,
+                                                            .asyncPipelineThreads = 0,
+                                                            .memoryPoolThreshold = 0,
+                                                            .checkpointFrames = NULL,
+                                                            .checkpointFile = NULL,
+                                                            .prewarmPipelineThreads = 0,
+                                                            .preloadMemoryBudget = 0,
+                                                            .parallelRecordingThreads = 0,
+                                                            .gpuTimestamps = FALSE,
+                                                            .memoryStatsInterval = 0,
+                                                            .noPresent = FALSE,
+                                                            .enableVscAlias = FALSE,
 };
 
 vkReplay* g_pReplayer = NULL;
@@ -197,9 +208,17 @@ vktrace_trace_packet_header* VKTRACER_CDECL VkReplayInterpret(vktrace_trace_pack
 vktrace_replay::VKTRACE_REPLAY_RESULT VKTRACER_CDECL VkReplayReplay(vktrace_trace_packet_header* pPacket) {
     vktrace_replay::VKTRACE_REPLAY_RESULT result = vktrace_replay::VKTRACE_REPLAY_ERROR;
     if (g_pReplayer != NULL) {
+        if (g_pReplayer->record_in_parallel(pPacket)) {
+            // Recorded on a worker thread.
+            return vktrace_replay::VKTRACE_REPLAY_SUCCESS;
+        }
+        // The packets recorded in parallel are done, report them before
+        // replaying this one so the validation messages stay apart.
+        vktrace_replay::VKTRACE_REPLAY_RESULT parallelResult = g_pReplayer->pop_parallel_recording_result();
         result = g_pReplayer->replay(pPacket);
 
         if (result == vktrace_replay::VKTRACE_REPLAY_SUCCESS) result = g_pReplayer->pop_validation_msgs();
+        if (result == vktrace_replay::VKTRACE_REPLAY_SUCCESS) result = parallelResult;
     }
     return result;
 }
@@ -0,0 +1,285 @@
+/*
+ *
+ * Copyright (C) 2016-2024 ARM Limited
+ * All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+extern "C" {
+#include "vktrace_trace_packet_utils.h"
+}
+
+#include <algorithm>
+#include <atomic>
+
+#include "vkreplay_asyncpipeline.h"
+
+// Candidates offered to LookAhead(), the others are created when reached.
+static const size_t kMaxCandidates = 256;
+// Destroys kept before the ones already replayed are pruned.
+static const size_t kMaxDestroys = 4096;
+
+static std::atomic<uint64_t> s_compileTime(0);
+static std::atomic<uint64_t> s_waitTime(0);
+static std::atomic<uint64_t> s_pipelineCount(0);
+static std::atomic<uint64_t> s_earlyCount(0);
+static std::atomic<uint64_t> s_failureCount(0);
+
+uint64_t get_async_pipeline_compile_time() { return s_compileTime; }
+
+uint64_t get_async_pipeline_wait_time() { return s_waitTime; }
+
+uint64_t get_async_pipeline_count() { return s_pipelineCount; }
+
+uint64_t get_async_pipeline_early_count() { return s_earlyCount; }
+
+uint64_t get_async_pipeline_failure_count() { return s_failureCount; }
+
+namespace vktrace_replay {
+
+AsyncPipelineCompiler::AsyncPipelineCompiler(uint32_t threadCount) : m_runningCount(0), m_hasPending(false), m_exiting(false) {
+    for (uint32_t i = 0; i < threadCount; i++) {
+        m_workers.emplace_back(&AsyncPipelineCompiler::WorkerThread, this);
+    }
+}
+
+AsyncPipelineCompiler::~AsyncPipelineCompiler() {
+    WaitIdle();
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_exiting = true;
+    }
+    m_queueCondition.notify_all();
+    for (auto &worker : m_workers) {
+        worker.join();
+    }
+}
+
+void AsyncPipelineCompiler::WorkerThread() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (true) {
+        m_queueCondition.wait(lock, [this] { return m_exiting || !m_queue.empty() || !m_earlyQueue.empty(); });
+        JobPtr job;
+        if (!m_queue.empty()) {
+            job = m_queue.front();
+            m_queue.pop_front();
+        } else if (!m_earlyQueue.empty()) {
+            job = m_earlyQueue.front();
+            m_earlyQueue.pop_front();
+        } else {
+            break;
+        }
+        m_runningCount++;
+        lock.unlock();
+
+        uint64_t startTime = vktrace_get_time();
+        job->result = job->create(job->replayPipelines.data());
+        s_compileTime += vktrace_get_time() - startTime;
+        s_pipelineCount += job->replayPipelines.size();
+        if (job->result != VK_SUCCESS) {
+            s_failureCount++;
+        }
+        // The create infos belong to the packet, don't keep anything around.
+        job->create = nullptr;
+
+        lock.lock();
+        job->done = true;
+        m_runningCount--;
+        m_doneCondition.notify_all();
+    }
+}
+
+void AsyncPipelineCompiler::Submit(uint64_t packetIndex, bool early, const char *entrypointName, VkDevice device,
+                                   uint32_t pipelineCount, const VkPipeline *pTracePipelines, CreateFunc create) {
+    JobPtr job = std::make_shared<Job>();
+    job->packetIndex = packetIndex;
+    job->entrypointName = entrypointName;
+    job->device = device;
+    job->tracePipelines.assign(pTracePipelines, pTracePipelines + pipelineCount);
+    job->replayPipelines.resize(pipelineCount, VK_NULL_HANDLE);
+    job->create = create;
+    job->result = VK_NOT_READY;
+    job->done = false;
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (early) {
+            m_earlyQueue.push_back(job);
+            m_earlyJobs[packetIndex] = job;
+            s_earlyCount++;
+        } else {
+            m_queue.push_back(job);
+            m_pending.push_back(job);
+            for (auto tracePipeline : job->tracePipelines) {
+                m_pendingPipelines[tracePipeline] = job;
+            }
+            m_hasPending = true;
+        }
+    }
+    m_queueCondition.notify_one();
+}
+
+bool AsyncPipelineCompiler::Claim(uint64_t packetIndex) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_earlyJobs.find(packetIndex);
+    if (it == m_earlyJobs.end()) {
+        return false;
+    }
+    JobPtr job = it->second;
+    m_earlyJobs.erase(it);
+    // The replay has caught up with the job, it now goes before the other early ones.
+    auto queued = std::find(m_earlyQueue.begin(), m_earlyQueue.end(), job);
+    if (queued != m_earlyQueue.end()) {
+        m_earlyQueue.erase(queued);
+        m_queue.push_back(job);
+    }
+    m_pending.push_back(job);
+    for (auto tracePipeline : job->tracePipelines) {
+        m_pendingPipelines[tracePipeline] = job;
+    }
+    m_hasPending = true;
+    return true;
+}
+
+AsyncPipelineCompiler::JobPtr AsyncPipelineCompiler::Take(VkPipeline tracePipeline) {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    auto it = m_pendingPipelines.find(tracePipeline);
+    if (it == m_pendingPipelines.end()) {
+        return nullptr;
+    }
+    JobPtr job = it->second;
+    if (!job->done) {
+        uint64_t startTime = vktrace_get_time();
+        m_doneCondition.wait(lock, [&job] { return job->done; });
+        s_waitTime += vktrace_get_time() - startTime;
+    }
+    for (auto pipeline : job->tracePipelines) {
+        m_pendingPipelines.erase(pipeline);
+    }
+    m_pending.erase(std::find(m_pending.begin(), m_pending.end(), job));
+    m_hasPending = !m_pending.empty();
+    return job;
+}
+
+std::vector<AsyncPipelineCompiler::JobPtr> AsyncPipelineCompiler::TakeAll() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    uint64_t startTime = vktrace_get_time();
+    m_doneCondition.wait(lock, [this] {
+        return std::all_of(m_pending.begin(), m_pending.end(), [](const JobPtr &job) { return job->done; });
+    });
+    s_waitTime += vktrace_get_time() - startTime;
+
+    std::vector<JobPtr> jobs;
+    jobs.swap(m_pending);
+    m_pendingPipelines.clear();
+    m_hasPending = false;
+    return jobs;
+}
+
+std::vector<AsyncPipelineCompiler::JobPtr> AsyncPipelineCompiler::TakeUnclaimed(VkDevice device) {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    std::vector<JobPtr> jobs;
+    for (auto it = m_earlyJobs.begin(); it != m_earlyJobs.end();) {
+        if (device == VK_NULL_HANDLE || it->second->device == device) {
+            jobs.push_back(it->second);
+            it = m_earlyJobs.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    m_doneCondition.wait(lock, [&jobs] { return std::all_of(jobs.begin(), jobs.end(), [](const JobPtr &job) { return job->done; }); });
+    return jobs;
+}
+
+void AsyncPipelineCompiler::WaitIdle() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_doneCondition.wait(lock, [this] { return m_queue.empty() && m_earlyQueue.empty() && m_runningCount == 0; });
+}
+
+void AsyncPipelineCompiler::AddCandidate(Candidate &&candidate) {
+    std::lock_guard<std::mutex> lock(m_lookAheadMutex);
+    if (m_candidates.size() < kMaxCandidates) {
+        m_candidates.push_back(std::move(candidate));
+    }
+}
+
+void AsyncPipelineCompiler::AddDestroy(uint64_t packetIndex, uint64_t handle) {
+    std::lock_guard<std::mutex> lock(m_lookAheadMutex);
+    m_destroys[handle].push_back(packetIndex);
+}
+
+bool AsyncPipelineCompiler::DestroyedBefore(uint64_t currentIndex, const Candidate &candidate) {
+    for (const auto &dependency : candidate.dependencies) {
+        auto it = m_destroys.find(dependency.handle);
+        if (it == m_destroys.end()) {
+            continue;
+        }
+        auto &indices = it->second;
+        indices.erase(indices.begin(), std::upper_bound(indices.begin(), indices.end(), currentIndex));
+        if (indices.empty()) {
+            m_destroys.erase(it);
+        } else if (indices.front() < candidate.packetIndex) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void AsyncPipelineCompiler::LookAhead(uint64_t currentIndex, const std::function<bool(const Candidate &candidate)> &submit) {
+    std::vector<Candidate> candidates;
+    {
+        std::lock_guard<std::mutex> lock(m_lookAheadMutex);
+        // The packets of the candidates already reached may be gone, only
+        // their index is looked at.
+        while (!m_candidates.empty() && m_candidates.front().packetIndex <= currentIndex) {
+            m_candidates.pop_front();
+        }
+        if (m_destroys.size() > kMaxDestroys) {
+            for (auto it = m_destroys.begin(); it != m_destroys.end();) {
+                if (it->second.back() <= currentIndex) {
+                    it = m_destroys.erase(it);
+                } else {
+                    ++it;
+                }
+            }
+        }
+        for (auto it = m_candidates.begin(); it != m_candidates.end();) {
+            if (DestroyedBefore(currentIndex, *it)) {
+                ++it;
+            } else {
+                candidates.push_back(std::move(*it));
+                it = m_candidates.erase(it);
+            }
+        }
+    }
+
+    // Candidates which are not ready yet go back in order.
+    std::vector<Candidate> notReady;
+    for (auto &candidate : candidates) {
+        if (!submit(candidate)) {
+            notReady.push_back(std::move(candidate));
+        }
+    }
+    if (!notReady.empty()) {
+        std::lock_guard<std::mutex> lock(m_lookAheadMutex);
+        for (auto &candidate : notReady) {
+            auto it = std::lower_bound(m_candidates.begin(), m_candidates.end(), candidate.packetIndex,
+                                       [](const Candidate &c, uint64_t packetIndex) { return c.packetIndex < packetIndex; });
+            m_candidates.insert(it, std::move(candidate));
+        }
+    }
+}
+
+}  // namespace vktrace_replay
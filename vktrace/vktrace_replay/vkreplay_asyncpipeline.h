@@ -0,0 +1,154 @@
+/*
+ *
+ * Copyright (C) 2016-2024 ARM Limited
+ * All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "vulkan/vulkan.h"
+#include "vktrace_trace_packet_identifiers.h"
+
+namespace vktrace_replay {
+
+// Creates pipelines on worker threads so that vkCreateGraphicsPipelines() and
+// vkCreateComputePipelines() in the middle of a frame range don't stall the
+// replay thread. Every job creates the pipelines of one vkCreate*Pipelines
+// call. The replay thread keeps going and only waits for a job when one of its
+// pipelines is looked up (see vkReplay::resolve_async_pipeline()).
+//
+// The preload thread also reports the pipeline creations it loads ahead of the
+// replay as candidates. The replay thread submits a candidate early once the
+// objects it references have been created and none of them is destroyed before
+// the candidate is reached (see LookAhead()). An early job is only handed over
+// when the replay reaches its packet (see Claim()), as its trace handles may
+// still name other live pipelines until then.
+//
+// The create infos of a job point into the packet memory, the caller must keep
+// that memory alive until the job is done (see WaitIdle()).
+class AsyncPipelineCompiler {
+   public:
+    typedef std::function<VkResult(VkPipeline *pPipelines)> CreateFunc;
+
+    struct Job {
+        uint64_t packetIndex;
+        const char *entrypointName;
+        VkDevice device;
+        std::vector<VkPipeline> tracePipelines;
+        std::vector<VkPipeline> replayPipelines;
+        CreateFunc create;
+        VkResult result;
+        bool done;
+    };
+    typedef std::shared_ptr<Job> JobPtr;
+
+    struct Dependency {
+        VkObjectType type;
+        uint64_t handle;
+    };
+
+    struct Candidate {
+        uint64_t packetIndex;
+        vktrace_trace_packet_header *pHeader;
+        std::vector<Dependency> dependencies;
+    };
+
+    explicit AsyncPipelineCompiler(uint32_t threadCount);
+    ~AsyncPipelineCompiler();
+
+    AsyncPipelineCompiler(const AsyncPipelineCompiler &) = delete;
+    AsyncPipelineCompiler &operator=(const AsyncPipelineCompiler &) = delete;
+
+    // Queue the creation of pipelineCount pipelines, pTracePipelines are the
+    // handles recorded in the trace. An early job is held back until its
+    // packet is claimed and runs after the jobs of the packets already reached.
+    void Submit(uint64_t packetIndex, bool early, const char *entrypointName, VkDevice device, uint32_t pipelineCount,
+                const VkPipeline *pTracePipelines, CreateFunc create);
+
+    bool HasPending() const { return m_hasPending; }
+
+    // Hand the early job of the packet over to Take()/TakeAll(). Returns false
+    // if the packet was not submitted early.
+    bool Claim(uint64_t packetIndex);
+
+    // Wait for the early jobs which have not been claimed and hand them over,
+    // for the caller to destroy their pipelines.
+    std::vector<JobPtr> TakeUnclaimed(VkDevice device);
+
+    // Preload thread: record a pipeline creation loaded ahead of the replay,
+    // and the destruction of an object a candidate may reference.
+    void AddCandidate(Candidate &&candidate);
+    void AddDestroy(uint64_t packetIndex, uint64_t handle);
+
+    // Replay thread: call submit for the candidates after currentIndex, in
+    // order, whose dependencies are not destroyed before they are reached.
+    // submit returns false if the candidate is not ready yet, it is then
+    // offered again by a later call.
+    void LookAhead(uint64_t currentIndex, const std::function<bool(const Candidate &candidate)> &submit);
+
+    // Wait for the job which creates tracePipeline and hand it over to the
+    // caller. Returns nullptr if no queued job creates tracePipeline.
+    JobPtr Take(VkPipeline tracePipeline);
+
+    // Wait for all queued jobs and hand them over in submission order.
+    std::vector<JobPtr> TakeAll();
+
+    // Wait until every queued job is done without handing them over. This can
+    // be called from any thread.
+    void WaitIdle();
+
+   private:
+    void WorkerThread();
+
+    bool DestroyedBefore(uint64_t currentIndex, const Candidate &candidate);
+
+    std::vector<std::thread> m_workers;
+    std::mutex m_mutex;
+    std::condition_variable m_queueCondition;
+    std::condition_variable m_doneCondition;
+    std::deque<JobPtr> m_queue;
+    std::deque<JobPtr> m_earlyQueue;
+    std::vector<JobPtr> m_pending;
+    std::unordered_map<VkPipeline, JobPtr> m_pendingPipelines;
+    std::unordered_map<uint64_t, JobPtr> m_earlyJobs;
+    uint32_t m_runningCount;
+    std::atomic<bool> m_hasPending;
+    bool m_exiting;
+
+    std::mutex m_lookAheadMutex;
+    std::deque<Candidate> m_candidates;
+    // Packet indices of the destructions of each handle, in order.
+    std::unordered_map<uint64_t, std::vector<uint64_t>> m_destroys;
+};
+
+}  // namespace vktrace_replay
+
+// Statistics reported in the result json.
+uint64_t get_async_pipeline_compile_time();
+uint64_t get_async_pipeline_wait_time();
+uint64_t get_async_pipeline_count();
+uint64_t get_async_pipeline_early_count();
+uint64_t get_async_pipeline_failure_count();
@@ -0,0 +1,350 @@
+/*
+ *
+ * Copyright (C) 2016-2024 ARM Limited
+ * All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+extern "C" {
+#include "vktrace_trace_packet_utils.h"
+}
+
+#include <algorithm>
+
+#include "vkreplay_gputimestamps.h"
+#include "vkreplay_vkreplay.h"
+#include "vk_enum_string_helper.h"
+
+// Number of submissions of a queue family which can be in flight before the
+// replay thread waits for the oldest one.
+#define GPU_TIMESTAMP_SLOT_COUNT 256
+
+struct gpu_submit_time {
+    uint32_t frame;
+    VkDevice device;
+    uint64_t begin;  // timestamps
+    uint64_t end;
+    uint64_t timestampMask;
+    float timestampPeriod;
+    bool resolved;
+};
+
+static std::vector<gpu_submit_time> s_submits;
+
+static uint64_t ticks_to_ns(uint64_t ticks, float timestampPeriod) { return uint64_t(double(ticks) * timestampPeriod); }
+
+// Ticks from base to timestamp, negative if timestamp is earlier. The
+// timestamps wrap around at timestampMask.
+static int64_t ticks_since(uint64_t timestamp, uint64_t base, uint64_t timestampMask) {
+    uint64_t ticks = (timestamp - base) & timestampMask;
+    if (ticks > timestampMask / 2) {
+        return -int64_t((base - timestamp) & timestampMask);
+    }
+    return int64_t(ticks);
+}
+
+// GPU time of the submissions of a frame. The queues of a device share its
+// timestamp domain, the time during which submissions overlap, on the same
+// queue or not, is counted once.
+static uint64_t frame_time(const std::vector<const gpu_submit_time *> &submits) {
+    uint64_t time = 0;
+    std::vector<bool> counted(submits.size(), false);
+    for (size_t i = 0; i < submits.size(); i++) {
+        if (counted[i]) {
+            continue;
+        }
+        // The queue families may have different valid bits, compare the bits they share.
+        VkDevice device = submits[i]->device;
+        uint64_t timestampMask = UINT64_MAX;
+        for (size_t j = i; j < submits.size(); j++) {
+            if (submits[j]->device == device) {
+                timestampMask &= submits[j]->timestampMask;
+            }
+        }
+        std::vector<std::pair<int64_t, int64_t>> intervals;
+        for (size_t j = i; j < submits.size(); j++) {
+            if (submits[j]->device == device) {
+                counted[j] = true;
+                int64_t begin = ticks_since(submits[j]->begin, submits[i]->begin, timestampMask);
+                intervals.emplace_back(begin, begin + int64_t((submits[j]->end - submits[j]->begin) & timestampMask));
+            }
+        }
+        std::sort(intervals.begin(), intervals.end());
+        uint64_t busy = 0;
+        int64_t end = INT64_MIN;
+        for (const auto &interval : intervals) {
+            int64_t begin = std::max(interval.first, end);
+            if (interval.second > begin) {
+                busy += interval.second - begin;
+                end = interval.second;
+            }
+        }
+        time += ticks_to_ns(busy, submits[i]->timestampPeriod);
+    }
+    return time;
+}
+
+std::vector<GpuFrameTime> get_gpu_frame_times() {
+    std::vector<GpuFrameTime> frames;
+    std::vector<const gpu_submit_time *> frameSubmits;
+    for (const auto &submit : s_submits) {
+        if (!submit.resolved) {
+            continue;
+        }
+        // The frame numbers start over in every loop, consecutive submissions
+        // of the same frame number belong to the same frame.
+        if (frames.empty() || frames.back().frame != submit.frame) {
+            if (!frames.empty()) {
+                frames.back().time = frame_time(frameSubmits);
+            }
+            frames.push_back({submit.frame, 0, {}});
+            frameSubmits.clear();
+        }
+        frames.back().submits.push_back(ticks_to_ns((submit.end - submit.begin) & submit.timestampMask, submit.timestampPeriod));
+        frameSubmits.push_back(&submit);
+    }
+    if (!frames.empty()) {
+        frames.back().time = frame_time(frameSubmits);
+    }
+    return frames;
+}
+
+uint64_t get_gpu_timestamp_submit_count() { return s_submits.size(); }
+
+namespace vktrace_replay {
+
+GpuTimestamps::GpuTimestamps(const VkLayerDispatchTable *pTable) : m_pTable(pTable) {}
+
+GpuTimestamps::~GpuTimestamps() {
+    // The devices are destroyed by now, their objects went with them.
+    m_queues.clear();
+    m_rings.clear();
+}
+
+void GpuTimestamps::AddQueue(VkDevice device, VkQueue queue, uint32_t queueFamilyIndex, uint32_t timestampValidBits,
+                             float timestampPeriod) {
+    Ring *ring = nullptr;
+    if (timestampValidBits > 0) {
+        for (auto &it : m_rings) {
+            if (it->device == device && it->queueFamilyIndex == queueFamilyIndex) {
+                ring = it.get();
+                break;
+            }
+        }
+        if (ring == nullptr) {
+            ring = CreateRing(device, queueFamilyIndex, timestampValidBits, timestampPeriod);
+        }
+    }
+    m_queues[queue] = std::make_pair(device, ring);
+}
+
+GpuTimestamps::Ring *GpuTimestamps::CreateRing(VkDevice device, uint32_t queueFamilyIndex, uint32_t timestampValidBits,
+                                               float timestampPeriod) {
+    std::unique_ptr<Ring> ring(new Ring());
+    ring->device = device;
+    ring->queueFamilyIndex = queueFamilyIndex;
+    ring->timestampMask = timestampValidBits >= 64 ? UINT64_MAX : (uint64_t(1) << timestampValidBits) - 1;
+    ring->timestampPeriod = timestampPeriod;
+    ring->queryPool = VK_NULL_HANDLE;
+    ring->commandPool = VK_NULL_HANDLE;
+    ring->nextSlot = 0;
+
+    VkQueryPoolCreateInfo queryPoolCreateInfo = {};
+    queryPoolCreateInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    queryPoolCreateInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    queryPoolCreateInfo.queryCount = GPU_TIMESTAMP_SLOT_COUNT * 2;
+    VkResult result = m_pTable->CreateQueryPool(device, &queryPoolCreateInfo, NULL, &ring->queryPool);
+    if (result == VK_SUCCESS) {
+        VkCommandPoolCreateInfo commandPoolCreateInfo = {};
+        commandPoolCreateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        commandPoolCreateInfo.queueFamilyIndex = queueFamilyIndex;
+        result = m_pTable->CreateCommandPool(device, &commandPoolCreateInfo, NULL, &ring->commandPool);
+    }
+    VkFenceCreateInfo fenceCreateInfo = {};
+    fenceCreateInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+    for (uint32_t slot = 0; slot < GPU_TIMESTAMP_SLOT_COUNT && result == VK_SUCCESS; slot++) {
+        VkFence fence = VK_NULL_HANDLE;
+        result = m_pTable->CreateFence(device, &fenceCreateInfo, NULL, &fence);
+        if (result == VK_SUCCESS) {
+            ring->fences.push_back(fence);
+        }
+    }
+    if (result == VK_SUCCESS) {
+        ring->commandBuffers.resize(GPU_TIMESTAMP_SLOT_COUNT * 2);
+        VkCommandBufferAllocateInfo allocateInfo = {};
+        allocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocateInfo.commandPool = ring->commandPool;
+        allocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocateInfo.commandBufferCount = GPU_TIMESTAMP_SLOT_COUNT * 2;
+        result = m_pTable->AllocateCommandBuffers(device, &allocateInfo, ring->commandBuffers.data());
+        if (result != VK_SUCCESS) {
+            ring->commandBuffers.clear();
+        }
+    }
+    VkCommandBufferBeginInfo beginInfo = {};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    for (uint32_t slot = 0; slot < GPU_TIMESTAMP_SLOT_COUNT && result == VK_SUCCESS; slot++) {
+        // The queries are reset on the queue, a slot is only reused once its
+        // fence is signaled and its results have been read. The begin
+        // timestamp is written once the semaphore waits and the previous
+        // commands of the queue are done, a top of pipe one would count them.
+        VkCommandBuffer begin = ring->commandBuffers[slot * 2];
+        VkCommandBuffer end = ring->commandBuffers[slot * 2 + 1];
+        result = m_pTable->BeginCommandBuffer(begin, &beginInfo);
+        if (result == VK_SUCCESS) {
+            m_pTable->CmdResetQueryPool(begin, ring->queryPool, slot * 2, 2);
+            m_pTable->CmdWriteTimestamp(begin, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, ring->queryPool, slot * 2);
+            result = m_pTable->EndCommandBuffer(begin);
+        }
+        if (result == VK_SUCCESS) {
+            result = m_pTable->BeginCommandBuffer(end, &beginInfo);
+        }
+        if (result == VK_SUCCESS) {
+            m_pTable->CmdWriteTimestamp(end, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, ring->queryPool, slot * 2 + 1);
+            result = m_pTable->EndCommandBuffer(end);
+        }
+    }
+    if (result != VK_SUCCESS) {
+        vktrace_LogWarning("Failed to create the timestamp queries of queue family %u: %s, its submissions will not be measured.",
+                           queueFamilyIndex, string_VkResult(result));
+        DestroyRing(ring.get());
+        return nullptr;
+    }
+    m_rings.push_back(std::move(ring));
+    return m_rings.back().get();
+}
+
+void GpuTimestamps::DestroyRing(Ring *ring) {
+    if (ring->commandPool != VK_NULL_HANDLE) {
+        m_pTable->DestroyCommandPool(ring->device, ring->commandPool, NULL);
+    }
+    for (VkFence fence : ring->fences) {
+        m_pTable->DestroyFence(ring->device, fence, NULL);
+    }
+    if (ring->queryPool != VK_NULL_HANDLE) {
+        m_pTable->DestroyQueryPool(ring->device, ring->queryPool, NULL);
+    }
+}
+
+bool GpuTimestamps::BeginSubmit(VkQueue queue, uint32_t frame, VkCommandBuffer *pBegin, VkCommandBuffer *pEnd, VkFence *pFence) {
+    auto it = m_queues.find(queue);
+    if (it == m_queues.end() || it->second.second == nullptr) {
+        return false;
+    }
+    Ring *ring = it->second.second;
+    if (ring->pending.size() == GPU_TIMESTAMP_SLOT_COUNT) {
+        // The oldest submission holds the next slot.
+        ReadSlot(ring, true);
+    }
+    uint32_t slot = ring->nextSlot;
+    ring->nextSlot = (slot + 1) % GPU_TIMESTAMP_SLOT_COUNT;
+    ring->pending.push_back({slot, s_submits.size(), true});
+    s_submits.push_back({frame, ring->device, 0, 0, ring->timestampMask, ring->timestampPeriod, false});
+    *pBegin = ring->commandBuffers[slot * 2];
+    *pEnd = ring->commandBuffers[slot * 2 + 1];
+    *pFence = ring->fences[slot];
+    return true;
+}
+
+void GpuTimestamps::CancelSubmit(VkQueue queue) {
+    Ring *ring = m_queues.at(queue).second;
+    ring->nextSlot = ring->pending.back().slot;
+    ring->pending.pop_back();
+    s_submits.pop_back();
+}
+
+void GpuTimestamps::SubmitFence(VkQueue queue) {
+    Ring *ring = m_queues.at(queue).second;
+    PendingSlot &pending = ring->pending.back();
+    // Signaled once the work previously submitted to the queue is done.
+    VkResult result = m_pTable->QueueSubmit(queue, 0, NULL, ring->fences[pending.slot]);
+    if (result != VK_SUCCESS) {
+        vktrace_LogWarning("Failed to submit the fence of a measured submission: %s, waiting for the queue.", string_VkResult(result));
+        m_pTable->QueueWaitIdle(queue);
+        pending.fenced = false;
+    }
+}
+
+bool GpuTimestamps::ReadSlot(Ring *ring, bool wait) {
+    const PendingSlot &pending = ring->pending.front();
+    VkFence fence = ring->fences[pending.slot];
+    VkResult result = VK_SUCCESS;
+    if (pending.fenced) {
+        // The command buffers of the slot may still be executing until the fence is signaled.
+        result = wait ? m_pTable->WaitForFences(ring->device, 1, &fence, VK_TRUE, UINT64_MAX)
+                      : m_pTable->GetFenceStatus(ring->device, fence);
+        if (result == VK_NOT_READY) {
+            return false;
+        }
+    }
+    // Each timestamp is followed by its availability.
+    uint64_t data[4] = {};
+    if (result == VK_SUCCESS) {
+        result = m_pTable->GetQueryPoolResults(ring->device, ring->queryPool, pending.slot * 2, 2, sizeof(data), data,
+                                               sizeof(uint64_t) * 2, VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+        if (pending.fenced) {
+            m_pTable->ResetFences(ring->device, 1, &fence);
+        }
+    }
+    if (result == VK_SUCCESS && data[1] != 0 && data[3] != 0) {
+        gpu_submit_time &submit = s_submits[pending.submitIndex];
+        submit.begin = data[0];
+        submit.end = data[2];
+        submit.resolved = true;
+    } else {
+        // The submission is lost (device lost or never executed), free its slot.
+        vktrace_LogWarning("Failed to read the timestamps of a submission: %s.", string_VkResult(result));
+    }
+    ring->pending.pop_front();
+    return true;
+}
+
+void GpuTimestamps::Poll() {
+    for (auto &ring : m_rings) {
+        while (!ring->pending.empty() && ReadSlot(ring.get(), false)) {
+        }
+    }
+}
+
+void GpuTimestamps::Resolve(VkDevice device) {
+    for (auto &ring : m_rings) {
+        if (ring->device == device) {
+            while (!ring->pending.empty()) {
+                ReadSlot(ring.get(), true);
+            }
+        }
+    }
+}
+
+void GpuTimestamps::RemoveDevice(VkDevice device) {
+    Resolve(device);
+    for (auto it = m_queues.begin(); it != m_queues.end();) {
+        if (it->second.first == device) {
+            it = m_queues.erase(it);
+        } else {
+            it++;
+        }
+    }
+    for (auto it = m_rings.begin(); it != m_rings.end();) {
+        if ((*it)->device == device) {
+            DestroyRing(it->get());
+            it = m_rings.erase(it);
+        } else {
+            it++;
+        }
+    }
+}
+
+}  // namespace vktrace_replay
@@ -0,0 +1,117 @@
+/*
+ *
+ * Copyright (C) 2016-2024 ARM Limited
+ * All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#pragma once
+
+#include <deque>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "vulkan/vulkan.h"
+
+typedef struct VkLayerDispatchTable_ VkLayerDispatchTable;
+
+namespace vktrace_replay {
+
+// Measures the GPU time of the replayed queue submissions with timestamp
+// queries. A command buffer writing an all commands timestamp is submitted
+// before the command buffers of the trace, and one writing a bottom of pipe
+// timestamp after them (see vkReplay::submit_remapped()). The begin timestamp
+// waits for the semaphore waits of the first batch and for the previous work
+// of the queue, neither is counted; the waits of the later batches are.
+//
+// The command buffers are recorded once per queue family, each slot of the
+// ring has its own pair of queries and a fence signaled when the submission
+// completes. A slot is only reused once its fence is signaled. The results
+// are read without waiting after the following submissions, so they are
+// usually available a few frames later; the replay thread only waits when
+// the ring of the queue family is full, or in Resolve().
+class GpuTimestamps {
+   public:
+    explicit GpuTimestamps(const VkLayerDispatchTable *pTable);
+    ~GpuTimestamps();
+
+    GpuTimestamps(const GpuTimestamps &) = delete;
+    GpuTimestamps &operator=(const GpuTimestamps &) = delete;
+
+    bool HasQueue(VkQueue queue) const { return m_queues.find(queue) != m_queues.end(); }
+
+    // Add a replay queue of device. The submissions of queue families without
+    // timestamp support (timestampValidBits is 0) are not measured.
+    void AddQueue(VkDevice device, VkQueue queue, uint32_t queueFamilyIndex, uint32_t timestampValidBits, float timestampPeriod);
+
+    // Get the command buffers to submit first and last in a submission of
+    // queue during frame, and the fence to signal when it completes. Returns
+    // false if the queue can't be measured.
+    bool BeginSubmit(VkQueue queue, uint32_t frame, VkCommandBuffer *pBegin, VkCommandBuffer *pEnd, VkFence *pFence);
+    // Drop the last BeginSubmit() of queue, the submission failed.
+    void CancelSubmit(VkQueue queue);
+    // Submit the fence of the last BeginSubmit() of queue on its own, the
+    // submission had a fence of the trace.
+    void SubmitFence(VkQueue queue);
+
+    // Read the results of the finished submissions without waiting.
+    void Poll();
+    // Wait for the submissions of device and read their results.
+    void Resolve(VkDevice device);
+    // Destroy the query pools and command pools of device, the device must be idle.
+    void RemoveDevice(VkDevice device);
+
+   private:
+    struct PendingSlot {
+        uint32_t slot;
+        size_t submitIndex;
+        bool fenced;  // false if the fence could not be submitted, the queue was idled instead
+    };
+
+    struct Ring {
+        VkDevice device;
+        uint32_t queueFamilyIndex;
+        uint64_t timestampMask;
+        float timestampPeriod;
+        VkQueryPool queryPool;
+        VkCommandPool commandPool;
+        std::vector<VkCommandBuffer> commandBuffers;  // begin and end command buffer of each slot
+        std::vector<VkFence> fences;                  // fence of each slot
+        std::deque<PendingSlot> pending;              // oldest first
+        uint32_t nextSlot;
+    };
+
+    Ring *CreateRing(VkDevice device, uint32_t queueFamilyIndex, uint32_t timestampValidBits, float timestampPeriod);
+    void DestroyRing(Ring *ring);
+    bool ReadSlot(Ring *ring, bool wait);
+
+    const VkLayerDispatchTable *m_pTable;
+    std::vector<std::unique_ptr<Ring>> m_rings;
+    std::unordered_map<VkQueue, std::pair<VkDevice, Ring *>> m_queues;  // no ring if the queue is not measured
+};
+
+}  // namespace vktrace_replay
+
+struct GpuFrameTime {
+    uint32_t frame;
+    uint64_t time;                  // GPU time of the frame, the submissions which overlap are counted once, in ns
+    std::vector<uint64_t> submits;  // GPU time of each submission, in ns
+};
+
+// GPU time of the measured frames, in replay order. Submissions whose results
+// were never read are left out.
+std::vector<GpuFrameTime> get_gpu_frame_times();
+uint64_t get_gpu_timestamp_submit_count();
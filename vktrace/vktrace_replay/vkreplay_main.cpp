@@ -48,6 +48,12 @@
 #include "vkreplay_seq.h"
 #include "vkreplay_vkdisplay.h"
 #include "vkreplay_preload.h"
+#include "vkreplay_asyncpipeline.h"
+#include "vkreplay_parallelrecord.h"
+#include "vkreplay_gputimestamps.h"
+#include "vkreplay_memorypool.h"
+#include "vkreplay_memorystats.h"
+#include "vkreplay_pipelineprewarm.h"
 #include "screenshot_parsing.h"
 #include "vktrace_vk_packet_id.h"
 #include "vkreplay_vkreplay.h"
@@ -67,6 +73,12 @@ const char* env_var_screenshot_format = "VK_SCREENSHOT_FORMAT";
 const char* env_var_screenshot_prefix = "VK_SCREENSHOT_PREFIX";
 #endif
 
+#if defined(ANDROID)
+const char* env_var_instance_layers = "debug.vulkan.layers";
+#else
+const char* env_var_instance_layers = "VK_INSTANCE_LAYERS";
+#endif
+
 #if defined(ANDROID)
 static std::string outputfile = "/sdcard/vktrace_result.json";
 #else
@@ -459,7 +471,84 @@ vktrace_SettingInfo g_settings_info[] = {
      {&replaySettings.insertDeviceExtension},
      {&replaySettings.insertDeviceExtension},
      TRUE,
-     "Insert device extension."}
+     "Insert device extension."},
+    {"apt",
+     "asyncPipelineThreads",
+     VKTRACE_SETTING_UINT,
+     {&replaySettings.asyncPipelineThreads},
+     {&replaySettings.asyncPipelineThreads},
+     TRUE,
+     "Number of worker threads creating pipelines asynchronously while replaying the preloaded frame range, 0 creates them on the replay thread. Requires PreloadTraceFile. Default is 0."},
+    {"mpt",
+     "memoryPoolThreshold",
+     VKTRACE_SETTING_UINT,
+     {&replaySettings.memoryPoolThreshold},
+     {&replaySettings.memoryPoolThreshold},
+     TRUE,
+     "Place device memory allocations up to <uint> KB into shared 64 MB blocks to reduce driver allocations. 0 disables pooling. Default is 0."},
+    {"cpf",
+     "checkpointFrames",
+     VKTRACE_SETTING_STRING,
+     {&replaySettings.checkpointFrames},
+     {&replaySettings.checkpointFrames},
+     TRUE,
+     "Write a checkpoint at frame <startframe>: the replay is recaptured by the trace layer and trimmed from that frame, the checkpoint holds the object state and resource contents at <startframe> followed by the frames up to <endframe> (default: end of the trace). <string> is <startframe>[-<endframe>]."},
+    {"cpo",
+     "checkpointFile",
+     VKTRACE_SETTING_STRING,
+     {&replaySettings.checkpointFile},
+     {&replaySettings.checkpointFile},
+     TRUE,
+     "Path of the checkpoint written by -cpf. Default is <tracefile>.checkpoint-<startframe>.vktrace."},
+    {"pwt",
+     "prewarmPipelineThreads",
+     VKTRACE_SETTING_UINT,
+     {&replaySettings.prewarmPipelineThreads},
+     {&replaySettings.prewarmPipelineThreads},
+     TRUE,
+     "Number of worker threads compiling the shader modules and pipelines of the trace into a pipeline cache right after the device is created, so the replay creates them from the cache. 0 disables the pre-warm pass. Default is 0."},
+    {"pmb",
+     "preloadMemoryBudget",
+     VKTRACE_SETTING_UINT,
+     {&replaySettings.preloadMemoryBudget},
+     {&replaySettings.preloadMemoryBudget},
+     TRUE,
+     "Memory budget of the preloaded trace in MB. Packets larger than half a preload chunk are spilled to a memory mapped scratch file next to the trace file. Requires PreloadTraceFile. Default is 0, the budget is derived from the free memory."},
+    {"prt",
+     "parallelRecordingThreads",
+     VKTRACE_SETTING_UINT,
+     {&replaySettings.parallelRecordingThreads},
+     {&replaySettings.parallelRecordingThreads},
+     TRUE,
+     "Number of worker threads recording the command buffers of different command pools concurrently while replaying the preloaded frame range, 0 records them on the replay thread. Requires PreloadTraceFile. Default is 0."},
+    {"gts",
+     "gpuTimestamps",
+     VKTRACE_SETTING_BOOL,
+     {&replaySettings.gpuTimestamps},
+     {&replaySettings.gpuTimestamps},
+     TRUE,
+     "Measure the GPU time of every queue submission with timestamp queries, the per-frame and per-submit GPU time is written to vktrace_result.json. Default is FALSE."},
+    {"msi",
+     "memoryStatsInterval",
+     VKTRACE_SETTING_UINT,
+     {&replaySettings.memoryStatsInterval},
+     {&replaySettings.memoryStatsInterval},
+     TRUE,
+     "Sample the process RSS, the size of the live device memory allocations per memory type and the heap budget and usage (VK_EXT_memory_budget) every <uint> frames, the samples and peaks are written to vktrace_result.json. Default is 0, no sampling."},
+    {"npr",
+     "noPresent",
+     VKTRACE_SETTING_BOOL,
+     {&replaySettings.noPresent},
+     {&replaySettings.noPresent},
+     TRUE,
+     "Benchmark without presentation: acquires only signal their semaphore and fence and presents only wait for their semaphores, nothing is copied to or shown on the swapchain. Frames are still counted. Requires enableVirtualSwapchain. Default is FALSE."},
+    {"vsca",
+     "enableVscAlias",
+     VKTRACE_SETTING_BOOL,
+     {&replaySettings.enableVscAlias},
+     {&replaySettings.enableVscAlias},
+     TRUE,
+     "Render the trace directly into the swapchain images instead of the virtual images when the replay swapchain has the format, extent and image count of the trace, so presents skip the copy from the virtual image. Acquires are retried until they return the image index of the trace, as with forceSyncImgIdx. Requires enableVirtualSwapchain. Default is FALSE."}
 };
 
 vktrace_SettingGroup g_replaySettingGroup = {"vkreplay", sizeof(g_settings_info) / sizeof(g_settings_info[0]), &g_settings_info[0], nullptr};
@@ -645,6 +734,119 @@ inline long long getTimeType(clockid_t id)
     return tp.tv_sec * 1000000000LL + tp.tv_nsec;
 }
 
+// Length of the option of VKTRACE_TRIM_TRIGGER the trace layer accepts
+// (MAX_TRIM_TRIGGER_OPTION_STRING_LENGTH in vktrace_lib_trim.cpp).
+#define CHECKPOINT_TRIGGER_OPTION_LENGTH 32
+
+// Turn off the replay options which add Vulkan work of their own, the trace
+// layer would record it into the checkpoint with the work of the trace.
+static void disableCheckpointInjectedWork() {
+    if (replaySettings.enableVirtualSwapchain) {
+        vktrace_LogWarning("Checkpoint: disabling the virtual swapchain, its image copies would be recorded.");
+        replaySettings.enableVirtualSwapchain = FALSE;
+        replaySettings.enableVscPerfMode = FALSE;
+        replaySettings.enableVscAlias = FALSE;
+    }
+    if (replaySettings.gpuTimestamps) {
+        vktrace_LogWarning("Checkpoint: disabling GPU timestamps, their queries would be recorded.");
+        replaySettings.gpuTimestamps = FALSE;
+    }
+    if (replaySettings.perfMeasuringMode > 0) {
+        vktrace_LogWarning("Checkpoint: disabling perf measuring mode, its marker presents would be recorded.");
+        replaySettings.perfMeasuringMode = 0;
+    }
+    if (replaySettings.finishBeforeSwap) {
+        vktrace_LogWarning("Checkpoint: disabling finish before swap, its waits would be recorded.");
+        replaySettings.finishBeforeSwap = FALSE;
+    }
+    if (replaySettings.prewarmPipelineThreads > 0) {
+        vktrace_LogWarning("Checkpoint: disabling pipeline pre-warming, its pipelines would be recorded.");
+        replaySettings.prewarmPipelineThreads = 0;
+    }
+    if (replaySettings.memoryPoolThreshold > 0) {
+        vktrace_LogWarning("Checkpoint: disabling the memory pool, its allocations would be recorded instead of the traced ones.");
+        replaySettings.memoryPoolThreshold = 0;
+    }
+}
+
+// A checkpoint is a trimmed trace recaptured from this replay. The trace layer
+// is loaded into vkreplay with a frame trim trigger, so at the checkpoint frame
+// the trim state tracker writes the object state and resource contents it
+// recreates with its generate:: packets, followed by the remaining frames.
+// Replaying the checkpoint starts at that frame without the warm-up.
+static bool setupCheckpoint(const char* checkpointFrames, const char* checkpointFile, const char* traceFile) {
+    uint64_t startFrame = 0;
+    uint64_t endFrame = UINT64_MAX;
+    int matches = sscanf(checkpointFrames, "%" SCNu64 "-%" SCNu64, &startFrame, &endFrame);
+    if (matches < 1 || startFrame > endFrame) {
+        vktrace_LogError("Invalid checkpoint frames '%s', expected <startframe>[-<endframe>].", checkpointFrames);
+        return false;
+    }
+    if (replaySettings.numLoops > 1) {
+        vktrace_LogError("Checkpoint can't be written when replaying more than one loop.");
+        return false;
+    }
+    if (replaySettings.noPresent) {
+        // The trace layer counts the frames at vkQueuePresentKHR.
+        vktrace_LogError("Checkpoint can't be written when presents are skipped.");
+        return false;
+    }
+
+    // Without an end frame the layer keeps recording until the replay ends.
+    std::string triggerOption = std::to_string(startFrame);
+    if (matches == 2) {
+        triggerOption += "-" + std::to_string(endFrame);
+    }
+    if (triggerOption.size() >= CHECKPOINT_TRIGGER_OPTION_LENGTH) {
+        vktrace_LogError("Checkpoint frames '%s' are too long for the trace layer.", checkpointFrames);
+        return false;
+    }
+
+    std::string checkpointPath;
+    if (checkpointFile != NULL) {
+        checkpointPath = checkpointFile;
+    } else {
+        checkpointPath = (traceFile != NULL) ? traceFile : "vkreplay";
+        const char* suffixes[] = {".gz", ".vktrace"};
+        for (auto suffix : suffixes) {
+            size_t len = strlen(suffix);
+            if (checkpointPath.size() > len && checkpointPath.compare(checkpointPath.size() - len, len, suffix) == 0) {
+                checkpointPath.resize(checkpointPath.size() - len);
+            }
+        }
+        checkpointPath += ".checkpoint-" + std::to_string(startFrame) + ".vktrace";
+    }
+    // The trace layer ignores shorter paths and writes to its default file.
+    if (checkpointPath.size() < 7) {
+        vktrace_LogError("Checkpoint file path '%s' is too short.", checkpointPath.c_str());
+        return false;
+    }
+
+    disableCheckpointInjectedWork();
+
+    // The trace layer goes first, next to vkreplay, so that the work other
+    // layers add (screenshots, validation) is not recorded.
+    std::string layers;
+    const char* enabledLayers = vktrace_get_global_var(env_var_instance_layers);
+    if (enabledLayers != NULL) {
+        layers = enabledLayers;
+    }
+    if (layers.find("VK_LAYER_LUNARG_vktrace") == std::string::npos) {
+#if defined(WIN32)
+        layers = layers.empty() ? "VK_LAYER_LUNARG_vktrace" : "VK_LAYER_LUNARG_vktrace;" + layers;
+#else
+        layers = layers.empty() ? "VK_LAYER_LUNARG_vktrace" : "VK_LAYER_LUNARG_vktrace:" + layers;
+#endif
+    }
+
+    std::string trigger = "frames-" + triggerOption;
+    vktrace_set_global_var(env_var_instance_layers, layers.c_str());
+    vktrace_set_global_var(VKTRACE_TRIM_TRIGGER_ENV, trigger.c_str());
+    vktrace_set_global_var("VKTRACE_TRACE_PATH_FILENAME", checkpointPath.c_str());
+    vktrace_LogAlways("Checkpoint of frame %" PRIu64 " will be written to %s", startFrame, checkpointPath.c_str());
+    return true;
+}
+
 int main_loop(vktrace_replay::ReplayDisplay display, Sequencer& seq, vktrace_trace_packet_replay_library* replayerArray[], Json::Value& resultJson) {
     int err = 0;
     vktrace_trace_packet_header* packet;
@@ -782,6 +984,10 @@ int main_loop(vktrace_replay::ReplayDisplay display, Sequencer& seq, vktrace_tra
                 case VKTRACE_TPI_PORTABILITY_TABLE:
                 case VKTRACE_TPI_META_DATA:
                     break;
+                case VKTRACE_TPI_BLOB:
+                    // Registered before the packets referencing it are interpreted.
+                    vktrace_register_blob(packet);
+                    break;
 #if VK_ANDROID_frame_boundary
                 case VKTRACE_TPI_VK_vkFrameBoundaryANDROID:
 #endif
@@ -800,6 +1006,10 @@ int main_loop(vktrace_replay::ReplayDisplay display, Sequencer& seq, vktrace_tra
                         usleep(replaySettings.instrumentationDelay);
                     }
 
+                    if (timer_started) {
+                        memory_stats_frame(frameNumber);
+                    }
+
                     if (g_pReplaySettings->pScriptPath != NULL && (trigger_script_all_frames || frames.find(frameNumber) != frames.end())) {
                         triggerScript();
                     }
@@ -939,6 +1149,54 @@ int main_loop(vktrace_replay::ReplayDisplay display, Sequencer& seq, vktrace_tra
                 vktrace_LogAlways("The frame range can be preloaded completely!");
             else
                 vktrace_LogAlways("The frame range can't be preloaded completely!");
+            PreloadStats stats = get_preload_stats();
+            vktrace_LogAlways("preload: %" PRIu64 " chunk hits, %" PRIu64 " chunk misses, %" PRIu64 " packets (%" PRIu64
+                              " bytes) spilled, peak resident: %" PRIu64 " bytes",
+                              stats.hitCount, stats.missCount, stats.spilledCount, stats.spilledBytes, stats.peakResidentBytes);
+        }
+        if (replaySettings.asyncPipelineThreads > 0) {
+            vktrace_LogAlways("%" PRIu64 " pipelines created asynchronously, compile time: %.6fs, waiting time when replaying: %.6fs",
+                              get_async_pipeline_count(),
+                              static_cast<double>(get_async_pipeline_compile_time()) / NANOSEC_IN_ONE_SEC,
+                              static_cast<double>(get_async_pipeline_wait_time()) / NANOSEC_IN_ONE_SEC);
+        }
+        if (replaySettings.parallelRecordingThreads > 0) {
+            vktrace_LogAlways("%" PRIu64 " packets recorded in parallel, %" PRIu64 " ordering points waited for, waiting time when replaying: %.6fs",
+                              get_parallel_recording_packet_count(), get_parallel_recording_sync_count(),
+                              static_cast<double>(get_parallel_recording_wait_time()) / NANOSEC_IN_ONE_SEC);
+        }
+        if (replaySettings.gpuTimestamps) {
+            std::vector<GpuFrameTime> gpuFrames = get_gpu_frame_times();
+            uint64_t gpuTime = 0;
+            for (const auto &frame : gpuFrames) {
+                gpuTime += frame.time;
+            }
+            vktrace_LogAlways("GPU time: %.6fs in %zu frames (%.6fs per frame), %" PRIu64 " submissions measured",
+                              static_cast<double>(gpuTime) / NANOSEC_IN_ONE_SEC, gpuFrames.size(),
+                              gpuFrames.empty() ? 0.0 : static_cast<double>(gpuTime) / gpuFrames.size() / NANOSEC_IN_ONE_SEC,
+                              get_gpu_timestamp_submit_count());
+        }
+        if (pipeline_prewarm_enabled()) {
+            PipelinePrewarmStats stats = get_pipeline_prewarm_stats();
+            vktrace_LogAlways("%" PRIu64 " pipelines pre-warmed (%" PRIu64 " skipped, %" PRIu64 " failed), pre-warm time: %.6fs",
+                              stats.pipelineCount, stats.skippedCount, stats.failedCount,
+                              static_cast<double>(stats.time) / NANOSEC_IN_ONE_SEC);
+        }
+        if (memory_pool_enabled()) {
+            MemoryPoolStats stats = get_memory_pool_stats();
+            vktrace_LogAlways("%" PRIu64 " memory allocations replayed with %" PRIu64 " driver allocations (%" PRIu64 " pooled in %" PRIu64
+                              " blocks), peak: %" PRIu64 " traced, %" PRIu64 " driver",
+                              stats.traceAllocationCount, stats.driverAllocationCount, stats.pooledAllocationCount, stats.blockCount,
+                              stats.tracePeakAllocationCount, stats.driverPeakAllocationCount);
+        }
+        if (memory_stats_enabled()) {
+            MemoryStats stats = get_memory_stats();
+            vktrace_LogAlways("memory: %zu samples, peak RSS: %" PRIu64 " bytes, peak device memory allocated: %" PRIu64 " bytes",
+                              stats.samples.size(), stats.peakRss, stats.peakAllocatedBytes);
+            for (size_t i = 0; i < stats.peakHeapUsage.size(); i++) {
+                vktrace_LogAlways("memory heap %zu: size %" PRIu64 ", peak usage %" PRIu64 ", lowest budget %" PRIu64, i,
+                                  stats.heapSize[i], stats.peakHeapUsage[i], stats.minHeapBudget[i]);
+            }
         }
 
         resultJson["fps"]           = fps;
@@ -963,6 +1221,122 @@ int main_loop(vktrace_replay::ReplayDisplay display, Sequencer& seq, vktrace_tra
         resultJson["frames"] = totalLoopFrames;
         resultJson["loops"] = totalLoops;
         resultJson["frame_range"] = std::to_string(start_frame) + "-" + std::to_string(end_frame);
+        if (replaySettings.asyncPipelineThreads > 0) {
+            // Pipeline creation runs on worker threads, its time is not part of the frame time.
+            // pipeline_wait_time is how long the replay thread was blocked waiting for them.
+            resultJson["pipeline_compile_time"] = static_cast<double>(get_async_pipeline_compile_time()) / NANOSEC_IN_ONE_SEC;
+            resultJson["pipeline_wait_time"]    = static_cast<double>(get_async_pipeline_wait_time()) / NANOSEC_IN_ONE_SEC;
+            resultJson["async_pipelines"]       = Json::UInt64(get_async_pipeline_count());
+            resultJson["early_async_pipelines"] = Json::UInt64(get_async_pipeline_early_count());
+            resultJson["async_pipeline_failures"] = Json::UInt64(get_async_pipeline_failure_count());
+        }
+        if (replaySettings.parallelRecordingThreads > 0) {
+            // recording_wait_time is how long the replay thread was blocked at ordering points.
+            resultJson["parallel_recorded_packets"] = Json::UInt64(get_parallel_recording_packet_count());
+            resultJson["recording_syncs"]           = Json::UInt64(get_parallel_recording_sync_count());
+            resultJson["recording_wait_time"]       = static_cast<double>(get_parallel_recording_wait_time()) / NANOSEC_IN_ONE_SEC;
+        }
+        if (replaySettings.gpuTimestamps) {
+            // GPU time of the submissions, from the start of their first batch
+            // to the end of their last batch. The gpu_time of a frame counts the
+            // time during which its submissions overlap once.
+            uint64_t gpuTime = 0;
+            Json::Value gpuFrames(Json::arrayValue);
+            for (const auto &frame : get_gpu_frame_times()) {
+                Json::Value gpuFrame;
+                gpuFrame["frame"]    = frame.frame;
+                gpuFrame["gpu_time"] = static_cast<double>(frame.time) / NANOSEC_IN_ONE_SEC;
+                Json::Value submits(Json::arrayValue);
+                for (uint64_t submit : frame.submits) {
+                    submits.append(static_cast<double>(submit) / NANOSEC_IN_ONE_SEC);
+                }
+                gpuFrame["submits"] = submits;
+                gpuFrames.append(gpuFrame);
+                gpuTime += frame.time;
+            }
+            resultJson["gpu_time"]   = static_cast<double>(gpuTime) / NANOSEC_IN_ONE_SEC;
+            resultJson["gpu_frames"] = gpuFrames;
+        }
+        if (pipeline_prewarm_enabled()) {
+            // The pre-warm pass runs before the first frame, it is part of the startup time.
+            PipelinePrewarmStats stats = get_pipeline_prewarm_stats();
+            resultJson["pipeline_prewarm_time"] = static_cast<double>(stats.time) / NANOSEC_IN_ONE_SEC;
+            resultJson["prewarmed_pipelines"]   = Json::UInt64(stats.pipelineCount);
+        }
+        if (replaySettings.preloadTraceFile) {
+            PreloadStats stats = get_preload_stats();
+            Json::Value preload;
+            preload["budget_bytes"]        = Json::UInt64(stats.budget);
+            preload["chunk_hits"]          = Json::UInt64(stats.hitCount);
+            preload["chunk_misses"]        = Json::UInt64(stats.missCount);
+            preload["stall_time"]          = static_cast<double>(stats.stallTime) / NANOSEC_IN_ONE_SEC;
+            preload["spilled_packets"]     = Json::UInt64(stats.spilledCount);
+            preload["spilled_bytes"]       = Json::UInt64(stats.spilledBytes);
+            preload["peak_resident_bytes"] = Json::UInt64(stats.peakResidentBytes);
+            resultJson["preload"] = preload;
+        }
+        if (memory_pool_enabled()) {
+            MemoryPoolStats stats = get_memory_pool_stats();
+            Json::Value pool;
+            pool["trace_allocations"]       = Json::UInt64(stats.traceAllocationCount);
+            pool["trace_allocated_bytes"]   = Json::UInt64(stats.traceAllocationBytes);
+            pool["trace_peak_allocations"]  = Json::UInt64(stats.tracePeakAllocationCount);
+            pool["driver_allocations"]      = Json::UInt64(stats.driverAllocationCount);
+            pool["driver_allocated_bytes"]  = Json::UInt64(stats.driverAllocationBytes);
+            pool["driver_peak_allocations"] = Json::UInt64(stats.driverPeakAllocationCount);
+            pool["pooled_allocations"]      = Json::UInt64(stats.pooledAllocationCount);
+            pool["blocks"]                  = Json::UInt64(stats.blockCount);
+            resultJson["memory_pool"] = pool;
+        }
+        if (memory_stats_enabled()) {
+            // Each sample holds the values at its frame, and the peak of the
+            // allocated device memory since the previous sample.
+            MemoryStats stats = get_memory_stats();
+            Json::Value memory;
+            memory["interval"]             = replaySettings.memoryStatsInterval;
+            memory["peak_rss"]             = Json::UInt64(stats.peakRss);
+            memory["peak_allocated_bytes"] = Json::UInt64(stats.peakAllocatedBytes);
+            Json::Value heaps(Json::arrayValue);
+            for (size_t i = 0; i < stats.heapSize.size(); i++) {
+                Json::Value heap;
+                heap["size"] = Json::UInt64(stats.heapSize[i]);
+                if (i < stats.peakHeapUsage.size()) {
+                    heap["peak_usage"] = Json::UInt64(stats.peakHeapUsage[i]);
+                    heap["min_budget"] = Json::UInt64(stats.minHeapBudget[i]);
+                }
+                heaps.append(heap);
+            }
+            memory["heaps"] = heaps;
+            Json::Value memoryTypes(Json::arrayValue);
+            for (const auto &type : stats.memoryTypes) {
+                Json::Value memoryType;
+                memoryType["heap"]                 = type.heapIndex;
+                memoryType["peak_allocated_bytes"] = Json::UInt64(type.peakAllocatedBytes);
+                memoryTypes.append(memoryType);
+            }
+            memory["memory_types"] = memoryTypes;
+            Json::Value samples(Json::arrayValue);
+            for (const auto &sample : stats.samples) {
+                Json::Value value;
+                value["frame"]                = sample.frame;
+                value["rss"]                  = Json::UInt64(sample.rss);
+                value["allocated_bytes"]      = Json::UInt64(sample.allocatedBytes);
+                value["peak_allocated_bytes"] = Json::UInt64(sample.peakAllocatedBytes);
+                if (!sample.heapUsage.empty()) {
+                    Json::Value heapUsage(Json::arrayValue);
+                    Json::Value heapBudget(Json::arrayValue);
+                    for (size_t i = 0; i < sample.heapUsage.size(); i++) {
+                        heapUsage.append(Json::UInt64(sample.heapUsage[i]));
+                        heapBudget.append(Json::UInt64(sample.heapBudget[i]));
+                    }
+                    value["heap_usage"]  = heapUsage;
+                    value["heap_budget"] = heapBudget;
+                }
+                samples.append(value);
+            }
+            memory["samples"] = samples;
+            resultJson["memory"] = memory;
+        }
 
     } else {
         vktrace_LogError("fps error!");
@@ -974,6 +1348,8 @@ out:
         delete g_decompressor;
         g_decompressor = nullptr;
     }
+    free_pipeline_prewarm_packets();
+    vktrace_free_blobs();
     if (replaySettings.screenshotList != NULL) {
         vktrace_free((char*)replaySettings.screenshotList);
         replaySettings.screenshotList = NULL;
@@ -1299,6 +1675,19 @@ int vkreplay_main(int argc, char** argv, vktrace_replay::ReplayDisplayImp* pDisp
         }
     }
 
+    // Set up environment for checkpoint
+    if (replaySettings.checkpointFrames != NULL) {
+        if (!setupCheckpoint(replaySettings.checkpointFrames, replaySettings.checkpointFile, replaySettings.pTraceFilePath)) {
+            vktrace_SettingGroup_print(&g_replaySettingGroup);
+            if (pAllSettings != NULL) {
+                vktrace_SettingGroup_Delete_Loaded(&pAllSettings, &numAllSettings);
+            }
+            return -1;
+        }
+    } else if (replaySettings.checkpointFile != NULL) {
+        vktrace_LogWarning("Checkpoint file should be used when checkpoint enabled!");
+    }
+
     vktrace_LogAlways("Replaying with v%s", VKTRACE_VERSION);
 
     // open the trace file
@@ -1415,6 +1804,15 @@ int vkreplay_main(int argc, char** argv, vktrace_replay::ReplayDisplayImp* pDisp
         return -1;
     }
 
+    if (fileHeader.bit_flags & ~VKTRACE_KNOWN_FILE_HEADER_FLAGS) {
+        vktrace_LogError("Trace file has unknown flags 0x%x, you'll need a newer replayer.",
+                         fileHeader.bit_flags & ~VKTRACE_KNOWN_FILE_HEADER_FLAGS);
+        fclose(tracefp);
+        vktrace_free(pTraceFile);
+        vktrace_free(traceFile);
+        return -1;
+    }
+
     // Make sure magic number in trace file is valid and we have at least one gpuinfo struct
     if (fileHeader.magic != VKTRACE_FILE_MAGIC || fileHeader.n_gpuinfo < 1) {
         vktrace_LogError("%s does not appear to be a valid Vulkan trace file.", pTraceFile);
@@ -1640,6 +2038,16 @@ int vkreplay_main(int argc, char** argv, vktrace_replay::ReplayDisplayImp* pDisp
         return -1;
     }
 
+    // collect the packets of the pipeline pre-warm pass
+    if (replaySettings.prewarmPipelineThreads > 0) {
+        if (replaySettings.forceVariableRateShading != NULL) {
+            vktrace_LogWarning("-fvrs changes the replayed pipelines, the pipeline pre-warm pass is disabled.");
+        } else if (!init_pipeline_prewarm(traceFile, pFileHeader->first_packet_offset, g_decompressor,
+                                          replaySettings.prewarmPipelineThreads)) {
+            vktrace_LogWarning("The pipeline pre-warm pass is disabled.");
+        }
+    }
+
     // main loop
     uint64_t filesize = (pFileHeader->compress_type == VKTRACE_COMPRESS_TYPE_NONE) ? traceFile->mFileLen : fileHeader.decompress_file_size;
     Sequencer sequencer(traceFile, g_decompressor, filesize);
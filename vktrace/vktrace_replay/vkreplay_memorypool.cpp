@@ -0,0 +1,572 @@
+/*
+ *
+ * Copyright (C) 2016-2024 ARM Limited
+ * All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <algorithm>
+#include <list>
+#include <map>
+#include <unordered_map>
+#include <vector>
+
+#include "vkreplay_vkreplay.h"
+#include "vkreplay_memorypool.h"
+
+namespace {
+
+// Largest alignment given to a pooled allocation, resources placed in small
+// allocations don't need more.
+const VkDeviceSize kMaxPooledAlignment = 64 * 1024;
+const VkDeviceSize kMinPooledAlignment = 256;
+
+struct Block {
+    VkDevice device;
+    VkDeviceMemory memory;
+    uint32_t memoryTypeIndex;
+    VkDeviceSize size;
+    VkDeviceSize usedSize;
+    void* pMappedData;
+    std::map<VkDeviceSize, VkDeviceSize> freeRanges;  // offset -> size
+};
+
+struct Suballocation {
+    Block* pBlock;
+    VkDeviceSize offset;
+    VkDeviceSize size;           // reserved size inside the block
+    VkDeviceSize requestedSize;  // allocationSize of the traced call
+};
+
+struct DeviceInfo {
+    VkPhysicalDeviceMemoryProperties memoryProperties;
+    VkDeviceSize minAlignment;
+    std::vector<std::list<Block*>> blocks;  // indexed by memory type
+};
+
+VkDeviceSize s_maxPooledSize = 0;
+VkDeviceSize s_blockSize = 0;
+MemoryPoolStats s_stats = {};
+uint64_t s_traceLiveCount = 0;
+uint64_t s_driverLiveCount = 0;
+
+std::unordered_map<VkDevice, DeviceInfo> s_devices;
+std::unordered_map<VkDeviceMemory, Suballocation*> s_suballocations;
+
+// The driver entry points replaced by the wrappers below.
+PFN_vkAllocateMemory s_pfnAllocateMemory = nullptr;
+PFN_vkFreeMemory s_pfnFreeMemory = nullptr;
+PFN_vkMapMemory s_pfnMapMemory = nullptr;
+PFN_vkUnmapMemory s_pfnUnmapMemory = nullptr;
+PFN_vkFlushMappedMemoryRanges s_pfnFlushMappedMemoryRanges = nullptr;
+PFN_vkInvalidateMappedMemoryRanges s_pfnInvalidateMappedMemoryRanges = nullptr;
+PFN_vkGetDeviceMemoryCommitment s_pfnGetDeviceMemoryCommitment = nullptr;
+PFN_vkBindBufferMemory s_pfnBindBufferMemory = nullptr;
+PFN_vkBindImageMemory s_pfnBindImageMemory = nullptr;
+PFN_vkBindBufferMemory2 s_pfnBindBufferMemory2 = nullptr;
+PFN_vkBindBufferMemory2KHR s_pfnBindBufferMemory2KHR = nullptr;
+PFN_vkBindImageMemory2 s_pfnBindImageMemory2 = nullptr;
+PFN_vkBindImageMemory2KHR s_pfnBindImageMemory2KHR = nullptr;
+PFN_vkQueueBindSparse s_pfnQueueBindSparse = nullptr;
+PFN_vkDestroyDevice s_pfnDestroyDevice = nullptr;
+PFN_vkSetDebugUtilsObjectNameEXT s_pfnSetDebugUtilsObjectNameEXT = nullptr;
+PFN_vkSetDebugUtilsObjectTagEXT s_pfnSetDebugUtilsObjectTagEXT = nullptr;
+PFN_vkDebugMarkerSetObjectNameEXT s_pfnDebugMarkerSetObjectNameEXT = nullptr;
+PFN_vkDebugMarkerSetObjectTagEXT s_pfnDebugMarkerSetObjectTagEXT = nullptr;
+PFN_vkSetDeviceMemoryPriorityEXT s_pfnSetDeviceMemoryPriorityEXT = nullptr;
+
+VkDeviceSize align_up(VkDeviceSize value, VkDeviceSize alignment) { return (value + alignment - 1) / alignment * alignment; }
+
+VkDeviceSize next_pow2(VkDeviceSize value) {
+    VkDeviceSize result = 1;
+    while (result < value) {
+        result <<= 1;
+    }
+    return result;
+}
+
+Suballocation* find_suballocation(VkDeviceMemory memory) {
+    if (s_suballocations.empty()) {
+        return nullptr;
+    }
+    auto it = s_suballocations.find(memory);
+    return it == s_suballocations.end() ? nullptr : it->second;
+}
+
+void count_driver_allocation(VkDeviceSize size) {
+    s_stats.driverAllocationCount++;
+    s_stats.driverAllocationBytes += size;
+    s_driverLiveCount++;
+    s_stats.driverPeakAllocationCount = std::max(s_stats.driverPeakAllocationCount, s_driverLiveCount);
+}
+
+bool allocate_from_block(Block* pBlock, VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize* pOffset) {
+    for (auto it = pBlock->freeRanges.begin(); it != pBlock->freeRanges.end(); ++it) {
+        VkDeviceSize offset = align_up(it->first, alignment);
+        VkDeviceSize end = it->first + it->second;
+        if (offset + size > end) {
+            continue;
+        }
+        VkDeviceSize rangeOffset = it->first;
+        pBlock->freeRanges.erase(it);
+        if (offset > rangeOffset) {
+            pBlock->freeRanges[rangeOffset] = offset - rangeOffset;
+        }
+        if (offset + size < end) {
+            pBlock->freeRanges[offset + size] = end - (offset + size);
+        }
+        pBlock->usedSize += size;
+        *pOffset = offset;
+        return true;
+    }
+    return false;
+}
+
+void free_to_block(Block* pBlock, VkDeviceSize offset, VkDeviceSize size) {
+    pBlock->usedSize -= size;
+    // Merge with the free ranges on both sides.
+    auto next = pBlock->freeRanges.lower_bound(offset);
+    if (next != pBlock->freeRanges.end() && offset + size == next->first) {
+        size += next->second;
+        next = pBlock->freeRanges.erase(next);
+    }
+    if (next != pBlock->freeRanges.begin()) {
+        auto prev = std::prev(next);
+        if (prev->first + prev->second == offset) {
+            prev->second += size;
+            return;
+        }
+    }
+    pBlock->freeRanges[offset] = size;
+}
+
+void destroy_block(Block* pBlock) {
+    if (pBlock->pMappedData != nullptr) {
+        s_pfnUnmapMemory(pBlock->device, pBlock->memory);
+    }
+    s_pfnFreeMemory(pBlock->device, pBlock->memory, nullptr);
+    s_driverLiveCount--;
+    delete pBlock;
+}
+
+VkResult translate_range(const VkMappedMemoryRange& range, VkMappedMemoryRange* pTranslated) {
+    *pTranslated = range;
+    Suballocation* pSub = find_suballocation(range.memory);
+    if (pSub == nullptr) {
+        return VK_SUCCESS;
+    }
+    pTranslated->memory = pSub->pBlock->memory;
+    pTranslated->offset = pSub->offset + range.offset;
+    if (range.size == VK_WHOLE_SIZE || range.offset + range.size == pSub->requestedSize) {
+        // The end of the allocation doesn't need to be aligned to
+        // nonCoherentAtomSize, the end of the reserved range is.
+        pTranslated->size = pSub->size - range.offset;
+    }
+    return VK_SUCCESS;
+}
+
+//-------------------------------------------------------------------------
+// Dispatch table wrappers
+//-------------------------------------------------------------------------
+VKAPI_ATTR VkResult VKAPI_CALL pool_AllocateMemory(VkDevice device, const VkMemoryAllocateInfo* pAllocateInfo,
+                                                   const VkAllocationCallbacks* pAllocator, VkDeviceMemory* pMemory) {
+    s_stats.traceAllocationCount++;
+    s_stats.traceAllocationBytes += pAllocateInfo->allocationSize;
+    s_traceLiveCount++;
+    s_stats.tracePeakAllocationCount = std::max(s_stats.tracePeakAllocationCount, s_traceLiveCount);
+
+    auto deviceIt = s_devices.find(device);
+    bool poolable = deviceIt != s_devices.end() && pAllocateInfo->pNext == nullptr && pAllocateInfo->allocationSize > 0 &&
+                    pAllocateInfo->allocationSize <= s_maxPooledSize &&
+                    pAllocateInfo->memoryTypeIndex < deviceIt->second.memoryProperties.memoryTypeCount;
+    if (poolable) {
+        VkMemoryPropertyFlags flags = deviceIt->second.memoryProperties.memoryTypes[pAllocateInfo->memoryTypeIndex].propertyFlags;
+        poolable = (flags & (VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT | VK_MEMORY_PROPERTY_PROTECTED_BIT)) == 0;
+    }
+    if (!poolable) {
+        VkResult result = s_pfnAllocateMemory(device, pAllocateInfo, pAllocator, pMemory);
+        if (result == VK_SUCCESS) {
+            count_driver_allocation(pAllocateInfo->allocationSize);
+        } else {
+            s_traceLiveCount--;
+        }
+        return result;
+    }
+
+    DeviceInfo& info = deviceIt->second;
+    VkDeviceSize size = align_up(pAllocateInfo->allocationSize, info.minAlignment);
+    VkDeviceSize alignment = std::max(info.minAlignment, std::min(kMaxPooledAlignment, next_pow2(size)));
+
+    std::list<Block*>& blocks = info.blocks[pAllocateInfo->memoryTypeIndex];
+    Block* pBlock = nullptr;
+    VkDeviceSize offset = 0;
+    for (auto candidate : blocks) {
+        if (candidate->size - candidate->usedSize >= size && allocate_from_block(candidate, size, alignment, &offset)) {
+            pBlock = candidate;
+            break;
+        }
+    }
+    if (pBlock == nullptr) {
+        VkMemoryAllocateInfo blockInfo = {VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO, nullptr, s_blockSize,
+                                          pAllocateInfo->memoryTypeIndex};
+        VkDeviceMemory blockMemory = VK_NULL_HANDLE;
+        if (s_pfnAllocateMemory(device, &blockInfo, nullptr, &blockMemory) != VK_SUCCESS) {
+            // The heap may be too small for a whole block, don't pool this one.
+            vktrace_LogDebug("Memory pool: failed to allocate a %llu bytes block of memory type %u.", s_blockSize,
+                             pAllocateInfo->memoryTypeIndex);
+            VkResult result = s_pfnAllocateMemory(device, pAllocateInfo, pAllocator, pMemory);
+            if (result == VK_SUCCESS) {
+                count_driver_allocation(pAllocateInfo->allocationSize);
+            } else {
+                s_traceLiveCount--;
+            }
+            return result;
+        }
+        count_driver_allocation(s_blockSize);
+        s_stats.blockCount++;
+
+        pBlock = new Block();
+        pBlock->device = device;
+        pBlock->memory = blockMemory;
+        pBlock->memoryTypeIndex = pAllocateInfo->memoryTypeIndex;
+        pBlock->size = s_blockSize;
+        pBlock->usedSize = 0;
+        pBlock->pMappedData = nullptr;
+        pBlock->freeRanges[0] = s_blockSize;
+        blocks.push_back(pBlock);
+        allocate_from_block(pBlock, size, alignment, &offset);
+    }
+
+    Suballocation* pSub = new Suballocation();
+    pSub->pBlock = pBlock;
+    pSub->offset = offset;
+    pSub->size = size;
+    pSub->requestedSize = pAllocateInfo->allocationSize;
+    // The address of the suballocation can't collide with a live driver handle.
+    *pMemory = (VkDeviceMemory)(uintptr_t)pSub;
+    s_suballocations[*pMemory] = pSub;
+    s_stats.pooledAllocationCount++;
+    return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL pool_FreeMemory(VkDevice device, VkDeviceMemory memory, const VkAllocationCallbacks* pAllocator) {
+    if (memory == VK_NULL_HANDLE) {
+        return;
+    }
+    s_traceLiveCount--;
+    Suballocation* pSub = find_suballocation(memory);
+    if (pSub == nullptr) {
+        s_pfnFreeMemory(device, memory, pAllocator);
+        s_driverLiveCount--;
+        return;
+    }
+    s_suballocations.erase(memory);
+    Block* pBlock = pSub->pBlock;
+    free_to_block(pBlock, pSub->offset, pSub->size);
+    delete pSub;
+
+    if (pBlock->usedSize == 0) {
+        auto deviceIt = s_devices.find(pBlock->device);
+        if (deviceIt != s_devices.end()) {
+            deviceIt->second.blocks[pBlock->memoryTypeIndex].remove(pBlock);
+        }
+        destroy_block(pBlock);
+    }
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL pool_MapMemory(VkDevice device, VkDeviceMemory memory, VkDeviceSize offset, VkDeviceSize size,
+                                              VkMemoryMapFlags flags, void** ppData) {
+    Suballocation* pSub = find_suballocation(memory);
+    if (pSub == nullptr) {
+        return s_pfnMapMemory(device, memory, offset, size, flags, ppData);
+    }
+    // Several suballocations of a block can be mapped at the same time, the
+    // block stays mapped until it is freed.
+    Block* pBlock = pSub->pBlock;
+    if (pBlock->pMappedData == nullptr) {
+        VkResult result = s_pfnMapMemory(device, pBlock->memory, 0, VK_WHOLE_SIZE, 0, &pBlock->pMappedData);
+        if (result != VK_SUCCESS) {
+            pBlock->pMappedData = nullptr;
+            return result;
+        }
+    }
+    *ppData = static_cast<uint8_t*>(pBlock->pMappedData) + pSub->offset + offset;
+    return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL pool_UnmapMemory(VkDevice device, VkDeviceMemory memory) {
+    if (find_suballocation(memory) == nullptr) {
+        s_pfnUnmapMemory(device, memory);
+    }
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL pool_FlushMappedMemoryRanges(VkDevice device, uint32_t memoryRangeCount,
+                                                            const VkMappedMemoryRange* pMemoryRanges) {
+    if (s_suballocations.empty()) {
+        return s_pfnFlushMappedMemoryRanges(device, memoryRangeCount, pMemoryRanges);
+    }
+    std::vector<VkMappedMemoryRange> ranges(memoryRangeCount);
+    for (uint32_t i = 0; i < memoryRangeCount; i++) {
+        translate_range(pMemoryRanges[i], &ranges[i]);
+    }
+    return s_pfnFlushMappedMemoryRanges(device, memoryRangeCount, ranges.data());
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL pool_InvalidateMappedMemoryRanges(VkDevice device, uint32_t memoryRangeCount,
+                                                                 const VkMappedMemoryRange* pMemoryRanges) {
+    if (s_suballocations.empty()) {
+        return s_pfnInvalidateMappedMemoryRanges(device, memoryRangeCount, pMemoryRanges);
+    }
+    std::vector<VkMappedMemoryRange> ranges(memoryRangeCount);
+    for (uint32_t i = 0; i < memoryRangeCount; i++) {
+        translate_range(pMemoryRanges[i], &ranges[i]);
+    }
+    return s_pfnInvalidateMappedMemoryRanges(device, memoryRangeCount, ranges.data());
+}
+
+VKAPI_ATTR void VKAPI_CALL pool_GetDeviceMemoryCommitment(VkDevice device, VkDeviceMemory memory,
+                                                          VkDeviceSize* pCommittedMemoryInBytes) {
+    Suballocation* pSub = find_suballocation(memory);
+    if (pSub == nullptr) {
+        s_pfnGetDeviceMemoryCommitment(device, memory, pCommittedMemoryInBytes);
+        return;
+    }
+    *pCommittedMemoryInBytes = pSub->requestedSize;
+}
+
+// A pooled VkDeviceMemory is the address of its Suballocation, drivers which
+// store the object names and tags in the object would write into it. The
+// names and tags of the pooled allocations are dropped.
+bool is_pooled_memory_object(VkObjectType objectType, uint64_t objectHandle) {
+    return objectType == VK_OBJECT_TYPE_DEVICE_MEMORY &&
+           find_suballocation((VkDeviceMemory)(uintptr_t)objectHandle) != nullptr;
+}
+
+bool is_pooled_memory_object(VkDebugReportObjectTypeEXT objectType, uint64_t object) {
+    return objectType == VK_DEBUG_REPORT_OBJECT_TYPE_DEVICE_MEMORY_EXT &&
+           find_suballocation((VkDeviceMemory)(uintptr_t)object) != nullptr;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL pool_SetDebugUtilsObjectNameEXT(VkDevice device, const VkDebugUtilsObjectNameInfoEXT* pNameInfo) {
+    if (is_pooled_memory_object(pNameInfo->objectType, pNameInfo->objectHandle)) {
+        return VK_SUCCESS;
+    }
+    return s_pfnSetDebugUtilsObjectNameEXT(device, pNameInfo);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL pool_SetDebugUtilsObjectTagEXT(VkDevice device, const VkDebugUtilsObjectTagInfoEXT* pTagInfo) {
+    if (is_pooled_memory_object(pTagInfo->objectType, pTagInfo->objectHandle)) {
+        return VK_SUCCESS;
+    }
+    return s_pfnSetDebugUtilsObjectTagEXT(device, pTagInfo);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL pool_DebugMarkerSetObjectNameEXT(VkDevice device, const VkDebugMarkerObjectNameInfoEXT* pNameInfo) {
+    if (is_pooled_memory_object(pNameInfo->objectType, pNameInfo->object)) {
+        return VK_SUCCESS;
+    }
+    return s_pfnDebugMarkerSetObjectNameEXT(device, pNameInfo);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL pool_DebugMarkerSetObjectTagEXT(VkDevice device, const VkDebugMarkerObjectTagInfoEXT* pTagInfo) {
+    if (is_pooled_memory_object(pTagInfo->objectType, pTagInfo->object)) {
+        return VK_SUCCESS;
+    }
+    return s_pfnDebugMarkerSetObjectTagEXT(device, pTagInfo);
+}
+
+// The block is shared with other allocations, the priority of a pooled
+// allocation is not applied to it.
+VKAPI_ATTR void VKAPI_CALL pool_SetDeviceMemoryPriorityEXT(VkDevice device, VkDeviceMemory memory, float priority) {
+    if (find_suballocation(memory) != nullptr) {
+        return;
+    }
+    s_pfnSetDeviceMemoryPriorityEXT(device, memory, priority);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL pool_BindBufferMemory(VkDevice device, VkBuffer buffer, VkDeviceMemory memory,
+                                                     VkDeviceSize memoryOffset) {
+    Suballocation* pSub = find_suballocation(memory);
+    if (pSub != nullptr) {
+        memory = pSub->pBlock->memory;
+        memoryOffset += pSub->offset;
+    }
+    return s_pfnBindBufferMemory(device, buffer, memory, memoryOffset);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL pool_BindImageMemory(VkDevice device, VkImage image, VkDeviceMemory memory,
+                                                    VkDeviceSize memoryOffset) {
+    Suballocation* pSub = find_suballocation(memory);
+    if (pSub != nullptr) {
+        memory = pSub->pBlock->memory;
+        memoryOffset += pSub->offset;
+    }
+    return s_pfnBindImageMemory(device, image, memory, memoryOffset);
+}
+
+template <typename BindInfo>
+std::vector<BindInfo> translate_bind_infos(uint32_t bindInfoCount, const BindInfo* pBindInfos) {
+    std::vector<BindInfo> bindInfos(pBindInfos, pBindInfos + bindInfoCount);
+    for (auto& bindInfo : bindInfos) {
+        Suballocation* pSub = find_suballocation(bindInfo.memory);
+        if (pSub != nullptr) {
+            bindInfo.memory = pSub->pBlock->memory;
+            bindInfo.memoryOffset += pSub->offset;
+        }
+    }
+    return bindInfos;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL pool_BindBufferMemory2(VkDevice device, uint32_t bindInfoCount,
+                                                      const VkBindBufferMemoryInfo* pBindInfos) {
+    auto bindInfos = translate_bind_infos(bindInfoCount, pBindInfos);
+    return s_pfnBindBufferMemory2(device, bindInfoCount, bindInfos.data());
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL pool_BindBufferMemory2KHR(VkDevice device, uint32_t bindInfoCount,
+                                                         const VkBindBufferMemoryInfo* pBindInfos) {
+    auto bindInfos = translate_bind_infos(bindInfoCount, pBindInfos);
+    return s_pfnBindBufferMemory2KHR(device, bindInfoCount, bindInfos.data());
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL pool_BindImageMemory2(VkDevice device, uint32_t bindInfoCount,
+                                                     const VkBindImageMemoryInfo* pBindInfos) {
+    auto bindInfos = translate_bind_infos(bindInfoCount, pBindInfos);
+    return s_pfnBindImageMemory2(device, bindInfoCount, bindInfos.data());
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL pool_BindImageMemory2KHR(VkDevice device, uint32_t bindInfoCount,
+                                                        const VkBindImageMemoryInfo* pBindInfos) {
+    auto bindInfos = translate_bind_infos(bindInfoCount, pBindInfos);
+    return s_pfnBindImageMemory2KHR(device, bindInfoCount, bindInfos.data());
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL pool_QueueBindSparse(VkQueue queue, uint32_t bindInfoCount, const VkBindSparseInfo* pBindInfo,
+                                                    VkFence fence) {
+    if (s_suballocations.empty()) {
+        return s_pfnQueueBindSparse(queue, bindInfoCount, pBindInfo, fence);
+    }
+    // The bind arrays are copied so the translated handles don't leak back
+    // into the packet.
+    std::vector<VkBindSparseInfo> bindInfos(pBindInfo, pBindInfo + bindInfoCount);
+    std::list<std::vector<VkSparseBufferMemoryBindInfo>> bufferBindInfos;
+    std::list<std::vector<VkSparseImageOpaqueMemoryBindInfo>> imageOpaqueBindInfos;
+    std::list<std::vector<VkSparseImageMemoryBindInfo>> imageBindInfos;
+    std::list<std::vector<VkSparseMemoryBind>> memoryBinds;
+    std::list<std::vector<VkSparseImageMemoryBind>> imageMemoryBinds;
+    for (auto& bindInfo : bindInfos) {
+        bufferBindInfos.emplace_back(bindInfo.pBufferBinds, bindInfo.pBufferBinds + bindInfo.bufferBindCount);
+        for (auto& bufferBind : bufferBindInfos.back()) {
+            memoryBinds.emplace_back(translate_bind_infos(bufferBind.bindCount, bufferBind.pBinds));
+            bufferBind.pBinds = memoryBinds.back().data();
+        }
+        bindInfo.pBufferBinds = bufferBindInfos.back().data();
+
+        imageOpaqueBindInfos.emplace_back(bindInfo.pImageOpaqueBinds, bindInfo.pImageOpaqueBinds + bindInfo.imageOpaqueBindCount);
+        for (auto& imageOpaqueBind : imageOpaqueBindInfos.back()) {
+            memoryBinds.emplace_back(translate_bind_infos(imageOpaqueBind.bindCount, imageOpaqueBind.pBinds));
+            imageOpaqueBind.pBinds = memoryBinds.back().data();
+        }
+        bindInfo.pImageOpaqueBinds = imageOpaqueBindInfos.back().data();
+
+        imageBindInfos.emplace_back(bindInfo.pImageBinds, bindInfo.pImageBinds + bindInfo.imageBindCount);
+        for (auto& imageBind : imageBindInfos.back()) {
+            imageMemoryBinds.emplace_back(translate_bind_infos(imageBind.bindCount, imageBind.pBinds));
+            imageBind.pBinds = imageMemoryBinds.back().data();
+        }
+        bindInfo.pImageBinds = imageBindInfos.back().data();
+    }
+    return s_pfnQueueBindSparse(queue, bindInfoCount, bindInfos.data(), fence);
+}
+
+VKAPI_ATTR void VKAPI_CALL pool_DestroyDevice(VkDevice device, const VkAllocationCallbacks* pAllocator) {
+    auto deviceIt = s_devices.find(device);
+    if (deviceIt != s_devices.end()) {
+        for (auto it = s_suballocations.begin(); it != s_suballocations.end();) {
+            if (it->second->pBlock->device == device) {
+                delete it->second;
+                it = s_suballocations.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        for (auto& blocks : deviceIt->second.blocks) {
+            for (auto pBlock : blocks) {
+                destroy_block(pBlock);
+            }
+        }
+        s_devices.erase(deviceIt);
+    }
+    s_pfnDestroyDevice(device, pAllocator);
+}
+
+}  // namespace
+
+void init_memory_pool(VkDeviceSize maxPooledSize, VkDeviceSize blockSize) {
+    s_maxPooledSize = maxPooledSize;
+    s_blockSize = blockSize;
+}
+
+bool memory_pool_enabled() { return s_maxPooledSize > 0; }
+
+void memory_pool_hook_dispatch_table(VkLayerDispatchTable* pTable) {
+    if (!memory_pool_enabled()) {
+        return;
+    }
+#define HOOK_DISPATCH_ENTRY(name)              \
+    if (pTable->name != pool_##name) {         \
+        s_pfn##name = pTable->name;            \
+        if (s_pfn##name != nullptr) {          \
+            pTable->name = pool_##name;        \
+        }                                      \
+    }
+    HOOK_DISPATCH_ENTRY(AllocateMemory)
+    HOOK_DISPATCH_ENTRY(FreeMemory)
+    HOOK_DISPATCH_ENTRY(MapMemory)
+    HOOK_DISPATCH_ENTRY(UnmapMemory)
+    HOOK_DISPATCH_ENTRY(FlushMappedMemoryRanges)
+    HOOK_DISPATCH_ENTRY(InvalidateMappedMemoryRanges)
+    HOOK_DISPATCH_ENTRY(GetDeviceMemoryCommitment)
+    HOOK_DISPATCH_ENTRY(BindBufferMemory)
+    HOOK_DISPATCH_ENTRY(BindImageMemory)
+    HOOK_DISPATCH_ENTRY(BindBufferMemory2)
+    HOOK_DISPATCH_ENTRY(BindBufferMemory2KHR)
+    HOOK_DISPATCH_ENTRY(BindImageMemory2)
+    HOOK_DISPATCH_ENTRY(BindImageMemory2KHR)
+    HOOK_DISPATCH_ENTRY(QueueBindSparse)
+    HOOK_DISPATCH_ENTRY(DestroyDevice)
+    HOOK_DISPATCH_ENTRY(SetDebugUtilsObjectNameEXT)
+    HOOK_DISPATCH_ENTRY(SetDebugUtilsObjectTagEXT)
+    HOOK_DISPATCH_ENTRY(DebugMarkerSetObjectNameEXT)
+    HOOK_DISPATCH_ENTRY(DebugMarkerSetObjectTagEXT)
+    HOOK_DISPATCH_ENTRY(SetDeviceMemoryPriorityEXT)
+#undef HOOK_DISPATCH_ENTRY
+}
+
+void memory_pool_add_device(VkDevice device, const VkPhysicalDeviceProperties& properties,
+                            const VkPhysicalDeviceMemoryProperties& memoryProperties) {
+    if (!memory_pool_enabled()) {
+        return;
+    }
+    DeviceInfo& info = s_devices[device];
+    info.memoryProperties = memoryProperties;
+    // Keep separate allocations on separate bufferImageGranularity pages and
+    // make every pooled range a valid flush range.
+    info.minAlignment = std::max(kMinPooledAlignment, std::max(properties.limits.bufferImageGranularity,
+                                                               properties.limits.nonCoherentAtomSize));
+    info.blocks.resize(memoryProperties.memoryTypeCount);
+}
+
+MemoryPoolStats get_memory_pool_stats() { return s_stats; }
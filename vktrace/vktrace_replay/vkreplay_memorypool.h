@@ -0,0 +1,64 @@
+/*
+ *
+ * Copyright (C) 2016-2024 ARM Limited
+ * All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#pragma once
+
+#include <cinttypes>
+#include "vulkan/vulkan.h"
+
+typedef struct VkLayerDispatchTable_ VkLayerDispatchTable;
+
+// Replay-side device memory pooling.
+//
+// Small vkAllocateMemory calls are placed into large blocks allocated per
+// memory type. The memory entry points of the device dispatch table are
+// replaced by wrappers, so the rest of vkreplay keeps using the VkDeviceMemory
+// handle returned by AllocateMemory as if it was a driver allocation: the
+// wrappers translate pooled handles into the block and the offset inside the
+// block for bind, map, flush, invalidate and sparse binding.
+//
+// Only allocations without a pNext chain are pooled. Allocations that are
+// dedicated, exported, imported or use device address / capture replay flags
+// keep their own driver allocation, so the device address remapping and the
+// external memory paths are not affected.
+
+struct MemoryPoolStats {
+    uint64_t traceAllocationCount;    // vkAllocateMemory calls replayed
+    uint64_t traceAllocationBytes;
+    uint64_t tracePeakAllocationCount;
+    uint64_t driverAllocationCount;   // vkAllocateMemory calls made to the driver
+    uint64_t driverAllocationBytes;
+    uint64_t driverPeakAllocationCount;
+    uint64_t pooledAllocationCount;
+    uint64_t blockCount;
+};
+
+// maxPooledSize: allocations up to this size are pooled.
+// blockSize: size of the driver allocations the pools are made of.
+void init_memory_pool(VkDeviceSize maxPooledSize, VkDeviceSize blockSize);
+
+// Replace the memory entry points of pTable with the pooling wrappers. Must be
+// called every time the table is (re)initialized.
+void memory_pool_hook_dispatch_table(VkLayerDispatchTable* pTable);
+
+void memory_pool_add_device(VkDevice device, const VkPhysicalDeviceProperties& properties,
+                            const VkPhysicalDeviceMemoryProperties& memoryProperties);
+
+bool memory_pool_enabled();
+MemoryPoolStats get_memory_pool_stats();
@@ -0,0 +1,184 @@
+/*
+ *
+ * Copyright (C) 2016-2024 ARM Limited
+ * All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <unordered_map>
+
+#if defined(PLATFORM_LINUX)
+#include <unistd.h>
+#endif
+
+extern "C" {
+#include "vktrace_common.h"
+}
+
+#include "vkreplay_memorystats.h"
+
+namespace {
+
+struct Allocation {
+    VkDevice device;
+    uint32_t memoryTypeIndex;
+    VkDeviceSize size;
+};
+
+struct SampledDevice {
+    VkDevice device;
+    VkPhysicalDevice physicalDevice;
+    PFN_vkGetPhysicalDeviceMemoryProperties2 pfnGetPhysicalDeviceMemoryProperties2;
+};
+
+uint32_t s_interval = 0;
+MemoryStats s_stats = {};
+uint64_t s_allocatedBytes = 0;
+uint64_t s_rangePeakAllocatedBytes = 0;  // since the previous sample
+SampledDevice s_device = {VK_NULL_HANDLE, VK_NULL_HANDLE, nullptr};
+std::unordered_map<VkDeviceMemory, Allocation> s_allocations;
+
+uint64_t get_rss() {
+#if defined(PLATFORM_LINUX)
+    // The second field of statm is the resident set size in pages.
+    FILE* file = fopen("/proc/self/statm", "r");
+    if (file == nullptr) {
+        return 0;
+    }
+    unsigned long long size = 0;
+    unsigned long long resident = 0;
+    int matches = fscanf(file, "%llu %llu", &size, &resident);
+    fclose(file);
+    if (matches != 2) {
+        return 0;
+    }
+    return resident * uint64_t(sysconf(_SC_PAGESIZE));
+#else
+    return 0;
+#endif
+}
+
+void sample_heaps(MemoryStatsSample* pSample) {
+    if (s_device.pfnGetPhysicalDeviceMemoryProperties2 == nullptr) {
+        return;
+    }
+    VkPhysicalDeviceMemoryBudgetPropertiesEXT budgetProperties = {};
+    budgetProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+    VkPhysicalDeviceMemoryProperties2 memoryProperties = {};
+    memoryProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+    memoryProperties.pNext = &budgetProperties;
+    s_device.pfnGetPhysicalDeviceMemoryProperties2(s_device.physicalDevice, &memoryProperties);
+
+    uint32_t heapCount = memoryProperties.memoryProperties.memoryHeapCount;
+    pSample->heapBudget.assign(budgetProperties.heapBudget, budgetProperties.heapBudget + heapCount);
+    pSample->heapUsage.assign(budgetProperties.heapUsage, budgetProperties.heapUsage + heapCount);
+    if (s_stats.peakHeapUsage.size() != heapCount) {
+        s_stats.peakHeapUsage.assign(heapCount, 0);
+        s_stats.minHeapBudget.assign(heapCount, UINT64_MAX);
+    }
+    for (uint32_t i = 0; i < heapCount; i++) {
+        s_stats.peakHeapUsage[i] = std::max<uint64_t>(s_stats.peakHeapUsage[i], budgetProperties.heapUsage[i]);
+        s_stats.minHeapBudget[i] = std::min<uint64_t>(s_stats.minHeapBudget[i], budgetProperties.heapBudget[i]);
+    }
+}
+
+}  // namespace
+
+void init_memory_stats(uint32_t interval) { s_interval = interval; }
+
+bool memory_stats_enabled() { return s_interval > 0; }
+
+void memory_stats_add_device(VkDevice device, VkPhysicalDevice physicalDevice, const VkPhysicalDeviceMemoryProperties& memoryProperties,
+                             PFN_vkGetPhysicalDeviceMemoryProperties2 pfnGetPhysicalDeviceMemoryProperties2) {
+    s_device = {device, physicalDevice, pfnGetPhysicalDeviceMemoryProperties2};
+    s_stats.heapSize.resize(memoryProperties.memoryHeapCount);
+    for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; i++) {
+        s_stats.heapSize[i] = memoryProperties.memoryHeaps[i].size;
+    }
+    if (s_stats.memoryTypes.size() < memoryProperties.memoryTypeCount) {
+        s_stats.memoryTypes.resize(memoryProperties.memoryTypeCount, {0, 0, 0, 0});
+    }
+    for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++) {
+        s_stats.memoryTypes[i].heapIndex = memoryProperties.memoryTypes[i].heapIndex;
+    }
+    // The budget of the previous device no longer applies.
+    s_stats.peakHeapUsage.clear();
+    s_stats.minHeapBudget.clear();
+    if (pfnGetPhysicalDeviceMemoryProperties2 == nullptr) {
+        vktrace_LogWarning("VK_EXT_memory_budget is not supported, the memory heaps will not be sampled.");
+    }
+}
+
+void memory_stats_remove_device(VkDevice device) {
+    for (auto it = s_allocations.begin(); it != s_allocations.end();) {
+        if (it->second.device == device) {
+            MemoryTypeStats& type = s_stats.memoryTypes[it->second.memoryTypeIndex];
+            type.allocationCount--;
+            type.allocatedBytes -= it->second.size;
+            s_allocatedBytes -= it->second.size;
+            it = s_allocations.erase(it);
+        } else {
+            it++;
+        }
+    }
+    if (s_device.device == device) {
+        s_device = {VK_NULL_HANDLE, VK_NULL_HANDLE, nullptr};
+    }
+}
+
+void memory_stats_allocate(VkDevice device, VkDeviceMemory memory, uint32_t memoryTypeIndex, VkDeviceSize size) {
+    if (memoryTypeIndex >= s_stats.memoryTypes.size()) {
+        return;
+    }
+    s_allocations[memory] = {device, memoryTypeIndex, size};
+    MemoryTypeStats& type = s_stats.memoryTypes[memoryTypeIndex];
+    type.allocationCount++;
+    type.allocatedBytes += size;
+    type.peakAllocatedBytes = std::max(type.peakAllocatedBytes, type.allocatedBytes);
+    s_allocatedBytes += size;
+    s_rangePeakAllocatedBytes = std::max(s_rangePeakAllocatedBytes, s_allocatedBytes);
+    s_stats.peakAllocatedBytes = std::max(s_stats.peakAllocatedBytes, s_allocatedBytes);
+}
+
+void memory_stats_free(VkDeviceMemory memory) {
+    auto it = s_allocations.find(memory);
+    if (it == s_allocations.end()) {
+        return;
+    }
+    MemoryTypeStats& type = s_stats.memoryTypes[it->second.memoryTypeIndex];
+    type.allocationCount--;
+    type.allocatedBytes -= it->second.size;
+    s_allocatedBytes -= it->second.size;
+    s_allocations.erase(it);
+}
+
+void memory_stats_frame(uint32_t frame) {
+    if (s_interval == 0 || frame % s_interval != 0) {
+        return;
+    }
+    MemoryStatsSample sample;
+    sample.frame = frame;
+    sample.rss = get_rss();
+    sample.allocatedBytes = s_allocatedBytes;
+    sample.peakAllocatedBytes = std::max(s_rangePeakAllocatedBytes, s_allocatedBytes);
+    sample_heaps(&sample);
+    s_rangePeakAllocatedBytes = s_allocatedBytes;
+    s_stats.peakRss = std::max(s_stats.peakRss, sample.rss);
+    s_stats.samples.push_back(std::move(sample));
+}
+
+MemoryStats get_memory_stats() { return s_stats; }
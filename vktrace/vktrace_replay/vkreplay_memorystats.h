@@ -0,0 +1,77 @@
+/*
+ *
+ * Copyright (C) 2016-2024 ARM Limited
+ * All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#pragma once
+
+#include <cinttypes>
+#include <vector>
+#include "vulkan/vulkan.h"
+
+// Replay memory footprint sampling.
+//
+// The device memory allocations made by the replay are counted per memory
+// type as they are allocated and freed. Every <interval> frames a sample is
+// taken of the process RSS, the live allocations and, when the physical device
+// supports VK_EXT_memory_budget, the budget and usage of each memory heap as
+// reported by the driver. The heaps of the last created device are sampled.
+
+struct MemoryStatsSample {
+    uint32_t frame;
+    uint64_t rss;                      // resident set size of the process, 0 if unknown
+    uint64_t allocatedBytes;           // live replay allocations of all memory types
+    uint64_t peakAllocatedBytes;       // peak of allocatedBytes since the previous sample
+    std::vector<uint64_t> heapBudget;  // empty without VK_EXT_memory_budget
+    std::vector<uint64_t> heapUsage;
+};
+
+struct MemoryTypeStats {
+    uint32_t heapIndex;
+    uint64_t allocationCount;  // live allocations
+    uint64_t allocatedBytes;
+    uint64_t peakAllocatedBytes;
+};
+
+struct MemoryStats {
+    uint64_t peakRss;
+    uint64_t peakAllocatedBytes;
+    std::vector<uint64_t> heapSize;
+    std::vector<uint64_t> peakHeapUsage;  // empty without VK_EXT_memory_budget
+    std::vector<uint64_t> minHeapBudget;
+    std::vector<MemoryTypeStats> memoryTypes;
+    std::vector<MemoryStatsSample> samples;
+};
+
+// interval: number of frames between two samples.
+void init_memory_stats(uint32_t interval);
+bool memory_stats_enabled();
+
+// pfnGetPhysicalDeviceMemoryProperties2 is NULL if the heap budget can't be queried.
+void memory_stats_add_device(VkDevice device, VkPhysicalDevice physicalDevice,
+                             const VkPhysicalDeviceMemoryProperties& memoryProperties,
+                             PFN_vkGetPhysicalDeviceMemoryProperties2 pfnGetPhysicalDeviceMemoryProperties2);
+// Drop the allocations which were not freed before device is destroyed.
+void memory_stats_remove_device(VkDevice device);
+
+void memory_stats_allocate(VkDevice device, VkDeviceMemory memory, uint32_t memoryTypeIndex, VkDeviceSize size);
+void memory_stats_free(VkDeviceMemory memory);
+
+// Take a sample if frame is a multiple of the interval.
+void memory_stats_frame(uint32_t frame);
+
+MemoryStats get_memory_stats();
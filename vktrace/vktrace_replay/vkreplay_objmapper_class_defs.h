@@ -270,6 +270,11 @@ class vkReplayObjMapper {
     ~vkReplayObjMapper() {}
 
     bool m_adjustForGPU;  // true if replay adjusts behavior based on GPU
+
+    // Set when pipelines are created asynchronously. remap_pipelines() calls it
+    // first so that a pipeline which is still being created gets added to
+    // m_pipelines before it is looked up.
+    std::function<void(VkPipeline)> m_resolveAsyncPipeline;
     void init_objMemCount(const uint64_t handle, const VkDebugReportObjectTypeEXT objectType, const uint32_t &num) {
         switch (objectType) {
             case VK_DEBUG_REPORT_OBJECT_TYPE_BUFFER_EXT: {
@@ -0,0 +1,162 @@
+/*
+ *
+ * Copyright (C) 2016-2024 ARM Limited
+ * All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+extern "C" {
+#include "vktrace_trace_packet_utils.h"
+}
+
+#include <atomic>
+
+#include "vkreplay_parallelrecord.h"
+
+static std::atomic<uint64_t> s_packetCount(0);
+static uint64_t s_syncCount = 0;
+static uint64_t s_waitTime = 0;
+
+uint64_t get_parallel_recording_packet_count() { return s_packetCount; }
+
+uint64_t get_parallel_recording_sync_count() { return s_syncCount; }
+
+uint64_t get_parallel_recording_wait_time() { return s_waitTime; }
+
+namespace vktrace_replay {
+
+ParallelRecorder::ParallelRecorder(uint32_t threadCount, RecordFunc record)
+    : m_record(record), m_queuedCount(0), m_exiting(false), m_hasPending(false) {
+    for (uint32_t i = 0; i < threadCount; i++) {
+        m_workers.emplace_back(&ParallelRecorder::WorkerThread, this);
+    }
+}
+
+ParallelRecorder::~ParallelRecorder() {
+    WaitIdle();
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_exiting = true;
+    }
+    m_queueCondition.notify_all();
+    for (auto &worker : m_workers) {
+        worker.join();
+    }
+}
+
+void ParallelRecorder::WorkerThread() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (true) {
+        m_queueCondition.wait(lock, [this] { return m_exiting || !m_readyLanes.empty(); });
+        if (m_readyLanes.empty()) {
+            break;
+        }
+        // Keep the lane until it is drained, so its packets are replayed in order.
+        Lane *lane = m_readyLanes.front();
+        m_readyLanes.pop_front();
+        while (!lane->packets.empty()) {
+            vktrace_trace_packet_header *pPacket = lane->packets.front();
+            lane->packets.pop_front();
+            lock.unlock();
+
+            bool success = m_record(pPacket);
+            s_packetCount++;
+
+            lock.lock();
+            if (!success) {
+                m_failedPackets.push_back(pPacket);
+            }
+            m_queuedCount--;
+        }
+        lane->scheduled = false;
+        if (m_queuedCount == 0) {
+            m_doneCondition.notify_all();
+        }
+    }
+}
+
+void ParallelRecorder::AddCommandBuffers(VkCommandPool commandPool, uint32_t commandBufferCount,
+                                         const VkCommandBuffer *pCommandBuffers) {
+    for (uint32_t i = 0; i < commandBufferCount; i++) {
+        m_commandBufferPools[pCommandBuffers[i]] = commandPool;
+    }
+}
+
+void ParallelRecorder::RemoveCommandBuffers(uint32_t commandBufferCount, const VkCommandBuffer *pCommandBuffers) {
+    for (uint32_t i = 0; i < commandBufferCount; i++) {
+        m_commandBufferPools.erase(pCommandBuffers[i]);
+    }
+}
+
+void ParallelRecorder::RemoveCommandPool(VkCommandPool commandPool) {
+    for (auto it = m_commandBufferPools.begin(); it != m_commandBufferPools.end();) {
+        if (it->second == commandPool) {
+            it = m_commandBufferPools.erase(it);
+        } else {
+            it++;
+        }
+    }
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_lanes.erase(commandPool);
+}
+
+VkCommandPool ParallelRecorder::GetCommandPool(VkCommandBuffer commandBuffer) const {
+    auto it = m_commandBufferPools.find(commandBuffer);
+    return it != m_commandBufferPools.end() ? it->second : VK_NULL_HANDLE;
+}
+
+void ParallelRecorder::Submit(VkCommandPool commandPool, vktrace_trace_packet_header *pPacket) {
+    bool schedule = false;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        Lane &lane = m_lanes[commandPool];
+        lane.packets.push_back(pPacket);
+        m_queuedCount++;
+        if (!lane.scheduled) {
+            lane.scheduled = true;
+            m_readyLanes.push_back(&lane);
+            schedule = true;
+        }
+    }
+    m_hasPending = true;
+    if (schedule) {
+        m_queueCondition.notify_one();
+    }
+}
+
+void ParallelRecorder::Sync() {
+    if (!m_hasPending) {
+        return;
+    }
+    uint64_t startTime = vktrace_get_time();
+    WaitIdle();
+    s_waitTime += vktrace_get_time() - startTime;
+    s_syncCount++;
+    m_hasPending = false;
+}
+
+void ParallelRecorder::WaitIdle() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_doneCondition.wait(lock, [this] { return m_queuedCount == 0; });
+}
+
+std::vector<vktrace_trace_packet_header *> ParallelRecorder::TakeFailedPackets() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::vector<vktrace_trace_packet_header *> failedPackets;
+    failedPackets.swap(m_failedPackets);
+    return failedPackets;
+}
+
+}  // namespace vktrace_replay
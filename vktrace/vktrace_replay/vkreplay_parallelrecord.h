@@ -0,0 +1,111 @@
+/*
+ *
+ * Copyright (C) 2016-2024 ARM Limited
+ * All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "vulkan/vulkan.h"
+#include "vktrace_trace_packet_identifiers.h"
+
+namespace vktrace_replay {
+
+// Records command buffers on worker threads. The packets recording the command
+// buffers of one command pool go to the same lane and are replayed in order by
+// one worker at a time, as a command pool must be externally synchronized.
+// The lanes of different command pools are replayed concurrently. Every other
+// packet is an ordering point, the replay thread waits until all the lanes are
+// drained before replaying it (see vkReplay::record_in_parallel()).
+//
+// The queued packets are replayed after the replay thread has moved on, the
+// caller must keep their memory alive until they are done (see WaitIdle()).
+// The packets which failed are kept for the replay thread to report them at
+// the next ordering point (see TakeFailedPackets()).
+class ParallelRecorder {
+   public:
+    // Returns false if the packet failed to replay.
+    typedef std::function<bool(vktrace_trace_packet_header *pPacket)> RecordFunc;
+
+    ParallelRecorder(uint32_t threadCount, RecordFunc record);
+    ~ParallelRecorder();
+
+    ParallelRecorder(const ParallelRecorder &) = delete;
+    ParallelRecorder &operator=(const ParallelRecorder &) = delete;
+
+    // Track the command pools of the trace command buffers. Replay thread only,
+    // the lanes must be drained before a command pool is removed.
+    void AddCommandBuffers(VkCommandPool commandPool, uint32_t commandBufferCount, const VkCommandBuffer *pCommandBuffers);
+    void RemoveCommandBuffers(uint32_t commandBufferCount, const VkCommandBuffer *pCommandBuffers);
+    void RemoveCommandPool(VkCommandPool commandPool);
+    // Returns VK_NULL_HANDLE if the command buffer is unknown.
+    VkCommandPool GetCommandPool(VkCommandBuffer commandBuffer) const;
+
+    // Queue a packet recording a command buffer of commandPool.
+    void Submit(VkCommandPool commandPool, vktrace_trace_packet_header *pPacket);
+
+    // Whether packets were submitted since the last Sync(). Replay thread only.
+    bool HasPending() const { return m_hasPending; }
+
+    // Wait until every queued packet is replayed, called by the replay thread
+    // at the ordering points.
+    void Sync();
+
+    // Same as Sync() without counting it in the statistics. This can be called
+    // from any thread.
+    void WaitIdle();
+
+    // The packets which failed since the last call, in the order they were
+    // replayed. Replay thread only, after Sync().
+    std::vector<vktrace_trace_packet_header *> TakeFailedPackets();
+
+   private:
+    struct Lane {
+        std::deque<vktrace_trace_packet_header *> packets;
+        bool scheduled = false;  // in m_readyLanes or being replayed by a worker
+    };
+
+    void WorkerThread();
+
+    RecordFunc m_record;
+    std::vector<std::thread> m_workers;
+    std::mutex m_mutex;
+    std::condition_variable m_queueCondition;
+    std::condition_variable m_doneCondition;
+    std::unordered_map<VkCommandPool, Lane> m_lanes;
+    std::deque<Lane *> m_readyLanes;
+    uint64_t m_queuedCount;
+    bool m_exiting;
+    std::vector<vktrace_trace_packet_header *> m_failedPackets;
+
+    std::unordered_map<VkCommandBuffer, VkCommandPool> m_commandBufferPools;
+    bool m_hasPending;
+};
+
+}  // namespace vktrace_replay
+
+// Statistics reported in the result json.
+uint64_t get_parallel_recording_packet_count();
+uint64_t get_parallel_recording_sync_count();
+uint64_t get_parallel_recording_wait_time();
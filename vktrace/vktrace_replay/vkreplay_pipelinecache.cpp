@@ -2,13 +2,16 @@
 
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
 #include <dirent.h>
+#include <fcntl.h>
 
 #include <fstream>
 #include <sstream>
 #include <algorithm>
 #include <unistd.h>
 #include <vector>
+#include <cstdio>
 
 namespace {
 
@@ -66,6 +69,35 @@ namespace {
         return result;
     }
 
+    bool ParseUint64(const std::string &str, uint64_t &value) {
+        if (str.empty() || std::string::npos != str.find_first_not_of("0123456789")) {
+            return false;
+        }
+        value = std::stoull(str);
+        return true;
+    }
+
+    // Split <gpi>-<cache handle>-<gpu info>-<pipeline cache uuid>.dat
+    bool ParseCacheFileName(const std::string &full_path, uint64_t &gpi, uint64_t &cache_handle, uint64_t &gpu_info, std::string &uuid) {
+        const std::size_t pos_begin = full_path.find_last_of("/") + 1;
+        const std::size_t pos_ext = full_path.rfind(".dat");
+        if (std::string::npos == pos_ext || pos_ext < pos_begin || pos_ext + 4 != full_path.size()) {
+            return false;
+        }
+
+        std::vector<std::string> fields;
+        std::stringstream ss(full_path.substr(pos_begin, pos_ext - pos_begin));
+        std::string field;
+        while (std::getline(ss, field, '-')) {
+            fields.push_back(field);
+        }
+        if (4 != fields.size() || std::string::npos != fields[3].find_first_not_of("0123456789")) {
+            return false;
+        }
+        uuid = fields[3];
+        return ParseUint64(fields[0], gpi) && ParseUint64(fields[1], cache_handle) && ParseUint64(fields[2], gpu_info);
+    }
+
 }
 
 namespace vktrace_replay {
@@ -105,12 +137,16 @@ namespace vktrace_replay {
 
         for (auto &info : m_cachemap) {
             if (nullptr != info.second.first) {
-                VKTRACE_DELETE(info.second.first);
+                munmap(info.second.first, info.second.second);
             }
         }
+        for (auto &cache : m_retiredCaches) {
+            munmap(cache.first, cache.second);
+        }
     }
 
     std::pair<void*, size_t> PipelineCacheAccessor::GetPipelineCache(const VkPipelineCache &cache_handle) const {
+        std::lock_guard<std::mutex> lock(m_mutex);
         const uint64_t key = m_pipelineCacheToGpi.at(cache_handle);
         std::pair<void*, size_t> result({nullptr, 0});
         const auto iter = m_cachemap.find(key);
@@ -122,6 +158,7 @@ namespace vktrace_replay {
     }
 
     bool PipelineCacheAccessor::WritePipelineCache(const VkPipelineCache &cache_handle, void* cache_data, const uint32_t &cache_size, const uint64_t &gpu_info, const uint8_t *pipelinecache_uuid) {
+        std::lock_guard<std::mutex> lock(m_mutex);
         bool result = false;
         const uint64_t cache_handle_value = reinterpret_cast<uint64_t>(cache_handle);
         const std::string root_path = m_cachepath;
@@ -131,28 +168,44 @@ namespace vktrace_replay {
         ss << root_path << "/" << gpi << "-" << cache_handle_value << "-" << gpu_info << "-" << uuid << ".dat";
 
         const std::string file_name = ss.str();
+        // Write to a temporary file and rename it, so an interrupted replay
+        // never leaves a truncated cache file behind for the next run.
+        const std::string tmp_file_name = file_name + ".tmp";
         std::ofstream file;
-        file.open(file_name, std::ios::binary | std::ios::out);
+        file.open(tmp_file_name, std::ios::binary | std::ios::out);
         if (!file) {
             return result;
         }
 
         file.write(reinterpret_cast<const char*>(cache_data), cache_size);
-        if (!file.fail()) {
-            result = true;
-            char *full_path = realpath(file_name.c_str(), NULL);
-            if (nullptr != full_path) {
-                vktrace_LogAlways("Pipeline cache data file %s has been saved.", full_path);
-                free(full_path);
-                full_path = nullptr;
+        file.close();
+        if (file.fail() || 0 != rename(tmp_file_name.c_str(), file_name.c_str())) {
+            vktrace_LogWarning("Failed to save pipeline cache data file %s.", file_name.c_str());
+            remove(tmp_file_name.c_str());
+            return result;
+        }
+
+        result = true;
+        char *full_path = realpath(file_name.c_str(), NULL);
+        if (nullptr != full_path) {
+            vktrace_LogAlways("Pipeline cache data file %s has been saved.", full_path);
+            // A file which was already indexed has just been overwritten in place.
+            if (nullptr == FindIndexed(gpi, cache_handle_value, &gpu_info, &uuid)) {
+                auto &entries = m_index[gpi];
+                CacheFileInfo info = {cache_handle_value, gpu_info, uuid, full_path};
+                entries.insert(std::upper_bound(entries.begin(), entries.end(), info,
+                                                [](const CacheFileInfo &a, const CacheFileInfo &b) { return a.full_path < b.full_path; }),
+                               info);
             }
+            free(full_path);
+            full_path = nullptr;
         }
-        file.close();
 
         return result;
     }
 
     bool PipelineCacheAccessor::LoadPipelineCache(const std::string &full_path) {
+        std::lock_guard<std::mutex> lock(m_mutex);
         const uint64_t key = ParsePipelineCacheHandle(full_path);
         if (0 == key) {
             // Cannot parse the pipeline cache handler value from the path, the input file name may not
@@ -161,17 +214,32 @@ namespace vktrace_replay {
             return false;
         }
 
+        // The same cache may be looked up by the preloading and the replay
+        // thread, a file which is already mapped is used as is.
+        const auto loaded = m_loadedFiles.find(key);
+        if (m_loadedFiles.end() != loaded && loaded->second == full_path) {
+            return true;
+        }
+
         auto cache_result = ReadPipelineCache(full_path);
         if (nullptr == cache_result.first) {
             return false;
         }
 
+        // The previous data may still be referenced by a packet, it is
+        // released with the accessor.
+        const auto previous = m_cachemap.find(key);
+        if (m_cachemap.end() != previous && nullptr != previous->second.first) {
+            m_retiredCaches.push_back(previous->second);
+        }
         m_cachemap[key] = cache_result;
+        m_loadedFiles[key] = full_path;
         vktrace_LogAlways("Pipeline cache data file %s has been loaded.", full_path.c_str());
         return true;
     }
 
     void PipelineCacheAccessor::SetPipelineCacheRootPath(const std::string &path) {
+        std::lock_guard<std::mutex> lock(m_mutex);
         assert(!path.empty());
         char *full_path = realpath(path.c_str(), nullptr);
         if (nullptr == full_path) {
@@ -192,13 +260,54 @@ namespace vktrace_replay {
             free(full_path);
             full_path = nullptr;
         }
+        BuildIndex();
+    }
+
+    void PipelineCacheAccessor::BuildIndex() {
+        m_index.clear();
+        std::vector<std::string> &&file_list = GetFileList(m_cachepath);
+        size_t file_count = 0;
+        for (const auto &full_path : file_list) {
+            uint64_t gpi = 0;
+            CacheFileInfo info;
+            if (!ParseCacheFileName(full_path, gpi, info.cache_handle, info.gpu_info, info.uuid)) {
+                vktrace_LogDebug("Skip %s, it is not a pipeline cache data file.", full_path.c_str());
+                continue;
+            }
+            info.full_path = full_path;
+            m_index[gpi].push_back(info);
+            file_count++;
+        }
+        // Keep the lookup result independent of the readdir order.
+        for (auto &entry : m_index) {
+            std::sort(entry.second.begin(), entry.second.end(),
+                      [](const CacheFileInfo &a, const CacheFileInfo &b) { return a.full_path < b.full_path; });
+        }
+        vktrace_LogVerbose("%zu pipeline cache data files found in %s.", file_count, m_cachepath.c_str());
+    }
+
+    const PipelineCacheAccessor::CacheFileInfo* PipelineCacheAccessor::FindIndexed(const uint64_t &gpi, const uint64_t &cache_handle, const uint64_t *gpu_info, const std::string *uuid) const {
+        const auto iter = m_index.find(gpi);
+        if (m_index.end() == iter) {
+            return nullptr;
+        }
+        for (const auto &info : iter->second) {
+            if (info.cache_handle == cache_handle &&
+                (nullptr == gpu_info || info.gpu_info == *gpu_info) &&
+                (nullptr == uuid || info.uuid == *uuid)) {
+                return &info;
+            }
+        }
+        return nullptr;
     }
 
     void PipelineCacheAccessor::CollectPacketInfo(const VkDevice &device, const VkPipelineCache &cache_key) {
+        std::lock_guard<std::mutex> lock(m_mutex);
         m_collected_packetinfo_list.push_back(std::make_pair(device, cache_key));
     }
 
     void PipelineCacheAccessor::RemoveCollectedPacketInfo(const VkDevice &device, const VkPipelineCache &cache_key) {
+        std::lock_guard<std::mutex> lock(m_mutex);
         auto pair = std::make_pair(device, cache_key);
         auto iter = std::find(m_collected_packetinfo_list.begin(), m_collected_packetinfo_list.end(), pair);
         if (iter != m_collected_packetinfo_list.end()) {
@@ -211,71 +320,51 @@ namespace vktrace_replay {
     }
 
     std::string PipelineCacheAccessor::FindFile(const uint64_t &gpi, const VkPipelineCache &cache_handle) {
+        std::lock_guard<std::mutex> lock(m_mutex);
         std::string result;
-        std::vector<std::string> &&file_list = GetFileList(m_cachepath);
-        if (file_list.empty()) {
+        if (m_index.empty()) {
             return result;
         }
         m_pipelineCacheToGpi[cache_handle] = gpi;
-        const uint64_t cache_handle_value = reinterpret_cast<uint64_t>(cache_handle);
-        std::stringstream ss;
-        std::stringstream ss_gpi_value;
-        ss_gpi_value << gpi;
-        ss << cache_handle_value;
-        for (const auto &full_path : file_list) {
-            if (std::string::npos != full_path.find(ss.str()) &&
-                std::string::npos != full_path.find(ss_gpi_value.str())) {
-                result = full_path;
-                break;
-            }
+        const CacheFileInfo *info = FindIndexed(gpi, reinterpret_cast<uint64_t>(cache_handle), nullptr, nullptr);
+        if (nullptr != info) {
+            result = info->full_path;
         }
 
         return result;
     }
 
     std::string PipelineCacheAccessor::FindFile(const uint64_t &gpi, const VkPipelineCache &cache_handle, const uint64_t &gpu_info, const uint8_t *pipelinecache_uuid) {
+        std::lock_guard<std::mutex> lock(m_mutex);
         std::string result;
-        std::vector<std::string> &&file_list = GetFileList(m_cachepath);
-        const uint64_t cache_handle_value = reinterpret_cast<uint64_t>(cache_handle);
-        std::stringstream ss_gpi_value;
+        uint64_t cache_gpi = gpi;
         if (gpi != UINT64_MAX) {
             m_pipelineCacheToGpi[cache_handle] = gpi;
-            ss_gpi_value << gpi;
         } else {
-            ss_gpi_value << m_pipelineCacheToGpi.at(cache_handle);
+            cache_gpi = m_pipelineCacheToGpi.at(cache_handle);
         }
-        if (file_list.empty()) {
+        if (m_index.empty()) {
             return result;
         }
 
-        std::stringstream ss_cache_handle;
-        std::stringstream ss_gpu_info;
-        std::stringstream ss_pipelinecache_uuid;
-        ss_cache_handle << cache_handle_value;
-        ss_gpu_info << gpu_info;
-        std::string &&uuid = PipelinecacheUUIDToString(pipelinecache_uuid);
-        for (const auto &full_path : file_list) {
-            if (std::string::npos != full_path.find(ss_gpi_value.str()) &&
-                std::string::npos != full_path.find(ss_cache_handle.str()) &&
-                std::string::npos != full_path.find(ss_gpu_info.str()) &&
-                std::string::npos != full_path.find(uuid)) {
-                result = full_path;
-                break;
-            }
+        const std::string &&uuid = PipelinecacheUUIDToString(pipelinecache_uuid);
+        const CacheFileInfo *info = FindIndexed(cache_gpi, reinterpret_cast<uint64_t>(cache_handle), &gpu_info, &uuid);
+        if (nullptr != info) {
+            result = info->full_path;
         }
 
         return result;
     }
 
     std::list<std::pair<VkDevice, VkPipelineCache>> PipelineCacheAccessor::GetCollectedPacketInfo() const {
+        std::lock_guard<std::mutex> lock(m_mutex);
         return m_collected_packetinfo_list;
     }
 
     std::pair<void*, size_t> PipelineCacheAccessor::ReadPipelineCache(const std::string &full_path) {
         std::pair<void*, size_t> result({nullptr, 0});
-        std::ifstream file;
-        file.open(full_path, std::ios::binary | std::ios::in | std::ios::ate);
-        if (!file) {
+        const int fd = open(full_path.c_str(), O_RDONLY);
+        if (fd < 0) {
             vktrace_LogWarning("Pipeline cache data file %s not found!", full_path.c_str());
             return result;
         }
@@ -289,14 +378,22 @@ namespace vktrace_replay {
 // +     16 | VK_UUID_SIZE | a pipeline cache ID equal to VkPhysicalDeviceProperties::pipelineCacheUUID                                                    +
 // +-------------------------------------------------------------------------------------------------------------------------------------------------------+
 
-        const uint32_t file_size = file.tellg();
-        file.seekg(0, std::ios::beg);
-        char *cache_data = VKTRACE_NEW_ARRAY(char, file_size);
-        file.read(cache_data, file_size);
-        file.close();
+        // The data is only handed to vkCreatePipelineCache, map the file
+        // instead of copying it.
+        struct stat64 st;
+        if (0 != fstat64(fd, &st) || 0 == st.st_size) {
+            close(fd);
+            return result;
+        }
+        void *cache_data = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (MAP_FAILED == cache_data) {
+            vktrace_LogWarning("Failed to map pipeline cache data file %s.", full_path.c_str());
+            return result;
+        }
 
         result.first = cache_data;
-        result.second = file_size;
+        result.second = static_cast<size_t>(st.st_size);
 
         return result;
     }
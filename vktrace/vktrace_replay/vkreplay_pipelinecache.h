@@ -31,7 +31,10 @@ extern "C" {
 #include <map>
 #include <list>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <unordered_map>
+#include <vector>
 
 /* Class to handle fetching and sequencing packets from a tracefile.
  * Contains no knowledge of type of tracer needed to process packet.
@@ -60,10 +63,28 @@ namespace vktrace_replay {
 
             std::list<std::pair<VkDevice, VkPipelineCache>> GetCollectedPacketInfo() const;
         private:
+            // One cache data file, parsed from its name
+            // <gpi>-<cache handle>-<gpu info>-<pipeline cache uuid>.dat
+            struct CacheFileInfo {
+                uint64_t    cache_handle;
+                uint64_t    gpu_info;
+                std::string uuid;
+                std::string full_path;
+            };
+
             std::pair<void*, size_t> ReadPipelineCache(const std::string &full_path);
+            void                     BuildIndex();
+            const CacheFileInfo*     FindIndexed(const uint64_t &gpi, const uint64_t &cache_handle, const uint64_t *gpu_info, const std::string *uuid) const;
 
         private:
+            // The cache directory is scanned once, lookups go through the
+            // index which is keyed by the global packet index of vkCreatePipelineCache.
+            std::unordered_map<uint64_t, std::vector<CacheFileInfo>> m_index;
+            // Loaded cache data is mapped read-only from the data file.
             std::map<uint64_t, std::pair<void*, size_t>>           m_cachemap;
+            std::map<uint64_t, std::string>                        m_loadedFiles;
+            std::vector<std::pair<void*, size_t>>                  m_retiredCaches;
+            mutable std::mutex                                     m_mutex;
             std::map<VkPipelineCache, uint64_t>                    m_pipelineCacheToGpi;
             std::list<std::pair<VkDevice, VkPipelineCache>>        m_collected_packetinfo_list;
             std::string                                            m_cachepath;
@@ -0,0 +1,520 @@
+/*
+ *
+ * Copyright (C) 2016-2024 ARM Limited
+ * All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+extern "C" {
+#include "vktrace_trace_packet_utils.h"
+}
+
+#include <atomic>
+#include <functional>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "vktrace_packet_scanner.h"
+#include "vkreplay_pipelineprewarm.h"
+#include "vkreplay_vkreplay.h"
+#include "vk_enum_string_helper.h"
+
+static uint32_t s_threadCount = 0;
+static std::unordered_map<VkDevice, std::vector<vktrace_trace_packet_header *>> s_devicePackets;
+static PipelinePrewarmStats s_stats = {};
+
+static bool is_prewarm_packet(uint16_t packetId) {
+    switch (packetId) {
+        case VKTRACE_TPI_VK_vkCreateShaderModule:
+        case VKTRACE_TPI_VK_vkDestroyShaderModule:
+        case VKTRACE_TPI_VK_vkCreateDescriptorSetLayout:
+        case VKTRACE_TPI_VK_vkDestroyDescriptorSetLayout:
+        case VKTRACE_TPI_VK_vkCreatePipelineLayout:
+        case VKTRACE_TPI_VK_vkDestroyPipelineLayout:
+        case VKTRACE_TPI_VK_vkCreateRenderPass:
+        case VKTRACE_TPI_VK_vkCreateRenderPass2:
+        case VKTRACE_TPI_VK_vkCreateRenderPass2KHR:
+        case VKTRACE_TPI_VK_vkDestroyRenderPass:
+        case VKTRACE_TPI_VK_vkCreateGraphicsPipelines:
+        case VKTRACE_TPI_VK_vkCreateComputePipelines:
+            return true;
+        default:
+            return false;
+    }
+}
+
+// Returns false for the creations which failed when the trace was captured.
+static bool get_packet_device(const vktrace_trace_packet_header *pHeader, VkDevice *pDevice) {
+    switch (pHeader->packet_id) {
+#define PREWARM_CREATE_PACKET(name)                                       \
+    case VKTRACE_TPI_VK_##name: {                                         \
+        const packet_##name *pPacket = (const packet_##name *)pHeader->pBody; \
+        *pDevice = pPacket->device;                                       \
+        return pPacket->result == VK_SUCCESS;                             \
+    }
+#define PREWARM_DESTROY_PACKET(name)                                      \
+    case VKTRACE_TPI_VK_##name: {                                         \
+        const packet_##name *pPacket = (const packet_##name *)pHeader->pBody; \
+        *pDevice = pPacket->device;                                       \
+        return true;                                                      \
+    }
+        PREWARM_CREATE_PACKET(vkCreateShaderModule)
+        PREWARM_CREATE_PACKET(vkCreateDescriptorSetLayout)
+        PREWARM_CREATE_PACKET(vkCreatePipelineLayout)
+        PREWARM_CREATE_PACKET(vkCreateRenderPass)
+        PREWARM_CREATE_PACKET(vkCreateRenderPass2)
+        PREWARM_CREATE_PACKET(vkCreateRenderPass2KHR)
+        PREWARM_CREATE_PACKET(vkCreateGraphicsPipelines)
+        PREWARM_CREATE_PACKET(vkCreateComputePipelines)
+        PREWARM_DESTROY_PACKET(vkDestroyShaderModule)
+        PREWARM_DESTROY_PACKET(vkDestroyDescriptorSetLayout)
+        PREWARM_DESTROY_PACKET(vkDestroyPipelineLayout)
+        PREWARM_DESTROY_PACKET(vkDestroyRenderPass)
+#undef PREWARM_CREATE_PACKET
+#undef PREWARM_DESTROY_PACKET
+        default:
+            return false;
+    }
+}
+
+bool init_pipeline_prewarm(FileLike *pFile, uint64_t firstPacketOffset, decompressor *pDecompressor, uint32_t threadCount) {
+    uint64_t startTime = vktrace_get_time();
+    vktrace_PacketScanner *pScanner = vktrace_PacketScanner_create(pFile, firstPacketOffset, 0);
+    if (pScanner == nullptr) {
+        return false;
+    }
+
+    uint64_t originalFilePos = vktrace_FileLike_GetCurrentPosition(pFile);
+    uint64_t packetCount = 0;
+    bool success = true;
+    vktrace_trace_packet_header header;
+    uint64_t position = 0;
+    while (vktrace_PacketScanner_next(pScanner, &header, &position)) {
+        if (header.packet_id != VKTRACE_TPI_BLOB && !is_prewarm_packet(header.packet_id)) {
+            continue;
+        }
+        if (!vktrace_FileLike_SetCurrentPosition(pFile, position)) {
+            success = false;
+            break;
+        }
+        vktrace_trace_packet_header *pPacket = vktrace_read_trace_packet(pFile);
+        if (pPacket == nullptr) {
+            success = false;
+            break;
+        }
+        if (pPacket->tracer_id == VKTRACE_TID_VULKAN_COMPRESSED && decompress_packet(pDecompressor, pPacket) != 0) {
+            vktrace_LogError("Decompress packet error.");
+            vktrace_free(pPacket);
+            success = false;
+            break;
+        }
+        if (pPacket->packet_id == VKTRACE_TPI_BLOB) {
+            // The packets referencing the blob are interpreted below, long before the replay gets to register it.
+            vktrace_register_blob(pPacket);
+            vktrace_free(pPacket);
+            continue;
+        }
+
+        VkDevice traceDevice = VK_NULL_HANDLE;
+        if (interpret_trace_packet_vk(pPacket) == nullptr || !get_packet_device(pPacket, &traceDevice)) {
+            vktrace_free(pPacket);
+            continue;
+        }
+        s_devicePackets[traceDevice].push_back(pPacket);
+        packetCount++;
+    }
+    vktrace_PacketScanner_delete(&pScanner);
+
+    if (!vktrace_FileLike_SetCurrentPosition(pFile, originalFilePos)) {
+        success = false;
+    }
+    if (!success) {
+        vktrace_LogError("Failed to collect the packets of the pipeline pre-warm pass.");
+        free_pipeline_prewarm_packets();
+        return false;
+    }
+
+    s_threadCount = threadCount;
+    s_stats.time += vktrace_get_time() - startTime;
+    vktrace_LogVerbose("Collected %" PRIu64 " packets for the pipeline pre-warm pass in %.6fs.", packetCount,
+                       static_cast<double>(vktrace_get_time() - startTime) / NANOSEC_IN_ONE_SEC);
+    return true;
+}
+
+bool pipeline_prewarm_enabled() { return s_threadCount > 0; }
+
+void free_pipeline_prewarm_packets() {
+    for (auto &devicePackets : s_devicePackets) {
+        for (auto pPacket : devicePackets.second) {
+            vktrace_free(pPacket);
+        }
+    }
+    s_devicePackets.clear();
+}
+
+PipelinePrewarmStats get_pipeline_prewarm_stats() { return s_stats; }
+
+namespace vktrace_replay {
+
+// Replays the collected packets of one device into private objects and
+// compiles the pipelines into a pipeline cache. The handles in the packets are
+// trace handles, they are remapped with the maps of the pre-warmer and never
+// touch the object mapper of the replay.
+class PipelinePrewarmer {
+   public:
+    PipelinePrewarmer(VkDevice device, const VkLayerDispatchTable *pTable, VkPipelineCache cache)
+        : m_device(device), m_pTable(pTable), m_cache(cache), m_skippedCount(0), m_compiledCount(0), m_failedCount(0) {}
+    ~PipelinePrewarmer() { DestroyObjects(); }
+
+    void Replay(vktrace_trace_packet_header *pHeader);
+
+    // Compile all pipelines collected by Replay() and wait for them.
+    void Compile(uint32_t threadCount);
+
+    uint64_t GetCompiledCount() const { return m_compiledCount; }
+    uint64_t GetSkippedCount() const { return m_skippedCount; }
+    uint64_t GetFailedCount() const { return m_failedCount; }
+
+   private:
+    void CreateShaderModule(packet_vkCreateShaderModule *pPacket);
+    void CreateDescriptorSetLayout(packet_vkCreateDescriptorSetLayout *pPacket);
+    void CreatePipelineLayout(packet_vkCreatePipelineLayout *pPacket);
+    void AddRenderPass(VkResult result, VkRenderPass traceRenderPass, VkRenderPass renderPass);
+    void AddGraphicsPipelines(packet_vkCreateGraphicsPipelines *pPacket);
+    void AddComputePipelines(packet_vkCreateComputePipelines *pPacket);
+    void DestroyObjects();
+
+    // Remaps a trace handle, *pHandle is left VK_NULL_HANDLE if it is not known.
+    template <typename T>
+    static bool Remap(const std::unordered_map<T, T> &map, T *pHandle) {
+        if (*pHandle == VK_NULL_HANDLE) {
+            return true;
+        }
+        auto it = map.find(*pHandle);
+        *pHandle = (it != map.end()) ? it->second : VK_NULL_HANDLE;
+        return *pHandle != VK_NULL_HANDLE;
+    }
+
+    VkDevice m_device;
+    const VkLayerDispatchTable *m_pTable;
+    VkPipelineCache m_cache;
+
+    // Objects destroyed in the trace are removed from the maps, so the trace
+    // handles can be reused, but are kept alive until the pipelines are compiled.
+    std::unordered_map<VkShaderModule, VkShaderModule> m_shaderModules;
+    std::unordered_map<VkDescriptorSetLayout, VkDescriptorSetLayout> m_setLayouts;
+    std::unordered_map<VkPipelineLayout, VkPipelineLayout> m_pipelineLayouts;
+    std::unordered_map<VkRenderPass, VkRenderPass> m_renderPasses;
+    std::vector<VkShaderModule> m_createdShaderModules;
+    std::vector<VkDescriptorSetLayout> m_createdSetLayouts;
+    std::vector<VkPipelineLayout> m_createdPipelineLayouts;
+    std::vector<VkRenderPass> m_createdRenderPasses;
+
+    // One job per pipeline, the create infos point into the packets.
+    std::vector<std::function<VkResult()>> m_jobs;
+    uint64_t m_skippedCount;
+    std::atomic<uint64_t> m_compiledCount;
+    std::atomic<uint64_t> m_failedCount;
+};
+
+void PipelinePrewarmer::Replay(vktrace_trace_packet_header *pHeader) {
+    switch (pHeader->packet_id) {
+        case VKTRACE_TPI_VK_vkCreateShaderModule:
+            CreateShaderModule((packet_vkCreateShaderModule *)pHeader->pBody);
+            break;
+        case VKTRACE_TPI_VK_vkDestroyShaderModule:
+            m_shaderModules.erase(((packet_vkDestroyShaderModule *)pHeader->pBody)->shaderModule);
+            break;
+        case VKTRACE_TPI_VK_vkCreateDescriptorSetLayout:
+            CreateDescriptorSetLayout((packet_vkCreateDescriptorSetLayout *)pHeader->pBody);
+            break;
+        case VKTRACE_TPI_VK_vkDestroyDescriptorSetLayout:
+            m_setLayouts.erase(((packet_vkDestroyDescriptorSetLayout *)pHeader->pBody)->descriptorSetLayout);
+            break;
+        case VKTRACE_TPI_VK_vkCreatePipelineLayout:
+            CreatePipelineLayout((packet_vkCreatePipelineLayout *)pHeader->pBody);
+            break;
+        case VKTRACE_TPI_VK_vkDestroyPipelineLayout:
+            m_pipelineLayouts.erase(((packet_vkDestroyPipelineLayout *)pHeader->pBody)->pipelineLayout);
+            break;
+        case VKTRACE_TPI_VK_vkCreateRenderPass: {
+            packet_vkCreateRenderPass *pPacket = (packet_vkCreateRenderPass *)pHeader->pBody;
+            VkRenderPass renderPass = VK_NULL_HANDLE;
+            VkResult result = m_pTable->CreateRenderPass(m_device, pPacket->pCreateInfo, nullptr, &renderPass);
+            AddRenderPass(result, *pPacket->pRenderPass, renderPass);
+        } break;
+        case VKTRACE_TPI_VK_vkCreateRenderPass2: {
+            packet_vkCreateRenderPass2 *pPacket = (packet_vkCreateRenderPass2 *)pHeader->pBody;
+            VkRenderPass renderPass = VK_NULL_HANDLE;
+            VkResult result = m_pTable->CreateRenderPass2(m_device, pPacket->pCreateInfo, nullptr, &renderPass);
+            AddRenderPass(result, *pPacket->pRenderPass, renderPass);
+        } break;
+        case VKTRACE_TPI_VK_vkCreateRenderPass2KHR: {
+            packet_vkCreateRenderPass2KHR *pPacket = (packet_vkCreateRenderPass2KHR *)pHeader->pBody;
+            VkRenderPass renderPass = VK_NULL_HANDLE;
+            VkResult result = m_pTable->CreateRenderPass2KHR(m_device, pPacket->pCreateInfo, nullptr, &renderPass);
+            AddRenderPass(result, *pPacket->pRenderPass, renderPass);
+        } break;
+        case VKTRACE_TPI_VK_vkDestroyRenderPass:
+            m_renderPasses.erase(((packet_vkDestroyRenderPass *)pHeader->pBody)->renderPass);
+            break;
+        case VKTRACE_TPI_VK_vkCreateGraphicsPipelines:
+            AddGraphicsPipelines((packet_vkCreateGraphicsPipelines *)pHeader->pBody);
+            break;
+        case VKTRACE_TPI_VK_vkCreateComputePipelines:
+            AddComputePipelines((packet_vkCreateComputePipelines *)pHeader->pBody);
+            break;
+        default:
+            break;
+    }
+}
+
+void PipelinePrewarmer::CreateShaderModule(packet_vkCreateShaderModule *pPacket) {
+    // The validation cache is a trace handle.
+    if (find_ext_struct((const vulkan_struct_header *)pPacket->pCreateInfo->pNext,
+                        VK_STRUCTURE_TYPE_SHADER_MODULE_VALIDATION_CACHE_CREATE_INFO_EXT) != nullptr) {
+        m_shaderModules.erase(*pPacket->pShaderModule);
+        return;
+    }
+    VkShaderModule shaderModule = VK_NULL_HANDLE;
+    if (m_pTable->CreateShaderModule(m_device, pPacket->pCreateInfo, nullptr, &shaderModule) != VK_SUCCESS) {
+        m_shaderModules.erase(*pPacket->pShaderModule);
+        return;
+    }
+    m_shaderModules[*pPacket->pShaderModule] = shaderModule;
+    m_createdShaderModules.push_back(shaderModule);
+}
+
+void PipelinePrewarmer::CreateDescriptorSetLayout(packet_vkCreateDescriptorSetLayout *pPacket) {
+    VkDescriptorSetLayoutCreateInfo *pInfo = (VkDescriptorSetLayoutCreateInfo *)pPacket->pCreateInfo;
+    m_setLayouts.erase(*pPacket->pSetLayout);
+    if (pInfo->pBindings != nullptr) {
+        pInfo->pBindings = (VkDescriptorSetLayoutBinding *)vktrace_trace_packet_interpret_buffer_pointer(pPacket->header,
+                                                                                                          (intptr_t)pInfo->pBindings);
+        for (uint32_t i = 0; i < pInfo->bindingCount; i++) {
+            // Immutable samplers are trace handles and would need the samplers of the trace.
+            if (pInfo->pBindings[i].pImmutableSamplers != nullptr &&
+                (pInfo->pBindings[i].descriptorType == VK_DESCRIPTOR_TYPE_SAMPLER ||
+                 pInfo->pBindings[i].descriptorType == VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER)) {
+                return;
+            }
+        }
+    }
+    VkDescriptorSetLayout setLayout = VK_NULL_HANDLE;
+    if (m_pTable->CreateDescriptorSetLayout(m_device, pInfo, nullptr, &setLayout) != VK_SUCCESS) {
+        return;
+    }
+    m_setLayouts[*pPacket->pSetLayout] = setLayout;
+    m_createdSetLayouts.push_back(setLayout);
+}
+
+void PipelinePrewarmer::CreatePipelineLayout(packet_vkCreatePipelineLayout *pPacket) {
+    VkPipelineLayoutCreateInfo *pInfo = (VkPipelineLayoutCreateInfo *)pPacket->pCreateInfo;
+    m_pipelineLayouts.erase(*pPacket->pPipelineLayout);
+    for (uint32_t i = 0; i < pInfo->setLayoutCount && pInfo->pSetLayouts != nullptr; i++) {
+        if (!Remap(m_setLayouts, (VkDescriptorSetLayout *)&pInfo->pSetLayouts[i])) {
+            return;
+        }
+    }
+    VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+    if (m_pTable->CreatePipelineLayout(m_device, pInfo, nullptr, &pipelineLayout) != VK_SUCCESS) {
+        return;
+    }
+    m_pipelineLayouts[*pPacket->pPipelineLayout] = pipelineLayout;
+    m_createdPipelineLayouts.push_back(pipelineLayout);
+}
+
+void PipelinePrewarmer::AddRenderPass(VkResult result, VkRenderPass traceRenderPass, VkRenderPass renderPass) {
+    if (result != VK_SUCCESS) {
+        m_renderPasses.erase(traceRenderPass);
+        return;
+    }
+    m_renderPasses[traceRenderPass] = renderPass;
+    m_createdRenderPasses.push_back(renderPass);
+}
+
+void PipelinePrewarmer::AddGraphicsPipelines(packet_vkCreateGraphicsPipelines *pPacket) {
+    // Same fix-ups as vkReplay::manually_replay_vkCreateGraphicsPipelines(), the
+    // packet interpreter leaves them to the replay.
+    VkGraphicsPipelineCreateInfo *pCIs = (VkGraphicsPipelineCreateInfo *)pPacket->pCreateInfos;
+    for (uint32_t i = 0; i < pPacket->createInfoCount; i++) {
+        vkreplay_process_pnext_structs(pPacket->header, (void *)&pCIs[i]);
+        vkreplay_process_pnext_structs(pPacket->header, (void *)pCIs[i].pStages);
+        vkreplay_process_pnext_structs(pPacket->header, (void *)pCIs[i].pVertexInputState);
+        vkreplay_process_pnext_structs(pPacket->header, (void *)pCIs[i].pInputAssemblyState);
+        vkreplay_process_pnext_structs(pPacket->header, (void *)pCIs[i].pTessellationState);
+        vkreplay_process_pnext_structs(pPacket->header, (void *)pCIs[i].pViewportState);
+        vkreplay_process_pnext_structs(pPacket->header, (void *)pCIs[i].pRasterizationState);
+        vkreplay_process_pnext_structs(pPacket->header, (void *)pCIs[i].pMultisampleState);
+        vkreplay_process_pnext_structs(pPacket->header, (void *)pCIs[i].pDepthStencilState);
+        vkreplay_process_pnext_structs(pPacket->header, (void *)pCIs[i].pColorBlendState);
+        vkreplay_process_pnext_structs(pPacket->header, (void *)pCIs[i].pDynamicState);
+        if (pCIs[i].pViewportState != nullptr) {
+            VkPipelineViewportStateCreateInfo *pViewportState = (VkPipelineViewportStateCreateInfo *)pCIs[i].pViewportState;
+            pViewportState->pViewports =
+                (VkViewport *)vktrace_trace_packet_interpret_buffer_pointer(pPacket->header, (intptr_t)pViewportState->pViewports);
+            pViewportState->pScissors =
+                (VkRect2D *)vktrace_trace_packet_interpret_buffer_pointer(pPacket->header, (intptr_t)pViewportState->pScissors);
+        }
+        if (pCIs[i].pMultisampleState != nullptr) {
+            VkPipelineMultisampleStateCreateInfo *pMultisampleState = (VkPipelineMultisampleStateCreateInfo *)pCIs[i].pMultisampleState;
+            pMultisampleState->pSampleMask =
+                (VkSampleMask *)vktrace_trace_packet_interpret_buffer_pointer(pPacket->header, (intptr_t)pMultisampleState->pSampleMask);
+        }
+
+        VkGraphicsPipelineCreateInfo createInfo = pCIs[i];
+        if ((createInfo.flags & VK_PIPELINE_CREATE_LIBRARY_BIT_KHR) != 0 ||
+            find_ext_struct((const vulkan_struct_header *)createInfo.pNext, VK_STRUCTURE_TYPE_PIPELINE_LIBRARY_CREATE_INFO_KHR) !=
+                nullptr) {
+            m_skippedCount++;
+            continue;
+        }
+        bool remapped = Remap(m_pipelineLayouts, &createInfo.layout) && Remap(m_renderPasses, &createInfo.renderPass);
+        VkPipelineShaderStageCreateInfo *pStages = (VkPipelineShaderStageCreateInfo *)createInfo.pStages;
+        for (uint32_t j = 0; remapped && j < createInfo.stageCount; j++) {
+            remapped = Remap(m_shaderModules, &pStages[j].module);
+        }
+        if (!remapped) {
+            m_skippedCount++;
+            continue;
+        }
+        // The base pipeline is not created here, derivatives are compiled as standalone pipelines.
+        createInfo.flags &= ~VK_PIPELINE_CREATE_DERIVATIVE_BIT;
+        createInfo.basePipelineHandle = VK_NULL_HANDLE;
+        createInfo.basePipelineIndex = -1;
+
+        m_jobs.push_back([this, createInfo]() {
+            VkPipeline pipeline = VK_NULL_HANDLE;
+            VkResult result = m_pTable->CreateGraphicsPipelines(m_device, m_cache, 1, &createInfo, nullptr, &pipeline);
+            if (result == VK_SUCCESS) {
+                m_pTable->DestroyPipeline(m_device, pipeline, nullptr);
+            }
+            return result;
+        });
+    }
+}
+
+void PipelinePrewarmer::AddComputePipelines(packet_vkCreateComputePipelines *pPacket) {
+    for (uint32_t i = 0; i < pPacket->createInfoCount; i++) {
+        vkreplay_process_pnext_structs(pPacket->header, (void *)&pPacket->pCreateInfos[i]);
+        VkComputePipelineCreateInfo createInfo = pPacket->pCreateInfos[i];
+        if (!Remap(m_pipelineLayouts, &createInfo.layout) || !Remap(m_shaderModules, &createInfo.stage.module)) {
+            m_skippedCount++;
+            continue;
+        }
+        createInfo.flags &= ~VK_PIPELINE_CREATE_DERIVATIVE_BIT;
+        createInfo.basePipelineHandle = VK_NULL_HANDLE;
+        createInfo.basePipelineIndex = -1;
+
+        m_jobs.push_back([this, createInfo]() {
+            VkPipeline pipeline = VK_NULL_HANDLE;
+            VkResult result = m_pTable->CreateComputePipelines(m_device, m_cache, 1, &createInfo, nullptr, &pipeline);
+            if (result == VK_SUCCESS) {
+                m_pTable->DestroyPipeline(m_device, pipeline, nullptr);
+            }
+            return result;
+        });
+    }
+}
+
+void PipelinePrewarmer::Compile(uint32_t threadCount) {
+    std::atomic<size_t> nextJob(0);
+    auto worker = [this, &nextJob]() {
+        for (size_t i = nextJob++; i < m_jobs.size(); i = nextJob++) {
+            if (m_jobs[i]() == VK_SUCCESS) {
+                m_compiledCount++;
+            } else {
+                m_failedCount++;
+            }
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (uint32_t i = 0; i < threadCount && i < m_jobs.size(); i++) {
+        workers.emplace_back(worker);
+    }
+    for (auto &thread : workers) {
+        thread.join();
+    }
+    m_jobs.clear();
+}
+
+void PipelinePrewarmer::DestroyObjects() {
+    for (auto shaderModule : m_createdShaderModules) {
+        m_pTable->DestroyShaderModule(m_device, shaderModule, nullptr);
+    }
+    for (auto pipelineLayout : m_createdPipelineLayouts) {
+        m_pTable->DestroyPipelineLayout(m_device, pipelineLayout, nullptr);
+    }
+    for (auto setLayout : m_createdSetLayouts) {
+        m_pTable->DestroyDescriptorSetLayout(m_device, setLayout, nullptr);
+    }
+    for (auto renderPass : m_createdRenderPasses) {
+        m_pTable->DestroyRenderPass(m_device, renderPass, nullptr);
+    }
+    m_createdShaderModules.clear();
+    m_createdPipelineLayouts.clear();
+    m_createdSetLayouts.clear();
+    m_createdRenderPasses.clear();
+    m_shaderModules.clear();
+    m_setLayouts.clear();
+    m_pipelineLayouts.clear();
+    m_renderPasses.clear();
+}
+
+}  // namespace vktrace_replay
+
+VkPipelineCache pipeline_prewarm_device(VkDevice traceDevice, VkDevice device, const VkLayerDispatchTable *pTable) {
+    auto it = s_devicePackets.find(traceDevice);
+    if (it == s_devicePackets.end()) {
+        return VK_NULL_HANDLE;
+    }
+    std::vector<vktrace_trace_packet_header *> packets;
+    packets.swap(it->second);
+    s_devicePackets.erase(it);
+
+    uint64_t startTime = vktrace_get_time();
+    VkPipelineCache cache = VK_NULL_HANDLE;
+    VkPipelineCacheCreateInfo cacheCreateInfo = {VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO, nullptr, 0, 0, nullptr};
+    VkResult result = pTable->CreatePipelineCache(device, &cacheCreateInfo, nullptr, &cache);
+    if (result == VK_SUCCESS) {
+        vktrace_replay::PipelinePrewarmer prewarmer(device, pTable, cache);
+        for (auto pPacket : packets) {
+            prewarmer.Replay(pPacket);
+        }
+        prewarmer.Compile(s_threadCount);
+
+        s_stats.pipelineCount += prewarmer.GetCompiledCount();
+        s_stats.skippedCount += prewarmer.GetSkippedCount();
+        s_stats.failedCount += prewarmer.GetFailedCount();
+        vktrace_LogAlways("Pre-warmed %" PRIu64 " pipelines (%" PRIu64 " skipped, %" PRIu64 " failed) with %u threads in %.6fs.",
+                          prewarmer.GetCompiledCount(), prewarmer.GetSkippedCount(), prewarmer.GetFailedCount(), s_threadCount,
+                          static_cast<double>(vktrace_get_time() - startTime) / NANOSEC_IN_ONE_SEC);
+        if (prewarmer.GetCompiledCount() == 0) {
+            pTable->DestroyPipelineCache(device, cache, nullptr);
+            cache = VK_NULL_HANDLE;
+        }
+    } else {
+        vktrace_LogError("Failed to create the pipeline cache of the pre-warm pass: %s.", string_VkResult(result));
+        cache = VK_NULL_HANDLE;
+    }
+
+    for (auto pPacket : packets) {
+        vktrace_free(pPacket);
+    }
+    s_stats.time += vktrace_get_time() - startTime;
+    return cache;
+}
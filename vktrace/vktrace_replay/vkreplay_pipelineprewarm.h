@@ -0,0 +1,68 @@
+/*
+ *
+ * Copyright (C) 2016-2024 ARM Limited
+ * All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#pragma once
+
+#include <cinttypes>
+#include "vulkan/vulkan.h"
+#include "vktrace_filelike.h"
+#include "decompressor.h"
+
+typedef struct VkLayerDispatchTable_ VkLayerDispatchTable;
+
+// Pipeline pre-warm pass.
+//
+// Before the replay starts, the trace is scanned for the packets which create
+// shader modules, descriptor set layouts, pipeline layouts, render passes and
+// graphics / compute pipelines. Right after a traced device is created on the
+// replay side, those packets are replayed into private objects and the
+// pipelines are compiled on worker threads into a new pipeline cache. The
+// pipelines are destroyed as soon as they are compiled, only the cache is
+// kept: the vkCreate*Pipelines calls of the replay use it (or get it merged
+// into the pipeline cache of the trace), so they are served from the cache
+// instead of compiling on the replay thread.
+//
+// Skipped, these are compiled by the replay as usual:
+// - descriptor set layouts with immutable samplers and everything using them,
+// - pipeline libraries and pipelines linking them,
+// - shader modules using a validation cache.
+
+struct PipelinePrewarmStats {
+    uint64_t pipelineCount;  // pipelines compiled into the cache
+    uint64_t skippedCount;   // pipelines which could not be pre-warmed
+    uint64_t failedCount;    // pipelines which failed to compile
+    uint64_t time;           // time spent in the pre-warm passes, in ns
+};
+
+// Collect the packets of the pre-warm pass from the trace. The position of
+// pFile is not changed. Must be called before the replay starts, threadCount
+// is the number of compiling threads.
+bool init_pipeline_prewarm(FileLike* pFile, uint64_t firstPacketOffset, decompressor* pDecompressor, uint32_t threadCount);
+
+bool pipeline_prewarm_enabled();
+
+// Compile the collected pipelines of traceDevice with device and free their
+// packets. Returns the pipeline cache holding them, or VK_NULL_HANDLE if
+// nothing was compiled. The cache belongs to the caller.
+VkPipelineCache pipeline_prewarm_device(VkDevice traceDevice, VkDevice device, const VkLayerDispatchTable* pTable);
+
+// Free the packets of devices which were never created.
+void free_pipeline_prewarm_packets();
+
+PipelinePrewarmStats get_pipeline_prewarm_stats();
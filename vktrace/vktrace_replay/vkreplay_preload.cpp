@@ -22,12 +22,20 @@ extern "C" {
 }
 
 #include <cinttypes>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
 #include <sys/sysinfo.h>
 
+#include <algorithm>
 #include <thread>
 #include <mutex>
 #include <condition_variable>
 #include <fstream>
+#include <string>
+#include <vector>
 
 #include "vkreplay_factory.h"
 #include "vkreplay_preload.h"
@@ -38,6 +46,10 @@ extern "C" {
 #define SIZE_1K         1024
 #define SIZE_1M         (SIZE_1K * SIZE_1K)
 
+// Packet id of the records which are loaded in a chunk in place of a spilled
+// packet. It is a reserved id which never appears in a trace file.
+#define PRELOAD_SPILLED_PACKET_ID VKTRACE_TPI_RESERVED_ID_13
+
 enum chunk_status {
     CHUNK_EMPTY,
     CHUNK_LOADING,
@@ -59,12 +71,26 @@ enum skip_notify_status {
     SKIP_NOTIFY
 };
 
+// A packet loaded in the scratch file instead of a chunk.
+struct spilled_packet {
+    char*    address = nullptr;
+    uint64_t offset  = 0;
+    uint64_t size    = 0;
+};
+
+// Loaded in a chunk in place of a spilled packet.
+struct spilled_packet_record {
+    vktrace_trace_packet_header  header;    // packet_id is PRELOAD_SPILLED_PACKET_ID
+    vktrace_trace_packet_header* pPacket;
+};
+
 struct mem_chunk_info {
     uint64_t     chunk_size      = 0;
     char*        base_address    = nullptr;
     char*        current_address = nullptr;
     chunk_status status          = CHUNK_EMPTY;
     std::mutex   mtx;
+    std::vector<spilled_packet> spilled;   // the packets spilled by the content of the chunk
 };
 
 struct simple_sem {
@@ -103,9 +129,29 @@ struct preload_context {
     simple_sem  preload_sem_ready;
     bool        exceed_preloading_range = false;
     uint64_t    preload_waiting_time = 0;
+    uint64_t    preload_mem_size = 0;
+    uint64_t    hit_count = 0;
+    uint64_t    miss_count = 0;
 
 } g_preload_context;
 
+// With a preload memory budget, the packets larger than half a chunk are loaded
+// in a memory mapped scratch file instead of the chunks, a chunk only holds a
+// record pointing to them. The scratch file is only used by the loading thread.
+struct preload_spill_context {
+    bool        enabled = false;
+    int         fd = -1;
+    uint64_t    file_size = 0;
+    uint64_t    mapped_size = 0;
+    uint64_t    peak_mapped_size = 0;
+    uint64_t    spilled_count = 0;
+    uint64_t    spilled_size = 0;
+    // Released on the next chunk reload, the last packet of the reloaded chunk
+    // may still be replaying.
+    std::vector<spilled_packet> retired;
+};
+static preload_spill_context g_preload_spill;
+
 vktrace_trace_packet_header g_preload_header;
 vktrace_trace_packet_header_compression_ext g_preload_header_ext;
 static decompressor* g_decompressor = nullptr;
@@ -116,6 +162,18 @@ uint64_t get_preload_waiting_time_when_replaying()
     return g_preload_context.preload_waiting_time;
 }
 
+PreloadStats get_preload_stats() {
+    PreloadStats stats = {};
+    stats.budget = (uint64_t)replaySettings.preloadMemoryBudget * SIZE_1M;
+    stats.hitCount = g_preload_context.hit_count;
+    stats.missCount = g_preload_context.miss_count;
+    stats.stallTime = g_preload_context.preload_waiting_time;
+    stats.spilledCount = g_preload_spill.spilled_count;
+    stats.spilledBytes = g_preload_spill.spilled_size;
+    stats.peakResidentBytes = g_preload_context.preload_mem_size + g_preload_spill.peak_mapped_size;
+    return stats;
+}
+
 static uint64_t get_system_memory_size() {
     struct sysinfo si;
     if (sysinfo(&si)) {
@@ -163,11 +221,16 @@ static uint64_t get_free_memory_size() {
 
 static uint32_t calc_chunk_count(uint64_t sys_mem_size, uint64_t chunk_size, uint64_t file_size) {
     uint32_t chunk_count = 0;
-    uint64_t system_total_mem_size = get_system_memory_size();
-    uint64_t preload_mem_size = sys_mem_size * replaySettings.memoryPercentage / 100;
-    if (preload_mem_size > system_total_mem_size / 2) {
-        vktrace_LogAlways("Init preload: The system total memory size = %llu, the free memory size greater than system_total_mem_size / 2.", system_total_mem_size);
-        preload_mem_size = system_total_mem_size / 2;
+    uint64_t preload_mem_size = 0;
+    if (replaySettings.preloadMemoryBudget > 0) {
+        preload_mem_size = (uint64_t)replaySettings.preloadMemoryBudget * SIZE_1M;
+    } else {
+        uint64_t system_total_mem_size = get_system_memory_size();
+        preload_mem_size = sys_mem_size * replaySettings.memoryPercentage / 100;
+        if (preload_mem_size > system_total_mem_size / 2) {
+            vktrace_LogAlways("Init preload: The system total memory size = %llu, the free memory size greater than system_total_mem_size / 2.", system_total_mem_size);
+            preload_mem_size = system_total_mem_size / 2;
+        }
     }
     preload_mem_size = std::min(preload_mem_size, MAX_CHUNK_COUNT * chunk_size);
     if (file_size <= preload_mem_size) {
@@ -279,6 +342,9 @@ static uint64_t load_packet(FileLike* file, void* load_addr, uint64_t packet_siz
         case VKTRACE_TPI_META_DATA:
         case VKTRACE_TPI_PORTABILITY_TABLE:
             break;
+        case VKTRACE_TPI_BLOB:
+            vktrace_register_blob(pHeader);
+            break;
 #if VK_ANDROID_frame_boundary
         case VKTRACE_TPI_VK_vkFrameBoundaryANDROID:
 #endif
@@ -310,28 +376,21 @@ static uint64_t load_packet(FileLike* file, void* load_addr, uint64_t packet_siz
                 vktrace_LogError("Bad packet type id=%d, index=%d.", pHeader->packet_id, pHeader->global_packet_index);
             }
             extern vkReplay* g_pReplayer;
+            if (replaySettings.premapping && g_pReplayer->premap(pHeader)) {
+                pHeader->packet_id += PREMAP_SHIFT;
+            }
             switch (pHeader->packet_id) {
-                case VKTRACE_TPI_VK_vkFlushMappedMemoryRanges: {
-                    if (replaySettings.premapping && g_pReplayer->premap_FlushMappedMemoryRanges(pHeader)) {
-                        pHeader->packet_id += PREMAP_SHIFT;
-                    }
-                    break;
-                }
-                case VKTRACE_TPI_VK_vkUpdateDescriptorSets: {
-                    if (replaySettings.premapping && g_pReplayer->premap_UpdateDescriptorSets(pHeader)) {
-                        pHeader->packet_id += PREMAP_SHIFT;
-                    }
-                    break;
-                }
-                case VKTRACE_TPI_VK_vkCmdBindDescriptorSets: {
-                    if (replaySettings.premapping && g_pReplayer->premap_CmdBindDescriptorSets(pHeader)) {
-                        pHeader->packet_id += PREMAP_SHIFT;
-                    }
-                    break;
-                }
-                case VKTRACE_TPI_VK_vkCmdDrawIndexed: {
-                    if (replaySettings.premapping && g_pReplayer->premap_CmdDrawIndexed(pHeader)) {
-                        pHeader->packet_id += PREMAP_SHIFT;
+                case VKTRACE_TPI_VK_vkCreateGraphicsPipelines:
+                case VKTRACE_TPI_VK_vkCreateComputePipelines:
+                case VKTRACE_TPI_VK_vkDestroyShaderModule:
+                case VKTRACE_TPI_VK_vkDestroyPipelineLayout:
+                case VKTRACE_TPI_VK_vkDestroyRenderPass:
+                case VKTRACE_TPI_VK_vkDestroyPipelineCache:
+                case VKTRACE_TPI_VK_vkDestroyDevice: {
+                    // Pipelines can be created ahead of the replay when the
+                    // objects they use are not destroyed before.
+                    if (replaySettings.asyncPipelineThreads > 0) {
+                        g_pReplayer->scan_async_pipelines(pHeader);
                     }
                     break;
                 }
@@ -376,6 +435,96 @@ bool preloaded_whole()
     return preloaded_whole_range;
 }
 
+static bool init_spill() {
+    // The scratch file is unlinked right away, it is removed when it is closed.
+    std::string path = std::string(replaySettings.pTraceFilePath) + ".preload-spill";
+    g_preload_spill.fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (g_preload_spill.fd < 0) {
+        vktrace_LogWarning("Init preload: failed to create the scratch file %s, large packets won't be spilled.", path.c_str());
+        return false;
+    }
+    unlink(path.c_str());
+    g_preload_spill.enabled = true;
+    return true;
+}
+
+static bool spill_needed(uint64_t packet_size, uint64_t chunk_size) {
+    return g_preload_spill.enabled && packet_size >= chunk_size / 2;
+}
+
+// Map a region of the scratch file for a packet of the chunk, nullptr if it fails.
+static vktrace_trace_packet_header* spill_map(mem_chunk_info* chunk, uint64_t packet_size) {
+    static const uint64_t page_size = sysconf(_SC_PAGESIZE);
+    spilled_packet packet;
+    packet.offset = g_preload_spill.file_size;
+    packet.size = (packet_size + page_size - 1) / page_size * page_size;
+    // Reserve the disk space, a write to a mapping which can't be backed raises SIGBUS.
+    int err = posix_fallocate(g_preload_spill.fd, packet.offset, packet.size);
+    if (err != 0) {
+        vktrace_LogWarning("Failed to extend the preload scratch file to %llu bytes (%s).", packet.offset + packet.size, strerror(err));
+        return nullptr;
+    }
+    void* address = mmap(nullptr, packet.size, PROT_READ | PROT_WRITE, MAP_SHARED, g_preload_spill.fd, packet.offset);
+    if (address == MAP_FAILED) {
+        vktrace_LogWarning("Failed to map the preload scratch file (%s).", strerror(errno));
+        return nullptr;
+    }
+    packet.address = (char*)address;
+    chunk->spilled.push_back(packet);
+
+    g_preload_spill.file_size += packet.size;
+    g_preload_spill.mapped_size += packet.size;
+    g_preload_spill.peak_mapped_size = std::max(g_preload_spill.peak_mapped_size, g_preload_spill.mapped_size);
+    g_preload_spill.spilled_count++;
+    g_preload_spill.spilled_size += packet_size;
+    return (vktrace_trace_packet_header*)packet.address;
+}
+
+static void release_spilled_packets(std::vector<spilled_packet>& packets) {
+    for (auto& packet : packets) {
+        munmap(packet.address, packet.size);
+#if defined(FALLOC_FL_PUNCH_HOLE)
+        fallocate(g_preload_spill.fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, packet.offset, packet.size);
+#endif
+        g_preload_spill.mapped_size -= packet.size;
+    }
+    packets.clear();
+    if (g_preload_spill.mapped_size == 0 && g_preload_spill.file_size > 0) {
+        if (ftruncate(g_preload_spill.fd, 0) == 0) {
+            g_preload_spill.file_size = 0;
+        }
+    }
+}
+
+// The content of the chunk is about to be overwritten.
+static void retire_spilled_packets(mem_chunk_info* chunk, bool release_retired) {
+    if (release_retired) {
+        release_spilled_packets(g_preload_spill.retired);
+    }
+    g_preload_spill.retired.insert(g_preload_spill.retired.end(), chunk->spilled.begin(), chunk->spilled.end());
+    chunk->spilled.clear();
+}
+
+// Load the next packet in the scratch file and a record pointing to it at load_addr.
+static bool load_spilled_packet(mem_chunk_info* chunk, char* load_addr) {
+    vktrace_trace_packet_header* pPacket = spill_map(chunk, g_preload_context.next_pkt_size_decompressed);
+    if (pPacket == nullptr) {
+        // Large packets span several chunks from now on.
+        g_preload_spill.enabled = false;
+        return false;
+    }
+    if (!load_packet(g_preload_context.tracefile, pPacket, g_preload_context.next_pkt_size)) {
+        return false;
+    }
+    spilled_packet_record* pRecord = (spilled_packet_record*)load_addr;
+    pRecord->header = *pPacket;
+    pRecord->header.packet_id = PRELOAD_SPILLED_PACKET_ID;
+    pRecord->header.size = sizeof(spilled_packet_record);
+    pRecord->header.pBody = (uintptr_t)&pRecord->pPacket;
+    pRecord->pPacket = pPacket;
+    return true;
+}
+
 // skipped_to_first, 0: no skipping; 1: skipping detected; 2: skipping notify
 volatile uint32_t skipped_to_first = SKIPPING_NONE;
 volatile uint32_t skipped_notify = SKIP_NOTIFY_NONE;
@@ -408,7 +557,16 @@ static void chunk_loading() {
 
             if (!first_full) {
                 preloaded_whole_range = false;
+                // Pipelines created asynchronously may still read their create
+                // infos from the packets in this chunk, and command buffers
+                // recorded in parallel their commands.
+                extern vkReplay* g_pReplayer;
+                if (g_pReplayer != nullptr) {
+                    g_pReplayer->wait_async_pipelines_idle();
+                    g_pReplayer->wait_parallel_recording_idle();
+                }
             }
+            retire_spilled_packets(cur_chunk, true);
             // loading
             vktrace_LogDebug("Loading chunk %d !", g_preload_context.loading_idx);
             uint32_t loaded_packet_count = 0;
@@ -417,7 +575,8 @@ static void chunk_loading() {
             uint32_t chunks_needed = 1;
 
             // if the loading packet size is larger than the size of a chunk
-            if(g_preload_context.next_pkt_size_decompressed > cur_chunk->chunk_size){
+            if(g_preload_context.next_pkt_size_decompressed > cur_chunk->chunk_size
+               && !spill_needed(g_preload_context.next_pkt_size_decompressed, cur_chunk->chunk_size)){
                 // ceil(chunks_needed)
                 chunks_needed =uint32_t((g_preload_context.next_pkt_size_decompressed - 1) * 1.0 / cur_chunk->chunk_size) + 1;
                 assert(chunks_needed > 1);
@@ -473,6 +632,7 @@ static void chunk_loading() {
                     }
                     tmp_chunk->mtx.lock();
                     vktrace_LogDebug("Chunk %llu is locked when loading.", g_preload_context.loading_idx + i);
+                    retire_spilled_packets(tmp_chunk, false);
                     tmp_chunk->status = CHUNK_LOADING;
                     vktrace_LogDebug("Loading chunk - %d !", g_preload_context.loading_idx + i);
                 }
@@ -491,9 +651,24 @@ static void chunk_loading() {
 
             while (!g_preload_context.exiting_thd
                    && g_preload_context.next_pkt_size_decompressed
-                   && !g_preload_context.exceed_preloading_range
-                   && (cur_chunk->current_address + g_preload_context.next_pkt_size_decompressed) < boundary_addr) {
-                if (!load_packet(g_preload_context.tracefile, cur_chunk->current_address, g_preload_context.next_pkt_size)) {
+                   && !g_preload_context.exceed_preloading_range) {
+                if (spill_needed(g_preload_context.next_pkt_size_decompressed, cur_chunk->chunk_size)) {
+                    if ((cur_chunk->current_address + sizeof(spilled_packet_record)) >= boundary_addr) {
+                        break;
+                    }
+                    if (load_spilled_packet(cur_chunk, cur_chunk->current_address)) {
+                        cur_chunk->current_address += sizeof(spilled_packet_record);
+                        get_packet_size(g_preload_context.tracefile);
+                        loaded_packet_count++;
+                        continue;
+                    }
+                    if (g_preload_spill.enabled) {
+                        break;
+                    }
+                    // the scratch file is full, load the packet in the chunks
+                }
+                if ((cur_chunk->current_address + g_preload_context.next_pkt_size_decompressed) >= boundary_addr
+                    || !load_packet(g_preload_context.tracefile, cur_chunk->current_address, g_preload_context.next_pkt_size)) {
                     break;
                 }
                 cur_chunk->current_address += g_preload_context.next_pkt_size_decompressed;
@@ -541,6 +716,14 @@ bool init_preload(FileLike* file, vktrace_replay::vktrace_trace_packet_replay_li
         replaySettings.preloadChunkSize = 200;
         vktrace_LogAlways("Init preload: the chunk size is too small, adjusted to 200 (MB)!");
     }
+    if (replaySettings.preloadMemoryBudget > 0) {
+        vktrace_LogAlways("Init preload: memory budget: %u (MB)", replaySettings.preloadMemoryBudget);
+        // Two chunks at least, one is loaded while the other one is replayed.
+        if (replaySettings.preloadChunkSize > replaySettings.preloadMemoryBudget / 2) {
+            replaySettings.preloadChunkSize = std::max(replaySettings.preloadMemoryBudget / 2, 1u);
+            vktrace_LogAlways("Init preload: the chunk size is too large for the budget, adjusted to %u (MB)!", replaySettings.preloadChunkSize);
+        }
+    }
 
     static const uint64_t chunk_size  = replaySettings.preloadChunkSize * SIZE_1M;
     uint32_t chunk_count = calc_chunk_count(system_free_mem_size, chunk_size, filesize);
@@ -559,6 +742,7 @@ bool init_preload(FileLike* file, vktrace_replay::vktrace_trace_packet_replay_li
     }
 
     g_preload_context.chunk_count = chunk_count;
+    g_preload_context.preload_mem_size = chunk_size * chunk_count;
     g_preload_context.tracefile   = file;
     g_preload_context.loading_idx = chunk_count;
     g_preload_context.using_idx   = chunk_count;
@@ -574,6 +758,10 @@ bool init_preload(FileLike* file, vktrace_replay::vktrace_trace_packet_replay_li
             g_preload_context.chunks[i].current_address = g_preload_context.chunks[i].base_address;
         }
 
+        if (replaySettings.preloadMemoryBudget > 0 && g_preload_spill.fd < 0) {
+            init_spill();
+        }
+
         get_packet_size(g_preload_context.tracefile);
         g_preload_context.thd_obj = std::thread(chunk_loading);
 
@@ -631,12 +819,19 @@ vktrace_trace_packet_header* preload_get_next_packet()
     }
 
     if (cur_chunk->status == CHUNK_READY || cur_chunk->status == CHUNK_LOADING) {
+        bool hit = cur_chunk->status == CHUNK_READY;
         uint64_t start_time = vktrace_get_time();
         cur_chunk->mtx.lock();
         vktrace_LogDebug("Chunk %llu is locked when preloading !", g_preload_context.using_idx);
         uint64_t end_time = vktrace_get_time();
-        if (vktrace_replay::timerStarted())
+        if (vktrace_replay::timerStarted()) {
             g_preload_context.preload_waiting_time += end_time - start_time;
+            if (hit) {
+                g_preload_context.hit_count++;
+            } else {
+                g_preload_context.miss_count++;
+            }
+        }
         assert(cur_chunk->status == CHUNK_READY);
         if(boundary_addr == cur_chunk->current_address){
             vktrace_LogDebug("This chunk has nothing! Too many chunks when preloading !");
@@ -659,6 +854,10 @@ vktrace_trace_packet_header* preload_get_next_packet()
     if (pHeader->size == 0) {
         vktrace_LogError("This is a wrong packetage !");
     }
+    vktrace_trace_packet_header* pPacket = pHeader;
+    if (pHeader->packet_id == PRELOAD_SPILLED_PACKET_ID) {
+        pPacket = ((spilled_packet_record*)pHeader)->pPacket;
+    }
     cur_chunk->current_address += pHeader->size;
     if(replaySettings.printCurrentPacketIndex > 1) {
         vktrace_LogDebug("Chunk (%llu), pHeader: %p,id %llu, size: %llu, boundary_addr: %p",
@@ -714,7 +913,7 @@ vktrace_trace_packet_header* preload_get_next_packet()
             });
         }
     }
-    return pHeader;
+    return pPacket;
 }
 
 void exit_preload() {
@@ -730,5 +929,14 @@ void exit_preload() {
         vktrace_free(g_preload_context.preload_mem);
         g_preload_context.preload_mem = nullptr;
     }
+    if (g_preload_spill.fd >= 0) {
+        for (uint32_t i = 0; i < g_preload_context.chunk_count; i++) {
+            release_spilled_packets(g_preload_context.chunks[i].spilled);
+        }
+        release_spilled_packets(g_preload_spill.retired);
+        close(g_preload_spill.fd);
+        g_preload_spill.fd = -1;
+        g_preload_spill.enabled = false;
+    }
 }
 
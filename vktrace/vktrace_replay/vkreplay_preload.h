@@ -27,4 +27,17 @@ void exit_preload();
 uint64_t get_preload_waiting_time_when_replaying();
 bool preloaded_whole();
 
+// The hits, misses and stall time are counted while the frame range is replayed.
+struct PreloadStats {
+    uint64_t budget;             // preload memory budget in bytes, 0 when it is derived from the free memory
+    uint64_t hitCount;           // chunks which were loaded when the replay reached them
+    uint64_t missCount;          // chunks the replay had to wait for
+    uint64_t stallTime;          // time the replay waited for chunks, in ns
+    uint64_t spilledCount;       // packets loaded in the scratch file
+    uint64_t spilledBytes;
+    uint64_t peakResidentBytes;  // the chunks plus the peak size of the mapped scratch file
+};
+
+PreloadStats get_preload_stats();
+
 #endif /* _VKTRACE_PRELOAD_H_ */
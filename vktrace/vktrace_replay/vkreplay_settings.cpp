@@ -80,6 +80,17 @@ static vkreplayer_settings s_defaultVkReplaySettings = {
                                                             .fDevBuild2HostBuild = FALSE,
                                                             .useTraceSurfaceTransformFlagBit = FALSE,
                                                             .insertDeviceExtension = NULL,
+                                                            .asyncPipelineThreads = 0,
+                                                            .memoryPoolThreshold = 0,
+                                                            .checkpointFrames = NULL,
+                                                            .checkpointFile = NULL,
+                                                            .prewarmPipelineThreads = 0,
+                                                            .preloadMemoryBudget = 0,
+                                                            .parallelRecordingThreads = 0,
+                                                            .gpuTimestamps = FALSE,
+                                                            .memoryStatsInterval = 0,
+                                                            .noPresent = FALSE,
+                                                            .enableVscAlias = FALSE,
                                                        };
 
 vktrace_SettingInfo g_vk_settings_info[] = {
@@ -439,7 +450,84 @@ vktrace_SettingInfo g_vk_settings_info[] = {
      {&g_vkReplaySettings.insertDeviceExtension},
      {&s_defaultVkReplaySettings.insertDeviceExtension},
      TRUE,
-     "Insert device extension."}
+     "Insert device extension."},
+    {"apt",
+     "asyncPipelineThreads",
+     VKTRACE_SETTING_UINT,
+     {&g_vkReplaySettings.asyncPipelineThreads},
+     {&s_defaultVkReplaySettings.asyncPipelineThreads},
+     TRUE,
+     "Number of worker threads creating pipelines asynchronously while replaying the preloaded frame range, 0 creates them on the replay thread. Requires PreloadTraceFile. Default is 0."},
+    {"mpt",
+     "memoryPoolThreshold",
+     VKTRACE_SETTING_UINT,
+     {&g_vkReplaySettings.memoryPoolThreshold},
+     {&s_defaultVkReplaySettings.memoryPoolThreshold},
+     TRUE,
+     "Place device memory allocations up to <uint> KB into shared 64 MB blocks to reduce driver allocations. 0 disables pooling. Default is 0."},
+    {"cpf",
+     "checkpointFrames",
+     VKTRACE_SETTING_STRING,
+     {&g_vkReplaySettings.checkpointFrames},
+     {&s_defaultVkReplaySettings.checkpointFrames},
+     TRUE,
+     "Write a checkpoint at frame <startframe>: the replay is recaptured by the trace layer and trimmed from that frame, the checkpoint holds the object state and resource contents at <startframe> followed by the frames up to <endframe> (default: end of the trace). <string> is <startframe>[-<endframe>]."},
+    {"cpo",
+     "checkpointFile",
+     VKTRACE_SETTING_STRING,
+     {&g_vkReplaySettings.checkpointFile},
+     {&s_defaultVkReplaySettings.checkpointFile},
+     TRUE,
+     "Path of the checkpoint written by -cpf. Default is <tracefile>.checkpoint-<startframe>.vktrace."},
+    {"pwt",
+     "prewarmPipelineThreads",
+     VKTRACE_SETTING_UINT,
+     {&g_vkReplaySettings.prewarmPipelineThreads},
+     {&s_defaultVkReplaySettings.prewarmPipelineThreads},
+     TRUE,
+     "Number of worker threads compiling the shader modules and pipelines of the trace into a pipeline cache right after the device is created, so the replay creates them from the cache. 0 disables the pre-warm pass. Default is 0."},
+    {"pmb",
+     "preloadMemoryBudget",
+     VKTRACE_SETTING_UINT,
+     {&g_vkReplaySettings.preloadMemoryBudget},
+     {&s_defaultVkReplaySettings.preloadMemoryBudget},
+     TRUE,
+     "Memory budget of the preloaded trace in MB. Packets larger than half a preload chunk are spilled to a memory mapped scratch file next to the trace file. Requires PreloadTraceFile. Default is 0, the budget is derived from the free memory."},
+    {"prt",
+     "parallelRecordingThreads",
+     VKTRACE_SETTING_UINT,
+     {&g_vkReplaySettings.parallelRecordingThreads},
+     {&s_defaultVkReplaySettings.parallelRecordingThreads},
+     TRUE,
+     "Number of worker threads recording the command buffers of different command pools concurrently while replaying the preloaded frame range, 0 records them on the replay thread. Requires PreloadTraceFile. Default is 0."},
+    {"gts",
+     "gpuTimestamps",
+     VKTRACE_SETTING_BOOL,
+     {&g_vkReplaySettings.gpuTimestamps},
+     {&s_defaultVkReplaySettings.gpuTimestamps},
+     TRUE,
+     "Measure the GPU time of every queue submission with timestamp queries, the per-frame and per-submit GPU time is written to vktrace_result.json. Default is FALSE."},
+    {"msi",
+     "memoryStatsInterval",
+     VKTRACE_SETTING_UINT,
+     {&g_vkReplaySettings.memoryStatsInterval},
+     {&s_defaultVkReplaySettings.memoryStatsInterval},
+     TRUE,
+     "Sample the process RSS, the size of the live device memory allocations per memory type and the heap budget and usage (VK_EXT_memory_budget) every <uint> frames, the samples and peaks are written to vktrace_result.json. Default is 0, no sampling."},
+    {"npr",
+     "noPresent",
+     VKTRACE_SETTING_BOOL,
+     {&g_vkReplaySettings.noPresent},
+     {&s_defaultVkReplaySettings.noPresent},
+     TRUE,
+     "Benchmark without presentation: acquires only signal their semaphore and fence and presents only wait for their semaphores, nothing is copied to or shown on the swapchain. Frames are still counted. Requires enableVirtualSwapchain. Default is FALSE."},
+    {"vsca",
+     "enableVscAlias",
+     VKTRACE_SETTING_BOOL,
+     {&g_vkReplaySettings.enableVscAlias},
+     {&s_defaultVkReplaySettings.enableVscAlias},
+     TRUE,
+     "Render the trace directly into the swapchain images instead of the virtual images when the replay swapchain has the format, extent and image count of the trace, so presents skip the copy from the virtual image. Acquires are retried until they return the image index of the trace, as with forceSyncImgIdx. Requires enableVirtualSwapchain. Default is FALSE."}
 };
 
 vktrace_SettingGroup g_vkReplaySettingGroup = { "vkreplay_vk", sizeof(g_vk_settings_info) / sizeof(g_vk_settings_info[0]), &g_vk_settings_info[0], nullptr };
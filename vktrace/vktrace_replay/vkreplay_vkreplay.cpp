@@ -222,6 +222,17 @@ vkreplayer_settings replaySettings = {
                                         .fDevBuild2HostBuild = FALSE,
                                         .useTraceSurfaceTransformFlagBit = FALSE,
                                         .insertDeviceExtension = NULL,
+                                        .asyncPipelineThreads = 0,
+                                        .memoryPoolThreshold = 0,
+                                        .checkpointFrames = NULL,
+                                        .checkpointFile = NULL,
+                                        .prewarmPipelineThreads = 0,
+                                        .preloadMemoryBudget = 0,
+                                        .parallelRecordingThreads = 0,
+                                        .gpuTimestamps = FALSE,
+                                        .memoryStatsInterval = 0,
+                                        .noPresent = FALSE,
+                                        .enableVscAlias = FALSE,
                                      };
 
 namespace vktrace_replay {
@@ -247,7 +258,9 @@ vkReplay::vkReplay(vkreplayer_settings *pReplaySettings, vktrace_trace_file_head
                    vktrace_replay::ReplayDisplayImp *display)
     : m_objMapper(pReplaySettings->premapping)
     , initialized_screenshot_list("")
-    , m_pipelinecache_accessor(std::make_shared<vktrace_replay::PipelineCacheAccessor>()) {
+    , m_pipelinecache_accessor(std::make_shared<vktrace_replay::PipelineCacheAccessor>())
+    , m_asyncPipelineFailed(false)
+    , m_asyncPipelineLookAhead(false) {
     g_pReplaySettings = pReplaySettings;
     m_pDSDump = NULL;
     m_pCBDump = NULL;
@@ -289,6 +302,46 @@ vkReplay::vkReplay(vkreplayer_settings *pReplaySettings, vktrace_trace_file_head
     }
     rtHandler = new RayTracingPipelineHandlerVer1;
 
+    if (g_pReplaySettings->asyncPipelineThreads > 0) {
+        if (g_pReplaySettings->preloadTraceFile) {
+            m_asyncPipelineCompiler.reset(new vktrace_replay::AsyncPipelineCompiler(g_pReplaySettings->asyncPipelineThreads));
+            m_objMapper.m_resolveAsyncPipeline = [this](VkPipeline tracePipeline) {
+                if (m_asyncPipelineCompiler->HasPending()) {
+                    resolve_async_pipeline(tracePipeline);
+                }
+            };
+        } else {
+            vktrace_LogWarning("asyncPipelineThreads needs PreloadTraceFile, pipelines will be created on the replay thread.");
+        }
+    }
+
+    if (g_pReplaySettings->parallelRecordingThreads > 0) {
+        if (g_pReplaySettings->preloadTraceFile) {
+            m_parallelRecorder.reset(new vktrace_replay::ParallelRecorder(
+                g_pReplaySettings->parallelRecordingThreads, [this](vktrace_trace_packet_header *packet) {
+                    // Reported by the replay thread, see pop_parallel_recording_result().
+                    return replay(packet) == vktrace_replay::VKTRACE_REPLAY_SUCCESS;
+                }));
+        } else {
+            vktrace_LogWarning("parallelRecordingThreads needs PreloadTraceFile, command buffers will be recorded on the replay thread.");
+        }
+    }
+
+    if (g_pReplaySettings->gpuTimestamps) {
+        m_gpuTimestamps.reset(new vktrace_replay::GpuTimestamps(&m_vkDeviceFuncs));
+    }
+
+    if (g_pReplaySettings->memoryPoolThreshold > 0) {
+        // Pooling anything bigger than a quarter of a block would waste most of it.
+        VkDeviceSize blockSize = 64 * 1024 * 1024;
+        VkDeviceSize threshold = std::min<VkDeviceSize>(VkDeviceSize(g_pReplaySettings->memoryPoolThreshold) * 1024, blockSize / 4);
+        init_memory_pool(threshold, blockSize);
+    }
+
+    if (g_pReplaySettings->memoryStatsInterval > 0) {
+        init_memory_stats(g_pReplaySettings->memoryStatsInterval);
+    }
+
     if (g_pReplaySettings->fDevBuild2HostBuild == TRUE) {
         g_devBuild2HostBuild_state = DEVBUILD_TO_HOSTBUILD_REQUESTED;
     }
@@ -303,8 +356,17 @@ std::vector<uintptr_t> portabilityTablePackets;
 FileLike *traceFile;
 
 void vkReplay::destroyObjects(const VkDevice &device) {
+    if (m_parallelRecorder != nullptr) {
+        m_parallelRecorder->Sync();
+    }
+    resolve_all_async_pipelines();
+    release_unclaimed_async_pipelines(device);
+    release_prewarm_pipeline_cache(device);
+
     // Make sure no gpu job is running before quit vkreplay
     m_vkDeviceFuncs.DeviceWaitIdle(device);
+    release_gpu_timestamps(device);
+    memory_stats_remove_device(device);
 
     // Destroy all objects created from the device before destroy device.
     // Reference:
@@ -518,6 +580,11 @@ void vkReplay::destroyObjects(const VkDevice &device) {
 }
 
 vkReplay::~vkReplay() {
+    m_parallelRecorder.reset();
+    resolve_all_async_pipelines();
+    m_objMapper.m_resolveAsyncPipeline = nullptr;
+    m_asyncPipelineCompiler.reset();
+
     for (auto subobj = traceQueueFamilyProperties.begin(); subobj != traceQueueFamilyProperties.end(); subobj++) {
         free(subobj->second.queueFamilyProperties);
     }
@@ -678,15 +745,35 @@ void vkReplay::push_validation_msg(VkFlags msgFlags, VkDebugReportObjectTypeEXT
     strncpy(msgObj.msg, pMsg, 256);
     msgObj.msg[255] = '\0';
     msgObj.pUserData = (void *)pUserData;
+    std::lock_guard<std::mutex> lock(m_validationMsgsMutex);
     m_validationMsgs.push_back(msgObj);
 }
 
 vktrace_replay::VKTRACE_REPLAY_RESULT vkReplay::pop_validation_msgs() {
+    std::lock_guard<std::mutex> lock(m_validationMsgsMutex);
     if (m_validationMsgs.size() == 0) return vktrace_replay::VKTRACE_REPLAY_SUCCESS;
     m_validationMsgs.clear();
     return vktrace_replay::VKTRACE_REPLAY_VALIDATION_ERROR;
 }
 
+// The result of the packets recorded on the parallel recording threads since
+// the previous ordering point, called by the replay thread once they are done.
+vktrace_replay::VKTRACE_REPLAY_RESULT vkReplay::pop_parallel_recording_result() {
+    if (m_parallelRecorder == nullptr) {
+        return vktrace_replay::VKTRACE_REPLAY_SUCCESS;
+    }
+    vktrace_replay::VKTRACE_REPLAY_RESULT result = vktrace_replay::VKTRACE_REPLAY_SUCCESS;
+    for (vktrace_trace_packet_header *packet : m_parallelRecorder->TakeFailedPackets()) {
+        vktrace_LogError("Failed to replay packet_id %d, with global_packet_index %d.", packet->packet_id,
+                         packet->global_packet_index);
+        result = vktrace_replay::VKTRACE_REPLAY_ERROR;
+    }
+    // The validation messages of the recorded packets, as the replay thread
+    // hasn't replayed anything since they were queued.
+    vktrace_replay::VKTRACE_REPLAY_RESULT validationResult = pop_validation_msgs();
+    return result != vktrace_replay::VKTRACE_REPLAY_SUCCESS ? result : validationResult;
+}
+
 int vkReplay::dump_validation_data() {
     if (m_pDSDump && m_pCBDump) {
         m_pDSDump((char *)"pipeline_dump.dot");
@@ -2481,6 +2568,23 @@ VkResult vkReplay::manually_replay_vkCreateDevice(packet_vkCreateDevice *pPacket
 
         // Build device dispatch table
         layer_init_device_dispatch_table(device, &m_vkDeviceFuncs, m_vkDeviceFuncs.GetDeviceProcAddr);
+        if (memory_pool_enabled()) {
+            VkPhysicalDeviceProperties properties = {};
+            VkPhysicalDeviceMemoryProperties memoryProperties = {};
+            m_vkFuncs.GetPhysicalDeviceProperties(remappedPhysicalDevice, &properties);
+            m_vkFuncs.GetPhysicalDeviceMemoryProperties(remappedPhysicalDevice, &memoryProperties);
+            memory_pool_hook_dispatch_table(&m_vkDeviceFuncs);
+            memory_pool_add_device(device, properties, memoryProperties);
+        }
+        if (memory_stats_enabled()) {
+            add_memory_stats_device(device, remappedPhysicalDevice);
+        }
+        if (pipeline_prewarm_enabled()) {
+            VkPipelineCache prewarmCache = pipeline_prewarm_device(*(pPacket->pDevice), device, &m_vkDeviceFuncs);
+            if (prewarmCache != VK_NULL_HANDLE) {
+                m_prewarmPipelineCaches[device] = prewarmCache;
+            }
+        }
 #if VK_ANDROID_frame_boundary
     if(m_vkDeviceFuncs_tmp.FrameBoundaryANDROID == nullptr) {
         m_vkDeviceFuncs_tmp.FrameBoundaryANDROID = (PFN_vkFrameBoundaryANDROID)  m_vkDeviceFuncs.GetDeviceProcAddr(device, "vkFrameBoundaryANDROID");
@@ -2598,6 +2702,23 @@ VkResult vkReplay::manually_replay_vkCreateDevice(packet_vkCreateDevice *pPacket
         g_pReplaySettings->forceSyncImgIdx = false;
     }
 
+    // Without presents the frames only exist in the virtual swapchain images.
+    if (g_pReplaySettings->noPresent && (!g_pReplaySettings->enableVirtualSwapchain || m_bScreenshotLayer)) {
+        vktrace_LogWarning("npr: noPresent needs enableVirtualSwapchain and no screenshot layer, the frames will be presented.");
+        g_pReplaySettings->noPresent = false;
+    }
+
+    // The aliased swapchain images are presented, and the acquires must return
+    // the image index of the trace since the trace renders to that image.
+    if (g_pReplaySettings->enableVscAlias) {
+        if (!g_pReplaySettings->enableVirtualSwapchain || g_pReplaySettings->enableVscPerfMode || g_pReplaySettings->noPresent) {
+            vktrace_LogWarning("vsca: enableVscAlias needs enableVirtualSwapchain without enableVscPerfMode and noPresent, the virtual images will not be aliased.");
+            g_pReplaySettings->enableVscAlias = false;
+        } else {
+            g_pReplaySettings->forceSyncImgIdx = true;
+        }
+    }
+
     forceDisableCaptureReplayFeature();
     vktrace_LogAlways("Actual using device feature CaptureReplay: BDA %d, AS %d, RTPSGH %d, SGHSize %llu",
                     replayDeviceToFeatureSupport[device].bufferDeviceAddressCaptureReplay, replayDeviceToFeatureSupport[device].accelerationStructureCaptureReplay,
@@ -3193,7 +3314,41 @@ VkResult vkReplay::manually_replay_vkQueueSubmit(packet_vkQueueSubmit *pPacket)
             }
         }
     }
-    replayResult = m_vkDeviceFuncs.QueueSubmit(remappedQueue, pPacket->submitCount, remappedSubmits, remappedFence);
+    return submit_remapped(pPacket->queue, remappedQueue, pPacket->submitCount, remappedSubmits, remappedFence);
+}
+
+// Submit the remapped batches of a vkQueueSubmit() of traceQueue.
+VkResult vkReplay::submit_remapped(VkQueue traceQueue, VkQueue remappedQueue, uint32_t submitCount, VkSubmitInfo *remappedSubmits,
+                                   VkFence remappedFence) {
+    // Measure the GPU time of the submission: the timestamp command buffers go
+    // first in the first batch and last in the last batch. The fence of the
+    // timestamps is signaled by the submission if the trace has no fence.
+    VkSubmitInfo *submits = remappedSubmits;
+    std::vector<VkSubmitInfo> timedSubmits;
+    std::vector<VkCommandBuffer> firstCommandBuffers, lastCommandBuffers;
+    VkCommandBuffer beginCommandBuffer, endCommandBuffer;
+    VkFence timestampFence = VK_NULL_HANDLE;
+    bool timed = false;
+    if (m_gpuTimestamps != nullptr && can_measure_submit(submitCount, remappedSubmits)) {
+        timed = begin_gpu_timestamp_submit(traceQueue, remappedQueue, &beginCommandBuffer, &endCommandBuffer, &timestampFence);
+    }
+    if (timed) {
+        timedSubmits.assign(remappedSubmits, remappedSubmits + submitCount);
+        VkSubmitInfo &first = timedSubmits.front();
+        firstCommandBuffers.push_back(beginCommandBuffer);
+        firstCommandBuffers.insert(firstCommandBuffers.end(), first.pCommandBuffers, first.pCommandBuffers + first.commandBufferCount);
+        first.commandBufferCount = static_cast<uint32_t>(firstCommandBuffers.size());
+        first.pCommandBuffers = firstCommandBuffers.data();
+        VkSubmitInfo &last = timedSubmits.back();
+        lastCommandBuffers.assign(last.pCommandBuffers, last.pCommandBuffers + last.commandBufferCount);
+        lastCommandBuffers.push_back(endCommandBuffer);
+        last.commandBufferCount = static_cast<uint32_t>(lastCommandBuffers.size());
+        last.pCommandBuffers = lastCommandBuffers.data();
+        submits = timedSubmits.data();
+    }
+    VkResult replayResult = m_vkDeviceFuncs.QueueSubmit(remappedQueue, submitCount, submits,
+                                                        (timed && remappedFence == VK_NULL_HANDLE) ? timestampFence : remappedFence);
+    end_gpu_timestamp_submit(timed, remappedQueue, replayResult, remappedFence);
 
 #if VK_ANDROID_frame_boundary
     g_queue = remappedQueue;
@@ -3201,7 +3356,88 @@ VkResult vkReplay::manually_replay_vkQueueSubmit(packet_vkQueueSubmit *pPacket)
     return replayResult;
 }
 
+VkResult vkReplay::manually_replay_vkQueueSubmitPremapped(packet_vkQueueSubmit *pPacket) {
+    VkQueue remappedQueue = m_objMapper.remap_queues(pPacket->queue);
+    if (remappedQueue == VK_NULL_HANDLE) {
+        vktrace_LogError("Skipping vkQueueSubmitPremapped() due to invalid remapped VkQueue.");
+        return VK_ERROR_VALIDATION_FAILED_EXT;
+    }
+
+    VkFence remappedFence = m_objMapper.remap_fences(pPacket->fence);
+    if (pPacket->fence != VK_NULL_HANDLE && remappedFence == VK_NULL_HANDLE) {
+        vktrace_LogError("Skipping vkQueueSubmitPremapped() due to invalid remapped VkFence.");
+        return VK_ERROR_VALIDATION_FAILED_EXT;
+    }
+
+    // The packet keeps the trace semaphores and the premapped command buffers,
+    // the remapped handles go to local arrays so the packet can be replayed again.
+    size_t commandBufferCount = 0;
+    size_t semaphoreCount = 0;
+    for (uint32_t submit_idx = 0; submit_idx < pPacket->submitCount; submit_idx++) {
+        const VkSubmitInfo *submit = &pPacket->pSubmits[submit_idx];
+        commandBufferCount += submit->pCommandBuffers != NULL ? submit->commandBufferCount : 0;
+        semaphoreCount += submit->pWaitSemaphores != NULL ? submit->waitSemaphoreCount : 0;
+        semaphoreCount += submit->pSignalSemaphores != NULL ? submit->signalSemaphoreCount : 0;
+    }
+    std::vector<VkSubmitInfo> remappedSubmits(pPacket->pSubmits, pPacket->pSubmits + pPacket->submitCount);
+    std::vector<VkCommandBuffer> remappedCommandBuffers(commandBufferCount);
+    std::vector<VkSemaphore> remappedSemaphores(semaphoreCount);
+    VkCommandBuffer *pRemappedBuffers = remappedCommandBuffers.data();
+    VkSemaphore *pRemappedSems = remappedSemaphores.data();
+
+    for (uint32_t submit_idx = 0; submit_idx < pPacket->submitCount; submit_idx++) {
+        const VkSubmitInfo *submit = &pPacket->pSubmits[submit_idx];
+        VkSubmitInfo *remappedSubmit = &remappedSubmits[submit_idx];
+        uint32_t i = 0;
+        if (submit->pCommandBuffers != NULL) {
+            remappedSubmit->pCommandBuffers = pRemappedBuffers;
+            for (i = 0; i < submit->commandBufferCount; i++, pRemappedBuffers++) {
+                *pRemappedBuffers = *reinterpret_cast<VkCommandBuffer *>(submit->pCommandBuffers[i]);
+                if (*pRemappedBuffers == VK_NULL_HANDLE) {
+                    vktrace_LogError("Skipping vkQueueSubmitPremapped() due to invalid remapped VkCommandBuffer.");
+                    return VK_ERROR_VALIDATION_FAILED_EXT;
+                }
+            }
+        }
+        if (submit->pWaitSemaphores != NULL) {
+            remappedSubmit->pWaitSemaphores = pRemappedSems;
+            for (i = 0; i < submit->waitSemaphoreCount; i++, pRemappedSems++) {
+                *pRemappedSems = m_objMapper.remap_semaphores(submit->pWaitSemaphores[i]);
+                if (g_pReplaySettings->forceSyncImgIdx) {
+                    if (acquireSemaphoreToFSIISemaphore.find(*pRemappedSems) != acquireSemaphoreToFSIISemaphore.end()) {
+                        *pRemappedSems = acquireSemaphoreToFSIISemaphore[*pRemappedSems];
+                    }
+                }
+                if (*pRemappedSems == VK_NULL_HANDLE) {
+                    vktrace_LogError("Skipping vkQueueSubmitPremapped() due to invalid remapped wait VkSemaphore.");
+                    return VK_ERROR_VALIDATION_FAILED_EXT;
+                }
+            }
+        }
+        if (submit->pSignalSemaphores != NULL) {
+            remappedSubmit->pSignalSemaphores = pRemappedSems;
+            for (i = 0; i < submit->signalSemaphoreCount; i++, pRemappedSems++) {
+                *pRemappedSems = m_objMapper.remap_semaphores(submit->pSignalSemaphores[i]);
+                if (*pRemappedSems == VK_NULL_HANDLE) {
+                    vktrace_LogError("Skipping vkQueueSubmitPremapped() due to invalid remapped signal VkSemaphore.");
+                    return VK_ERROR_VALIDATION_FAILED_EXT;
+                }
+            }
+        }
+    }
+    return submit_remapped(pPacket->queue, remappedQueue, pPacket->submitCount, remappedSubmits.data(), remappedFence);
+}
+
 VkResult vkReplay::manually_replay_vkQueueSubmit2(packet_vkQueueSubmit2 *pPacket) {
+    return manually_replay_vkQueueSubmit2(pPacket, m_vkDeviceFuncs.QueueSubmit2);
+}
+
+VkResult vkReplay::manually_replay_vkQueueSubmit2KHR(packet_vkQueueSubmit2KHR *pPacket) {
+    // vkQueueSubmit2KHR has the same packet layout.
+    return manually_replay_vkQueueSubmit2(reinterpret_cast<packet_vkQueueSubmit2 *>(pPacket), m_vkDeviceFuncs.QueueSubmit2KHR);
+}
+
+VkResult vkReplay::manually_replay_vkQueueSubmit2(packet_vkQueueSubmit2 *pPacket, PFN_vkQueueSubmit2 queueSubmit2) {
     VkResult replayResult = VK_ERROR_VALIDATION_FAILED_EXT;
     VkQueue remappedQueue = m_objMapper.remap_queues(pPacket->queue);
     if (remappedQueue == VK_NULL_HANDLE) {
@@ -3258,7 +3494,123 @@ VkResult vkReplay::manually_replay_vkQueueSubmit2(packet_vkQueueSubmit2 *pPacket
             }
         }
     }
-    replayResult = m_vkDeviceFuncs.QueueSubmit2(remappedQueue, pPacket->submitCount, remappedSubmits, remappedFence);
+    return submit2_remapped(pPacket->queue, remappedQueue, pPacket->submitCount, remappedSubmits, remappedFence, queueSubmit2);
+}
+
+VkResult vkReplay::manually_replay_vkQueueSubmit2Premapped(packet_vkQueueSubmit2 *pPacket) {
+    return manually_replay_vkQueueSubmit2Premapped(pPacket, m_vkDeviceFuncs.QueueSubmit2);
+}
+
+VkResult vkReplay::manually_replay_vkQueueSubmit2KHRPremapped(packet_vkQueueSubmit2KHR *pPacket) {
+    return manually_replay_vkQueueSubmit2Premapped(reinterpret_cast<packet_vkQueueSubmit2 *>(pPacket), m_vkDeviceFuncs.QueueSubmit2KHR);
+}
+
+VkResult vkReplay::manually_replay_vkQueueSubmit2Premapped(packet_vkQueueSubmit2 *pPacket, PFN_vkQueueSubmit2 queueSubmit2) {
+    VkQueue remappedQueue = m_objMapper.remap_queues(pPacket->queue);
+    if (remappedQueue == VK_NULL_HANDLE) {
+        vktrace_LogError("Skipping vkQueueSubmit2Premapped() due to invalid remapped VkQueue.");
+        return VK_ERROR_VALIDATION_FAILED_EXT;
+    }
+
+    VkFence remappedFence = m_objMapper.remap_fences(pPacket->fence);
+    if (pPacket->fence != VK_NULL_HANDLE && remappedFence == VK_NULL_HANDLE) {
+        vktrace_LogError("Skipping vkQueueSubmit2Premapped() due to invalid remapped VkFence.");
+        return VK_ERROR_VALIDATION_FAILED_EXT;
+    }
+
+    // See manually_replay_vkQueueSubmitPremapped().
+    size_t commandBufferCount = 0;
+    size_t semaphoreCount = 0;
+    for (uint32_t submit_idx = 0; submit_idx < pPacket->submitCount; submit_idx++) {
+        const VkSubmitInfo2 *submit = &pPacket->pSubmits[submit_idx];
+        commandBufferCount += submit->pCommandBufferInfos != NULL ? submit->commandBufferInfoCount : 0;
+        semaphoreCount += submit->pWaitSemaphoreInfos != NULL ? submit->waitSemaphoreInfoCount : 0;
+        semaphoreCount += submit->pSignalSemaphoreInfos != NULL ? submit->signalSemaphoreInfoCount : 0;
+    }
+    std::vector<VkSubmitInfo2> remappedSubmits(pPacket->pSubmits, pPacket->pSubmits + pPacket->submitCount);
+    std::vector<VkCommandBufferSubmitInfo> remappedCommandBuffers(commandBufferCount);
+    std::vector<VkSemaphoreSubmitInfo> remappedSemaphores(semaphoreCount);
+    VkCommandBufferSubmitInfo *pRemappedBuffers = remappedCommandBuffers.data();
+    VkSemaphoreSubmitInfo *pRemappedSems = remappedSemaphores.data();
+
+    for (uint32_t submit_idx = 0; submit_idx < pPacket->submitCount; submit_idx++) {
+        const VkSubmitInfo2 *submit = &pPacket->pSubmits[submit_idx];
+        VkSubmitInfo2 *remappedSubmit = &remappedSubmits[submit_idx];
+        uint32_t i = 0;
+        if (submit->pCommandBufferInfos != NULL) {
+            remappedSubmit->pCommandBufferInfos = pRemappedBuffers;
+            for (i = 0; i < submit->commandBufferInfoCount; i++, pRemappedBuffers++) {
+                *pRemappedBuffers = submit->pCommandBufferInfos[i];
+                pRemappedBuffers->commandBuffer = *reinterpret_cast<VkCommandBuffer *>(submit->pCommandBufferInfos[i].commandBuffer);
+                if (pRemappedBuffers->commandBuffer == VK_NULL_HANDLE) {
+                    vktrace_LogError("Skipping vkQueueSubmit2Premapped() due to invalid remapped VkCommandBuffer.");
+                    return VK_ERROR_VALIDATION_FAILED_EXT;
+                }
+            }
+        }
+        if (submit->pWaitSemaphoreInfos != NULL) {
+            remappedSubmit->pWaitSemaphoreInfos = pRemappedSems;
+            for (i = 0; i < submit->waitSemaphoreInfoCount; i++, pRemappedSems++) {
+                *pRemappedSems = submit->pWaitSemaphoreInfos[i];
+                pRemappedSems->semaphore = m_objMapper.remap_semaphores(submit->pWaitSemaphoreInfos[i].semaphore);
+                if (g_pReplaySettings->forceSyncImgIdx) {
+                    if (acquireSemaphoreToFSIISemaphore.find(pRemappedSems->semaphore) != acquireSemaphoreToFSIISemaphore.end()) {
+                        pRemappedSems->semaphore = acquireSemaphoreToFSIISemaphore[pRemappedSems->semaphore];
+                    }
+                }
+                if (pRemappedSems->semaphore == VK_NULL_HANDLE) {
+                    vktrace_LogError("Skipping vkQueueSubmit2Premapped() due to invalid remapped wait VkSemaphore.");
+                    return VK_ERROR_VALIDATION_FAILED_EXT;
+                }
+            }
+        }
+        if (submit->pSignalSemaphoreInfos != NULL) {
+            remappedSubmit->pSignalSemaphoreInfos = pRemappedSems;
+            for (i = 0; i < submit->signalSemaphoreInfoCount; i++, pRemappedSems++) {
+                *pRemappedSems = submit->pSignalSemaphoreInfos[i];
+                pRemappedSems->semaphore = m_objMapper.remap_semaphores(submit->pSignalSemaphoreInfos[i].semaphore);
+                if (pRemappedSems->semaphore == VK_NULL_HANDLE) {
+                    vktrace_LogError("Skipping vkQueueSubmit2Premapped() due to invalid remapped signal VkSemaphore.");
+                    return VK_ERROR_VALIDATION_FAILED_EXT;
+                }
+            }
+        }
+    }
+    return submit2_remapped(pPacket->queue, remappedQueue, pPacket->submitCount, remappedSubmits.data(), remappedFence, queueSubmit2);
+}
+
+// Submit the remapped batches of a vkQueueSubmit2() of traceQueue, see submit_remapped().
+VkResult vkReplay::submit2_remapped(VkQueue traceQueue, VkQueue remappedQueue, uint32_t submitCount, VkSubmitInfo2 *remappedSubmits,
+                                    VkFence remappedFence, PFN_vkQueueSubmit2 queueSubmit2) {
+    VkSubmitInfo2 *submits = remappedSubmits;
+    std::vector<VkSubmitInfo2> timedSubmits;
+    std::vector<VkCommandBufferSubmitInfo> firstCommandBuffers, lastCommandBuffers;
+    VkCommandBufferSubmitInfo beginCommandBuffer = {VK_STRUCTURE_TYPE_COMMAND_BUFFER_SUBMIT_INFO, NULL, VK_NULL_HANDLE, 0};
+    VkCommandBufferSubmitInfo endCommandBuffer = beginCommandBuffer;
+    VkFence timestampFence = VK_NULL_HANDLE;
+    bool timed = false;
+    if (m_gpuTimestamps != nullptr && can_measure_submit(submitCount, remappedSubmits)) {
+        timed = begin_gpu_timestamp_submit(traceQueue, remappedQueue, &beginCommandBuffer.commandBuffer,
+                                           &endCommandBuffer.commandBuffer, &timestampFence);
+    }
+    if (timed) {
+        timedSubmits.assign(remappedSubmits, remappedSubmits + submitCount);
+        VkSubmitInfo2 &first = timedSubmits.front();
+        firstCommandBuffers.push_back(beginCommandBuffer);
+        firstCommandBuffers.insert(firstCommandBuffers.end(), first.pCommandBufferInfos,
+                                   first.pCommandBufferInfos + first.commandBufferInfoCount);
+        first.commandBufferInfoCount = static_cast<uint32_t>(firstCommandBuffers.size());
+        first.pCommandBufferInfos = firstCommandBuffers.data();
+        VkSubmitInfo2 &last = timedSubmits.back();
+        lastCommandBuffers.assign(last.pCommandBufferInfos, last.pCommandBufferInfos + last.commandBufferInfoCount);
+        lastCommandBuffers.push_back(endCommandBuffer);
+        last.commandBufferInfoCount = static_cast<uint32_t>(lastCommandBuffers.size());
+        last.pCommandBufferInfos = lastCommandBuffers.data();
+        submits = timedSubmits.data();
+    }
+    VkResult replayResult = queueSubmit2(remappedQueue, submitCount, submits,
+                                         (timed && remappedFence == VK_NULL_HANDLE) ? timestampFence : remappedFence);
+    end_gpu_timestamp_submit(timed, remappedQueue, replayResult, remappedFence);
 #if VK_ANDROID_frame_boundary
     g_queue = remappedQueue;
 #endif
@@ -3910,8 +4262,553 @@ VkResult vkReplay::manually_replay_vkGetPipelineCacheData(packet_vkGetPipelineCa
     return replayResult;
 }
 
+bool vkReplay::use_async_pipeline_creation(VkResult traceResult) const {
+    // The workers read the create infos after the packet has been replayed, so
+    // the packet must stay in the preload memory.
+    return m_asyncPipelineCompiler != nullptr && traceResult == VK_SUCCESS && g_pReplaySettings->preloadTraceFile &&
+           vktrace_replay::timerStarted();
+}
+
+void vkReplay::add_async_pipelines(const vktrace_replay::AsyncPipelineCompiler::JobPtr &job) {
+    if (job->result != VK_SUCCESS) {
+        // Reported as the result of the packet being replayed, the pipelines
+        // are left unmapped as when they are created on the replay thread.
+        handle_replay_errors(job->entrypointName, job->result, VK_SUCCESS, vktrace_replay::VKTRACE_REPLAY_SUCCESS);
+        m_asyncPipelineFailed = true;
+        return;
+    }
+    for (size_t i = 0; i < job->tracePipelines.size(); i++) {
+        m_objMapper.add_to_pipelines_map(job->tracePipelines[i], job->replayPipelines[i]);
+        replayPipelineToDevice[job->replayPipelines[i]] = job->device;
+    }
+}
+
+void vkReplay::resolve_async_pipeline(VkPipeline tracePipeline) {
+    auto job = m_asyncPipelineCompiler->Take(tracePipeline);
+    if (job != nullptr) {
+        add_async_pipelines(job);
+    }
+}
+
+void vkReplay::resolve_all_async_pipelines() {
+    if (m_asyncPipelineCompiler == nullptr || !m_asyncPipelineCompiler->HasPending()) {
+        return;
+    }
+    for (auto &job : m_asyncPipelineCompiler->TakeAll()) {
+        add_async_pipelines(job);
+    }
+}
+
+void vkReplay::release_unclaimed_async_pipelines(VkDevice device) {
+    if (m_asyncPipelineCompiler == nullptr) {
+        return;
+    }
+    // Pipelines created ahead of packets which are never reached.
+    for (auto &job : m_asyncPipelineCompiler->TakeUnclaimed(device)) {
+        if (job->result == VK_SUCCESS) {
+            for (auto pipeline : job->replayPipelines) {
+                m_vkDeviceFuncs.DestroyPipeline(job->device, pipeline, NULL);
+            }
+        }
+    }
+}
+
+void vkReplay::sync_async_pipelines(vktrace_trace_packet_header *packet) {
+    // Objects which the pending pipelines were created from must not go away
+    // while the workers may still use them. The pipelines created ahead don't
+    // use objects destroyed before their packet (see scan_async_pipelines()).
+    switch (packet->packet_id) {
+        case VKTRACE_TPI_VK_vkMergePipelineCaches:
+            // dstCache must be externally synchronized, also against the
+            // pipelines created ahead.
+            resolve_all_async_pipelines();
+            m_asyncPipelineCompiler->WaitIdle();
+            break;
+        case VKTRACE_TPI_VK_vkDestroyShaderModule:
+        case VKTRACE_TPI_VK_vkDestroyPipelineLayout:
+        case VKTRACE_TPI_VK_vkDestroyRenderPass:
+        case VKTRACE_TPI_VK_vkDestroyPipelineCache:
+        case VKTRACE_TPI_VK_vkGetPipelineCacheData:
+            resolve_all_async_pipelines();
+            break;
+        case VKTRACE_TPI_VK_vkDestroyDevice:
+            resolve_all_async_pipelines();
+            release_unclaimed_async_pipelines(m_objMapper.remap_devices(((packet_vkDestroyDevice *)packet->pBody)->device));
+            break;
+        default:
+            break;
+    }
+}
+
+void vkReplay::wait_async_pipelines_idle() {
+    if (m_asyncPipelineCompiler != nullptr) {
+        m_asyncPipelineCompiler->WaitIdle();
+    }
+}
+
+static bool has_pipeline_dependencies_in_pnext(vktrace_trace_packet_header *pHeader, const void *pNext) {
+    // The pNext chain is not interpreted yet, its pointers are offsets in the packet.
+    const vulkan_struct_header *pStruct =
+        (const vulkan_struct_header *)vktrace_trace_packet_interpret_buffer_pointer(pHeader, (intptr_t)pNext);
+    while (pStruct != nullptr) {
+        if (pStruct->sType == VK_STRUCTURE_TYPE_PIPELINE_LIBRARY_CREATE_INFO_KHR ||
+            pStruct->sType == VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_SHADER_GROUPS_CREATE_INFO_NV) {
+            return true;
+        }
+        pStruct = (const vulkan_struct_header *)vktrace_trace_packet_interpret_buffer_pointer(pHeader, (intptr_t)pStruct->pNext);
+    }
+    return false;
+}
+
+void vkReplay::scan_async_pipelines(vktrace_trace_packet_header *pHeader) {
+    // Called by the preload thread for the interpreted packets, in order.
+    if (m_asyncPipelineCompiler == nullptr) {
+        return;
+    }
+    typedef vktrace_replay::AsyncPipelineCompiler::Dependency Dependency;
+    vktrace_replay::AsyncPipelineCompiler::Candidate candidate;
+    candidate.packetIndex = pHeader->global_packet_index;
+    candidate.pHeader = pHeader;
+    switch (pHeader->packet_id) {
+        case VKTRACE_TPI_VK_vkCreateGraphicsPipelines: {
+            packet_vkCreateGraphicsPipelines *pPacket = (packet_vkCreateGraphicsPipelines *)pHeader->pBody;
+            if (pPacket->result != VK_SUCCESS) {
+                return;
+            }
+            candidate.dependencies.push_back({VK_OBJECT_TYPE_DEVICE, (uint64_t)pPacket->device});
+            candidate.dependencies.push_back({VK_OBJECT_TYPE_PIPELINE_CACHE, (uint64_t)pPacket->pipelineCache});
+            for (uint32_t i = 0; i < pPacket->createInfoCount; i++) {
+                const VkGraphicsPipelineCreateInfo &createInfo = pPacket->pCreateInfos[i];
+                // Pipelines derived from or linked with other pipelines are created when reached.
+                if (createInfo.basePipelineHandle != VK_NULL_HANDLE || has_pipeline_dependencies_in_pnext(pHeader, createInfo.pNext)) {
+                    return;
+                }
+                for (uint32_t j = 0; j < createInfo.stageCount; j++) {
+                    candidate.dependencies.push_back({VK_OBJECT_TYPE_SHADER_MODULE, (uint64_t)createInfo.pStages[j].module});
+                }
+                candidate.dependencies.push_back({VK_OBJECT_TYPE_PIPELINE_LAYOUT, (uint64_t)createInfo.layout});
+                candidate.dependencies.push_back({VK_OBJECT_TYPE_RENDER_PASS, (uint64_t)createInfo.renderPass});
+            }
+            break;
+        }
+        case VKTRACE_TPI_VK_vkCreateComputePipelines: {
+            packet_vkCreateComputePipelines *pPacket = (packet_vkCreateComputePipelines *)pHeader->pBody;
+            if (pPacket->result != VK_SUCCESS) {
+                return;
+            }
+            candidate.dependencies.push_back({VK_OBJECT_TYPE_DEVICE, (uint64_t)pPacket->device});
+            candidate.dependencies.push_back({VK_OBJECT_TYPE_PIPELINE_CACHE, (uint64_t)pPacket->pipelineCache});
+            for (uint32_t i = 0; i < pPacket->createInfoCount; i++) {
+                const VkComputePipelineCreateInfo &createInfo = pPacket->pCreateInfos[i];
+                if (createInfo.basePipelineHandle != VK_NULL_HANDLE || has_pipeline_dependencies_in_pnext(pHeader, createInfo.pNext)) {
+                    return;
+                }
+                candidate.dependencies.push_back({VK_OBJECT_TYPE_SHADER_MODULE, (uint64_t)createInfo.stage.module});
+                candidate.dependencies.push_back({VK_OBJECT_TYPE_PIPELINE_LAYOUT, (uint64_t)createInfo.layout});
+            }
+            break;
+        }
+        case VKTRACE_TPI_VK_vkDestroyShaderModule:
+            m_asyncPipelineCompiler->AddDestroy(pHeader->global_packet_index,
+                                                (uint64_t)((packet_vkDestroyShaderModule *)pHeader->pBody)->shaderModule);
+            return;
+        case VKTRACE_TPI_VK_vkDestroyPipelineLayout:
+            m_asyncPipelineCompiler->AddDestroy(pHeader->global_packet_index,
+                                                (uint64_t)((packet_vkDestroyPipelineLayout *)pHeader->pBody)->pipelineLayout);
+            return;
+        case VKTRACE_TPI_VK_vkDestroyRenderPass:
+            m_asyncPipelineCompiler->AddDestroy(pHeader->global_packet_index,
+                                                (uint64_t)((packet_vkDestroyRenderPass *)pHeader->pBody)->renderPass);
+            return;
+        case VKTRACE_TPI_VK_vkDestroyPipelineCache:
+            m_asyncPipelineCompiler->AddDestroy(pHeader->global_packet_index,
+                                                (uint64_t)((packet_vkDestroyPipelineCache *)pHeader->pBody)->pipelineCache);
+            return;
+        case VKTRACE_TPI_VK_vkDestroyDevice:
+            m_asyncPipelineCompiler->AddDestroy(pHeader->global_packet_index, (uint64_t)((packet_vkDestroyDevice *)pHeader->pBody)->device);
+            return;
+        default:
+            return;
+    }
+    // Null handles don't need to exist.
+    auto &dependencies = candidate.dependencies;
+    dependencies.erase(std::remove_if(dependencies.begin(), dependencies.end(), [](const Dependency &d) { return d.handle == 0; }),
+                       dependencies.end());
+    m_asyncPipelineCompiler->AddCandidate(std::move(candidate));
+}
+
+bool vkReplay::async_pipeline_dependencies_ready(const vktrace_replay::AsyncPipelineCompiler::Candidate &candidate) {
+    // Looked up directly, the remap functions log the handles they can't find.
+    for (const auto &dependency : candidate.dependencies) {
+        bool ready = true;
+        switch (dependency.type) {
+            case VK_OBJECT_TYPE_DEVICE:
+                if (g_pReplaySettings->premapping) {
+                    auto it = m_objMapper.m_indirect_devices.find((VkDevice)dependency.handle);
+                    ready = it != m_objMapper.m_indirect_devices.end() && *it->second != VK_NULL_HANDLE;
+                } else {
+                    ready = m_objMapper.m_devices.count((VkDevice)dependency.handle) != 0;
+                }
+                break;
+            case VK_OBJECT_TYPE_PIPELINE_LAYOUT:
+                if (g_pReplaySettings->premapping) {
+                    auto it = m_objMapper.m_indirect_pipelinelayouts.find((VkPipelineLayout)dependency.handle);
+                    ready = it != m_objMapper.m_indirect_pipelinelayouts.end() && *it->second != VK_NULL_HANDLE;
+                } else {
+                    ready = m_objMapper.m_pipelinelayouts.count((VkPipelineLayout)dependency.handle) != 0;
+                }
+                break;
+            case VK_OBJECT_TYPE_SHADER_MODULE:
+                ready = m_objMapper.m_shadermodules.count((VkShaderModule)dependency.handle) != 0;
+                break;
+            case VK_OBJECT_TYPE_RENDER_PASS:
+                ready = m_objMapper.m_renderpasss.count((VkRenderPass)dependency.handle) != 0;
+                break;
+            case VK_OBJECT_TYPE_PIPELINE_CACHE:
+                ready = m_objMapper.m_pipelinecaches.count((VkPipelineCache)dependency.handle) != 0;
+                break;
+            default:
+                break;
+        }
+        if (!ready) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void vkReplay::look_ahead_async_pipelines(vktrace_trace_packet_header *packet) {
+    // Look for pipelines which can be created ahead once per frame, and when
+    // objects the next pipelines may use have just been created.
+    switch (packet->packet_id) {
+        case VKTRACE_TPI_VK_vkQueuePresentKHR:
+        case VKTRACE_TPI_VK_vkCreateShaderModule:
+        case VKTRACE_TPI_VK_vkCreatePipelineLayout:
+        case VKTRACE_TPI_VK_vkCreateRenderPass:
+        case VKTRACE_TPI_VK_vkCreateRenderPass2:
+        case VKTRACE_TPI_VK_vkCreateRenderPass2KHR:
+        case VKTRACE_TPI_VK_vkCreateGraphicsPipelines:
+        case VKTRACE_TPI_VK_vkCreateComputePipelines:
+            break;
+        default:
+            return;
+    }
+    if (!use_async_pipeline_creation(VK_SUCCESS)) {
+        return;
+    }
+    m_asyncPipelineCompiler->LookAhead(packet->global_packet_index, [this](const vktrace_replay::AsyncPipelineCompiler::Candidate &candidate) {
+        if (!async_pipeline_dependencies_ready(candidate)) {
+            return false;
+        }
+        // The manual replay remaps the create infos and submits the job as an
+        // early one, the packet is not replayed again when it is reached.
+        VkResult result = VK_SUCCESS;
+        m_asyncPipelineLookAhead = true;
+        if (candidate.pHeader->packet_id == VKTRACE_TPI_VK_vkCreateGraphicsPipelines) {
+            result = manually_replay_vkCreateGraphicsPipelines((packet_vkCreateGraphicsPipelines *)candidate.pHeader->pBody);
+        } else {
+            result = manually_replay_vkCreateComputePipelines((packet_vkCreateComputePipelines *)candidate.pHeader->pBody);
+        }
+        m_asyncPipelineLookAhead = false;
+        if (result != VK_SUCCESS) {
+            m_asyncPipelineLookAheadFailures.insert(candidate.packetIndex);
+        }
+        return true;
+    });
+}
+
+bool vkReplay::claim_async_pipelines(vktrace_trace_packet_header *pHeader, VkResult *pResult) {
+    if (m_asyncPipelineCompiler == nullptr || m_asyncPipelineLookAhead) {
+        return false;
+    }
+    if (m_asyncPipelineCompiler->Claim(pHeader->global_packet_index)) {
+        *pResult = VK_SUCCESS;
+        return true;
+    }
+    if (m_asyncPipelineLookAheadFailures.erase(pHeader->global_packet_index) != 0) {
+        // Its create infos were remapped when it failed, it can't be replayed again.
+        *pResult = VK_ERROR_VALIDATION_FAILED_EXT;
+        return true;
+    }
+    return false;
+}
+
+vktrace_replay::VKTRACE_REPLAY_RESULT vkReplay::async_pipelines_replayed(vktrace_trace_packet_header *packet,
+                                                                           vktrace_replay::VKTRACE_REPLAY_RESULT result) {
+    look_ahead_async_pipelines(packet);
+    // A pipeline creation which failed on a worker fails the packet which
+    // waited for it.
+    if (m_asyncPipelineFailed.exchange(false) && result == vktrace_replay::VKTRACE_REPLAY_SUCCESS) {
+        return vktrace_replay::VKTRACE_REPLAY_BAD_RETURN;
+    }
+    return result;
+}
+
+VkCommandBuffer vkReplay::get_parallel_command_buffer(vktrace_trace_packet_header *packet) const {
+    static std::vector<int8_t> s_parallelPackets(UINT16_MAX + 1, -1);
+    int8_t &parallel = s_parallelPackets[packet->packet_id];
+    if (parallel < 0) {
+        switch (packet->packet_id) {
+            case VKTRACE_TPI_VK_vkBeginCommandBuffer:
+            case VKTRACE_TPI_VK_vkEndCommandBuffer:
+            case VKTRACE_TPI_VK_vkResetCommandBuffer:
+                parallel = 1;
+                break;
+            // These look up replayer state which is not kept per command buffer.
+            case VKTRACE_TPI_VK_vkCmdCopyBuffer:
+            case VKTRACE_TPI_VK_vkCmdCopyBuffer2:
+            case VKTRACE_TPI_VK_vkCmdCopyBuffer2KHR:
+            // The secondary command buffers must have been recorded.
+            case VKTRACE_TPI_VK_vkCmdExecuteCommands:
+                parallel = 0;
+                break;
+            default: {
+                // Premapped packets hold the premapped command buffer, which is
+                // tracked along with the command buffer of the trace. The derived
+                // packets have no name, they are replayed in order.
+                uint16_t packetId = (packet->packet_id & PREMAP_SHIFT) ? packet->packet_id - PREMAP_SHIFT : packet->packet_id;
+                const char *name = vktrace_vk_packet_id_name((VKTRACE_TRACE_PACKET_ID_VK)packetId);
+                parallel = name != nullptr && strncmp(name, "vkCmd", 5) == 0 && strstr(name, "AccelerationStructure") == nullptr &&
+                           strstr(name, "Micromap") == nullptr && strstr(name, "TraceRays") == nullptr;
+            } break;
+        }
+    }
+    if (!parallel) {
+        return VK_NULL_HANDLE;
+    }
+    if (packet->packet_id == VKTRACE_TPI_VK_vkCmdBindPipeline &&
+        ((packet_vkCmdBindPipeline *)packet->pBody)->pipelineBindPoint == VK_PIPELINE_BIND_POINT_RAY_TRACING_KHR) {
+        // Sets the current ray tracing pipeline of rtHandler.
+        return VK_NULL_HANDLE;
+    }
+    // The command buffer is the first parameter of all of them.
+    return ((packet_vkEndCommandBuffer *)packet->pBody)->commandBuffer;
+}
+
+// The premapped packets hold the address of the replay command buffer in the
+// object mapper instead of the command buffer of the trace.
+std::vector<VkCommandBuffer> vkReplay::get_premapped_command_buffers(uint32_t commandBufferCount, const VkCommandBuffer *pCommandBuffers) {
+    std::vector<VkCommandBuffer> premapped(commandBufferCount);
+    for (uint32_t i = 0; i < commandBufferCount; i++) {
+        premapped[i] = reinterpret_cast<VkCommandBuffer>(m_objMapper.add_null_to_commandbuffers_map(pCommandBuffers[i]));
+    }
+    return premapped;
+}
+
+void vkReplay::track_parallel_command_buffers(vktrace_trace_packet_header *packet) {
+    switch (packet->packet_id) {
+        case VKTRACE_TPI_VK_vkAllocateCommandBuffers: {
+            packet_vkAllocateCommandBuffers *pPacket = (packet_vkAllocateCommandBuffers *)packet->pBody;
+            if (pPacket->result == VK_SUCCESS) {
+                m_parallelRecorder->AddCommandBuffers(pPacket->pAllocateInfo->commandPool, pPacket->pAllocateInfo->commandBufferCount,
+                                                      pPacket->pCommandBuffers);
+                if (g_pReplaySettings->premapping) {
+                    std::vector<VkCommandBuffer> premapped = get_premapped_command_buffers(pPacket->pAllocateInfo->commandBufferCount,
+                                                                                           pPacket->pCommandBuffers);
+                    m_parallelRecorder->AddCommandBuffers(pPacket->pAllocateInfo->commandPool, premapped.size(), premapped.data());
+                }
+            }
+        } break;
+        case VKTRACE_TPI_VK_vkFreeCommandBuffers: {
+            packet_vkFreeCommandBuffers *pPacket = (packet_vkFreeCommandBuffers *)packet->pBody;
+            m_parallelRecorder->RemoveCommandBuffers(pPacket->commandBufferCount, pPacket->pCommandBuffers);
+            if (g_pReplaySettings->premapping) {
+                std::vector<VkCommandBuffer> premapped = get_premapped_command_buffers(pPacket->commandBufferCount, pPacket->pCommandBuffers);
+                m_parallelRecorder->RemoveCommandBuffers(premapped.size(), premapped.data());
+            }
+        } break;
+        case VKTRACE_TPI_VK_vkDestroyCommandPool: {
+            packet_vkDestroyCommandPool *pPacket = (packet_vkDestroyCommandPool *)packet->pBody;
+            m_parallelRecorder->RemoveCommandPool(pPacket->commandPool);
+        } break;
+        default:
+            break;
+    }
+}
+
+bool vkReplay::record_in_parallel(vktrace_trace_packet_header *packet) {
+    if (m_parallelRecorder == nullptr) {
+        return false;
+    }
+    // The workers replay the packets after the replay thread has moved on, so
+    // the packets must stay in the preload memory.
+    VkCommandBuffer commandBuffer = get_parallel_command_buffer(packet);
+    if (commandBuffer != VK_NULL_HANDLE && g_pReplaySettings->preloadTraceFile && vktrace_replay::timerStarted()) {
+        VkCommandPool commandPool = m_parallelRecorder->GetCommandPool(commandBuffer);
+        if (commandPool != VK_NULL_HANDLE) {
+            if (!m_parallelRecorder->HasPending()) {
+                // The workers only read the replayer state, nothing may add to
+                // it until the next ordering point: bind the pending pipelines.
+                resolve_all_async_pipelines();
+            }
+            m_parallelRecorder->Submit(commandPool, packet);
+            return true;
+        }
+    }
+    m_parallelRecorder->Sync();
+    track_parallel_command_buffers(packet);
+    return false;
+}
+
+void vkReplay::wait_parallel_recording_idle() {
+    if (m_parallelRecorder != nullptr) {
+        m_parallelRecorder->WaitIdle();
+    }
+}
+
+// The timestamp command buffers can't be added to protected submissions, or to
+// device group submissions which have a device mask per command buffer.
+static bool can_measure_batch(const void *pNext) {
+    for (auto pStruct = reinterpret_cast<const VkBaseInStructure *>(pNext); pStruct != nullptr; pStruct = pStruct->pNext) {
+        if (pStruct->sType == VK_STRUCTURE_TYPE_DEVICE_GROUP_SUBMIT_INFO ||
+            pStruct->sType == VK_STRUCTURE_TYPE_PROTECTED_SUBMIT_INFO) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool vkReplay::can_measure_submit(uint32_t submitCount, const VkSubmitInfo *pSubmits) const {
+    uint32_t commandBufferCount = 0;
+    for (uint32_t i = 0; i < submitCount; i++) {
+        if (!can_measure_batch(pSubmits[i].pNext)) {
+            return false;
+        }
+        commandBufferCount += pSubmits[i].commandBufferCount;
+    }
+    return commandBufferCount > 0;
+}
+
+bool vkReplay::can_measure_submit(uint32_t submitCount, const VkSubmitInfo2 *pSubmits) const {
+    uint32_t commandBufferCount = 0;
+    for (uint32_t i = 0; i < submitCount; i++) {
+        if ((pSubmits[i].flags & VK_SUBMIT_PROTECTED_BIT) || !can_measure_batch(pSubmits[i].pNext)) {
+            return false;
+        }
+        commandBufferCount += pSubmits[i].commandBufferInfoCount;
+    }
+    return commandBufferCount > 0;
+}
+
+bool vkReplay::begin_gpu_timestamp_submit(VkQueue traceQueue, VkQueue remappedQueue, VkCommandBuffer *pBegin,
+                                          VkCommandBuffer *pEnd, VkFence *pFence) {
+    if (m_gpuTimestamps == nullptr || !m_inFrameRange) {
+        return false;
+    }
+    if (!m_gpuTimestamps->HasQueue(remappedQueue)) {
+        VkDevice device = VK_NULL_HANDLE;
+        uint32_t queueFamilyIndex = 0;
+        uint32_t timestampValidBits = 0;
+        float timestampPeriod = 1.0f;
+        auto deviceIt = traceQueueToDevice.find(traceQueue);
+        auto familyIt = traceQueueToFamilyIndex.find(traceQueue);
+        if (deviceIt != traceQueueToDevice.end() && familyIt != traceQueueToFamilyIndex.end()) {
+            // The queues are replayed with the queue family index of the trace.
+            device = m_objMapper.remap_devices(deviceIt->second);
+            queueFamilyIndex = familyIt->second;
+        }
+        auto physicalDeviceIt = replayPhysicalDevices.find(device);
+        if (physicalDeviceIt == replayPhysicalDevices.end()) {
+            vktrace_LogWarning("Unknown device of queue %p, its submissions will not be measured.", traceQueue);
+        } else {
+            uint32_t count = 0;
+            m_vkFuncs.GetPhysicalDeviceQueueFamilyProperties(physicalDeviceIt->second, &count, NULL);
+            std::vector<VkQueueFamilyProperties> queueFamilyProperties(count);
+            m_vkFuncs.GetPhysicalDeviceQueueFamilyProperties(physicalDeviceIt->second, &count, queueFamilyProperties.data());
+            if (queueFamilyIndex < count) {
+                timestampValidBits = queueFamilyProperties[queueFamilyIndex].timestampValidBits;
+            }
+            VkPhysicalDeviceProperties properties;
+            m_vkFuncs.GetPhysicalDeviceProperties(physicalDeviceIt->second, &properties);
+            timestampPeriod = properties.limits.timestampPeriod;
+            if (timestampValidBits == 0) {
+                vktrace_LogWarning("Queue family %u has no timestamp support, its submissions will not be measured.",
+                                   queueFamilyIndex);
+            }
+        }
+        m_gpuTimestamps->AddQueue(device, remappedQueue, queueFamilyIndex, timestampValidBits, timestampPeriod);
+    }
+    return m_gpuTimestamps->BeginSubmit(remappedQueue, m_frameNumber, pBegin, pEnd, pFence);
+}
+
+// remappedFence is the fence of the trace the submission was made with, if any.
+void vkReplay::end_gpu_timestamp_submit(bool timed, VkQueue remappedQueue, VkResult result, VkFence remappedFence) {
+    if (timed && result != VK_SUCCESS) {
+        m_gpuTimestamps->CancelSubmit(remappedQueue);
+    } else if (timed && remappedFence != VK_NULL_HANDLE) {
+        m_gpuTimestamps->SubmitFence(remappedQueue);
+    }
+    if (m_gpuTimestamps != nullptr) {
+        m_gpuTimestamps->Poll();
+    }
+}
+
+void vkReplay::add_memory_stats_device(VkDevice device, VkPhysicalDevice physicalDevice) {
+    VkPhysicalDeviceMemoryProperties memoryProperties = {};
+    m_vkFuncs.GetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+
+    // VK_EXT_memory_budget only extends a physical device query, it doesn't
+    // need to be enabled on the device.
+    PFN_vkGetPhysicalDeviceMemoryProperties2 pfnGetMemoryProperties2 = m_vkFuncs.GetPhysicalDeviceMemoryProperties2KHR;
+    if (pfnGetMemoryProperties2 == nullptr) {
+        pfnGetMemoryProperties2 = m_vkFuncs.GetPhysicalDeviceMemoryProperties2;
+    }
+    bool budgetSupported = false;
+    uint32_t extensionCount = 0;
+    if (pfnGetMemoryProperties2 != nullptr &&
+        m_vkFuncs.EnumerateDeviceExtensionProperties(physicalDevice, NULL, &extensionCount, NULL) == VK_SUCCESS) {
+        std::vector<VkExtensionProperties> extensions(extensionCount);
+        if (m_vkFuncs.EnumerateDeviceExtensionProperties(physicalDevice, NULL, &extensionCount, extensions.data()) == VK_SUCCESS) {
+            for (uint32_t i = 0; i < extensionCount; i++) {
+                if (strcmp(extensions[i].extensionName, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME) == 0) {
+                    budgetSupported = true;
+                    break;
+                }
+            }
+        }
+    }
+    memory_stats_add_device(device, physicalDevice, memoryProperties, budgetSupported ? pfnGetMemoryProperties2 : nullptr);
+}
+
+void vkReplay::release_gpu_timestamps(VkDevice device) {
+    if (m_gpuTimestamps != nullptr) {
+        m_gpuTimestamps->RemoveDevice(device);
+    }
+}
+
+VkPipelineCache vkReplay::get_prewarm_pipeline_cache(VkDevice device, VkPipelineCache pipelineCache) {
+    auto it = m_prewarmPipelineCaches.find(device);
+    if (it == m_prewarmPipelineCaches.end()) {
+        return pipelineCache;
+    }
+    if (pipelineCache == VK_NULL_HANDLE) {
+        return it->second;
+    }
+    if (m_prewarmMergedPipelineCaches.insert(pipelineCache).second) {
+        // The destination of vkMergePipelineCaches() must be externally synchronized,
+        // pending asynchronous pipelines may still be created with it.
+        wait_async_pipelines_idle();
+        VkResult result = m_vkDeviceFuncs.MergePipelineCaches(device, pipelineCache, 1, &it->second);
+        if (result != VK_SUCCESS) {
+            vktrace_LogWarning("Failed to merge the pre-warmed pipeline cache: %s.", string_VkResult(result));
+        }
+    }
+    return pipelineCache;
+}
+
+void vkReplay::release_prewarm_pipeline_cache(VkDevice device) {
+    auto it = m_prewarmPipelineCaches.find(device);
+    if (it != m_prewarmPipelineCaches.end()) {
+        m_vkDeviceFuncs.DestroyPipelineCache(device, it->second, NULL);
+        m_prewarmPipelineCaches.erase(it);
+    }
+}
+
 VkResult vkReplay::manually_replay_vkCreateComputePipelines(packet_vkCreateComputePipelines *pPacket) {
     VkResult replayResult = VK_ERROR_VALIDATION_FAILED_EXT;
+    if (claim_async_pipelines(pPacket->header, &replayResult)) {
+        return replayResult;
+    }
     VkDevice remappeddevice = m_objMapper.remap_devices(pPacket->device);
     uint32_t i;
 
@@ -3921,6 +4818,7 @@ VkResult vkReplay::manually_replay_vkCreateComputePipelines(packet_vkCreateCompu
 
     VkPipelineCache pipelineCache;
     pipelineCache = m_objMapper.remap_pipelinecaches(pPacket->pipelineCache);
+    pipelineCache = get_prewarm_pipeline_cache(remappeddevice, pipelineCache);
 
     VkComputePipelineCreateInfo *pLocalCIs = VKTRACE_NEW_ARRAY(VkComputePipelineCreateInfo, pPacket->createInfoCount);
     memcpy((void *)pLocalCIs, (void *)(pPacket->pCreateInfos), sizeof(VkComputePipelineCreateInfo) * pPacket->createInfoCount);
@@ -3935,6 +4833,19 @@ VkResult vkReplay::manually_replay_vkCreateComputePipelines(packet_vkCreateCompu
         pLocalCIs[i].basePipelineHandle = m_objMapper.remap_pipelines(pLocalCIs[i].basePipelineHandle);
     }
 
+    if (use_async_pipeline_creation(pPacket->result)) {
+        auto localCIs = std::make_shared<std::vector<VkComputePipelineCreateInfo>>(pLocalCIs, pLocalCIs + pPacket->createInfoCount);
+        PFN_vkCreateComputePipelines pfnCreateComputePipelines = m_vkDeviceFuncs.CreateComputePipelines;
+        m_asyncPipelineCompiler->Submit(pPacket->header->global_packet_index, m_asyncPipelineLookAhead, "vkCreateComputePipelines",
+                                        remappeddevice, pPacket->createInfoCount, pPacket->pPipelines,
+                                        [=](VkPipeline *pPipelines) {
+                                            return pfnCreateComputePipelines(remappeddevice, pipelineCache, (uint32_t)localCIs->size(),
+                                                                             localCIs->data(), NULL, pPipelines);
+                                        });
+        VKTRACE_DELETE(pLocalCIs);
+        return VK_SUCCESS;
+    }
+
     VkPipeline *local_pPipelines = VKTRACE_NEW_ARRAY(VkPipeline, pPacket->createInfoCount);
 
     replayResult = m_vkDeviceFuncs.CreateComputePipelines(remappeddevice, pipelineCache, pPacket->createInfoCount, pLocalCIs, NULL,
@@ -3955,14 +4866,18 @@ VkResult vkReplay::manually_replay_vkCreateComputePipelines(packet_vkCreateCompu
 
 VkResult vkReplay::manually_replay_vkCreateGraphicsPipelines(packet_vkCreateGraphicsPipelines *pPacket) {
     VkResult replayResult = VK_ERROR_VALIDATION_FAILED_EXT;
+    if (claim_async_pipelines(pPacket->header, &replayResult)) {
+        return replayResult;
+    }
     VkDevice remappedDevice = m_objMapper.remap_devices(pPacket->device);
     if (remappedDevice == VK_NULL_HANDLE) {
         vktrace_LogError("Skipping vkCreateGraphicsPipelines() due to invalid remapped VkDevice.");
         return VK_ERROR_VALIDATION_FAILED_EXT;
     }
 
-    // Declaration of VRS ext struct to be added/substituded in the pnext chain of pipeline create info
-    VkPipelineFragmentShadingRateStateCreateInfoKHR newPFSRStateCI = {};
+    // Declaration of VRS ext struct to be added/substituded in the pnext chain of pipeline create info.
+    // It is kept on the heap since asynchronous pipeline creation reads it after this function returns.
+    auto newPFSRStateCI = std::make_shared<VkPipelineFragmentShadingRateStateCreateInfoKHR>();
 
     // remap shaders from each stage
     VkGraphicsPipelineCreateInfo *pCIs = (VkGraphicsPipelineCreateInfo *)pPacket->pCreateInfos;
@@ -4023,7 +4938,7 @@ VkResult vkReplay::manually_replay_vkCreateGraphicsPipelines(packet_vkCreateGrap
         }
         // Manually add pnext struct for VRS.
         if (g_pReplaySettings->forceVariableRateShading != nullptr) {
-            newPFSRStateCI = {VK_STRUCTURE_TYPE_PIPELINE_FRAGMENT_SHADING_RATE_STATE_CREATE_INFO_KHR,
+            *newPFSRStateCI = {VK_STRUCTURE_TYPE_PIPELINE_FRAGMENT_SHADING_RATE_STATE_CREATE_INFO_KHR,
                               NULL,
                               {m_fragmentSize.width, m_fragmentSize.height},
                               {VK_FRAGMENT_SHADING_RATE_COMBINER_OP_KEEP_KHR, VK_FRAGMENT_SHADING_RATE_COMBINER_OP_KEEP_KHR}};
@@ -4032,9 +4947,9 @@ VkResult vkReplay::manually_replay_vkCreateGraphicsPipelines(packet_vkCreateGrap
                     (vulkan_struct_header *)&pCIs[i], VK_STRUCTURE_TYPE_PIPELINE_FRAGMENT_SHADING_RATE_STATE_CREATE_INFO_KHR);
             if (pPFSRStateCI) {
                 // Override the fragment size and combiner if VRS is already enabled.
-                memcpy(pPFSRStateCI, &newPFSRStateCI, sizeof(VkPipelineFragmentShadingRateStateCreateInfoKHR));
+                memcpy(pPFSRStateCI, newPFSRStateCI.get(), sizeof(VkPipelineFragmentShadingRateStateCreateInfoKHR));
             } else if (!m_fvrsOverrideOnly) {
-                add_ext_struct((vulkan_struct_header *)&pCIs[i], (vulkan_struct_header *)&newPFSRStateCI);
+                add_ext_struct((vulkan_struct_header *)&pCIs[i], (vulkan_struct_header *)newPFSRStateCI.get());
             } else {
                 vktrace_LogDebug("FVRS won't be applied to current pipeline in override only mode.");
             }
@@ -4047,8 +4962,22 @@ VkResult vkReplay::manually_replay_vkCreateGraphicsPipelines(packet_vkCreateGrap
         vktrace_LogError("Skipping vkCreateGraphicsPipelines() due to invalid remapped VkPipelineCache.");
         return VK_ERROR_VALIDATION_FAILED_EXT;
     }
+    remappedPipelineCache = get_prewarm_pipeline_cache(remappedDevice, remappedPipelineCache);
 
     uint32_t createInfoCount = pPacket->createInfoCount;
+    if (use_async_pipeline_creation(pPacket->result)) {
+        PFN_vkCreateGraphicsPipelines pfnCreateGraphicsPipelines = m_vkDeviceFuncs.CreateGraphicsPipelines;
+        m_asyncPipelineCompiler->Submit(pPacket->header->global_packet_index, m_asyncPipelineLookAhead, "vkCreateGraphicsPipelines",
+                                        remappedDevice, createInfoCount, pPacket->pPipelines,
+                                        [=](VkPipeline *pPipelines) {
+                                            // newPFSRStateCI is captured to keep it alive, pCIs may point to it.
+                                            (void)newPFSRStateCI;
+                                            return pfnCreateGraphicsPipelines(remappedDevice, remappedPipelineCache, createInfoCount, pCIs,
+                                                                              NULL, pPipelines);
+                                        });
+        return VK_SUCCESS;
+    }
+
     VkPipeline *local_pPipelines = VKTRACE_NEW_ARRAY(VkPipeline, pPacket->createInfoCount);
 
     replayResult = m_vkDeviceFuncs.CreateGraphicsPipelines(remappedDevice, remappedPipelineCache, createInfoCount, pCIs, NULL,
@@ -4126,7 +5055,7 @@ void vkReplay::manually_replay_vkCmdWaitEvents(packet_vkCmdWaitEvents *pPacket)
             pNextImg->image = curSwapchainImgStat.traceImageIndexToImage[m_imageIndex];
         }
         if (g_pReplaySettings->enableVirtualSwapchain && g_pReplaySettings->enableVscPerfMode == FALSE
-            && pNextImg->newLayout == VK_IMAGE_LAYOUT_PRESENT_SRC_KHR) {
+            && pNextImg->newLayout == VK_IMAGE_LAYOUT_PRESENT_SRC_KHR && getVirtualSwapchainImage(pNextImg->image) != VK_NULL_HANDLE) {
             pNextImg->newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
         }
         traceDevice = traceImageToDevice[pNextImg->image];
@@ -4178,7 +5107,7 @@ void vkReplay::manually_replay_vkCmdPipelineBarrier(packet_vkCmdPipelineBarrier
             pNextImg->image = curSwapchainImgStat.traceImageIndexToImage[m_imageIndex];
         }
         if (g_pReplaySettings->enableVirtualSwapchain && g_pReplaySettings->enableVscPerfMode == FALSE
-            && pNextImg->newLayout == VK_IMAGE_LAYOUT_PRESENT_SRC_KHR) {
+            && pNextImg->newLayout == VK_IMAGE_LAYOUT_PRESENT_SRC_KHR && getVirtualSwapchainImage(pNextImg->image) != VK_NULL_HANDLE) {
             curSwapchainImage = pNextImg->image;
             pNextImg->newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
         }
@@ -4233,7 +5162,7 @@ void vkReplay::manually_replay_vkCmdPipelineBarrier2KHR(packet_vkCmdPipelineBarr
             pNextImg->image = curSwapchainImgStat.traceImageIndexToImage[m_imageIndex];
         }
         if (g_pReplaySettings->enableVirtualSwapchain && g_pReplaySettings->enableVscPerfMode == FALSE
-            && pNextImg->newLayout == VK_IMAGE_LAYOUT_PRESENT_SRC_KHR) {
+            && pNextImg->newLayout == VK_IMAGE_LAYOUT_PRESENT_SRC_KHR && getVirtualSwapchainImage(pNextImg->image) != VK_NULL_HANDLE) {
             curSwapchainImage = pNextImg->image;
             pNextImg->newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
         }
@@ -4285,7 +5214,7 @@ void vkReplay::manually_replay_vkCmdPipelineBarrier2(packet_vkCmdPipelineBarrier
             pNextImg->image = curSwapchainImgStat.traceImageIndexToImage[m_imageIndex];
         }
         if (g_pReplaySettings->enableVirtualSwapchain && g_pReplaySettings->enableVscPerfMode == FALSE
-            && pNextImg->newLayout == VK_IMAGE_LAYOUT_PRESENT_SRC_KHR) {
+            && pNextImg->newLayout == VK_IMAGE_LAYOUT_PRESENT_SRC_KHR && getVirtualSwapchainImage(pNextImg->image) != VK_NULL_HANDLE) {
             curSwapchainImage = pNextImg->image;
             pNextImg->newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
         }
@@ -4509,6 +5438,12 @@ VkResult vkReplay::manually_replay_vkCreateRenderPass2KHR(packet_vkCreateRenderP
     return replayResult;
 }
 
+const vkReplay::SwapchainImageState &vkReplay::find_swapchain_image_state(VkSwapchainKHR swapchain) const {
+    static const SwapchainImageState s_unknownSwapchainImageState;
+    auto it = swapchainImageStates.find(swapchain);
+    return it != swapchainImageStates.end() ? it->second : s_unknownSwapchainImageState;
+}
+
 void vkReplay::manually_replay_vkCmdBeginRenderPass(packet_vkCmdBeginRenderPass *pPacket) {
     VkCommandBuffer remappedCommandBuffer = m_objMapper.remap_commandbuffers(pPacket->commandBuffer);
 
@@ -4518,7 +5453,7 @@ void vkReplay::manually_replay_vkCmdBeginRenderPass(packet_vkCmdBeginRenderPass
     }
 
     VkRenderPassBeginInfo local_renderPassBeginInfo;
-    SwapchainImageState& curSwapchainImgStat = swapchainImageStates[curSwapchainHandle];
+    const SwapchainImageState& curSwapchainImgStat = find_swapchain_image_state(curSwapchainHandle);
     memcpy((void *)&local_renderPassBeginInfo, (void *)pPacket->pRenderPassBegin, sizeof(VkRenderPassBeginInfo));
     local_renderPassBeginInfo.pClearValues = (const VkClearValue *)pPacket->pRenderPassBegin->pClearValues;
     if (curSwapchainImgStat.traceFramebufferToImageIndex.find(pPacket->pRenderPassBegin->framebuffer) != curSwapchainImgStat.traceFramebufferToImageIndex.end() &&
@@ -4528,7 +5463,7 @@ void vkReplay::manually_replay_vkCmdBeginRenderPass(packet_vkCmdBeginRenderPass
         bool bFind = false;
         for (auto &e : curSwapchainImgStat.traceFramebufferToImageIndex) {
             if (e.second == m_imageIndex &&
-                curSwapchainImgStat.traceFramebufferToRenderpass[e.first] == pPacket->pRenderPassBegin->renderPass) {
+                curSwapchainImgStat.find_renderpass(e.first) == pPacket->pRenderPassBegin->renderPass) {
                 local_renderPassBeginInfo.framebuffer = m_objMapper.remap_framebuffers(e.first);
                 bFind = true;
                 break;
@@ -4575,7 +5510,7 @@ void vkReplay::manually_replay_vkCmdBeginRenderPass2KHR(packet_vkCmdBeginRenderP
         return;
     }
     VkRenderPassBeginInfo local_renderPassBeginInfo;
-    SwapchainImageState& curSwapchainImgStat = swapchainImageStates[curSwapchainHandle];
+    const SwapchainImageState& curSwapchainImgStat = find_swapchain_image_state(curSwapchainHandle);
     memcpy((void *)&local_renderPassBeginInfo, (void *)pPacket->pRenderPassBegin, sizeof(VkRenderPassBeginInfo));
     local_renderPassBeginInfo.pClearValues = (const VkClearValue *)pPacket->pRenderPassBegin->pClearValues;
     if (curSwapchainImgStat.traceFramebufferToImageIndex.find(pPacket->pRenderPassBegin->framebuffer) != curSwapchainImgStat.traceFramebufferToImageIndex.end() &&
@@ -4585,7 +5520,7 @@ void vkReplay::manually_replay_vkCmdBeginRenderPass2KHR(packet_vkCmdBeginRenderP
         bool bFind = false;
         for (auto &e : curSwapchainImgStat.traceFramebufferToImageIndex) {
             if (e.second == m_imageIndex &&
-                curSwapchainImgStat.traceFramebufferToRenderpass[e.first] == pPacket->pRenderPassBegin->renderPass) {
+                curSwapchainImgStat.find_renderpass(e.first) == pPacket->pRenderPassBegin->renderPass) {
                 local_renderPassBeginInfo.framebuffer = m_objMapper.remap_framebuffers(e.first);
                 bFind = true;
                 break;
@@ -4632,7 +5567,7 @@ void vkReplay::manually_replay_vkCmdBeginRenderingKHR(packet_vkCmdBeginRendering
         return;
     }
     VkRenderingInfoKHR local_renderingInfo;
-    SwapchainImageState& curSwapchainImgStat = swapchainImageStates[curSwapchainHandle];
+    const SwapchainImageState& curSwapchainImgStat = find_swapchain_image_state(curSwapchainHandle);
     memcpy((void *)&local_renderingInfo, (void *)pPacket->pRenderingInfo, sizeof(VkRenderingInfoKHR));
     local_renderingInfo.pColorAttachments = (const VkRenderingAttachmentInfoKHR *)pPacket->pRenderingInfo->pColorAttachments;
 
@@ -4644,7 +5579,7 @@ void vkReplay::manually_replay_vkCmdBeginRenderingKHR(packet_vkCmdBeginRendering
         if (curSwapchainImgStat.traceImageViewToImageIndex.find(pPacket->pRenderingInfo->pColorAttachments[i].imageView) != curSwapchainImgStat.traceImageViewToImageIndex.end() &&
             curSwapchainImgStat.traceImageIndexToImageViews.find(m_imageIndex) != curSwapchainImgStat.traceImageIndexToImageViews.end() &&
             m_imageIndex != UINT32_MAX && m_imageIndex != m_pktImgIndex && !g_pReplaySettings->enableVirtualSwapchain) {
-            local_colorAttachmentInfo.imageView = m_objMapper.remap_imageviews(*curSwapchainImgStat.traceImageIndexToImageViews[m_imageIndex].begin());
+            local_colorAttachmentInfo.imageView = m_objMapper.remap_imageviews(*curSwapchainImgStat.traceImageIndexToImageViews.at(m_imageIndex).begin());
         } else {
             local_colorAttachmentInfo.imageView = m_objMapper.remap_imageviews(pPacket->pRenderingInfo->pColorAttachments[i].imageView);
         }
@@ -4662,7 +5597,7 @@ void vkReplay::manually_replay_vkCmdBeginRenderingKHR(packet_vkCmdBeginRendering
         if (curSwapchainImgStat.traceImageViewToImageIndex.find(pPacket->pRenderingInfo->pDepthAttachment->imageView) != curSwapchainImgStat.traceImageViewToImageIndex.end() &&
             curSwapchainImgStat.traceImageIndexToImageViews.find(m_imageIndex) != curSwapchainImgStat.traceImageIndexToImageViews.end() &&
             m_imageIndex != UINT32_MAX && m_imageIndex != m_pktImgIndex) {
-            local_depthAttachmentInfo.imageView = m_objMapper.remap_imageviews(*curSwapchainImgStat.traceImageIndexToImageViews[m_imageIndex].begin());
+            local_depthAttachmentInfo.imageView = m_objMapper.remap_imageviews(*curSwapchainImgStat.traceImageIndexToImageViews.at(m_imageIndex).begin());
         } else {
             local_depthAttachmentInfo.imageView = m_objMapper.remap_imageviews(pPacket->pRenderingInfo->pDepthAttachment->imageView);
         }
@@ -4679,7 +5614,7 @@ void vkReplay::manually_replay_vkCmdBeginRenderingKHR(packet_vkCmdBeginRendering
         if (curSwapchainImgStat.traceImageViewToImageIndex.find(pPacket->pRenderingInfo->pStencilAttachment->imageView) != curSwapchainImgStat.traceImageViewToImageIndex.end() &&
             curSwapchainImgStat.traceImageIndexToImageViews.find(m_imageIndex) != curSwapchainImgStat.traceImageIndexToImageViews.end() &&
             m_imageIndex != UINT32_MAX && m_imageIndex != m_pktImgIndex) {
-            local_stencilAttachmentInfo.imageView = m_objMapper.remap_imageviews(*curSwapchainImgStat.traceImageIndexToImageViews[m_imageIndex].begin());
+            local_stencilAttachmentInfo.imageView = m_objMapper.remap_imageviews(*curSwapchainImgStat.traceImageIndexToImageViews.at(m_imageIndex).begin());
         } else {
             local_stencilAttachmentInfo.imageView = m_objMapper.remap_imageviews(pPacket->pRenderingInfo->pStencilAttachment->imageView);
         }
@@ -4702,7 +5637,7 @@ void vkReplay::manually_replay_vkCmdBeginRendering(packet_vkCmdBeginRendering *p
         return;
     }
     VkRenderingInfo local_renderingInfo;
-    SwapchainImageState& curSwapchainImgStat = swapchainImageStates[curSwapchainHandle];
+    const SwapchainImageState& curSwapchainImgStat = find_swapchain_image_state(curSwapchainHandle);
     memcpy((void *)&local_renderingInfo, (void *)pPacket->pRenderingInfo, sizeof(VkRenderingInfo));
     local_renderingInfo.pColorAttachments = (const VkRenderingAttachmentInfo *)pPacket->pRenderingInfo->pColorAttachments;
 
@@ -4714,7 +5649,7 @@ void vkReplay::manually_replay_vkCmdBeginRendering(packet_vkCmdBeginRendering *p
         if (curSwapchainImgStat.traceImageViewToImageIndex.find(pPacket->pRenderingInfo->pColorAttachments[i].imageView) != curSwapchainImgStat.traceImageViewToImageIndex.end() &&
             curSwapchainImgStat.traceImageIndexToImageViews.find(m_imageIndex) != curSwapchainImgStat.traceImageIndexToImageViews.end() &&
             m_imageIndex != UINT32_MAX && m_imageIndex != m_pktImgIndex && !g_pReplaySettings->enableVirtualSwapchain) {
-            local_colorAttachmentInfo.imageView = m_objMapper.remap_imageviews(*curSwapchainImgStat.traceImageIndexToImageViews[m_imageIndex].begin());
+            local_colorAttachmentInfo.imageView = m_objMapper.remap_imageviews(*curSwapchainImgStat.traceImageIndexToImageViews.at(m_imageIndex).begin());
         } else {
             local_colorAttachmentInfo.imageView = m_objMapper.remap_imageviews(pPacket->pRenderingInfo->pColorAttachments[i].imageView);
         }
@@ -4732,7 +5667,7 @@ void vkReplay::manually_replay_vkCmdBeginRendering(packet_vkCmdBeginRendering *p
         if (curSwapchainImgStat.traceImageViewToImageIndex.find(pPacket->pRenderingInfo->pDepthAttachment->imageView) != curSwapchainImgStat.traceImageViewToImageIndex.end() &&
             curSwapchainImgStat.traceImageIndexToImageViews.find(m_imageIndex) != curSwapchainImgStat.traceImageIndexToImageViews.end() &&
             m_imageIndex != UINT32_MAX && m_imageIndex != m_pktImgIndex) {
-            local_depthAttachmentInfo.imageView = m_objMapper.remap_imageviews(*curSwapchainImgStat.traceImageIndexToImageViews[m_imageIndex].begin());
+            local_depthAttachmentInfo.imageView = m_objMapper.remap_imageviews(*curSwapchainImgStat.traceImageIndexToImageViews.at(m_imageIndex).begin());
         } else {
             local_depthAttachmentInfo.imageView = m_objMapper.remap_imageviews(pPacket->pRenderingInfo->pDepthAttachment->imageView);
         }
@@ -4749,7 +5684,7 @@ void vkReplay::manually_replay_vkCmdBeginRendering(packet_vkCmdBeginRendering *p
         if (curSwapchainImgStat.traceImageViewToImageIndex.find(pPacket->pRenderingInfo->pStencilAttachment->imageView) != curSwapchainImgStat.traceImageViewToImageIndex.end() &&
             curSwapchainImgStat.traceImageIndexToImageViews.find(m_imageIndex) != curSwapchainImgStat.traceImageIndexToImageViews.end() &&
             m_imageIndex != UINT32_MAX && m_imageIndex != m_pktImgIndex) {
-            local_stencilAttachmentInfo.imageView = m_objMapper.remap_imageviews(*curSwapchainImgStat.traceImageIndexToImageViews[m_imageIndex].begin());
+            local_stencilAttachmentInfo.imageView = m_objMapper.remap_imageviews(*curSwapchainImgStat.traceImageIndexToImageViews.at(m_imageIndex).begin());
         } else {
             local_stencilAttachmentInfo.imageView = m_objMapper.remap_imageviews(pPacket->pRenderingInfo->pStencilAttachment->imageView);
         }
@@ -4807,7 +5742,7 @@ VkResult vkReplay::manually_replay_vkBeginCommandBuffer(packet_vkBeginCommandBuf
     VkRenderPass savedRP = VK_NULL_HANDLE, *pRP;
     VkFramebuffer savedFB = VK_NULL_HANDLE, *pFB;
     if (pInfo != NULL && pHinfo != NULL) {
-        SwapchainImageState& curSwapchainImgStat = swapchainImageStates[curSwapchainHandle];
+        const SwapchainImageState& curSwapchainImgStat = find_swapchain_image_state(curSwapchainHandle);
         savedRP = pHinfo->renderPass;
         savedFB = pHinfo->framebuffer;
         pRP = &(pHinfo->renderPass);
@@ -4819,7 +5754,7 @@ VkResult vkReplay::manually_replay_vkBeginCommandBuffer(packet_vkBeginCommandBuf
             // Use Framebuffer mapped to the image index returned by vkAcquireNextImage()
             bool bFind = false;
             for (auto &e : curSwapchainImgStat.traceFramebufferToImageIndex) {
-                if (e.second == m_imageIndex && curSwapchainImgStat.traceFramebufferToRenderpass[e.first] == savedRP) {
+                if (e.second == m_imageIndex && curSwapchainImgStat.find_renderpass(e.first) == savedRP) {
                     *pFB = m_objMapper.remap_framebuffers(e.first);
                     bFind = true;
                     break;
@@ -5513,6 +6448,8 @@ VkResult vkReplay::manually_replay_vkAllocateMemory(packet_vkAllocateMemory *pPa
         m_objMapper.add_to_devicememorys_map(*(pPacket->pMemory), local_mem);
         replayDeviceMemoryToDevice[local_mem.replayDeviceMemory] = remappedDevice;
         replayDeviceMemoryToSize[local_mem.replayDeviceMemory] = pPacket->pAllocateInfo->allocationSize;
+        memory_stats_allocate(remappedDevice, local_mem.replayDeviceMemory, pPacket->pAllocateInfo->memoryTypeIndex,
+                              pPacket->pAllocateInfo->allocationSize);
 #if defined(ANDROID)
         // Mark the memory object if it is exported to external memory
         VkExportMemoryAllocateInfo* exportInfo = (VkExportMemoryAllocateInfo*)find_ext_struct(
@@ -5601,6 +6538,7 @@ void vkReplay::manually_replay_vkFreeMemory(packet_vkFreeMemory *pPacket) {
     local_mem = m_objMapper.find_devicememory(pPacket->memory);
     // TODO how/when to free pendingAlloc that did not use and existing devicememoryObj
     m_vkDeviceFuncs.FreeMemory(remappedDevice, local_mem.replayDeviceMemory, NULL);
+    memory_stats_free(local_mem.replayDeviceMemory);
 
     if (replayDeviceMemoryToSize.find(local_mem.replayDeviceMemory) != replayDeviceMemoryToSize.end())
         replayDeviceMemoryToSize.erase(local_mem.replayDeviceMemory);
@@ -7773,19 +8711,26 @@ VkResult vkReplay::manually_replay_vkFlushMappedMemoryRangesPremapped(packet_vkF
     return replayResult;
 }
 
-void vkReplay::manually_replay_vkCmdDrawIndexedPremapped(packet_vkCmdDrawIndexed *pPacket)
+void vkReplay::manually_replay_vkCmdBindVertexBuffersPremapped(packet_vkCmdBindVertexBuffers *pPacket)
 {
     VkCommandBuffer remappedCommandBuffer = *reinterpret_cast<VkCommandBuffer*>(pPacket->commandBuffer);
-    if (pPacket->commandBuffer != VK_NULL_HANDLE && remappedCommandBuffer == VK_NULL_HANDLE) {
-        vktrace_LogError("Error detected in CmdDrawIndexedPremapped() due to invalid remapped VkCommandBuffer.");
+    if (remappedCommandBuffer == VK_NULL_HANDLE) {
+        vktrace_LogError("Error detected in CmdBindVertexBuffersPremapped() due to invalid remapped VkCommandBuffer.");
         return;
     }
-    // No need to remap indexCount
-    // No need to remap instanceCount
-    // No need to remap firstIndex
-    // No need to remap vertexOffset
-    // No need to remap firstInstance
-    m_vkDeviceFuncs.CmdDrawIndexed(remappedCommandBuffer, pPacket->indexCount, pPacket->instanceCount, pPacket->firstIndex, pPacket->vertexOffset, pPacket->firstInstance);
+    // The packet keeps the premapped buffers so it can be replayed again.
+    std::vector<VkBuffer> remappedBuffers(pPacket->pBuffers != NULL ? pPacket->bindingCount : 0);
+    for (uint32_t i = 0; i < remappedBuffers.size(); i++) {
+        if (pPacket->pBuffers[i] != VK_NULL_HANDLE) {
+            remappedBuffers[i] = reinterpret_cast<bufferObj*>(pPacket->pBuffers[i])->replayBuffer;
+            if (remappedBuffers[i] == VK_NULL_HANDLE) {
+                vktrace_LogError("Error detected in CmdBindVertexBuffersPremapped() due to invalid remapped VkBuffer.");
+                return;
+            }
+        }
+    }
+    m_vkDeviceFuncs.CmdBindVertexBuffers(remappedCommandBuffer, pPacket->firstBinding, pPacket->bindingCount,
+                                         pPacket->pBuffers != NULL ? remappedBuffers.data() : NULL, pPacket->pOffsets);
     return;
 }
 
@@ -8772,6 +9717,11 @@ VkResult vkReplay::manually_replay_vkCreateSwapchainKHR(packet_vkCreateSwapchain
         }
         replaySurfaceCapabilities[*pSurf] = surfCap;
     }
+    // The virtual images can only be aliased to the swapchain images if the
+    // replay keeps the format and the extent of the trace, the usage of the
+    // swapchain images always includes the usage of the trace.
+    const VkFormat traceImageFormat = pPacket->pCreateInfo->imageFormat;
+    const VkExtent2D traceImageExtent = pPacket->pCreateInfo->imageExtent;
     const_cast<VkSwapchainCreateInfoKHR*>(pPacket->pCreateInfo)->imageExtent.width = std::max(surfCap.minImageExtent.width, pPacket->pCreateInfo->imageExtent.width);
     const_cast<VkSwapchainCreateInfoKHR*>(pPacket->pCreateInfo)->imageExtent.width = std::min(surfCap.maxImageExtent.width, pPacket->pCreateInfo->imageExtent.width);
     const_cast<VkSwapchainCreateInfoKHR*>(pPacket->pCreateInfo)->imageExtent.height = std::max(surfCap.minImageExtent.height, pPacket->pCreateInfo->imageExtent.height);
@@ -8952,6 +9902,14 @@ VkResult vkReplay::manually_replay_vkCreateSwapchainKHR(packet_vkCreateSwapchain
             traceSwapchainToCreateInfo[*(pPacket->pSwapchain)].pQueueFamilyIndices = (uint32_t*)malloc(sizeof(uint32_t) * pPacket->pCreateInfo->queueFamilyIndexCount);
             memcpy((void*)traceSwapchainToCreateInfo[*(pPacket->pSwapchain)].pQueueFamilyIndices,  (void*)pPacket->pCreateInfo->pQueueFamilyIndices, sizeof(uint32_t) * pPacket->pCreateInfo->queueFamilyIndexCount);
         }
+        if (g_pReplaySettings->enableVscAlias) {
+            if (pPacket->pCreateInfo->imageFormat == traceImageFormat && pPacket->pCreateInfo->imageExtent.width == traceImageExtent.width &&
+                pPacket->pCreateInfo->imageExtent.height == traceImageExtent.height) {
+                aliasedTraceSwapchains.insert(*(pPacket->pSwapchain));
+            } else {
+                vktrace_LogWarning("vsca: The swapchain format or extent differs from the trace, its images will be copied from virtual images.");
+            }
+        }
         curSwapchainHandle = local_pSwapchain;
     }
 
@@ -8985,11 +9943,13 @@ void vkReplay::deleteVirtualObject(VkDevice remappeddevice, VkImage image) {
             m_vkDeviceFuncs.DestroySemaphore(remappeddevice, sit->second, nullptr);
             virtualImageToVirtualSemaphore.erase(sit);
         }
-        auto cbit = virtualImageToVirtualCommandBuffer.find(virtualImage);
-        if (cbit != virtualImageToVirtualCommandBuffer.end()) {
+        auto cbit = virtualImageToCopyCommandBuffers.find(virtualImage);
+        if (cbit != virtualImageToCopyCommandBuffers.end()) {
             auto cpit = virtualImageToVirtualCommandPool.find(virtualImage);
-            m_vkDeviceFuncs.FreeCommandBuffers(remappeddevice, cpit->second, 1, &cbit->second);
-            virtualImageToVirtualCommandBuffer.erase(cbit);
+            for (auto &copy : cbit->second) {
+                m_vkDeviceFuncs.FreeCommandBuffers(remappeddevice, cpit->second, 1, &copy.second);
+            }
+            virtualImageToCopyCommandBuffers.erase(cbit);
         }
         auto cpit = virtualImageToVirtualCommandPool.find(virtualImage);
         if (cpit != virtualImageToVirtualCommandPool.end()) {
@@ -9042,6 +10002,7 @@ void vkReplay::manually_replay_vkDestroySwapchainKHR(packet_vkDestroySwapchainKH
     }
     auto scit = traceSwapchainToReplayImages.find(pPacket->swapchain);
         if (scit != traceSwapchainToReplayImages.end()) {
+        releaseVirtualImageCopies(remappeddevice, scit->second);
         traceSwapchainToReplayImages.erase(scit);
     }
     m_vkDeviceFuncs.DestroySwapchainKHR(remappeddevice, remappedswapchain, pPacket->pAllocator);
@@ -9062,6 +10023,7 @@ void vkReplay::manually_replay_vkDestroySwapchainKHR(packet_vkDestroySwapchainKH
         }
         traceSwapchainToCreateInfo.erase(it2);
     }
+    aliasedTraceSwapchains.erase(pPacket->swapchain);
 
     for (auto it3 = replaySurfToSwapchain.begin(); it3 != replaySurfToSwapchain.end(); it3++) {
         if (it3->second == remappedswapchain) {
@@ -9175,18 +10137,8 @@ bool vkReplay::createVirtualObject(VkDevice traceDevice, VkSwapchainKHR traceSwa
             return false;
         }
         virtualImageToVirtualCommandPool[virtualImage] = virtualCommandPool;
-
-        VkCommandBufferAllocateInfo cbAllocateInfo = {};
-        VkCommandBuffer virtualCommandBuffer = VK_NULL_HANDLE;
-        cbAllocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-        cbAllocateInfo.commandPool = virtualCommandPool;
-        cbAllocateInfo.commandBufferCount = 1;
-        result = m_vkDeviceFuncs.AllocateCommandBuffers(device, &cbAllocateInfo, &virtualCommandBuffer);
-        if (result != VK_SUCCESS) {
-            vktrace_LogError("virtual AllocateCommandBuffers create failed.");
-            return false;
-        }
-        virtualImageToVirtualCommandBuffer[virtualImage] = virtualCommandBuffer;
+        // The copies are recorded from the new pool on the first present.
+        virtualImageToCopyCommandBuffers[virtualImage].clear();
     }
     VkImageCopy virtualImageCopyRegion = {};
     virtualImageCopyRegion.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
@@ -9259,7 +10211,16 @@ VkResult vkReplay::manually_replay_vkGetSwapchainImagesKHR(packet_vkGetSwapchain
     if (replayResult == VK_SUCCESS) {
         if (numImages != 0) {
             VkImage *pReplayImages = (VkImage *)pPacket->pSwapchainImages;
-            if (g_pReplaySettings->enableVirtualSwapchain) {
+            // The trace images of an aliased swapchain are mapped to the swapchain images as without the virtual swapchain.
+            bool aliased = false;
+            if (g_pReplaySettings->enableVirtualSwapchain && aliasedTraceSwapchains.count(pPacket->swapchain)) {
+                aliased = *pPacket->pSwapchainImageCount == numImages;
+                if (!aliased) {
+                    vktrace_LogWarning("vsca: The swapchain image count differs from the trace, its images will be copied from virtual images.");
+                    aliasedTraceSwapchains.erase(pPacket->swapchain);
+                }
+            }
+            if (g_pReplaySettings->enableVirtualSwapchain && !aliased) {
                 bool bFlag = createVirtualObject(pPacket->device, pPacket->swapchain, packetImage, numImages);
                 if (!bFlag) {
                     vktrace_LogError("There is some virtual object created failed.");
@@ -9305,11 +10266,27 @@ VkResult vkReplay::manually_replay_vkGetSwapchainImagesKHR(packet_vkGetSwapchain
     return replayResult;
 }
 
-VkResult vkReplay::copyFromVirtualImageToReplayImage(VkQueue traceQueue, VkImage virtualImage, VkImage replayImage, VkImageCopy* pCopyReg, uint32_t queueFamilyIndex, std::vector<VkSemaphore>& semaphores) {
-    VkQueue queue = m_objMapper.remap_queues(traceQueue);
+// The copy of a virtual image to a replay swapchain image doesn't change from
+// one frame to the next: it is recorded the first time the pair is presented,
+// and submitted again on the following presents. The fence of the virtual
+// image is waited for before the next copy, so the command buffer is never
+// pending when it is submitted.
+VkCommandBuffer vkReplay::recordVirtualImageCopy(VkImage virtualImage, VkImage replayImage, const VkImageCopy* pCopyReg) {
+    VkDevice device = replayImageToDevice[virtualImage];
+    VkCommandBufferAllocateInfo cbAllocateInfo = {};
+    VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+    cbAllocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    cbAllocateInfo.commandPool = virtualImageToVirtualCommandPool[virtualImage];
+    cbAllocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    cbAllocateInfo.commandBufferCount = 1;
+    VkResult result = m_vkDeviceFuncs.AllocateCommandBuffers(device, &cbAllocateInfo, &commandBuffer);
+    if (result != VK_SUCCESS) {
+        vktrace_LogError("virtual AllocateCommandBuffers create failed.");
+        return VK_NULL_HANDLE;
+    }
     VkCommandBufferBeginInfo command_buffer_begin_info = {};
     command_buffer_begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-    VkResult result = m_vkDeviceFuncs.BeginCommandBuffer(virtualImageToVirtualCommandBuffer[virtualImage], &command_buffer_begin_info);
+    result = m_vkDeviceFuncs.BeginCommandBuffer(commandBuffer, &command_buffer_begin_info);
     assert(result == VK_SUCCESS);
     std::vector<VkImageMemoryBarrier> image_barriers(2);
     VkImageMemoryBarrier& image_barrier_src = image_barriers.at(0);
@@ -9337,11 +10314,11 @@ VkResult vkReplay::copyFromVirtualImageToReplayImage(VkQueue traceQueue, VkImage
     image_barrier_dst.image = replayImage;
     image_barrier_dst.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
 
-    m_vkDeviceFuncs.CmdPipelineBarrier(virtualImageToVirtualCommandBuffer[virtualImage], VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+    m_vkDeviceFuncs.CmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
         VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, NULL, 0, NULL, 1, &image_barrier_src);
-    m_vkDeviceFuncs.CmdPipelineBarrier(virtualImageToVirtualCommandBuffer[virtualImage], VK_PIPELINE_STAGE_TRANSFER_BIT,
+    m_vkDeviceFuncs.CmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
         VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, NULL, 0, NULL, 1, &image_barrier_dst);
-    m_vkDeviceFuncs.CmdCopyImage(virtualImageToVirtualCommandBuffer[virtualImage], virtualImage, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+    m_vkDeviceFuncs.CmdCopyImage(commandBuffer, virtualImage, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
         replayImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, pCopyReg);
 
     image_barrier_src.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
@@ -9352,17 +10329,51 @@ VkResult vkReplay::copyFromVirtualImageToReplayImage(VkQueue traceQueue, VkImage
     image_barrier_src.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
     image_barrier_dst.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
     image_barrier_dst.newLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR; // TBD could also be VK_IMAGE_LAYOUT_SHARED_PRESENT_KHR
-    m_vkDeviceFuncs.CmdPipelineBarrier(virtualImageToVirtualCommandBuffer[virtualImage], VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, NULL, 0, NULL, image_barriers.size(), image_barriers.data());
+    m_vkDeviceFuncs.CmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, NULL, 0, NULL, image_barriers.size(), image_barriers.data());
 
-    result = m_vkDeviceFuncs.EndCommandBuffer(virtualImageToVirtualCommandBuffer[virtualImage]);
+    result = m_vkDeviceFuncs.EndCommandBuffer(commandBuffer);
     assert(result == VK_SUCCESS);
+    virtualImageToCopyCommandBuffers[virtualImage][replayImage] = commandBuffer;
+    return commandBuffer;
+}
+
+void vkReplay::releaseVirtualImageCopies(VkDevice remappeddevice, const std::vector<VkImage>& replayImages) {
+    for (auto &it : virtualImageToCopyCommandBuffers) {
+        for (VkImage replayImage : replayImages) {
+            auto cbit = it.second.find(replayImage);
+            if (cbit == it.second.end()) {
+                continue;
+            }
+            // The last copy of the virtual image may still be running.
+            auto fit = virtualImageToDeviceFence.find(it.first);
+            if (fit != virtualImageToDeviceFence.end()) {
+                m_vkDeviceFuncs.WaitForFences(fit->second.device, 1, &fit->second.fence, VK_TRUE, UINT64_MAX);
+            }
+            m_vkDeviceFuncs.FreeCommandBuffers(remappeddevice, virtualImageToVirtualCommandPool[it.first], 1, &cbit->second);
+            it.second.erase(cbit);
+        }
+    }
+}
+
+VkResult vkReplay::copyFromVirtualImageToReplayImage(VkQueue traceQueue, VkImage virtualImage, VkImage replayImage, VkImageCopy* pCopyReg, uint32_t queueFamilyIndex, std::vector<VkSemaphore>& semaphores) {
+    VkQueue queue = m_objMapper.remap_queues(traceQueue);
+    VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+    auto cbit = virtualImageToCopyCommandBuffers[virtualImage].find(replayImage);
+    if (cbit != virtualImageToCopyCommandBuffers[virtualImage].end()) {
+        commandBuffer = cbit->second;
+    } else {
+        commandBuffer = recordVirtualImageCopy(virtualImage, replayImage, pCopyReg);
+        if (commandBuffer == VK_NULL_HANDLE) {
+            return VK_ERROR_VALIDATION_FAILED_EXT;
+        }
+    }
     VkSubmitInfo submitInfo = {};
     submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
     submitInfo.commandBufferCount = 1;
-    submitInfo.pCommandBuffers = &virtualImageToVirtualCommandBuffer[virtualImage];
+    submitInfo.pCommandBuffers = &commandBuffer;
     submitInfo.signalSemaphoreCount = 1;
     submitInfo.pSignalSemaphores = &virtualImageToVirtualSemaphore[virtualImage];
-    result = m_vkDeviceFuncs.QueueSubmit(queue, 1, &submitInfo,virtualImageToVirtualFence[virtualImage]);
+    VkResult result = m_vkDeviceFuncs.QueueSubmit(queue, 1, &submitInfo,virtualImageToVirtualFence[virtualImage]);
     assert(result == VK_SUCCESS);
     semaphores.push_back(virtualImageToVirtualSemaphore[virtualImage]);
     auto it = traceQueueToDevice.find(traceQueue);
@@ -9379,8 +10390,12 @@ VkResult vkReplay::manually_replay_vkQueuePresentKHR(packet_vkQueuePresentKHR *p
     VkResult replayResult = VK_SUCCESS;
     uint32_t remappedImageIndex = m_objMapper.remap_pImageIndex(*pPacket->pPresentInfo->pImageIndices);
     std::vector<VkSemaphore> semaphores;
-    if (g_pReplaySettings->enableVirtualSwapchain && g_pReplaySettings->enableVscPerfMode == FALSE) {
+    if (g_pReplaySettings->enableVirtualSwapchain && g_pReplaySettings->enableVscPerfMode == FALSE && !g_pReplaySettings->noPresent) {
         for (uint32_t i = 0; i < pPacket->pPresentInfo->swapchainCount; i++) {
+            // The trace rendered to the swapchain image itself.
+            if (aliasedTraceSwapchains.count(pPacket->pPresentInfo->pSwapchains[i])) {
+                continue;
+            }
             VkImage traceImage = traceSwapchainToImages[pPacket->pPresentInfo->pSwapchains[i]][pPacket->pPresentInfo->pImageIndices[0]];
             if (curSwapchainImage != VK_NULL_HANDLE && curSwapchainImage != traceImage) {
                 traceImage = curSwapchainImage;
@@ -9497,7 +10512,21 @@ VkResult vkReplay::manually_replay_vkQueuePresentKHR(packet_vkQueuePresentKHR *p
 
         present.waitSemaphoreCount = newSemaphores.size();
         present.pWaitSemaphores = newSemaphores.data();
-        replayResult = m_vkDeviceFuncs.QueuePresentKHR(remappedQueue, &present);
+        if (g_pReplaySettings->noPresent) {
+            // Nothing is shown, the wait semaphores only need to be waited for.
+            if (present.waitSemaphoreCount != 0) {
+                std::vector<VkPipelineStageFlags> waitStages(present.waitSemaphoreCount, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
+                VkSubmitInfo submitInfo = {};
+                submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+                submitInfo.waitSemaphoreCount = present.waitSemaphoreCount;
+                submitInfo.pWaitSemaphores = present.pWaitSemaphores;
+                submitInfo.pWaitDstStageMask = waitStages.data();
+                replayResult = m_vkDeviceFuncs.QueueSubmit(remappedQueue, 1, &submitInfo, VK_NULL_HANDLE);
+            }
+            present.pResults = NULL;
+        } else {
+            replayResult = m_vkDeviceFuncs.QueuePresentKHR(remappedQueue, &present);
+        }
         m_frameNumber++;
 
         // Compare the results from the trace file with those just received from the replay.  Report any differences.
@@ -9528,6 +10557,47 @@ out:
     return replayResult;
 }
 
+// With noPresent nothing is acquired from the swapchain: the semaphore and the
+// fence of the acquire are signaled by an empty submission and the image index
+// of the trace is kept. The frames are rendered to the virtual swapchain
+// images, so the swapchain image doesn't matter.
+VkResult vkReplay::acquire_without_present(VkDevice traceDevice, VkSemaphore traceSemaphore, VkFence traceFence, uint32_t traceImageIndex) {
+    VkSemaphore remappedsemaphore = m_objMapper.remap_semaphores(traceSemaphore);
+    if (traceSemaphore != VK_NULL_HANDLE && remappedsemaphore == VK_NULL_HANDLE) {
+        vktrace_LogError("Error detected in AcquireNextImageKHR() due to invalid remapped VkSemaphore.");
+        return VK_ERROR_VALIDATION_FAILED_EXT;
+    }
+    VkFence remappedfence = m_objMapper.remap_fences(traceFence);
+    if (traceFence != VK_NULL_HANDLE && remappedfence == VK_NULL_HANDLE) {
+        vktrace_LogError("Error detected in AcquireNextImageKHR() due to invalid remapped VkFence.");
+        return VK_ERROR_VALIDATION_FAILED_EXT;
+    }
+    VkQueue remappedQueue = VK_NULL_HANDLE;
+    for (const auto &it : traceQueueToDevice) {
+        if (it.second == traceDevice) {
+            remappedQueue = m_objMapper.remap_queues(it.first);
+            break;
+        }
+    }
+    if (remappedQueue == VK_NULL_HANDLE) {
+        vktrace_LogError("Error detected in AcquireNextImageKHR() due to no queue of the device to signal the acquire.");
+        return VK_ERROR_VALIDATION_FAILED_EXT;
+    }
+    VkSubmitInfo submitInfo = {};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    if (remappedsemaphore != VK_NULL_HANDLE) {
+        submitInfo.signalSemaphoreCount = 1;
+        submitInfo.pSignalSemaphores = &remappedsemaphore;
+    }
+    VkResult replayResult = m_vkDeviceFuncs.QueueSubmit(remappedQueue, 1, &submitInfo, remappedfence);
+    if (replayResult == VK_SUCCESS) {
+        m_objMapper.add_to_pImageIndex_map(traceImageIndex, traceImageIndex);
+        m_pktImgIndex = traceImageIndex;
+        m_imageIndex = traceImageIndex;
+    }
+    return replayResult;
+}
+
 VkResult vkReplay::manually_replay_vkAcquireNextImageKHR(packet_vkAcquireNextImageKHR* pPacket) {
     VkResult replayResult = VK_SUCCESS;
     uint32_t local_pImageIndex;
@@ -9552,6 +10622,9 @@ VkResult vkReplay::manually_replay_vkAcquireNextImageKHR(packet_vkAcquireNextIma
         vktrace_LogError("Error detected in AcquireNextImageKHR() due to invalid remapped VkFence.");
         return VK_ERROR_VALIDATION_FAILED_EXT;
     }
+    if (g_pReplaySettings->noPresent) {
+        return acquire_without_present(pPacket->device, pPacket->semaphore, pPacket->fence, *(pPacket->pImageIndex));
+    }
     if (g_pReplaySettings->forceSyncImgIdx) {
         uint32_t swapchain_img_count = swapchainImageAcquireStatus[pPacket->swapchain].size();
         local_pImageIndex = *(pPacket->pImageIndex);
@@ -11712,12 +12785,56 @@ bool vkReplay::premap_CmdBindDescriptorSets(vktrace_trace_packet_header* pHeader
     return true;
 }
 
-bool vkReplay::premap_CmdDrawIndexed(vktrace_trace_packet_header* pHeader)
+bool vkReplay::premap_QueueSubmit(vktrace_trace_packet_header* pHeader)
 {
-    packet_vkCmdDrawIndexed* pPacket = reinterpret_cast<packet_vkCmdDrawIndexed*>(pHeader->pBody);
+    packet_vkQueueSubmit* pPacket = reinterpret_cast<packet_vkQueueSubmit*>(pHeader->pBody);
+    // The queue, the fence and the semaphores are remapped when replaying, their maps are not shared with the preload
+    // thread so the lookups don't take the lock of the premapped maps.
+    for (uint32_t submit_idx = 0; submit_idx < pPacket->submitCount; submit_idx++) {
+        const VkSubmitInfo *submit = &pPacket->pSubmits[submit_idx];
+        for (uint32_t i = 0; i < submit->commandBufferCount && submit->pCommandBuffers != NULL; i++) {
+            VkCommandBuffer *pCommandBuffer = m_objMapper.add_null_to_commandbuffers_map(submit->pCommandBuffers[i]);
+            const_cast<VkCommandBuffer*>(submit->pCommandBuffers)[i] = reinterpret_cast<VkCommandBuffer>(pCommandBuffer);
+        }
+    }
+
+    return true;
+}
+
+bool vkReplay::premap_QueueSubmit2(vktrace_trace_packet_header* pHeader)
+{
+    packet_vkQueueSubmit2* pPacket = reinterpret_cast<packet_vkQueueSubmit2*>(pHeader->pBody);
+    // See premap_QueueSubmit().
+    for (uint32_t submit_idx = 0; submit_idx < pPacket->submitCount; submit_idx++) {
+        const VkSubmitInfo2 *submit = &pPacket->pSubmits[submit_idx];
+        for (uint32_t i = 0; i < submit->commandBufferInfoCount && submit->pCommandBufferInfos != NULL; i++) {
+            VkCommandBuffer *pCommandBuffer = m_objMapper.add_null_to_commandbuffers_map(submit->pCommandBufferInfos[i].commandBuffer);
+            const_cast<VkCommandBufferSubmitInfo*>(submit->pCommandBufferInfos)[i].commandBuffer = reinterpret_cast<VkCommandBuffer>(pCommandBuffer);
+        }
+    }
+
+    return true;
+}
+
+bool vkReplay::premap_QueueSubmit2KHR(vktrace_trace_packet_header* pHeader)
+{
+    // vkQueueSubmit2KHR has the same packet layout.
+    return premap_QueueSubmit2(pHeader);
+}
+
+bool vkReplay::premap_CmdBindVertexBuffers(vktrace_trace_packet_header* pHeader)
+{
+    packet_vkCmdBindVertexBuffers* pPacket = reinterpret_cast<packet_vkCmdBindVertexBuffers*>(pHeader->pBody);
     VkCommandBuffer *pCommandBuffer = m_objMapper.add_null_to_commandbuffers_map(pPacket->commandBuffer);
     pPacket->commandBuffer = reinterpret_cast<VkCommandBuffer>(pCommandBuffer);
 
+    for (uint32_t i = 0; i < pPacket->bindingCount && pPacket->pBuffers != NULL; i++) {
+        if (pPacket->pBuffers[i] != VK_NULL_HANDLE) {
+            bufferObj *pBufferObj = m_objMapper.add_null_to_buffers_map(pPacket->pBuffers[i]);
+            const_cast<VkBuffer*>(pPacket->pBuffers)[i] = reinterpret_cast<VkBuffer>(pBufferObj);
+        }
+    }
+
     return true;
 }
 
@@ -11764,20 +12881,31 @@ void vkReplay::changeDeviceFeature(VkBool32 *traceFeatures,VkBool32 *deviceFeatu
 
 void vkReplay::deviceWaitIdle()
 {
+    if (m_parallelRecorder != nullptr) {
+        m_parallelRecorder->Sync();
+    }
     if (g_pReplaySettings->premapping) {
         for (auto obj = m_objMapper.m_indirect_devices.begin(); obj != m_objMapper.m_indirect_devices.end(); obj++) {
-            if (*obj->second != VK_NULL_HANDLE)
+            if (*obj->second != VK_NULL_HANDLE) {
                 m_vkDeviceFuncs.DeviceWaitIdle(*obj->second);
+                if (m_gpuTimestamps != nullptr) {
+                    m_gpuTimestamps->Resolve(*obj->second);
+                }
+            }
         }
     }
     else {
         for (auto obj = m_objMapper.m_devices.begin(); obj != m_objMapper.m_devices.end(); obj++) {
             m_vkDeviceFuncs.DeviceWaitIdle(obj->second);
+            if (m_gpuTimestamps != nullptr) {
+                m_gpuTimestamps->Resolve(obj->second);
+            }
         }
     }
 }
 
 void vkReplay::on_terminate() {
+    resolve_all_async_pipelines();
     if (g_pReplaySettings->enablePipelineCache) {
         assert(nullptr != m_pipelinecache_accessor);
         auto cache_list = m_pipelinecache_accessor->GetCollectedPacketInfo();
@@ -31,6 +31,7 @@
 #include <stack>
 #include <string>
 #include <queue>
+#include <mutex>
 #if defined(PLATFORM_LINUX)
 #if defined(ANDROID)
 #include <android_native_app_glue.h>
@@ -108,6 +109,12 @@ extern "C" {
 #include "vkreplay_vkdisplay.h"
 #include "vkreplay_vk_objmapper.h"
 #include "vkreplay_pipelinecache.h"
+#include "vkreplay_asyncpipeline.h"
+#include "vkreplay_parallelrecord.h"
+#include "vkreplay_gputimestamps.h"
+#include "vkreplay_memorypool.h"
+#include "vkreplay_memorystats.h"
+#include "vkreplay_pipelineprewarm.h"
 #if !defined(ANDROID) && defined(PLATFORM_LINUX)
 #include "arm_headless_ext.h"
 #endif
@@ -136,6 +143,7 @@ class vkReplay {
     void push_validation_msg(VkFlags msgFlags, VkDebugReportObjectTypeEXT objType, uint64_t srcObjectHandle, size_t location,
                              int32_t msgCode, const char* pLayerPrefix, const char* pMsg, const void* pUserData);
     vktrace_replay::VKTRACE_REPLAY_RESULT pop_validation_msgs();
+    vktrace_replay::VKTRACE_REPLAY_RESULT pop_parallel_recording_result();
     int dump_validation_data();
     int get_frame_number() { return m_frameNumber; }
     void reset_frame_number(int frameNumber) { m_frameNumber = frameNumber > 0 ? frameNumber : 0; }
@@ -149,9 +157,18 @@ class vkReplay {
     bool premap_FlushMappedMemoryRanges(vktrace_trace_packet_header* pHeader);
     bool premap_UpdateDescriptorSets(vktrace_trace_packet_header* pHeader);
     bool premap_CmdBindDescriptorSets(vktrace_trace_packet_header* pHeader);
-    bool premap_CmdDrawIndexed(vktrace_trace_packet_header* pHeader);
+    bool premap_QueueSubmit(vktrace_trace_packet_header* pHeader);
+    bool premap_QueueSubmit2(vktrace_trace_packet_header* pHeader);
+    bool premap_QueueSubmit2KHR(vktrace_trace_packet_header* pHeader);
+    bool premap_CmdBindVertexBuffers(vktrace_trace_packet_header* pHeader);
+    // Premaps the packets of the premapped commands, generated along with replay().
+    bool premap(vktrace_trace_packet_header* pHeader);
 
     void post_interpret(vktrace_trace_packet_header* pHeader);
+    void wait_async_pipelines_idle();
+    void scan_async_pipelines(vktrace_trace_packet_header* pHeader);
+    bool record_in_parallel(vktrace_trace_packet_header* packet);
+    void wait_parallel_recording_idle();
     vkReplayObjMapper* get_ReplayObjMapper() { return &m_objMapper; };
     std::unordered_map<VkDevice, VkPhysicalDevice> &get_ReplayPhysicalDevices () { return replayPhysicalDevices; };
     VkLayerInstanceDispatchTable* get_VkLayerInstanceDispatchTable() { return &m_vkFuncs; };
@@ -271,6 +288,8 @@ class vkReplay {
 
     VkDebugReportCallbackEXT m_dbgMsgCallbackObj;
 
+    // Also pushed by the parallel recording threads.
+    std::mutex m_validationMsgsMutex;
     std::vector<struct ValidationMsg> m_validationMsgs;
     std::vector<int> m_screenshotFrames;
 
@@ -308,6 +327,9 @@ class vkReplay {
     // VkResult manually_replay_vkGetGlobalExtensionInfo(packet_vkGetGlobalExtensionInfo* pPacket);
     // VkResult manually_replay_vkGetPhysicalDeviceExtensionInfo(packet_vkGetPhysicalDeviceExtensionInfo* pPacket);
     VkResult manually_replay_vkQueueSubmit(packet_vkQueueSubmit* pPacket);
+    VkResult manually_replay_vkQueueSubmitPremapped(packet_vkQueueSubmit* pPacket);
+    VkResult submit_remapped(VkQueue traceQueue, VkQueue remappedQueue, uint32_t submitCount, VkSubmitInfo* remappedSubmits,
+                             VkFence remappedFence);
     VkResult manually_replay_vkQueueBindSparse(packet_vkQueueBindSparse* pPacket);
     // VkResult manually_replay_vkGetObjectInfo(packet_vkGetObjectInfo* pPacket);
     // VkResult manually_replay_vkGetImageSubresourceInfo(packet_vkGetImageSubresourceInfo* pPacket);
@@ -346,7 +368,7 @@ class vkReplay {
     VkResult manually_replay_vkFlushMappedMemoryRanges(packet_vkFlushMappedMemoryRanges* pPacket);
     VkResult manually_replay_vkFlushMappedMemoryRangesRemapAsInstanceSGHandle(packet_vkFlushMappedMemoryRangesRemapAsInstanceSGHandle* pPacket);
     VkResult manually_replay_vkFlushMappedMemoryRangesPremapped(packet_vkFlushMappedMemoryRanges* pPacket);
-    void manually_replay_vkCmdDrawIndexedPremapped(packet_vkCmdDrawIndexed* pPacket);
+    void manually_replay_vkCmdBindVertexBuffersPremapped(packet_vkCmdBindVertexBuffers* pPacket);
     VkResult manually_replay_vkInvalidateMappedMemoryRanges(packet_vkInvalidateMappedMemoryRanges* pPacket);
     void manually_replay_vkGetPhysicalDeviceMemoryProperties(packet_vkGetPhysicalDeviceMemoryProperties* pPacket);
     void manually_replay_vkGetPhysicalDeviceMemoryProperties2KHR(packet_vkGetPhysicalDeviceMemoryProperties2KHR* pPacket);
@@ -377,6 +399,7 @@ class vkReplay {
     void manually_replay_vkDestroySwapchainKHR(packet_vkDestroySwapchainKHR* pPacket);
     VkResult manually_replay_vkGetSwapchainImagesKHR(packet_vkGetSwapchainImagesKHR* pPacket);
     VkResult manually_replay_vkQueuePresentKHR(packet_vkQueuePresentKHR* pPacket);
+    VkResult acquire_without_present(VkDevice traceDevice, VkSemaphore traceSemaphore, VkFence traceFence, uint32_t traceImageIndex);
     VkResult manually_replay_vkAcquireNextImageKHR(packet_vkAcquireNextImageKHR* pPacket);
     VkResult manually_replay_vkCreateXcbSurfaceKHR(packet_vkCreateXcbSurfaceKHR* pPacket);
     VkBool32 manually_replay_vkGetPhysicalDeviceXcbPresentationSupportKHR(
@@ -453,6 +476,13 @@ class vkReplay {
     VkResult manually_replay_vkWaitSemaphores(packet_vkWaitSemaphores* pPacket);
     VkResult manually_replay_vkWaitSemaphoresKHR(packet_vkWaitSemaphoresKHR* pPacket);
     VkResult manually_replay_vkQueueSubmit2(packet_vkQueueSubmit2 *pPacket);
+    VkResult manually_replay_vkQueueSubmit2KHR(packet_vkQueueSubmit2KHR *pPacket);
+    VkResult manually_replay_vkQueueSubmit2(packet_vkQueueSubmit2 *pPacket, PFN_vkQueueSubmit2 queueSubmit2);
+    VkResult manually_replay_vkQueueSubmit2Premapped(packet_vkQueueSubmit2 *pPacket);
+    VkResult manually_replay_vkQueueSubmit2KHRPremapped(packet_vkQueueSubmit2KHR *pPacket);
+    VkResult manually_replay_vkQueueSubmit2Premapped(packet_vkQueueSubmit2 *pPacket, PFN_vkQueueSubmit2 queueSubmit2);
+    VkResult submit2_remapped(VkQueue traceQueue, VkQueue remappedQueue, uint32_t submitCount, VkSubmitInfo2 *remappedSubmits,
+                              VkFence remappedFence, PFN_vkQueueSubmit2 queueSubmit2);
     void manually_replay_vkCmdBeginRendering(packet_vkCmdBeginRendering *pPacket);
     VkResult manually_replay_vkImportSemaphoreFdKHR(packet_vkImportSemaphoreFdKHR* pPacket);
 
@@ -538,8 +568,11 @@ class vkReplay {
     std::unordered_map<VkImage, VkFence>  virtualImageToVirtualFence;
     std::unordered_map<VkImage, VkSemaphore>  virtualImageToVirtualSemaphore;
     std::unordered_map<VkImage, VkCommandPool>  virtualImageToVirtualCommandPool;
-    std::unordered_map<VkImage, VkCommandBuffer>  virtualImageToVirtualCommandBuffer;
+    // The copy of a virtual image to each replay swapchain image it was presented to, recorded once.
+    std::unordered_map<VkImage, std::unordered_map<VkImage, VkCommandBuffer>>  virtualImageToCopyCommandBuffers;
     std::unordered_map<VkSwapchainKHR, VkImageCopy>  traceSwapchainToVirtualImageCopyRegion;
+    // The trace swapchains whose images are not virtual with enableVscAlias.
+    std::unordered_set<VkSwapchainKHR> aliasedTraceSwapchains;
 
     // Map VkPhysicalDevice to VkPhysicalDeviceMemoryProperites
     std::unordered_map<VkPhysicalDevice, VkPhysicalDeviceMemoryProperties> traceMemoryProperties;
@@ -565,8 +598,17 @@ class vkReplay {
             traceFramebufferToAttachmentCount.clear();
             traceFramebufferToRenderpass.clear();
         }
+
+        // VK_NULL_HANDLE if the framebuffer is unknown. Doesn't insert, the
+        // render passes may be begun on the parallel recording threads.
+        VkRenderPass find_renderpass(VkFramebuffer framebuffer) const {
+            auto it = traceFramebufferToRenderpass.find(framebuffer);
+            return it != traceFramebufferToRenderpass.end() ? it->second : VK_NULL_HANDLE;
+        }
     };
     std::unordered_map<VkSwapchainKHR, SwapchainImageState> swapchainImageStates;
+    // An empty state if the swapchain is unknown, without inserting it.
+    const SwapchainImageState &find_swapchain_image_state(VkSwapchainKHR swapchain) const;
     std::unordered_map<VkSwapchainKHR, VkSwapchainCreateInfoKHR> traceSwapchainToCreateInfo;
     VkSwapchainKHR curSwapchainHandle;
     VkImage curSwapchainImage;
@@ -577,6 +619,7 @@ class vkReplay {
     std::unordered_map< VkSemaphore, VkSemaphore > acquireSemaphoreToFSIISemaphore;
     std::unordered_map< VkFence, VkFence > acquireFenceToFSIIFence;
     std::unordered_map< VkQueue, VkDevice > traceQueueToDevice;
+    std::unordered_map< VkQueue, uint32_t > traceQueueToFamilyIndex;
     std::queue< std::pair<VkSemaphore, VkFence> > fsiiSemaphoresAndFences;
 
     // Map VkImage to VkMemoryRequirements
@@ -707,6 +750,8 @@ class vkReplay {
     bool createVirtualObject(VkDevice traceDevice, VkSwapchainKHR traceSwapchain, VkImage* pRealImages, uint32_t traceImageCount);
     VkImage getVirtualSwapchainImage(VkImage traceImage);
     VkResult copyFromVirtualImageToReplayImage(VkQueue traceQueue, VkImage virtualImage, VkImage replayImage, VkImageCopy* pCopyReg, uint32_t queueFamilyIndex, std::vector<VkSemaphore>& semaphores);
+    VkCommandBuffer recordVirtualImageCopy(VkImage virtualImage, VkImage replayImage, const VkImageCopy* pCopyReg);
+    void releaseVirtualImageCopies(VkDevice remappeddevice, const std::vector<VkImage>& replayImages);
     void deleteVirtualObject(VkDevice remappeddevice, VkImage image);
     bool checkFVRSParam();
 
@@ -718,6 +763,47 @@ class vkReplay {
 
     vktrace_replay::PipelineCacheAccessor::Ptr    m_pipelinecache_accessor;
 
+    std::unique_ptr<vktrace_replay::AsyncPipelineCompiler> m_asyncPipelineCompiler;
+    bool use_async_pipeline_creation(VkResult traceResult) const;
+    // Set when a pipeline creation has failed since the last replayed packet.
+    std::atomic<bool> m_asyncPipelineFailed;
+    // Packets whose creation could not be submitted early, their create infos
+    // have already been remapped.
+    std::unordered_set<uint64_t> m_asyncPipelineLookAheadFailures;
+    bool m_asyncPipelineLookAhead;
+    void add_async_pipelines(const vktrace_replay::AsyncPipelineCompiler::JobPtr& job);
+    void resolve_async_pipeline(VkPipeline tracePipeline);
+    void resolve_all_async_pipelines();
+    void release_unclaimed_async_pipelines(VkDevice device);
+    void sync_async_pipelines(vktrace_trace_packet_header* packet);
+    bool has_async_pipelines() const { return m_asyncPipelineCompiler != nullptr && m_asyncPipelineCompiler->HasPending(); }
+    bool claim_async_pipelines(vktrace_trace_packet_header* pHeader, VkResult* pResult);
+    bool async_pipeline_dependencies_ready(const vktrace_replay::AsyncPipelineCompiler::Candidate& candidate);
+    void look_ahead_async_pipelines(vktrace_trace_packet_header* packet);
+    vktrace_replay::VKTRACE_REPLAY_RESULT async_pipelines_replayed(vktrace_trace_packet_header* packet,
+                                                                   vktrace_replay::VKTRACE_REPLAY_RESULT result);
+
+    std::unique_ptr<vktrace_replay::ParallelRecorder> m_parallelRecorder;
+    VkCommandBuffer get_parallel_command_buffer(vktrace_trace_packet_header* packet) const;
+    void track_parallel_command_buffers(vktrace_trace_packet_header* packet);
+    std::vector<VkCommandBuffer> get_premapped_command_buffers(uint32_t commandBufferCount, const VkCommandBuffer* pCommandBuffers);
+
+    std::unique_ptr<vktrace_replay::GpuTimestamps> m_gpuTimestamps;
+    bool can_measure_submit(uint32_t submitCount, const VkSubmitInfo* pSubmits) const;
+    bool can_measure_submit(uint32_t submitCount, const VkSubmitInfo2* pSubmits) const;
+    bool begin_gpu_timestamp_submit(VkQueue traceQueue, VkQueue remappedQueue, VkCommandBuffer* pBegin, VkCommandBuffer* pEnd,
+                                    VkFence* pFence);
+    void end_gpu_timestamp_submit(bool timed, VkQueue remappedQueue, VkResult result, VkFence remappedFence);
+    void release_gpu_timestamps(VkDevice device);
+    void add_memory_stats_device(VkDevice device, VkPhysicalDevice physicalDevice);
+
+    // Pipeline caches of the pre-warm pass per replay device, and the pipeline
+    // caches of the trace they have been merged into.
+    std::unordered_map<VkDevice, VkPipelineCache> m_prewarmPipelineCaches;
+    std::unordered_set<VkPipelineCache> m_prewarmMergedPipelineCaches;
+    VkPipelineCache get_prewarm_pipeline_cache(VkDevice device, VkPipelineCache pipelineCache);
+    void release_prewarm_pipeline_cache(VkDevice device);
+
     std::unordered_map<VkQueryPool, VkQueryType>  m_querypool_type;
 
     friend RayTracingPipelineShaderInfo;
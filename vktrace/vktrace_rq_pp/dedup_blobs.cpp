@@ -0,0 +1,486 @@
+#include <algorithm>
+#include <cinttypes>
+#include <cstring>
+#include <deque>
+#include <iterator>
+#include <unordered_map>
+#include <vector>
+
+#include "vktrace_rq_pp.h"
+#include "vktrace_vk_packet_id.h"
+#include "vktrace_packet_scanner.h"
+#include "vktrace_pageguard_memorycopy.h"
+
+// Stores the large payloads which occur more than once in a trace only once.
+//
+// The payloads of vkCmdUpdateBuffer, vkCreateShaderModule and vkFlushMappedMemoryRanges
+// are hashed in the pre pass. In the post pass the first occurrence of a repeated payload
+// is written to a VKTRACE_TPI_BLOB packet placed before the packet using it, and every
+// occurrence is removed from its packet and replaced by a reference to the blob. A payload
+// only becomes a blob reference if its bytes equal the blob, a hash match is not enough.
+//
+// The replayer keeps the blobs in memory, so payloads which occur once are left in place.
+// This pass does not: a blob is recorded by the location of its first occurrence in the
+// input trace, which is read back to compare the bytes when the hash matches again.
+// Flushed memory of traces with AS functions is not deduplicated, because the replayer
+// remaps the device addresses in it in place. The dedup command must run after the rq
+// command.
+
+static const uint64_t kMinBlobSize = 4096;
+
+struct payload_ref {
+    size_t field;     // Index of the pointer field in the fields of the packet
+    uint64_t offset;  // Offset of the payload from the packet body
+    uint64_t size;
+};
+
+struct blob_source {
+    uint64_t packetPosition;  // File offset of the packet with the first occurrence of the payload
+    uint64_t packetSize;
+    uint64_t offset;  // Offset of the payload from the decompressed packet body
+    uint64_t size;
+};
+
+// The payloads read back most recently, so a blob which repeats in a row is not read every time.
+static const uint64_t kBlobCacheBytes = 64 * 1024 * 1024;
+
+static std::unordered_map<uint64_t, uint32_t> s_hashCounts;
+static std::unordered_map<uint64_t, std::vector<uint64_t>> s_hashToBlobIds;
+static std::vector<blob_source> s_blobs;
+static std::unordered_map<uint64_t, std::vector<uint8_t>> s_blobCache;
+static std::deque<uint64_t> s_blobCacheOrder;
+static uint64_t s_blobCacheBytes = 0;
+static FileLike* s_traceFile = nullptr;
+static uint64_t s_blobBytes = 0;
+static uint64_t s_maxGid = 0;
+static uint64_t s_references = 0;
+static uint64_t s_savedBytes = 0;
+
+static uint64_t hash_payload(const uint8_t* pData, uint64_t size) {
+    // FNV-1a on 64-bit words, folded so the high bits of each word reach the low bits.
+    const uint64_t prime = 1099511628211ULL;
+    uint64_t hash = 14695981039346656037ULL ^ size;
+    uint64_t i = 0;
+    for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t)) {
+        uint64_t word;
+        memcpy(&word, pData + i, sizeof(word));
+        hash = (hash ^ word) * prime;
+        hash ^= hash >> 29;
+    }
+    for (; i < size; i++) {
+        hash = (hash ^ pData[i]) * prime;
+    }
+    return hash;
+}
+
+static bool is_candidate(vktrace_trace_file_header* pFileHeader, uint16_t packetId) {
+    switch (packetId) {
+        case VKTRACE_TPI_VK_vkCmdUpdateBuffer:
+        case VKTRACE_TPI_VK_vkCreateShaderModule:
+            return true;
+        case VKTRACE_TPI_VK_vkFlushMappedMemoryRanges:
+            // Older traces store the flushed ranges without the page guard block info, so
+            // the size of the data is not known.
+            return pFileHeader->trace_file_version >= VKTRACE_TRACE_FILE_VERSION_5 &&
+                   !(pFileHeader->bit_flags & VKTRACE_USE_ACCELERATION_STRUCTURE_API_BIT);
+        default:
+            return false;
+    }
+}
+
+// The pointer fields of a packet are byte offsets from the packet body.
+class packet_fields {
+   public:
+    explicit packet_fields(vktrace_trace_packet_header* pHeader)
+        : m_pBody((uint8_t*)pHeader->pBody), m_bodySize(pHeader->size - sizeof(vktrace_trace_packet_header)) {}
+
+    bool in_body(uint64_t offset, uint64_t size) const {
+        return offset != 0 && !(offset & VKTRACE_BLOB_REFERENCE_BIT) && offset <= m_bodySize && size <= m_bodySize - offset;
+    }
+
+    // Adds the pointer field at pField, returns the offset it holds or 0 if it is NULL or invalid.
+    uint64_t add(const void* pField) {
+        uint64_t location = (const uint8_t*)pField - m_pBody;
+        uint64_t offset = *(const uintptr_t*)pField;
+        if (offset == 0 || location + sizeof(uintptr_t) > m_bodySize) {
+            return 0;
+        }
+        m_fields.push_back(location);
+        return offset;
+    }
+
+    void add_payload(const void* pField, uint64_t size, std::vector<payload_ref>& payloads) {
+        uint64_t offset = add(pField);
+        if (size >= kMinBlobSize && in_body(offset, size)) {
+            payloads.push_back({m_fields.size() - 1, offset, size});
+        }
+    }
+
+    template <typename T>
+    T* at(uint64_t offset, uint64_t count = 1) const {
+        return in_body(offset, sizeof(T) * count) ? (T*)(m_pBody + offset) : nullptr;
+    }
+
+    // Removes the payload from the packet and stores the blob reference in its pointer field.
+    void remove_payload(vktrace_trace_packet_header* pHeader, const payload_ref& payload, uint64_t blobId) {
+        // The removed length keeps the buffers after the payload 8-byte aligned.
+        uint64_t length = ROUNDUP_TO_4(payload.size) & ~(uint64_t)7;
+        uint64_t end = payload.offset + length;
+        memmove(m_pBody + payload.offset, m_pBody + end, (size_t)(m_bodySize - end));
+        for (auto& location : m_fields) {
+            if (location >= end) {
+                location -= length;
+            }
+            uintptr_t* pValue = (uintptr_t*)(m_pBody + location);
+            if (*pValue != 0 && !(*pValue & VKTRACE_BLOB_REFERENCE_BIT) && *pValue >= end) {
+                *pValue -= length;
+            }
+        }
+        *(uintptr_t*)(m_pBody + m_fields[payload.field]) = VKTRACE_BLOB_REFERENCE_BIT | (uintptr_t)blobId;
+        m_bodySize -= length;
+        pHeader->size -= length;
+        if (pHeader->next_buffers_offset >= sizeof(vktrace_trace_packet_header) + end) {
+            pHeader->next_buffers_offset -= length;
+        }
+    }
+
+    const uint8_t* body() const { return m_pBody; }
+
+   private:
+    uint8_t* m_pBody;
+    uint64_t m_bodySize;
+    std::vector<uint64_t> m_fields;
+};
+
+// Returns the size of the page guard data of a flushed range, or 0 if it is not in that format.
+static uint64_t flushed_data_size(const packet_fields& fields, uint64_t offset) {
+    const PageGuardChangedBlockInfo* pInfo = fields.at<PageGuardChangedBlockInfo>(offset);
+    if (pInfo == nullptr || (pInfo[0].reserve0 & PAGEGUARD_SPECIAL_FORMAT_PACKET_FOR_VKFLUSHMAPPEDMEMORYRANGES)) {
+        return 0;
+    }
+    pInfo = fields.at<PageGuardChangedBlockInfo>(offset, (uint64_t)pInfo[0].offset + 1);
+    if (pInfo == nullptr) {
+        return 0;
+    }
+    uint64_t length = 0;
+    for (uint32_t i = 0; i < pInfo[0].offset; i++) {
+        length += pInfo[i + 1].length;
+    }
+    uint64_t size = sizeof(PageGuardChangedBlockInfo) * ((uint64_t)pInfo[0].offset + 1) + pInfo[0].length;
+    return (length == pInfo[0].length && fields.in_body(offset, size)) ? size : 0;
+}
+
+// Finds the pointer fields and the payloads of a decompressed packet. Returns false if the
+// packet has pointers which are not known, e.g. a pNext chain.
+static bool find_payloads(vktrace_trace_packet_header* pHeader, packet_fields& fields, std::vector<payload_ref>& payloads) {
+    switch (pHeader->packet_id) {
+        case VKTRACE_TPI_VK_vkCmdUpdateBuffer: {
+            packet_vkCmdUpdateBuffer* pPacket = (packet_vkCmdUpdateBuffer*)pHeader->pBody;
+            fields.add_payload(&pPacket->pData, pPacket->dataSize, payloads);
+        } break;
+        case VKTRACE_TPI_VK_vkCreateShaderModule: {
+            packet_vkCreateShaderModule* pPacket = (packet_vkCreateShaderModule*)pHeader->pBody;
+            VkShaderModuleCreateInfo* pCreateInfo = fields.at<VkShaderModuleCreateInfo>(fields.add(&pPacket->pCreateInfo));
+            if (pCreateInfo == nullptr || pCreateInfo->pNext != nullptr) {
+                return false;
+            }
+            fields.add(&pPacket->pAllocator);
+            fields.add(&pPacket->pShaderModule);
+            fields.add_payload(&pCreateInfo->pCode, pCreateInfo->codeSize, payloads);
+        } break;
+        case VKTRACE_TPI_VK_vkFlushMappedMemoryRanges: {
+            packet_vkFlushMappedMemoryRanges* pPacket = (packet_vkFlushMappedMemoryRanges*)pHeader->pBody;
+            uint32_t count = pPacket->memoryRangeCount;
+            VkMappedMemoryRange* pRanges = fields.at<VkMappedMemoryRange>(fields.add(&pPacket->pMemoryRanges), count);
+            uintptr_t* ppData = fields.at<uintptr_t>(fields.add(&pPacket->ppData), count);
+            if (pRanges == nullptr || ppData == nullptr) {
+                return false;
+            }
+            for (uint32_t i = 0; i < count; i++) {
+                if (pRanges[i].pNext != nullptr) {
+                    return false;
+                }
+            }
+            for (uint32_t i = 0; i < count; i++) {
+                // Only the first range of each memory has data, the other entries are not initialized.
+                bool first = true;
+                for (uint32_t j = 0; j < i && first; j++) {
+                    first = pRanges[j].memory != pRanges[i].memory;
+                }
+                if (first) {
+                    fields.add_payload(&ppData[i], flushed_data_size(fields, ppData[i]), payloads);
+                }
+            }
+        } break;
+        default:
+            return false;
+    }
+    return true;
+}
+
+static int decompress(vktrace_trace_file_header* pFileHeader, vktrace_trace_packet_header*& pHeader) {
+    if (g_compressor == nullptr) {
+        g_compressor = create_compressor((VKTRACE_COMPRESS_TYPE)pFileHeader->compress_type);
+        if (g_compressor == nullptr) {
+            vktrace_LogError("Create compressor failed.");
+            return -1;
+        }
+    }
+    if (g_decompressor == nullptr) {
+        g_decompressor = create_decompressor((VKTRACE_COMPRESS_TYPE)pFileHeader->compress_type);
+        if (g_decompressor == nullptr) {
+            vktrace_LogError("Create decompressor failed.");
+            return -1;
+        }
+    }
+    if (decompress_packet(g_decompressor, pHeader) < 0) {
+        vktrace_LogError("Decompress the packet failed !");
+        return -1;
+    }
+    return 0;
+}
+
+static void cache_blob(uint64_t blobId, const uint8_t* pData, uint64_t size) {
+    if (size > kBlobCacheBytes) {
+        return;
+    }
+    while (s_blobCacheBytes + size > kBlobCacheBytes && !s_blobCacheOrder.empty()) {
+        auto it = s_blobCache.find(s_blobCacheOrder.front());
+        s_blobCacheBytes -= it->second.size();
+        s_blobCache.erase(it);
+        s_blobCacheOrder.pop_front();
+    }
+    s_blobCache[blobId].assign(pData, pData + size);
+    s_blobCacheOrder.push_back(blobId);
+    s_blobCacheBytes += size;
+}
+
+// Compares a payload with a blob, the blob is read back from the input trace if it is not cached.
+static int compare_blob(vktrace_trace_file_header* pFileHeader, uint64_t blobId, const uint8_t* pData, uint64_t size,
+                        bool& equal) {
+    const blob_source& source = s_blobs[blobId];
+    equal = false;
+    if (source.size != size) {
+        return 0;
+    }
+    auto it = s_blobCache.find(blobId);
+    if (it != s_blobCache.end()) {
+        equal = memcmp(it->second.data(), pData, (size_t)size) == 0;
+        return 0;
+    }
+
+    vktrace_trace_packet_header* pHeader = (vktrace_trace_packet_header*)vktrace_malloc((size_t)source.packetSize);
+    if (pHeader == nullptr) {
+        vktrace_LogError("Failed to allocate trace packet with size of %" PRIu64 ".", source.packetSize);
+        return -1;
+    }
+    if (!vktrace_FileLike_SetCurrentPosition(s_traceFile, source.packetPosition) ||
+        !vktrace_FileLike_ReadRaw(s_traceFile, pHeader, source.packetSize)) {
+        vktrace_LogError("Failed to read back the payload of blob %" PRIu64 ".", blobId);
+        vktrace_free(pHeader);
+        return -1;
+    }
+    pHeader->pBody = (uintptr_t)(pHeader + 1);
+    if (pHeader->tracer_id == VKTRACE_TID_VULKAN_COMPRESSED && decompress(pFileHeader, pHeader) != 0) {
+        vktrace_free(pHeader);
+        return -1;
+    }
+    const uint8_t* pBlob = (const uint8_t*)pHeader->pBody + source.offset;
+    equal = memcmp(pBlob, pData, (size_t)size) == 0;
+    cache_blob(blobId, pBlob, size);
+    vktrace_free(pHeader);
+    return 0;
+}
+
+int pre_dedup_blobs(vktrace_trace_file_header* pFileHeader, FileLike* traceFile) {
+    if (pFileHeader->bit_flags & VKTRACE_BLOBS_DEDUPLICATED_BIT) {
+        vktrace_LogError("The blobs of the trace file are already deduplicated.");
+        return -1;
+    }
+    // The output is marked with the file version of the blob packets, so older replayers
+    // reject it. The file header of older versions has a different meaning then.
+    if (pFileHeader->trace_file_version < VKTRACE_TRACE_FILE_VERSION_11) {
+        vktrace_LogError("The dedup command needs a trace file of version %d or later, the trace file has version %d.",
+                         VKTRACE_TRACE_FILE_VERSION_11, pFileHeader->trace_file_version);
+        return -1;
+    }
+    s_traceFile = traceFile;
+    if (pFileHeader->bit_flags & VKTRACE_USE_ACCELERATION_STRUCTURE_API_BIT) {
+        vktrace_LogVerbose("The flushed memory is not deduplicated, there are AS related functions in the trace file.");
+    }
+
+    vktrace_PacketScanner* pScanner = vktrace_PacketScanner_create(traceFile, pFileHeader->first_packet_offset, 0);
+    if (pScanner == nullptr) {
+        return -1;
+    }
+    int ret = 0;
+    vktrace_trace_packet_header header;
+    uint64_t position = 0;
+    while (ret == 0 && vktrace_PacketScanner_next(pScanner, &header, &position)) {
+        s_maxGid = std::max(s_maxGid, header.global_packet_index);
+        if (!is_candidate(pFileHeader, header.packet_id) || header.size < sizeof(vktrace_trace_packet_header) + kMinBlobSize) {
+            continue;
+        }
+        vktrace_trace_packet_header* pHeader = (vktrace_trace_packet_header*)vktrace_malloc((size_t)header.size);
+        if (pHeader == nullptr) {
+            vktrace_LogError("Failed to allocate trace packet with size of %" PRIu64 ".", header.size);
+            ret = -1;
+            break;
+        }
+        *pHeader = header;
+        pHeader->pBody = (uintptr_t)(pHeader + 1);
+        if (!vktrace_PacketScanner_read_body(pScanner, 0, pHeader + 1, header.size - sizeof(header))) {
+            vktrace_LogError("Failed to read trace packet with size of %" PRIu64 ".", header.size);
+            ret = -1;
+        } else if (pHeader->tracer_id != VKTRACE_TID_VULKAN_COMPRESSED || decompress(pFileHeader, pHeader) == 0) {
+            packet_fields fields(pHeader);
+            std::vector<payload_ref> payloads;
+            if (find_payloads(pHeader, fields, payloads)) {
+                for (const auto& payload : payloads) {
+                    s_hashCounts[hash_payload(fields.body() + payload.offset, payload.size)]++;
+                }
+            }
+        } else {
+            ret = -1;
+        }
+        vktrace_free(pHeader);
+    }
+    vktrace_PacketScanner_delete(&pScanner);
+    if (ret != 0) {
+        return ret;
+    }
+
+    // Payloads which occur once are not kept.
+    for (auto it = s_hashCounts.begin(); it != s_hashCounts.end();) {
+        it = (it->second < 2) ? s_hashCounts.erase(it) : std::next(it);
+    }
+    vktrace_LogVerbose("Found %zu repeated payloads.", s_hashCounts.size());
+    pFileHeader->bit_flags |= VKTRACE_BLOBS_DEDUPLICATED_BIT;
+    pFileHeader->trace_file_version = std::max<uint32_t>(pFileHeader->trace_file_version, VKTRACE_TRACE_FILE_VERSION_12);
+    return 0;
+}
+
+static int write_blob_packet(vktrace_trace_file_header* pFileHeader, const vktrace_trace_packet_header* pRefHeader,
+                             uint64_t blobId, const uint8_t* pData, uint64_t size, FILE* newTraceFile, uint64_t* fileOffset,
+                             uint64_t* fileSize) {
+    uint64_t packetSize = ROUNDUP_TO_8(sizeof(vktrace_trace_packet_header) + sizeof(vktrace_trace_packet_blob) +
+                                       ROUNDUP_TO_4(size) + sizeof(uint32_t));
+    vktrace_trace_packet_header* pHeader = (vktrace_trace_packet_header*)vktrace_malloc((size_t)packetSize);
+    if (pHeader == nullptr) {
+        vktrace_LogError("Failed to allocate blob packet with size of %" PRIu64 ".", packetSize);
+        return -1;
+    }
+    memset(pHeader, 0, (size_t)packetSize);
+    pHeader->size = packetSize;
+    pHeader->global_packet_index = ++s_maxGid;
+    pHeader->tracer_id = VKTRACE_TID_VULKAN;
+    pHeader->packet_id = VKTRACE_TPI_BLOB;
+    pHeader->thread_id = pRefHeader->thread_id;
+    pHeader->vktrace_begin_time = pHeader->entrypoint_begin_time = pRefHeader->vktrace_begin_time;
+    pHeader->entrypoint_end_time = pHeader->vktrace_end_time = pRefHeader->vktrace_begin_time;
+    pHeader->next_buffers_offset = sizeof(vktrace_trace_packet_header) + sizeof(vktrace_trace_packet_blob) + ROUNDUP_TO_4(size);
+    pHeader->pBody = (uintptr_t)(pHeader + 1);
+    vktrace_trace_packet_blob* pBlob = (vktrace_trace_packet_blob*)pHeader->pBody;
+    pBlob->blob_id = blobId;
+    pBlob->size = size;
+    memcpy(pBlob + 1, pData, (size_t)size);
+
+    if (pFileHeader->compress_type != VKTRACE_COMPRESS_TYPE_NONE) {
+        if (g_compressor == nullptr) {
+            g_compressor = create_compressor((VKTRACE_COMPRESS_TYPE)pFileHeader->compress_type);
+            if (g_compressor == nullptr) {
+                vktrace_LogError("Create compressor failed.");
+                vktrace_free(pHeader);
+                return -1;
+            }
+        }
+        if (compress_packet(g_compressor, pHeader) != 0) {
+            vktrace_free(pHeader);
+            return -1;
+        }
+    }
+    if (pHeader->tracer_id == VKTRACE_TID_VULKAN_COMPRESSED) {
+        g_compress_packet_counter++;
+        *fileSize += packetSize + sizeof(vktrace_trace_packet_header_compression_ext);
+    } else {
+        *fileSize += packetSize;
+    }
+
+    uint64_t bytesWritten = fwrite(pHeader, 1, (size_t)pHeader->size, newTraceFile);
+    fflush(newTraceFile);
+    if (bytesWritten != pHeader->size) {
+        vktrace_LogError("Failed to write the blob packet for blob %" PRIu64 ".", blobId);
+        vktrace_free(pHeader);
+        return -1;
+    }
+    *fileOffset += bytesWritten;
+    vktrace_free(pHeader);
+    return 0;
+}
+
+int post_dedup_blobs(vktrace_trace_file_header* pFileHeader, vktrace_trace_packet_header*& pHeader, FILE* newTraceFile,
+                     uint64_t* fileOffset, uint64_t* fileSize) {
+    if (!is_candidate(pFileHeader, pHeader->packet_id) || s_hashCounts.empty()) {
+        return 0;
+    }
+    bool recompress = false;
+    if (pHeader->tracer_id == VKTRACE_TID_VULKAN_COMPRESSED) {
+        if (decompress(pFileHeader, pHeader) != 0) {
+            return -1;
+        }
+        recompress = true;
+    }
+
+    packet_fields fields(pHeader);
+    std::vector<payload_ref> payloads;
+    if (find_payloads(pHeader, fields, payloads)) {
+        // Removing the payloads from the back keeps the offsets of the ones before valid.
+        std::sort(payloads.begin(), payloads.end(),
+                  [](const payload_ref& a, const payload_ref& b) { return a.offset > b.offset; });
+        for (const auto& payload : payloads) {
+            const uint8_t* pData = fields.body() + payload.offset;
+            uint64_t hash = hash_payload(pData, payload.size);
+            if (s_hashCounts.find(hash) == s_hashCounts.end()) {
+                continue;
+            }
+            std::vector<uint64_t>& blobIds = s_hashToBlobIds[hash];
+            uint64_t blobId = UINT64_MAX;
+            for (uint64_t candidate : blobIds) {
+                bool equal = false;
+                if (compare_blob(pFileHeader, candidate, pData, payload.size, equal) != 0) {
+                    return -1;
+                }
+                if (equal) {
+                    blobId = candidate;
+                    break;
+                }
+            }
+            if (blobId == UINT64_MAX) {
+                const packet_info& packetInfo = g_globalPacketIndexToPacketInfo[pHeader->global_packet_index];
+                blobId = s_blobs.size();
+                s_blobs.push_back({packetInfo.position, packetInfo.size, payload.offset, payload.size});
+                s_blobBytes += payload.size;
+                blobIds.push_back(blobId);
+                cache_blob(blobId, pData, payload.size);
+                if (write_blob_packet(pFileHeader, pHeader, blobId, pData, payload.size, newTraceFile, fileOffset, fileSize) !=
+                    0) {
+                    return -1;
+                }
+            }
+            fields.remove_payload(pHeader, payload, blobId);
+            s_references++;
+            s_savedBytes += payload.size;
+        }
+    }
+
+    int ret = 0;
+    if (recompress) {
+        ret = compress_packet(g_compressor, pHeader);
+    }
+    return ret;
+}
+
+void post_dedup_blobs_report() {
+    vktrace_LogAlways("Replaced %" PRIu64 " payloads (%" PRIu64 " bytes) by %zu blobs (%" PRIu64 " bytes).", s_references,
+                      s_savedBytes, s_blobs.size(), s_blobBytes);
+}
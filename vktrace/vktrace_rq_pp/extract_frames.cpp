@@ -0,0 +1,571 @@
+#include <algorithm>
+#include <cinttypes>
+#include <set>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+
+#include "vktrace_rq_pp.h"
+#include "vktrace_vk_packet_id.h"
+#include "vktrace_packet_scanner.h"
+
+// Extracts the frames [frameStart, frameEnd] of a trace to a standalone trace.
+//
+// The frames before frameStart are fast-forwarded: their state-creating packets
+// (object creation, memory uploads, descriptor updates, command buffer recording)
+// are kept so the objects have the same state when the first extracted frame
+// begins, but the frame loop itself is removed:
+//   - vkAcquireNextImage*KHR and vkQueuePresentKHR are dropped, so no swapchain
+//     image is acquired when the extracted frames start. An acquire whose semaphore
+//     is only waited for in the extracted frames is kept.
+//   - Submits which wait on or signal semaphores belong to the frame loop. Their
+//     command buffers are dropped, but their semaphore operations and fence are
+//     kept, so the semaphores and fences waited for by later submits, including the
+//     ones of the extracted frames, are still signaled. The binary semaphore waits
+//     for a dropped acquire and the binary semaphore signals which only a dropped
+//     present waits for are removed, they have no counterpart left.
+//   - Submits without semaphores (uploads, layout transitions) are kept.
+//   - Host queries of results produced by the dropped work are dropped.
+//   - The waits for the fence of a dropped acquire are dropped, in every frame,
+//     until the fence is reset.
+// The packets after frameEnd are dropped.
+
+// A binary semaphore operation, the global packet index of the packet and the semaphore.
+typedef std::pair<uint64_t, uint64_t> semaphore_op;
+
+struct pending_signal {
+    uint64_t packetIndex;
+    bool fromAcquire;
+};
+
+static uint64_t s_frame = 0;
+static uint64_t s_droppedSubmits = 0;
+static uint64_t s_syncOnlySubmits = 0;
+static bool s_warnedAcquireFence = false;
+
+// Found by pre_extract_frames in the fast-forwarded frames and applied by post_extract_frames.
+static std::unordered_set<uint64_t> s_timelineSemaphores;
+static std::unordered_map<uint64_t, pending_signal> s_pendingSignals;
+static std::set<semaphore_op> s_droppedWaits;
+static std::set<semaphore_op> s_droppedSignals;
+static std::unordered_set<uint64_t> s_keptAcquires;
+
+// Fences which a dropped acquire would have signaled and which have not been reset since.
+static std::unordered_set<uint64_t> s_acquireFences;
+
+static bool is_frame_end(uint16_t packetId) {
+    switch (packetId) {
+#if VK_ANDROID_frame_boundary
+        case VKTRACE_TPI_VK_vkFrameBoundaryANDROID:
+#endif
+        case VKTRACE_TPI_VK_vkQueuePresentKHR:
+            return true;
+        default:
+            return false;
+    }
+}
+
+// The pointers in the packet bodies are interpreted without storing them back, so
+// the packets can be written out after their counts and arrays are edited.
+template <typename T>
+static T* interpret(vktrace_trace_packet_header* pHeader, const void* ptr) {
+    return (T*)vktrace_trace_packet_interpret_buffer_pointer(pHeader, (intptr_t)ptr);
+}
+
+template <typename T>
+static T* find_next_struct(vktrace_trace_packet_header* pHeader, const void* pStruct, VkStructureType sType) {
+    VkBaseOutStructure* pNext = interpret<VkBaseOutStructure>(pHeader, ((const VkBaseOutStructure*)pStruct)->pNext);
+    while (pNext != nullptr && pNext->sType != sType) {
+        pNext = interpret<VkBaseOutStructure>(pHeader, pNext->pNext);
+    }
+    return (T*)pNext;
+}
+
+static int decompress_for_edit(vktrace_trace_file_header* pFileHeader, vktrace_trace_packet_header*& pHeader, bool& recompress) {
+    if (pHeader->tracer_id != VKTRACE_TID_VULKAN_COMPRESSED) {
+        return 0;
+    }
+    if (g_compressor == nullptr) {
+        g_compressor = create_compressor((VKTRACE_COMPRESS_TYPE)pFileHeader->compress_type);
+        if (g_compressor == nullptr) {
+            vktrace_LogError("Create compressor failed.");
+            return -1;
+        }
+    }
+    if (g_decompressor == nullptr) {
+        g_decompressor = create_decompressor((VKTRACE_COMPRESS_TYPE)pFileHeader->compress_type);
+        if (g_decompressor == nullptr) {
+            vktrace_LogError("Create decompressor failed.");
+            return -1;
+        }
+    }
+    if (decompress_packet(g_decompressor, pHeader) < 0) {
+        vktrace_LogError("Decompress the packet failed !");
+        return -1;
+    }
+    recompress = true;
+    return 0;
+}
+
+static vktrace_trace_packet_header* read_packet(vktrace_trace_file_header* pFileHeader, FileLike* traceFile, uint64_t position,
+                                                uint64_t size) {
+    vktrace_trace_packet_header* pHeader = (vktrace_trace_packet_header*)vktrace_malloc((size_t)size);
+    if (pHeader == nullptr) {
+        return nullptr;
+    }
+    if (!vktrace_FileLike_SetCurrentPosition(traceFile, position) || !vktrace_FileLike_ReadRaw(traceFile, pHeader, size)) {
+        vktrace_LogError("Failed to read trace packet with size of %" PRIu64 ".", size);
+        vktrace_free(pHeader);
+        return nullptr;
+    }
+    pHeader->pBody = (uintptr_t)(pHeader + 1);
+    bool recompress = false;
+    if (decompress_for_edit(pFileHeader, pHeader, recompress) < 0) {
+        vktrace_free(pHeader);
+        return nullptr;
+    }
+    return pHeader;
+}
+
+static void signal_binary(uint64_t packetIndex, uint64_t semaphore, bool fromAcquire) {
+    if (s_timelineSemaphores.count(semaphore) == 0) {
+        s_pendingSignals[semaphore] = {packetIndex, fromAcquire};
+    }
+}
+
+static void wait_binary(uint64_t packetIndex, uint64_t semaphore, bool fromPresent) {
+    auto it = s_pendingSignals.find(semaphore);
+    if (it == s_pendingSignals.end() || s_timelineSemaphores.count(semaphore) != 0) {
+        return;
+    }
+    if (fromPresent && !it->second.fromAcquire) {
+        s_droppedSignals.emplace(it->second.packetIndex, semaphore);
+    } else if (!fromPresent && it->second.fromAcquire) {
+        s_droppedWaits.emplace(packetIndex, semaphore);
+    }
+    s_pendingSignals.erase(it);
+}
+
+// Pairs the binary semaphore signals and waits of a fast-forwarded packet.
+static void track_semaphores(vktrace_trace_packet_header* pHeader) {
+    uint64_t index = pHeader->global_packet_index;
+    switch (pHeader->packet_id) {
+        case VKTRACE_TPI_VK_vkCreateSemaphore: {
+            packet_vkCreateSemaphore* pPacket = (packet_vkCreateSemaphore*)pHeader->pBody;
+            const VkSemaphoreCreateInfo* pCreateInfo = interpret<VkSemaphoreCreateInfo>(pHeader, pPacket->pCreateInfo);
+            const VkSemaphore* pSemaphore = interpret<VkSemaphore>(pHeader, pPacket->pSemaphore);
+            if (pCreateInfo == nullptr || pSemaphore == nullptr) {
+                break;
+            }
+            const VkSemaphoreTypeCreateInfo* pType = find_next_struct<VkSemaphoreTypeCreateInfo>(
+                pHeader, pCreateInfo, VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO);
+            if (pType != nullptr && pType->semaphoreType == VK_SEMAPHORE_TYPE_TIMELINE) {
+                s_timelineSemaphores.insert((uint64_t)*pSemaphore);
+            }
+        } break;
+        case VKTRACE_TPI_VK_vkAcquireNextImageKHR: {
+            packet_vkAcquireNextImageKHR* pPacket = (packet_vkAcquireNextImageKHR*)pHeader->pBody;
+            if (pPacket->semaphore != VK_NULL_HANDLE) {
+                signal_binary(index, (uint64_t)pPacket->semaphore, true);
+            }
+        } break;
+        case VKTRACE_TPI_VK_vkAcquireNextImage2KHR: {
+            packet_vkAcquireNextImage2KHR* pPacket = (packet_vkAcquireNextImage2KHR*)pHeader->pBody;
+            const VkAcquireNextImageInfoKHR* pInfo = interpret<VkAcquireNextImageInfoKHR>(pHeader, pPacket->pAcquireInfo);
+            if (pInfo != nullptr && pInfo->semaphore != VK_NULL_HANDLE) {
+                signal_binary(index, (uint64_t)pInfo->semaphore, true);
+            }
+        } break;
+        case VKTRACE_TPI_VK_vkQueuePresentKHR: {
+            packet_vkQueuePresentKHR* pPacket = (packet_vkQueuePresentKHR*)pHeader->pBody;
+            const VkPresentInfoKHR* pInfo = interpret<VkPresentInfoKHR>(pHeader, pPacket->pPresentInfo);
+            const VkSemaphore* pWaits = pInfo ? interpret<VkSemaphore>(pHeader, pInfo->pWaitSemaphores) : nullptr;
+            for (uint32_t i = 0; pWaits != nullptr && i < pInfo->waitSemaphoreCount; i++) {
+                wait_binary(index, (uint64_t)pWaits[i], true);
+            }
+        } break;
+        case VKTRACE_TPI_VK_vkQueueSubmit: {
+            packet_vkQueueSubmit* pPacket = (packet_vkQueueSubmit*)pHeader->pBody;
+            const VkSubmitInfo* pSubmits = interpret<VkSubmitInfo>(pHeader, pPacket->pSubmits);
+            for (uint32_t i = 0; pSubmits != nullptr && i < pPacket->submitCount; i++) {
+                const VkSemaphore* pWaits = interpret<VkSemaphore>(pHeader, pSubmits[i].pWaitSemaphores);
+                for (uint32_t j = 0; pWaits != nullptr && j < pSubmits[i].waitSemaphoreCount; j++) {
+                    wait_binary(index, (uint64_t)pWaits[j], false);
+                }
+                const VkSemaphore* pSignals = interpret<VkSemaphore>(pHeader, pSubmits[i].pSignalSemaphores);
+                for (uint32_t j = 0; pSignals != nullptr && j < pSubmits[i].signalSemaphoreCount; j++) {
+                    signal_binary(index, (uint64_t)pSignals[j], false);
+                }
+            }
+        } break;
+        case VKTRACE_TPI_VK_vkQueueSubmit2:
+        case VKTRACE_TPI_VK_vkQueueSubmit2KHR: {
+            packet_vkQueueSubmit2* pPacket = (packet_vkQueueSubmit2*)pHeader->pBody;
+            const VkSubmitInfo2* pSubmits = interpret<VkSubmitInfo2>(pHeader, pPacket->pSubmits);
+            for (uint32_t i = 0; pSubmits != nullptr && i < pPacket->submitCount; i++) {
+                const VkSemaphoreSubmitInfo* pWaits = interpret<VkSemaphoreSubmitInfo>(pHeader, pSubmits[i].pWaitSemaphoreInfos);
+                for (uint32_t j = 0; pWaits != nullptr && j < pSubmits[i].waitSemaphoreInfoCount; j++) {
+                    wait_binary(index, (uint64_t)pWaits[j].semaphore, false);
+                }
+                const VkSemaphoreSubmitInfo* pSignals =
+                    interpret<VkSemaphoreSubmitInfo>(pHeader, pSubmits[i].pSignalSemaphoreInfos);
+                for (uint32_t j = 0; pSignals != nullptr && j < pSubmits[i].signalSemaphoreInfoCount; j++) {
+                    signal_binary(index, (uint64_t)pSignals[j].semaphore, false);
+                }
+            }
+        } break;
+        default:
+            break;
+    }
+}
+
+static bool is_tracked(uint16_t packetId) {
+    switch (packetId) {
+        case VKTRACE_TPI_VK_vkCreateSemaphore:
+        case VKTRACE_TPI_VK_vkAcquireNextImageKHR:
+        case VKTRACE_TPI_VK_vkAcquireNextImage2KHR:
+        case VKTRACE_TPI_VK_vkQueuePresentKHR:
+        case VKTRACE_TPI_VK_vkQueueSubmit:
+        case VKTRACE_TPI_VK_vkQueueSubmit2:
+        case VKTRACE_TPI_VK_vkQueueSubmit2KHR:
+            return true;
+        default:
+            return false;
+    }
+}
+
+int pre_extract_frames(vktrace_trace_file_header* pFileHeader, FileLike* traceFile) {
+    if (g_params.frameStart > g_params.frameEnd) {
+        vktrace_LogError("Invalid frame range %" PRIu64 "-%" PRIu64 ".", g_params.frameStart, g_params.frameEnd);
+        return -1;
+    }
+
+    vktrace_PacketScanner* pScanner = vktrace_PacketScanner_create(traceFile, pFileHeader->first_packet_offset, 0);
+    if (pScanner == nullptr) {
+        return -1;
+    }
+    int ret = 0;
+    uint64_t frameCount = 0;
+    vktrace_trace_packet_header header;
+    uint64_t position = 0;
+    while (vktrace_PacketScanner_next(pScanner, &header, &position)) {
+        if (frameCount < g_params.frameStart && is_tracked(header.packet_id)) {
+            vktrace_trace_packet_header* pHeader = read_packet(pFileHeader, traceFile, position, header.size);
+            if (pHeader == nullptr) {
+                ret = -1;
+                break;
+            }
+            track_semaphores(pHeader);
+            vktrace_free(pHeader);
+        }
+        if (is_frame_end(header.packet_id)) {
+            frameCount++;
+        }
+    }
+    vktrace_PacketScanner_delete(&pScanner);
+    if (ret != 0) {
+        return ret;
+    }
+
+    if (g_params.frameStart >= frameCount) {
+        vktrace_LogError("Start frame %" PRIu64 " is out of range, the trace has %" PRIu64 " frames.", g_params.frameStart,
+                         frameCount);
+        return -1;
+    }
+    // The semaphores still signaled when the extracted frames begin are waited for by them.
+    for (const auto& pending : s_pendingSignals) {
+        if (pending.second.fromAcquire) {
+            s_keptAcquires.insert(pending.second.packetIndex);
+        }
+    }
+    s_pendingSignals.clear();
+    vktrace_LogAlways("Extracting frames %" PRIu64 "-%" PRIu64 " of %" PRIu64 " frames.", g_params.frameStart,
+                      std::min(g_params.frameEnd, frameCount - 1), frameCount);
+    s_frame = 0;
+    return 0;
+}
+
+// Removes the removed semaphore operations from a semaphore array and the arrays parallel to it.
+template <typename T>
+static uint32_t compact_semaphores(uint64_t packetIndex, const std::set<semaphore_op>& removed, VkSemaphore* pSemaphores,
+                                   uint32_t count, T* pParallel0, uint64_t* pParallel1, uint32_t* pParallel2) {
+    uint32_t kept = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        if (removed.count(semaphore_op(packetIndex, (uint64_t)pSemaphores[i])) != 0) {
+            continue;
+        }
+        pSemaphores[kept] = pSemaphores[i];
+        if (pParallel0 != nullptr) {
+            pParallel0[kept] = pParallel0[i];
+        }
+        if (pParallel1 != nullptr) {
+            pParallel1[kept] = pParallel1[i];
+        }
+        if (pParallel2 != nullptr) {
+            pParallel2[kept] = pParallel2[i];
+        }
+        kept++;
+    }
+    return kept;
+}
+
+static uint32_t compact_semaphores(uint64_t packetIndex, const std::set<semaphore_op>& removed, VkSemaphoreSubmitInfo* pInfos,
+                                   uint32_t count) {
+    uint32_t kept = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        if (removed.count(semaphore_op(packetIndex, (uint64_t)pInfos[i].semaphore)) == 0) {
+            pInfos[kept++] = pInfos[i];
+        }
+    }
+    return kept;
+}
+
+// Drops the command buffers of a frame loop submit. Returns false if nothing is left to submit.
+static bool make_sync_only(vktrace_trace_packet_header* pHeader, VkSubmitInfo& submit) {
+    uint64_t index = pHeader->global_packet_index;
+    VkTimelineSemaphoreSubmitInfo* pTimeline =
+        find_next_struct<VkTimelineSemaphoreSubmitInfo>(pHeader, &submit, VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO);
+    VkDeviceGroupSubmitInfo* pDeviceGroup =
+        find_next_struct<VkDeviceGroupSubmitInfo>(pHeader, &submit, VK_STRUCTURE_TYPE_DEVICE_GROUP_SUBMIT_INFO);
+
+    bool waitValues = pTimeline != nullptr && pTimeline->waitSemaphoreValueCount == submit.waitSemaphoreCount;
+    bool waitIndices = pDeviceGroup != nullptr && pDeviceGroup->waitSemaphoreCount == submit.waitSemaphoreCount;
+    VkSemaphore* pWaits = interpret<VkSemaphore>(pHeader, submit.pWaitSemaphores);
+    if (pWaits != nullptr) {
+        submit.waitSemaphoreCount = compact_semaphores(
+            index, s_droppedWaits, pWaits, submit.waitSemaphoreCount,
+            interpret<VkPipelineStageFlags>(pHeader, submit.pWaitDstStageMask),
+            waitValues ? interpret<uint64_t>(pHeader, pTimeline->pWaitSemaphoreValues) : nullptr,
+            waitIndices ? interpret<uint32_t>(pHeader, pDeviceGroup->pWaitSemaphoreDeviceIndices) : nullptr);
+    }
+    if (waitValues) {
+        pTimeline->waitSemaphoreValueCount = submit.waitSemaphoreCount;
+    }
+    if (waitIndices) {
+        pDeviceGroup->waitSemaphoreCount = submit.waitSemaphoreCount;
+    }
+
+    bool signalValues = pTimeline != nullptr && pTimeline->signalSemaphoreValueCount == submit.signalSemaphoreCount;
+    bool signalIndices = pDeviceGroup != nullptr && pDeviceGroup->signalSemaphoreCount == submit.signalSemaphoreCount;
+    VkSemaphore* pSignals = interpret<VkSemaphore>(pHeader, submit.pSignalSemaphores);
+    if (pSignals != nullptr) {
+        submit.signalSemaphoreCount = compact_semaphores<uint32_t>(
+            index, s_droppedSignals, pSignals, submit.signalSemaphoreCount, nullptr,
+            signalValues ? interpret<uint64_t>(pHeader, pTimeline->pSignalSemaphoreValues) : nullptr,
+            signalIndices ? interpret<uint32_t>(pHeader, pDeviceGroup->pSignalSemaphoreDeviceIndices) : nullptr);
+    }
+    if (signalValues) {
+        pTimeline->signalSemaphoreValueCount = submit.signalSemaphoreCount;
+    }
+    if (signalIndices) {
+        pDeviceGroup->signalSemaphoreCount = submit.signalSemaphoreCount;
+    }
+
+    submit.commandBufferCount = 0;
+    if (pDeviceGroup != nullptr) {
+        pDeviceGroup->commandBufferCount = 0;
+    }
+    return submit.waitSemaphoreCount > 0 || submit.signalSemaphoreCount > 0;
+}
+
+static bool make_sync_only(vktrace_trace_packet_header* pHeader, VkSubmitInfo2& submit) {
+    uint64_t index = pHeader->global_packet_index;
+    VkSemaphoreSubmitInfo* pWaits = interpret<VkSemaphoreSubmitInfo>(pHeader, submit.pWaitSemaphoreInfos);
+    if (pWaits != nullptr) {
+        submit.waitSemaphoreInfoCount = compact_semaphores(index, s_droppedWaits, pWaits, submit.waitSemaphoreInfoCount);
+    }
+    VkSemaphoreSubmitInfo* pSignals = interpret<VkSemaphoreSubmitInfo>(pHeader, submit.pSignalSemaphoreInfos);
+    if (pSignals != nullptr) {
+        submit.signalSemaphoreInfoCount = compact_semaphores(index, s_droppedSignals, pSignals, submit.signalSemaphoreInfoCount);
+    }
+    submit.commandBufferInfoCount = 0;
+    return submit.waitSemaphoreInfoCount > 0 || submit.signalSemaphoreInfoCount > 0;
+}
+
+static int post_extract_frames_submit(vktrace_trace_file_header* pFileHeader, vktrace_trace_packet_header*& pHeader,
+                                      bool& rmdp) {
+    bool recompress = false;
+    if (decompress_for_edit(pFileHeader, pHeader, recompress) < 0) {
+        return -1;
+    }
+
+    bool frameLoop = false;
+    bool keep = false;
+    VkFence fence = VK_NULL_HANDLE;
+    switch (pHeader->packet_id) {
+        case VKTRACE_TPI_VK_vkQueueSubmit: {
+            packet_vkQueueSubmit* pPacket = (packet_vkQueueSubmit*)pHeader->pBody;
+            VkSubmitInfo* pSubmits = interpret<VkSubmitInfo>(pHeader, pPacket->pSubmits);
+            for (uint32_t i = 0; pSubmits != nullptr && i < pPacket->submitCount; i++) {
+                frameLoop |= pSubmits[i].waitSemaphoreCount > 0 || pSubmits[i].signalSemaphoreCount > 0;
+            }
+            for (uint32_t i = 0; frameLoop && i < pPacket->submitCount; i++) {
+                keep |= make_sync_only(pHeader, pSubmits[i]);
+            }
+            fence = pPacket->fence;
+        } break;
+        case VKTRACE_TPI_VK_vkQueueSubmit2:
+        case VKTRACE_TPI_VK_vkQueueSubmit2KHR: {
+            // vkQueueSubmit2KHR has the same packet layout.
+            packet_vkQueueSubmit2* pPacket = (packet_vkQueueSubmit2*)pHeader->pBody;
+            VkSubmitInfo2* pSubmits = interpret<VkSubmitInfo2>(pHeader, pPacket->pSubmits);
+            for (uint32_t i = 0; pSubmits != nullptr && i < pPacket->submitCount; i++) {
+                frameLoop |= pSubmits[i].waitSemaphoreInfoCount > 0 || pSubmits[i].signalSemaphoreInfoCount > 0;
+            }
+            for (uint32_t i = 0; frameLoop && i < pPacket->submitCount; i++) {
+                keep |= make_sync_only(pHeader, pSubmits[i]);
+            }
+            fence = pPacket->fence;
+        } break;
+        default:
+            // Should not be here
+            vktrace_LogError("post_extract_frames_submit(): unexpected API!");
+            return -1;
+    }
+
+    if (frameLoop) {
+        if (!keep && fence == VK_NULL_HANDLE) {
+            s_droppedSubmits++;
+            rmdp = true;
+            return 0;
+        }
+        s_syncOnlySubmits++;
+    }
+
+    int ret = 0;
+    if (recompress) {
+        ret = compress_packet(g_compressor, pHeader);
+    }
+    return ret;
+}
+
+static int post_extract_frames_acquire(vktrace_trace_file_header* pFileHeader, vktrace_trace_packet_header*& pHeader,
+                                       bool& rmdp) {
+    if (s_keptAcquires.count(pHeader->global_packet_index) != 0) {
+        return 0;
+    }
+    rmdp = true;
+    bool recompress = false;
+    if (decompress_for_edit(pFileHeader, pHeader, recompress) < 0) {
+        return -1;
+    }
+    VkFence fence = VK_NULL_HANDLE;
+    if (pHeader->packet_id == VKTRACE_TPI_VK_vkAcquireNextImageKHR) {
+        fence = ((packet_vkAcquireNextImageKHR*)pHeader->pBody)->fence;
+    } else {
+        packet_vkAcquireNextImage2KHR* pPacket = (packet_vkAcquireNextImage2KHR*)pHeader->pBody;
+        const VkAcquireNextImageInfoKHR* pInfo = interpret<VkAcquireNextImageInfoKHR>(pHeader, pPacket->pAcquireInfo);
+        fence = pInfo ? pInfo->fence : VK_NULL_HANDLE;
+    }
+    if (fence != VK_NULL_HANDLE) {
+        s_acquireFences.insert((uint64_t)fence);
+        if (!s_warnedAcquireFence) {
+            vktrace_LogWarning(
+                "vkAcquireNextImageKHR with a fence is dropped, the waits for the fence are dropped until it is reset.");
+            s_warnedAcquireFence = true;
+        }
+    }
+    return 0;
+}
+
+// Drops the host waits for the fences of the dropped acquires, they would never return.
+static int post_extract_frames_fence(vktrace_trace_file_header* pFileHeader, vktrace_trace_packet_header*& pHeader,
+                                     bool& rmdp) {
+    bool recompress = false;
+    if (decompress_for_edit(pFileHeader, pHeader, recompress) < 0) {
+        return -1;
+    }
+    switch (pHeader->packet_id) {
+        case VKTRACE_TPI_VK_vkResetFences: {
+            packet_vkResetFences* pPacket = (packet_vkResetFences*)pHeader->pBody;
+            const VkFence* pFences = interpret<VkFence>(pHeader, pPacket->pFences);
+            for (uint32_t i = 0; pFences != nullptr && i < pPacket->fenceCount; i++) {
+                s_acquireFences.erase((uint64_t)pFences[i]);
+            }
+        } break;
+        case VKTRACE_TPI_VK_vkGetFenceStatus: {
+            packet_vkGetFenceStatus* pPacket = (packet_vkGetFenceStatus*)pHeader->pBody;
+            rmdp = s_acquireFences.count((uint64_t)pPacket->fence) != 0;
+        } break;
+        case VKTRACE_TPI_VK_vkWaitForFences: {
+            packet_vkWaitForFences* pPacket = (packet_vkWaitForFences*)pHeader->pBody;
+            VkFence* pFences = interpret<VkFence>(pHeader, pPacket->pFences);
+            uint32_t kept = 0;
+            for (uint32_t i = 0; pFences != nullptr && i < pPacket->fenceCount; i++) {
+                if (s_acquireFences.count((uint64_t)pFences[i]) == 0) {
+                    pFences[kept++] = pFences[i];
+                }
+            }
+            if (pFences == nullptr || kept == pPacket->fenceCount) {
+                break;
+            }
+            // A wait for any of the fences would have returned when the acquire signaled its fence.
+            if (kept == 0 || !pPacket->waitAll) {
+                rmdp = true;
+            } else {
+                pPacket->fenceCount = kept;
+            }
+        } break;
+        default:
+            break;
+    }
+    if (rmdp) {
+        vktrace_LogVerbose("Dropped the wait for the fence of a dropped acquire in packet %" PRIu64 ".",
+                           pHeader->global_packet_index);
+        return 0;
+    }
+    return recompress ? compress_packet(g_compressor, pHeader) : 0;
+}
+
+int post_extract_frames(vktrace_trace_file_header* pFileHeader, vktrace_trace_packet_header*& pHeader, bool& rmdp) {
+    uint16_t packetId = pHeader->packet_id;
+    if (s_frame > g_params.frameEnd) {
+        rmdp = true;
+        return 0;
+    }
+    if (is_frame_end(packetId)) {
+        rmdp = s_frame < g_params.frameStart;
+        s_frame++;
+        if (s_frame == g_params.frameStart) {
+            vktrace_LogVerbose("Fast-forwarded %" PRIu64 " frames, dropped %" PRIu64 " submits and kept %" PRIu64
+                               " submits for their semaphores and fences.",
+                               s_frame, s_droppedSubmits, s_syncOnlySubmits);
+        }
+        return 0;
+    }
+
+    switch (packetId) {
+        case VKTRACE_TPI_VK_vkResetFences:
+        case VKTRACE_TPI_VK_vkGetFenceStatus:
+        case VKTRACE_TPI_VK_vkWaitForFences:
+            if (!s_acquireFences.empty()) {
+                return post_extract_frames_fence(pFileHeader, pHeader, rmdp);
+            }
+            break;
+        default:
+            break;
+    }
+    if (s_frame >= g_params.frameStart) {
+        return 0;
+    }
+
+    switch (packetId) {
+        case VKTRACE_TPI_VK_vkAcquireNextImageKHR:
+        case VKTRACE_TPI_VK_vkAcquireNextImage2KHR:
+            return post_extract_frames_acquire(pFileHeader, pHeader, rmdp);
+        case VKTRACE_TPI_VK_vkWaitSemaphores:
+        case VKTRACE_TPI_VK_vkWaitSemaphoresKHR:
+        case VKTRACE_TPI_VK_vkGetSemaphoreCounterValue:
+        case VKTRACE_TPI_VK_vkGetSemaphoreCounterValueKHR:
+        case VKTRACE_TPI_VK_vkGetQueryPoolResults:
+            rmdp = true;
+            break;
+        case VKTRACE_TPI_VK_vkQueueSubmit:
+        case VKTRACE_TPI_VK_vkQueueSubmit2:
+        case VKTRACE_TPI_VK_vkQueueSubmit2KHR:
+            return post_extract_frames_submit(pFileHeader, pHeader, rmdp);
+        default:
+            break;
+    }
+    return 0;
+}
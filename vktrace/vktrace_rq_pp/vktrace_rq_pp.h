@@ -10,6 +10,8 @@
 
 enum command_type {
     COMMAND_TYPE_RQ = 0xf,
+    COMMAND_TYPE_FRAMES = 0x10,
+    COMMAND_TYPE_DEDUP = 0x11,
 };
 
 struct parser_params {
@@ -20,6 +22,8 @@ struct parser_params {
     uint64_t shaderIndex = UINT64_MAX;
     uint64_t srcGlobalPacketIndexStart = UINT64_MAX;
     uint64_t srcGlobalPacketIndexEnd = UINT64_MAX;
+    uint64_t frameStart = 0;
+    uint64_t frameEnd = UINT64_MAX;
 };
 extern parser_params g_params;
 
@@ -63,6 +67,7 @@ typedef struct packet_info {
 
 extern compressor* g_compressor;
 extern decompressor* g_decompressor;
+extern int g_compress_packet_counter;
 extern std::list<uint64_t> g_globalPacketIndexList;
 extern std::unordered_map<uint64_t, packet_info> g_globalPacketIndexToPacketInfo;
 extern std::vector<uint64_t> g_portabilityTable;
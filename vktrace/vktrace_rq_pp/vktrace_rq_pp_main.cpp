@@ -3,6 +3,7 @@
 #include <iomanip>
 #include <cstdio>
 #include <cstring>
+#include <cinttypes>
 #include <list>
 #include <algorithm>
 #include <vector>
@@ -12,6 +13,7 @@
 #include "vktrace_common.h"
 #include "vktrace_tracelog.h"
 #include "vktrace_filelike.h"
+#include "vktrace_packet_scanner.h"
 #include "vktrace_trace_packet_utils.h"
 #include "vktrace_vk_packet_id.h"
 #include "json/json.h"
@@ -22,6 +24,8 @@ using namespace std;
 
 static string commandTypeEnumToStringArray[] = {
     "COMMAND_TYPE_RQ",
+    "COMMAND_TYPE_FRAMES",
+    "COMMAND_TYPE_DEDUP",
 };
 
 parser_params g_params;
@@ -31,8 +35,11 @@ bool removeDummyBuildAS = false;
 static void print_usage() {
     cout << "vktracerqpp " << VKTRACE_VERSION << " available options(NOTE:command must be placed at the beginning):" << endl;
     cout << "   rq                                                        Post process an ray query trace file." << endl << endl;
+    cout << "   frames                                                    Extract a frame range of a trace file to a standalone trace file." << endl << endl;
+    cout << "   dedup                                                     Store the large payloads which occur more than once in a trace file only once. Run it after the rq command." << endl << endl;
     cout << "   -ppbda                                                    Post process BufferDeviceAddress of an ray query trace file." << endl << endl;
     cout << "   --remove-dummy-build-as                                   Post process remove dummy build AS of an ray query trace file." << endl << endl;
+    cout << "   -f     <startframe>[-<endframe>]                          The frames to extract with the frames command. The frames before startframe are fast-forwarded." << endl << endl;
     cout << "   -in    src_tracefile                                      The src_tracefile to open. the parameter must exist and be placed after the command." << endl << endl;
     cout << "   -o     dst_traceFile                                      The dst_tracefile to generate. the parameter must exist and be placed after the command." << endl << endl;
 #if defined(_DEBUG)
@@ -72,6 +79,10 @@ static int parse_args(int argc, char** argv) {
     string commandArg = argv[1];
     if (commandArg.compare("rq") == 0) {
         g_params.command = COMMAND_TYPE_RQ;
+    } else if (commandArg.compare("frames") == 0) {
+        g_params.command = COMMAND_TYPE_FRAMES;
+    } else if (commandArg.compare("dedup") == 0) {
+        g_params.command = COMMAND_TYPE_DEDUP;
     } else {
         vktrace_LogError("Input command '%s' doesn't supported", commandArg.c_str());
         return -1;
@@ -97,6 +108,13 @@ static int parse_args(int argc, char** argv) {
                 return -1;
             }
             i = i + 2;
+        } else if (arg.compare("-f") == 0 && g_params.command == COMMAND_TYPE_FRAMES) {
+            int matches = sscanf(argv[i + 1], "%" SCNu64 "-%" SCNu64, &g_params.frameStart, &g_params.frameEnd);
+            if (matches < 1 || g_params.frameStart > g_params.frameEnd) {
+                vktrace_LogError("Invalid frames '%s', expected <startframe>[-<endframe>].", argv[i + 1]);
+                return -1;
+            }
+            i = i + 2;
         } else if (arg.compare("-in") == 0) {
             g_params.srcTraceFile = argv[i + 1];
             i = i + 2;
@@ -136,7 +154,7 @@ static vktrace_trace_packet_header g_portabilityTableHeader = {};
 static vktrace_trace_packet_header *g_pMetaData = nullptr;
 compressor* g_compressor = nullptr;
 decompressor* g_decompressor = nullptr;
-static int g_compress_packet_counter = 0;
+int g_compress_packet_counter = 0;
 
 static void append_portability_packet(FILE* pTraceFile) {
     uint64_t one_64 = 1;
@@ -298,16 +316,36 @@ int main(int argc, char** argv) {
         vktrace_LogError("Trace file version %d is larger than vkeditor version %d. You need a newer vkeditor to edit it.", pFileHeader->trace_file_version, VKTRACE_TRACE_FILE_VERSION);
         return -1;
     }
+    if (fileHeader.bit_flags & ~VKTRACE_KNOWN_FILE_HEADER_FLAGS) {
+        vktrace_LogError("Trace file has unknown flags 0x%x. You need a newer vkeditor to edit it.",
+                         fileHeader.bit_flags & ~VKTRACE_KNOWN_FILE_HEADER_FLAGS);
+        release(tracefp, traceFile, pFileHeader, tmpfile);
+        return -1;
+    }
 
-    vktrace_trace_packet_header* packet = NULL;
-    uint64_t currentPosition = vktrace_FileLike_GetCurrentPosition(traceFile);
-    // Construct mapping from global packet index to packet in trace file
-    while ((packet = vktrace_read_trace_packet(traceFile))) {
-        if (!packet) break;
-        save_packet_info(packet, currentPosition);
-        vktrace_delete_trace_packet_no_lock(&packet);
-        currentPosition = vktrace_FileLike_GetCurrentPosition(traceFile);
+    // Construct mapping from global packet index to packet in trace file. Only the
+    // meta data needs the packet body, the other packets are scanned by their headers.
+    vktrace_PacketScanner* pScanner =
+        vktrace_PacketScanner_create(traceFile, vktrace_FileLike_GetCurrentPosition(traceFile), 0);
+    if (pScanner == nullptr) {
+        release(tracefp, traceFile, pFileHeader, tmpfile);
+        return -1;
+    }
+    vktrace_trace_packet_header header;
+    uint64_t currentPosition = 0;
+    while (vktrace_PacketScanner_next(pScanner, &header, &currentPosition)) {
+        if (header.packet_id == VKTRACE_TPI_META_DATA) {
+            vktrace_trace_packet_header* packet = NULL;
+            if (vktrace_FileLike_SetCurrentPosition(traceFile, currentPosition) &&
+                (packet = vktrace_read_trace_packet(traceFile)) != NULL) {
+                save_packet_info(packet, currentPosition);
+                vktrace_delete_trace_packet_no_lock(&packet);
+            }
+        } else {
+            save_packet_info(&header, currentPosition);
+        }
     }
+    vktrace_PacketScanner_delete(&pScanner);
     vktrace_LogDebug("Read trace file completed.");
     if (fileHeader.bit_flags & VKTRACE_USE_ACCELERATION_STRUCTURE_API_BIT) {
         vktrace_LogAlways("There are AS related functions in the input trace file.");
@@ -362,6 +400,8 @@ int pre_remove_unused_handle(vktrace_trace_file_header* pFileHeader, FileLike* t
 int pre_remove_dummy_build_as(vktrace_trace_file_header* pFileHeader, FileLike* traceFile);
 int pre_remove_all_dummy_as(vktrace_trace_file_header* pFileHeader, FileLike* traceFile);
 int pre_find_sbt(vktrace_trace_file_header* pFileHeader, FileLike *traceFile);
+int pre_extract_frames(vktrace_trace_file_header* pFileHeader, FileLike* traceFile);
+int pre_dedup_blobs(vktrace_trace_file_header* pFileHeader, FileLike* traceFile);
 
 static int pre_handle_command(vktrace_trace_file_header* pFileHeader, FileLike *traceFile) {
     if (pFileHeader == nullptr) {
@@ -371,6 +411,10 @@ static int pre_handle_command(vktrace_trace_file_header* pFileHeader, FileLike *
     int ret;
     switch (g_params.command) {
         case COMMAND_TYPE_RQ: {
+            if (pFileHeader->bit_flags & VKTRACE_BLOBS_DEDUPLICATED_BIT) {
+                vktrace_LogError("The rq command must run before the dedup command.");
+                return -1;
+            }
             if (removeDummyBuildAS) {
                 ret = pre_remove_dummy_build_as(pFileHeader, traceFile);
                 ret |= pre_remove_all_dummy_as(pFileHeader, traceFile);
@@ -385,6 +429,14 @@ static int pre_handle_command(vktrace_trace_file_header* pFileHeader, FileLike *
             }
         } break;
 
+        case COMMAND_TYPE_FRAMES: {
+            ret = pre_extract_frames(pFileHeader, traceFile);
+        } break;
+
+        case COMMAND_TYPE_DEDUP: {
+            ret = pre_dedup_blobs(pFileHeader, traceFile);
+        } break;
+
         default: {
             vktrace_LogError("Input command %s does not exist.", commandTypeEnumToStringArray[g_params.command].c_str());
             return -1;
@@ -419,6 +471,10 @@ int post_remove_unused_handle(vktrace_trace_file_header* pFileHeader,  vktrace_t
 int post_remove_dummy_build_as(vktrace_trace_file_header* pFileHeader,  vktrace_trace_packet_header* &pHeader, FILE* newTraceFile,
                                uint64_t* fileOffset, uint64_t* fileSize, bool &rmdp);
 int post_find_sbt(vktrace_trace_file_header* pFileHeader, vktrace_trace_packet_header* &pHeader);
+int post_extract_frames(vktrace_trace_file_header* pFileHeader, vktrace_trace_packet_header*& pHeader, bool& rmdp);
+int post_dedup_blobs(vktrace_trace_file_header* pFileHeader, vktrace_trace_packet_header*& pHeader, FILE* newTraceFile,
+                     uint64_t* fileOffset, uint64_t* fileSize);
+void post_dedup_blobs_report();
 
 static int handle_packet(vktrace_trace_file_header* pFileHeader, vktrace_trace_packet_header*& pPacketHeader, FILE* newTraceFile,
                          uint64_t* fileOffset, uint64_t* fileSize, bool& rmdp) {
@@ -442,6 +498,14 @@ static int handle_packet(vktrace_trace_file_header* pFileHeader, vktrace_trace_p
             }
         } break;
 
+        case COMMAND_TYPE_FRAMES: {
+            ret = post_extract_frames(pFileHeader, pPacketHeader, rmdp);
+        } break;
+
+        case COMMAND_TYPE_DEDUP: {
+            ret = post_dedup_blobs(pFileHeader, pPacketHeader, newTraceFile, fileOffset, fileSize);
+        } break;
+
         default: {
             vktrace_LogError("Input command %s does not exist.", commandTypeEnumToStringArray[g_params.command].c_str());
             return -1;
@@ -504,7 +568,7 @@ static int post_handle_command(vktrace_trace_file_header* pFileHeader, FileLike*
     }
 
     // Writes file header.
-    if (!removeDummyBuildAS) {
+    if (g_params.command == COMMAND_TYPE_RQ && !removeDummyBuildAS) {
         pFileHeader->bit_flags |= VKTRACE_RQ_POSTPROCESSED_BIT;
     }
     uint64_t bytesWritten = fwrite(pFileHeader, 1, sizeof(vktrace_trace_file_header) + (size_t)(pFileHeader->n_gpuinfo * sizeof(struct_gpuinfo)), newfp);
@@ -582,6 +646,10 @@ static int post_handle_command(vktrace_trace_file_header* pFileHeader, FileLike*
         vktrace_free(pHeader);
     }
 
+    if (ret != -1 && g_params.command == COMMAND_TYPE_DEDUP) {
+        post_dedup_blobs_report();
+    }
+
     int metaSize = 0;
     if (ret != -1 && pFileHeader->trace_file_version > VKTRACE_TRACE_FILE_VERSION_9) {
         // Append meta data
@@ -0,0 +1,505 @@
+/*
+ * Copyright (C) 2016-2024 ARM Limited
+ * All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <cerrno>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "vktrace_common.h"
+#include "vktrace_tracelog.h"
+#include "vktrace_filelike.h"
+#include "vktrace_packet_scanner.h"
+#include "vktrace_trace_packet_utils.h"
+#include "vktrace_vk_packet_id.h"
+#include "json/json.h"
+
+using namespace std;
+
+struct vktracestats_params {
+    const char* traceFile = nullptr;
+    const char* reportFile = nullptr;
+    bool csv = false;
+    uint32_t topCount = 10;
+} g_params;
+
+struct packet_type_stats {
+    uint64_t count = 0;
+    uint64_t fileBytes = 0;  // bytes in the trace file, compressed if the packet is compressed
+    uint64_t rawBytes = 0;   // bytes after decompression
+    uint64_t compressedCount = 0;
+    uint64_t cpuTime = 0;    // sum of entrypoint_end_time - entrypoint_begin_time in ns
+};
+
+struct frame_stats {
+    uint64_t packets = 0;
+    uint64_t fileBytes = 0;
+    uint64_t rawBytes = 0;
+    uint64_t memoryUploadBytes = 0;  // raw bytes of the packets which carry mapped memory data
+    uint64_t commandBytes = 0;       // raw bytes of the vkCmd* packets
+    uint64_t cpuTime = 0;
+    uint64_t beginTime = UINT64_MAX;
+    uint64_t endTime = 0;
+};
+
+static void print_usage() {
+    cout << "vktracestats available options:" << endl;
+    cout << "    -o <traceFile>        The trace file to open and parse" << endl;
+    cout << "    -r <reportFile>       (Optional) The file to save the report to. The default is stdout." << endl;
+    cout << "    -csv                  (Optional) Save the report as CSV. The default is JSON." << endl;
+    cout << "    -n <count>            (Optional) Number of packet types and frames in the hotspot summary. The default is 10."
+         << endl;
+}
+
+static int parse_args(int argc, char** argv) {
+    for (int i = 1; i < argc;) {
+        string arg(argv[i]);
+        if (arg.compare("-o") == 0 && i + 1 < argc) {
+            g_params.traceFile = argv[i + 1];
+            i = i + 2;
+        } else if (arg.compare("-r") == 0 && i + 1 < argc) {
+            g_params.reportFile = argv[i + 1];
+            i = i + 2;
+        } else if (arg.compare("-csv") == 0) {
+            g_params.csv = true;
+            i++;
+        } else if (arg.compare("-n") == 0 && i + 1 < argc) {
+            char* end = nullptr;
+            errno = 0;
+            unsigned long count = strtoul(argv[i + 1], &end, 10);
+            if (end == argv[i + 1] || *end != '\0' || errno == ERANGE || count == 0 || count > UINT32_MAX ||
+                argv[i + 1][0] == '-') {
+                cout << "Error: -n expects a positive count, got '" << argv[i + 1] << "'." << endl;
+                return -1;
+            }
+            g_params.topCount = (uint32_t)count;
+            i = i + 2;
+        } else if (arg.compare("-h") == 0) {
+            print_usage();
+            exit(0);
+        } else {
+            return -1;
+        }
+    }
+    if (g_params.traceFile == nullptr) {
+        // traceFile option must be specified.
+        return -1;
+    }
+    return 0;
+}
+
+static string packet_name(uint16_t packetId) {
+    const char* name = nullptr;
+    switch (packetId) {
+        case VKTRACE_TPI_MESSAGE:
+            return "Message";
+        case VKTRACE_TPI_MARKER_CHECKPOINT:
+        case VKTRACE_TPI_MARKER_API_BOUNDARY:
+        case VKTRACE_TPI_MARKER_API_GROUP_BEGIN:
+        case VKTRACE_TPI_MARKER_API_GROUP_END:
+        case VKTRACE_TPI_MARKER_TERMINATE_PROCESS:
+            return "Marker";
+        case VKTRACE_TPI_PORTABILITY_TABLE:
+            return "Portability Table";
+        case VKTRACE_TPI_META_DATA:
+            return "Meta Data";
+        case VKTRACE_TPI_VK_vkFlushMappedMemoryRangesRemap:
+            return "vkFlushMappedMemoryRangesRemap";
+        case VKTRACE_TPI_VK_vkFlushMappedMemoryRangesRemapAsInstanceSGHandle:
+            return "vkFlushMappedMemoryRangesRemapAsInstanceSGHandle";
+        case VKTRACE_TPI_VK_vkUnmapMemoryRemapAsInstanceSGHandle:
+            return "vkUnmapMemoryRemapAsInstanceSGHandle";
+        case VKTRACE_TPI_VK_vkCmdPushConstantsRemap:
+            return "vkCmdPushConstantsRemap";
+        case VKTRACE_TPI_VK_vkCmdCopyBufferRemapBuffer:
+            return "vkCmdCopyBufferRemapBuffer";
+        case VKTRACE_TPI_VK_vkCmdCopyBufferRemapAS:
+            return "vkCmdCopyBufferRemapAS";
+        case VKTRACE_TPI_VK_vkCmdCopyBufferRemapASandBuffer:
+            return "vkCmdCopyBufferRemapASandBuffer";
+        default:
+            name = vktrace_vk_packet_id_name((VKTRACE_TRACE_PACKET_ID_VK)packetId);
+            break;
+    }
+    return name ? name : "Packet id " + to_string(packetId);
+}
+
+// The packets which carry the data the application wrote to mapped memory.
+static bool is_memory_upload(uint16_t packetId) {
+    switch (packetId) {
+        case VKTRACE_TPI_VK_vkFlushMappedMemoryRanges:
+        case VKTRACE_TPI_VK_vkFlushMappedMemoryRangesRemap:
+        case VKTRACE_TPI_VK_vkFlushMappedMemoryRangesRemapAsInstanceSGHandle:
+        case VKTRACE_TPI_VK_vkUnmapMemory:
+        case VKTRACE_TPI_VK_vkUnmapMemoryRemapAsInstanceSGHandle:
+            return true;
+        default:
+            return false;
+    }
+}
+
+static bool is_command(const string& name) { return name.compare(0, 5, "vkCmd") == 0; }
+
+static bool is_frame_end(uint16_t packetId) {
+    switch (packetId) {
+#if VK_ANDROID_frame_boundary
+        case VKTRACE_TPI_VK_vkFrameBoundaryANDROID:
+#endif
+        case VKTRACE_TPI_VK_vkQueuePresentKHR:
+            return true;
+        default:
+            return false;
+    }
+}
+
+static double ratio(uint64_t numerator, uint64_t denominator) {
+    return denominator ? (double)numerator / (double)denominator : 0.0;
+}
+
+// Indices of the top count elements of values, largest first.
+template <typename T, typename F>
+static vector<size_t> top_indices(const vector<T>& values, F key, uint32_t count) {
+    vector<size_t> indices(values.size());
+    for (size_t i = 0; i < indices.size(); i++) {
+        indices[i] = i;
+    }
+    count = (uint32_t)min<size_t>(count, indices.size());
+    partial_sort(indices.begin(), indices.begin() + count, indices.end(),
+                 [&](size_t a, size_t b) { return key(values[a]) > key(values[b]); });
+    indices.resize(count);
+    return indices;
+}
+
+static uint64_t median_file_bytes(const vector<frame_stats>& frames) {
+    if (frames.empty()) {
+        return 0;
+    }
+    vector<uint64_t> bytes;
+    bytes.reserve(frames.size());
+    for (const auto& frame : frames) {
+        bytes.push_back(frame.fileBytes);
+    }
+    nth_element(bytes.begin(), bytes.begin() + bytes.size() / 2, bytes.end());
+    return bytes[bytes.size() / 2];
+}
+
+static bool collect_stats(FileLike* traceFile, uint64_t firstPacketOffset, map<uint16_t, packet_type_stats>& packetTypes,
+                          vector<frame_stats>& frames) {
+    vktrace_PacketScanner* pScanner = vktrace_PacketScanner_create(traceFile, firstPacketOffset, 0);
+    if (pScanner == nullptr) {
+        return false;
+    }
+    map<uint16_t, string> names;
+    vktrace_trace_packet_header header;
+    uint64_t position = 0;
+    frames.emplace_back();
+    while (vktrace_PacketScanner_next(pScanner, &header, &position)) {
+        uint64_t rawBytes = header.size;
+        bool compressed = false;
+        if (header.tracer_id == VKTRACE_TID_VULKAN_COMPRESSED) {
+            vktrace_trace_packet_header_compression_ext compressionExt;
+            if (vktrace_PacketScanner_read_body(pScanner, 0, &compressionExt, sizeof(compressionExt))) {
+                rawBytes = sizeof(vktrace_trace_packet_header) + compressionExt.decompressed_size;
+                compressed = true;
+            }
+        }
+        uint64_t cpuTime = 0;
+        if (header.entrypoint_end_time > header.entrypoint_begin_time) {
+            cpuTime = header.entrypoint_end_time - header.entrypoint_begin_time;
+        }
+
+        packet_type_stats& type = packetTypes[header.packet_id];
+        type.count++;
+        type.fileBytes += header.size;
+        type.rawBytes += rawBytes;
+        type.compressedCount += compressed ? 1 : 0;
+        type.cpuTime += cpuTime;
+
+        // The meta data and the portability table are not part of any frame.
+        if (header.packet_id == VKTRACE_TPI_META_DATA || header.packet_id == VKTRACE_TPI_PORTABILITY_TABLE) {
+            continue;
+        }
+        auto it = names.find(header.packet_id);
+        if (it == names.end()) {
+            it = names.emplace(header.packet_id, packet_name(header.packet_id)).first;
+        }
+        frame_stats& frame = frames.back();
+        frame.packets++;
+        frame.fileBytes += header.size;
+        frame.rawBytes += rawBytes;
+        if (is_memory_upload(header.packet_id)) {
+            frame.memoryUploadBytes += rawBytes;
+        } else if (is_command(it->second)) {
+            frame.commandBytes += rawBytes;
+        }
+        frame.cpuTime += cpuTime;
+        if (header.entrypoint_begin_time != 0) {
+            frame.beginTime = min(frame.beginTime, header.entrypoint_begin_time);
+            frame.endTime = max(frame.endTime, header.entrypoint_end_time);
+        }
+        if (is_frame_end(header.packet_id)) {
+            frames.emplace_back();
+        }
+    }
+    vktrace_PacketScanner_delete(&pScanner);
+    // Drop the empty frame after the last present.
+    if (frames.size() > 1 && frames.back().packets == 0) {
+        frames.pop_back();
+    }
+    return true;
+}
+
+static uint64_t frame_wall_time(const frame_stats& frame) {
+    return (frame.endTime > frame.beginTime && frame.beginTime != UINT64_MAX) ? frame.endTime - frame.beginTime : 0;
+}
+
+static void write_json(ostream& out, const map<uint16_t, packet_type_stats>& packetTypes, const vector<frame_stats>& frames) {
+    Json::Value root;
+    uint64_t totalPackets = 0, totalFileBytes = 0, totalRawBytes = 0;
+    vector<pair<uint16_t, packet_type_stats>> types(packetTypes.begin(), packetTypes.end());
+    sort(types.begin(), types.end(), [](const pair<uint16_t, packet_type_stats>& a, const pair<uint16_t, packet_type_stats>& b) {
+        return a.second.fileBytes > b.second.fileBytes;
+    });
+    for (const auto& type : types) {
+        Json::Value value;
+        value["name"] = packet_name(type.first);
+        value["packet_id"] = type.first;
+        value["count"] = (Json::UInt64)type.second.count;
+        value["file_bytes"] = (Json::UInt64)type.second.fileBytes;
+        value["raw_bytes"] = (Json::UInt64)type.second.rawBytes;
+        value["compressed_count"] = (Json::UInt64)type.second.compressedCount;
+        value["compression_ratio"] = ratio(type.second.rawBytes, type.second.fileBytes);
+        value["cpu_time_ns"] = (Json::UInt64)type.second.cpuTime;
+        root["packet_types"].append(value);
+        totalPackets += type.second.count;
+        totalFileBytes += type.second.fileBytes;
+        totalRawBytes += type.second.rawBytes;
+    }
+    root["packets"] = (Json::UInt64)totalPackets;
+    root["file_bytes"] = (Json::UInt64)totalFileBytes;
+    root["raw_bytes"] = (Json::UInt64)totalRawBytes;
+    root["compression_ratio"] = ratio(totalRawBytes, totalFileBytes);
+    root["frame_count"] = (Json::UInt64)frames.size();
+
+    for (size_t i = 0; i < frames.size(); i++) {
+        Json::Value value;
+        value["frame"] = (Json::UInt64)i;
+        value["packets"] = (Json::UInt64)frames[i].packets;
+        value["file_bytes"] = (Json::UInt64)frames[i].fileBytes;
+        value["raw_bytes"] = (Json::UInt64)frames[i].rawBytes;
+        value["memory_upload_bytes"] = (Json::UInt64)frames[i].memoryUploadBytes;
+        value["command_bytes"] = (Json::UInt64)frames[i].commandBytes;
+        value["cpu_time_ns"] = (Json::UInt64)frames[i].cpuTime;
+        value["wall_time_ns"] = (Json::UInt64)frame_wall_time(frames[i]);
+        root["frames"].append(value);
+    }
+
+    uint64_t median = median_file_bytes(frames);
+    Json::Value hotspots;
+    hotspots["median_frame_file_bytes"] = (Json::UInt64)median;
+    for (size_t i = 0; i < types.size() && i < g_params.topCount; i++) {
+        Json::Value value;
+        value["name"] = packet_name(types[i].first);
+        value["file_bytes"] = (Json::UInt64)types[i].second.fileBytes;
+        value["share"] = ratio(types[i].second.fileBytes, totalFileBytes);
+        hotspots["packet_types_by_file_bytes"].append(value);
+    }
+    for (size_t i : top_indices(frames, [](const frame_stats& frame) { return frame.fileBytes; }, g_params.topCount)) {
+        Json::Value value;
+        value["frame"] = (Json::UInt64)i;
+        value["file_bytes"] = (Json::UInt64)frames[i].fileBytes;
+        value["times_median"] = ratio(frames[i].fileBytes, median);
+        hotspots["frames_by_file_bytes"].append(value);
+    }
+    for (size_t i : top_indices(frames, [](const frame_stats& frame) { return frame.cpuTime; }, g_params.topCount)) {
+        Json::Value value;
+        value["frame"] = (Json::UInt64)i;
+        value["cpu_time_ns"] = (Json::UInt64)frames[i].cpuTime;
+        hotspots["frames_by_cpu_time"].append(value);
+    }
+    root["hotspots"] = hotspots;
+    out << root.toStyledString();
+}
+
+static void write_csv(ostream& out, const map<uint16_t, packet_type_stats>& packetTypes, const vector<frame_stats>& frames) {
+    out << "packet type,packet id,count,file bytes,raw bytes,compressed count,compression ratio,cpu time ns" << endl;
+    for (const auto& type : packetTypes) {
+        out << packet_name(type.first) << "," << type.first << "," << type.second.count << "," << type.second.fileBytes << ","
+            << type.second.rawBytes << "," << type.second.compressedCount << ","
+            << ratio(type.second.rawBytes, type.second.fileBytes) << "," << type.second.cpuTime << endl;
+    }
+    out << endl;
+    out << "frame,packets,file bytes,raw bytes,memory upload bytes,command bytes,cpu time ns,wall time ns" << endl;
+    for (size_t i = 0; i < frames.size(); i++) {
+        out << i << "," << frames[i].packets << "," << frames[i].fileBytes << "," << frames[i].rawBytes << ","
+            << frames[i].memoryUploadBytes << "," << frames[i].commandBytes << "," << frames[i].cpuTime << ","
+            << frame_wall_time(frames[i]) << endl;
+    }
+
+    vector<pair<uint16_t, packet_type_stats>> types(packetTypes.begin(), packetTypes.end());
+    uint64_t totalFileBytes = 0;
+    for (const auto& type : types) {
+        totalFileBytes += type.second.fileBytes;
+    }
+    out << endl;
+    out << "hotspot packet type,file bytes,share" << endl;
+    for (size_t i : top_indices(types, [](const pair<uint16_t, packet_type_stats>& type) { return type.second.fileBytes; },
+                                g_params.topCount)) {
+        out << packet_name(types[i].first) << "," << types[i].second.fileBytes << ","
+            << ratio(types[i].second.fileBytes, totalFileBytes) << endl;
+    }
+    uint64_t median = median_file_bytes(frames);
+    out << endl;
+    out << "hotspot frame by file bytes,file bytes,times median" << endl;
+    for (size_t i : top_indices(frames, [](const frame_stats& frame) { return frame.fileBytes; }, g_params.topCount)) {
+        out << i << "," << frames[i].fileBytes << "," << ratio(frames[i].fileBytes, median) << endl;
+    }
+    out << endl;
+    out << "hotspot frame by cpu time,cpu time ns" << endl;
+    for (size_t i : top_indices(frames, [](const frame_stats& frame) { return frame.cpuTime; }, g_params.topCount)) {
+        out << i << "," << frames[i].cpuTime << endl;
+    }
+}
+
+// A short summary for the console, the full data is in the report. It goes to stderr when the report itself is written to
+// stdout, so the report stays machine readable.
+static void print_hotspots(FILE* out, const map<uint16_t, packet_type_stats>& packetTypes, const vector<frame_stats>& frames) {
+    vector<pair<uint16_t, packet_type_stats>> types(packetTypes.begin(), packetTypes.end());
+    uint64_t totalFileBytes = 0;
+    for (const auto& type : types) {
+        totalFileBytes += type.second.fileBytes;
+    }
+    auto byFileBytes = top_indices(types, [](const pair<uint16_t, packet_type_stats>& type) { return type.second.fileBytes; },
+                                   g_params.topCount);
+    fprintf(out, "Frames: %zu, file bytes: %" PRIu64 "\n", frames.size(), totalFileBytes);
+    fprintf(out, "Packet types with the most bytes:\n");
+    for (size_t i : byFileBytes) {
+        fprintf(out, "    %-48s %14" PRIu64 " bytes %5.1f%% %10" PRIu64 " packets\n", packet_name(types[i].first).c_str(),
+                types[i].second.fileBytes, 100.0 * ratio(types[i].second.fileBytes, totalFileBytes), types[i].second.count);
+    }
+    uint64_t median = median_file_bytes(frames);
+    fprintf(out, "Frames with the most bytes (median %" PRIu64 " bytes):\n", median);
+    for (size_t i : top_indices(frames, [](const frame_stats& frame) { return frame.fileBytes; }, g_params.topCount)) {
+        fprintf(out, "    frame %-8zu %14" PRIu64 " bytes %8.1fx median %14" PRIu64 " memory upload bytes\n", i,
+                frames[i].fileBytes, ratio(frames[i].fileBytes, median), frames[i].memoryUploadBytes);
+    }
+}
+
+// Creates an empty file with a unique name for the decompressed trace, so runs in parallel don't share one.
+static bool create_temp_file(string& path) {
+#if defined(PLATFORM_LINUX) || defined(PLATFORM_OSX)
+    char name[] = "/tmp/vktracestats_XXXXXX";
+    int fd = mkstemp(name);
+    if (fd < 0) {
+        return false;
+    }
+    close(fd);
+    path = name;
+    return true;
+#else
+    char dir[MAX_PATH];
+    char name[MAX_PATH];
+    if (GetTempPathA(MAX_PATH, dir) == 0 || GetTempFileNameA(dir, "vks", 0, name) == 0) {
+        return false;
+    }
+    path = name;
+    return true;
+#endif
+}
+
+int main(int argc, char** argv) {
+    if (parse_args(argc, argv) < 0) {
+        cout << "Error: invalid parameters!" << endl;
+        print_usage();
+        return -1;
+    }
+
+    FILE* tracefp = fopen(g_params.traceFile, "rb");
+    if (tracefp == NULL) {
+        vktrace_LogError("Cannot open trace file: '%s'.", g_params.traceFile);
+        return -1;
+    }
+    // Decompress trace file if it is a gz file.
+    const char* tmpfile = NULL;
+    string tmpfileName;
+    if (vktrace_File_IsCompressed(tracefp)) {
+        fclose(tracefp);
+        if (!create_temp_file(tmpfileName)) {
+            vktrace_LogError("Cannot create a temporary file for the decompressed trace.");
+            return -1;
+        }
+        tmpfile = tmpfileName.c_str();
+        if (!vktrace_File_Decompress(g_params.traceFile, tmpfile)) {
+            remove(tmpfile);
+            return -1;
+        }
+        tracefp = fopen(tmpfile, "rb");
+        if (tracefp == NULL) {
+            vktrace_LogError("Cannot open trace file: '%s'.", tmpfile);
+            remove(tmpfile);
+            return -1;
+        }
+    }
+
+    int ret = 0;
+    FileLike* traceFile = vktrace_FileLike_create_file(tracefp);
+    vktrace_trace_file_header fileHeader;
+    map<uint16_t, packet_type_stats> packetTypes;
+    vector<frame_stats> frames;
+    if (!vktrace_FileLike_ReadRaw(traceFile, &fileHeader, sizeof(fileHeader))) {
+        vktrace_LogError("Fail to read file header!");
+        ret = -1;
+    } else if (fileHeader.magic != VKTRACE_FILE_MAGIC) {
+        vktrace_LogError("%s does not appear to be a valid Vulkan trace file.", g_params.traceFile);
+        ret = -1;
+    } else if (!collect_stats(traceFile, fileHeader.first_packet_offset, packetTypes, frames)) {
+        ret = -1;
+    } else {
+        bool toStdout = (g_params.reportFile == nullptr);
+        ofstream reportFile;
+        if (!toStdout) {
+            reportFile.open(g_params.reportFile);
+            if (!reportFile.is_open()) {
+                vktrace_LogError("Cannot open report file: '%s'.", g_params.reportFile);
+                ret = -1;
+            }
+        }
+        if (ret == 0) {
+            ostream& out = toStdout ? cout : reportFile;
+            if (g_params.csv) {
+                write_csv(out, packetTypes, frames);
+            } else {
+                write_json(out, packetTypes, frames);
+            }
+            out.flush();
+            print_hotspots(toStdout ? stderr : stdout, packetTypes, frames);
+        }
+    }
+
+    fclose(tracefp);
+    vktrace_free(traceFile);
+    if (tmpfile) {
+        remove(tmpfile);
+    }
+    return ret;
+}
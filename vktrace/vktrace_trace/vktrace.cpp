@@ -167,6 +167,22 @@ vktrace_SettingInfo g_settings_info[] = {
      TRUE,
      "The compression threashold size. The package would be compressed only if they are larger than this value.\n\
                                         Default value is 1024(1KB)."},
+    {"ctn",
+     "CompressThreads",
+     VKTRACE_SETTING_UINT,
+     {&g_settings.compressThreads},
+     {&g_default_settings.compressThreads},
+     TRUE,
+     "The number of threads compressing packets for each traced process.\n\
+                                        0 compresses on the thread receiving the packets. Default value is 2."},
+    {"fi",
+     "FlushInterval",
+     VKTRACE_SETTING_UINT,
+     {&g_settings.flushInterval},
+     {&g_default_settings.flushInterval},
+     TRUE,
+     "The trace file is flushed at the end of every frame and at least every FlushInterval milliseconds.\n\
+                                        Default value is 1000."},
 };
 
 vktrace_SettingGroup g_settingGroup = { "vktrace", sizeof(g_settings_info) / sizeof(g_settings_info[0]), &g_settings_info[0], nullptr };
@@ -270,6 +286,8 @@ int main(int argc, char* argv[]) {
     g_default_settings.enable_trim_post_processing = false;
     g_default_settings.compressType = "lz4";
     g_default_settings.compressThreshold = 1024;
+    g_default_settings.compressThreads = 2;
+    g_default_settings.flushInterval = 1000;
 
     // Check to see if the PAGEGUARD_PAGEGUARD_ENABLE_ENV env var is set.
     // If it is set to anything but "1", set the default to false.
@@ -47,6 +47,8 @@ typedef struct vktrace_settings {
     const char* trimCmdBatchSizeStr;
     const char* compressType;
     unsigned int compressThreshold;
+    unsigned int compressThreads;
+    unsigned int flushInterval;
 } vktrace_settings;
 
 extern vktrace_settings g_settings;
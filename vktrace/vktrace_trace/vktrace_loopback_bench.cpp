@@ -0,0 +1,165 @@
+/*
+ *
+ * Copyright (C) 2016-2024 ARM Limited
+ * All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+// Loopback throughput benchmark for the vktrace server.
+//
+// Start the server without a program, then run the benchmark against it:
+//
+//     vktrace -o bench.vktrace
+//     vktrace_loopback_bench [packetCount] [packetSize] [packetsPerFrame] [clientCount]
+//
+// Every client opens its own connection, like a traced process does, sends a
+// trace file header followed by packetCount synthetic packets and a terminate
+// marker. A vkQueuePresentKHR packet is sent every packetsPerFrame packets, so
+// the server sees frame boundaries. The bodies are half random and half
+// zeros, so the lz4 compression has work to do but still compresses.
+//
+// The server closes the connection only after it has written, flushed and
+// closed the trace file, so each client waits for that before it stops. The
+// time measured is the time until the data is on disk, not until it has been
+// handed to the socket.
+
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+extern "C" {
+#include "vktrace_common.h"
+#include "vktrace_interconnect.h"
+#include "vktrace_trace_packet_utils.h"
+#include "vktrace_version.h"
+#include "vktrace_vk_packet_id.h"
+}
+
+static vktrace_trace_packet_header* create_packet(uint16_t packetId, uint64_t bodySize, uint32_t seed) {
+    uint64_t size = ROUNDUP_TO_8(sizeof(vktrace_trace_packet_header) + bodySize);
+    vktrace_trace_packet_header* pHeader = (vktrace_trace_packet_header*)vktrace_malloc((size_t)size);
+    memset(pHeader, 0, (size_t)size);
+    pHeader->size = size;
+    pHeader->tracer_id = VKTRACE_TID_VULKAN;
+    pHeader->packet_id = packetId;
+    pHeader->next_buffers_offset = size;
+
+    uint32_t* pBody = (uint32_t*)((char*)pHeader + sizeof(vktrace_trace_packet_header));
+    uint64_t count = (size - sizeof(vktrace_trace_packet_header)) / sizeof(uint32_t);
+    for (uint64_t i = 0; i < count / 2; i++) {
+        seed = seed * 1664525 + 1013904223;
+        pBody[i] = seed;
+    }
+    return pHeader;
+}
+
+static bool run_client(uint64_t packetCount, uint64_t packetSize, uint64_t packetsPerFrame, uint32_t clientIndex) {
+    MessageStream* pStream = vktrace_MessageStream_create(FALSE, "127.0.0.1", VKTRACE_BASE_PORT + VKTRACE_TID_VULKAN);
+    if (pStream == NULL) {
+        vktrace_LogError("Client %u cannot connect to the vktrace server.", clientIndex);
+        return false;
+    }
+
+    vktrace_trace_file_header fileHeader;
+    memset(&fileHeader, 0, sizeof(fileHeader));
+    fileHeader.trace_file_version = VKTRACE_TRACE_FILE_VERSION;
+    fileHeader.tracer_version = vktrace_version();
+    fileHeader.magic = VKTRACE_FILE_MAGIC;
+    fileHeader.first_packet_offset = sizeof(fileHeader);
+    fileHeader.tracer_count = 1;
+    fileHeader.tracer_id_array[0].id = VKTRACE_TID_VULKAN;
+    fileHeader.tracer_id_array[0].is_64_bit = (sizeof(intptr_t) == 8) ? 1 : 0;
+    fileHeader.trace_start_time = vktrace_get_time();
+    fileHeader.ptrsize = sizeof(void*);
+    fileHeader.n_gpuinfo = 0;
+    uint64_t fileHeaderSize = sizeof(fileHeaderSize) + sizeof(fileHeader);
+
+    bool success = vktrace_MessageStream_Send(pStream, &fileHeaderSize, sizeof(fileHeaderSize)) &&
+                   vktrace_MessageStream_Send(pStream, &fileHeader, sizeof(fileHeader));
+
+    vktrace_trace_packet_header* pPacket = create_packet(VKTRACE_TPI_VK_vkQueueSubmit, packetSize, clientIndex + 1);
+    vktrace_trace_packet_header* pPresent = create_packet(VKTRACE_TPI_VK_vkQueuePresentKHR, 64, clientIndex + 1);
+    for (uint64_t i = 0; success && i < packetCount; i++) {
+        vktrace_trace_packet_header* pHeader = (packetsPerFrame > 0 && (i + 1) % packetsPerFrame == 0) ? pPresent : pPacket;
+        pHeader->global_packet_index = i;
+        pHeader->thread_id = clientIndex;
+        pHeader->vktrace_begin_time = pHeader->entrypoint_begin_time = pHeader->entrypoint_end_time =
+            pHeader->vktrace_end_time = vktrace_get_time();
+        success = vktrace_MessageStream_Send(pStream, pHeader, pHeader->size);
+    }
+    vktrace_free(pPacket);
+    vktrace_free(pPresent);
+
+    vktrace_trace_packet_header* pTerminate = create_packet(VKTRACE_TPI_MARKER_TERMINATE_PROCESS, 8, 0);
+    if (success) {
+        success = vktrace_MessageStream_Send(pStream, pTerminate, pTerminate->size);
+    }
+    vktrace_free(pTerminate);
+
+    if (success) {
+        // The server never sends anything, the receive returns once it has
+        // finished the trace file and closed its end of the connection.
+        char reply;
+        if (vktrace_MessageStream_BlockingRecv(pStream, &reply, sizeof(reply)) || pStream->mErrorNum != WSAECONNRESET) {
+            vktrace_LogError("Client %u did not see the vktrace server close the connection.", clientIndex);
+            success = false;
+        }
+    }
+
+    if (!success) {
+        vktrace_LogError("Client %u failed to send packets to the vktrace server.", clientIndex);
+    }
+    vktrace_MessageStream_destroy(&pStream);
+    return success;
+}
+
+int main(int argc, char** argv) {
+    uint64_t packetCount = (argc > 1) ? strtoull(argv[1], NULL, 10) : 1000000;
+    uint64_t packetSize = (argc > 2) ? strtoull(argv[2], NULL, 10) : 4096;
+    uint64_t packetsPerFrame = (argc > 3) ? strtoull(argv[3], NULL, 10) : 1000;
+    uint32_t clientCount = (argc > 4) ? (uint32_t)strtoul(argv[4], NULL, 10) : 1;
+    if (packetCount == 0 || clientCount == 0) {
+        printf("Usage: %s [packetCount] [packetSize] [packetsPerFrame] [clientCount]\n", argv[0]);
+        return 1;
+    }
+
+    vktrace_LogSetLevel(VKTRACE_LOG_ERROR);
+    uint64_t startTime = vktrace_get_time();
+    std::vector<std::thread> clients;
+    std::vector<char> results(clientCount, 0);
+    for (uint32_t i = 0; i < clientCount; i++) {
+        clients.emplace_back([&, i] { results[i] = run_client(packetCount, packetSize, packetsPerFrame, i); });
+    }
+    for (auto& client : clients) {
+        client.join();
+    }
+    uint64_t elapsed = vktrace_get_time() - startTime;
+
+    for (uint32_t i = 0; i < clientCount; i++) {
+        if (!results[i]) {
+            return 1;
+        }
+    }
+    double seconds = (double)elapsed / 1000000000.0;
+    double megabytes = (double)(packetCount * clientCount) * ROUNDUP_TO_8(sizeof(vktrace_trace_packet_header) + packetSize) /
+                       (1024.0 * 1024.0);
+    printf("Wrote %" PRIu64 " packets of %" PRIu64 " bytes from %u client(s) in %.3f s: %.1f MB/s, %.0f packets/s\n",
+           packetCount * clientCount, packetSize, clientCount, seconds, megabytes / seconds,
+           (double)(packetCount * clientCount) / seconds);
+    return 0;
+}
@@ -49,6 +49,7 @@ extern "C" {
 #include "vktrace_vk_packet_id.h"
 }
 #include "compressor.h"
+#include "vktrace_writer.h"
 #include <cstddef>
 
 const unsigned long kWatchDogPollTime = 250;
@@ -271,11 +272,6 @@ VKTRACE_THREAD_ROUTINE_RETURN_TYPE Process_RunRecordTraceThread(LPVOID _threadIn
         }
     }
 
-    compressor* g_compressor = NULL;
-    if (strcmp(g_settings.compressType, "lz4") == 0) {
-        g_compressor = create_compressor(VKTRACE_COMPRESS_TYPE_LZ4);
-    }
-
     // create trace file
     pInfo->pTraceFile = vktrace_open_trace_file(pInfo);
 
@@ -334,7 +330,9 @@ VKTRACE_THREAD_ROUTINE_RETURN_TYPE Process_RunRecordTraceThread(LPVOID _threadIn
     assert(rval != SIG_ERR);
 #endif
 
-    std::vector<uint64_t> portabilityTable;
+    TraceFileWriter writer(pInfo->pTraceFile, &pInfo->pProcessInfo->traceFileCriticalSection, fileOffset,
+                           strcmp(g_settings.compressType, "lz4") == 0, g_settings.compressThreshold, g_settings.compressThreads,
+                           g_settings.flushInterval);
     std::vector<uint64_t> injectedCalls;
     std::unordered_map<VkDevice, uint32_t> deviceToFeatures;
     uint64_t decompress_file_size = fileOffset;
@@ -419,39 +417,36 @@ VKTRACE_THREAD_ROUTINE_RETURN_TYPE Process_RunRecordTraceThread(LPVOID _threadIn
 
             if (pInfo->pTraceFile != NULL) {
                 decompress_file_size += pHeader->size;
-                vktrace_enter_critical_section(&pInfo->pProcessInfo->traceFileCriticalSection);
-                if ((strcmp(g_settings.compressType, "lz4") == 0) &&
-                        pHeader->size - sizeof(vktrace_trace_packet_header) > g_settings.compressThreshold) {
-                    if (compress_packet(g_compressor, pHeader) != 0) {
-                        vktrace_LogError("Failed to compress the packet for packet_id = %hu", pHeader->packet_id);
-                    }
-                }
-                bytes_written = fwrite(pHeader, 1, (size_t)pHeader->size, pInfo->pTraceFile);
-                fflush(pInfo->pTraceFile);
-                vktrace_leave_critical_section(&pInfo->pProcessInfo->traceFileCriticalSection);
-                if (bytes_written != pHeader->size) {
-                    vktrace_LogError("Failed to write the packet for packet_id = %hu", pHeader->packet_id);
-                }
                 if (pHeader->packet_id == VKTRACE_TPI_VK_vkBuildAccelerationStructuresKHR || pHeader->packet_id == VKTRACE_TPI_VK_vkCreateAccelerationStructureKHR ||
                     pHeader->packet_id == VKTRACE_TPI_VK_vkGetAccelerationStructureBuildSizesKHR || pHeader->packet_id == VKTRACE_TPI_VK_vkCmdBuildAccelerationStructuresKHR) {
                     useAsApi = true;
                 }
-                // If the packet is one we need to track, add it to the table
-                if (vktrace_append_portabilitytable(pHeader->packet_id)) {
+                // If the packet is one we need to track, the writer records its offset in the file
+                bool addToPortabilityTable = vktrace_append_portabilitytable(pHeader->packet_id);
+                if (addToPortabilityTable) {
                     vktrace_LogDebug("Add packet to portability table: %s",
                                      vktrace_vk_packet_id_name((VKTRACE_TRACE_PACKET_ID_VK)pHeader->packet_id));
-                    portabilityTable.push_back(fileOffset);
                 }
                 lastPacketIndex = pHeader->global_packet_index;
                 lastPacketThreadId = pHeader->thread_id;
                 lastPacketEndTime = pHeader->vktrace_end_time;
-                fileOffset += bytes_written;
+                bool endOfFrame = (pHeader->packet_id == VKTRACE_TPI_VK_vkQueuePresentKHR);
+                // The writer owns the packet from here on.
+                writer.Write(pHeader, addToPortabilityTable, endOfFrame);
+                pHeader = NULL;
             }
         }
 
         // clean up
         vktrace_delete_trace_packet_no_lock(&pHeader);
     }
+    writer.Finish();
+    if (writer.GetWriteErrorCount() > 0) {
+        vktrace_LogError("%lu writes to the trace file failed, the trace file is incomplete.",
+                         (unsigned long)writer.GetWriteErrorCount());
+    }
+    vktrace_LogVerbose("Wrote packets up to offset %lu of the trace file.", (unsigned long)writer.GetFileOffset());
+    std::vector<uint64_t> portabilityTable = writer.GetRecordedOffsets();
     decompress_file_size += (sizeof(vktrace_trace_packet_header) + (portabilityTable.size() + 1)* sizeof(uint64_t));
     uint64_t meta_data_offset = 0;
     if (file_header.trace_file_version > VKTRACE_TRACE_FILE_VERSION_9) {
@@ -475,14 +470,13 @@ VKTRACE_THREAD_ROUTINE_RETURN_TYPE Process_RunRecordTraceThread(LPVOID _threadIn
         fwrite(&file_header.bit_flags, sizeof(uint16_t), 1, pInfo->pTraceFile);
         vktrace_LogAlways("There are AS related functions in the trace file.");
     }
-    if (g_compressor && g_compressor->compress_packet_counter > 0) {
+    if (writer.GetCompressedPacketCount() > 0) {
         fseek(pInfo->pTraceFile, offsetof(vktrace_trace_file_header, compress_type), SEEK_SET);
         VKTRACE_COMPRESS_TYPE type = compressTypeConvert(g_settings.compressType);
         bytes_written = fwrite(&type, sizeof(uint16_t), 1, pInfo->pTraceFile);
     }
     fclose(pInfo->pTraceFile);
     pInfo->pTraceFile = NULL;
-    delete g_compressor;
 
     VKTRACE_DELETE(fileLikeSocket);
     vktrace_MessageStream_destroy(&pMessageStream);
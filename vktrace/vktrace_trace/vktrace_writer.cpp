@@ -0,0 +1,229 @@
+/*
+ *
+ * Copyright (C) 2016-2024 ARM Limited
+ * All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <chrono>
+#include <memory>
+
+#include "vktrace_writer.h"
+#include "compressor.h"
+
+// Packets are gathered into blocks of this size before being written.
+static const size_t kBlockSize = 4 * 1024 * 1024;
+// Received packets waiting to be compressed or written, Write() blocks above this.
+static const uint64_t kMaxPendingBytes = 256 * 1024 * 1024;
+
+TraceFileWriter::TraceFileWriter(FILE* pFile, VKTRACE_CRITICAL_SECTION* pFileLock, uint64_t fileOffset, bool compress,
+                                 uint64_t compressThreshold, uint32_t compressThreads, uint32_t flushInterval)
+    : m_pFile(pFile),
+      m_pFileLock(pFileLock),
+      m_fileOffset(fileOffset),
+      m_compress(compress),
+      m_compressThreshold(compressThreshold),
+      m_flushInterval(flushInterval),
+      m_pendingBytes(0),
+      m_exiting(false),
+      m_finished(false),
+      m_pCompressor(nullptr),
+      m_dirty(false),
+      m_writeErrorCount(0),
+      m_compressedPacketCount(0) {
+    m_block.reserve(kBlockSize);
+    if (m_compress) {
+        if (compressThreads == 0) {
+            m_pCompressor = create_compressor(VKTRACE_COMPRESS_TYPE_LZ4);
+        }
+        for (uint32_t i = 0; i < compressThreads; i++) {
+            m_compressThreads.emplace_back(&TraceFileWriter::CompressThread, this);
+        }
+    }
+    m_writerThread = std::thread(&TraceFileWriter::WriterThread, this);
+}
+
+TraceFileWriter::~TraceFileWriter() {
+    Finish();
+    delete m_pCompressor;
+}
+
+void TraceFileWriter::Write(vktrace_trace_packet_header* pHeader, bool recordOffset, bool flush) {
+    const uint64_t size = pHeader->size;
+    bool compress = m_compress && pHeader->size - sizeof(vktrace_trace_packet_header) > m_compressThreshold;
+    if (compress && m_compressThreads.empty()) {
+        Compress(pHeader, m_pCompressor);
+        compress = false;
+    }
+
+    Item* pItem = new Item{pHeader, size, recordOffset, flush, !compress};
+    std::unique_lock<std::mutex> lock(m_mutex);
+    // A packet bigger than the bound is let through once everything before it is written.
+    m_spaceCondition.wait(lock, [this, size] { return m_pendingBytes == 0 || m_pendingBytes + size <= kMaxPendingBytes; });
+    m_pending.push_back(pItem);
+    m_pendingBytes += size;
+    if (compress) {
+        m_compressQueue.push_back(pItem);
+        m_compressCondition.notify_one();
+    } else {
+        m_writeCondition.notify_one();
+    }
+}
+
+void TraceFileWriter::Finish() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_finished) {
+            return;
+        }
+        m_exiting = true;
+    }
+    // Compress threads drain their queue before they exit, after this every
+    // pending packet is ready to be written.
+    m_compressCondition.notify_all();
+    for (auto& thread : m_compressThreads) {
+        thread.join();
+    }
+    m_compressThreads.clear();
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_finished = true;
+    }
+    m_writeCondition.notify_all();
+    m_writerThread.join();
+}
+
+void TraceFileWriter::Compress(vktrace_trace_packet_header*& pHeader, compressor* pCompressor) {
+    const uint16_t packetId = pHeader->packet_id;
+    const bool alreadyCompressed = (pHeader->tracer_id == VKTRACE_TID_VULKAN_COMPRESSED);
+    if (compress_packet(pCompressor, pHeader) != 0) {
+        vktrace_LogError("Failed to compress the packet for packet_id = %hu", packetId);
+    } else if (!alreadyCompressed && pHeader->tracer_id == VKTRACE_TID_VULKAN_COMPRESSED) {
+        m_compressedPacketCount++;
+    }
+}
+
+void TraceFileWriter::CompressThread() {
+    std::unique_ptr<compressor> pCompressor(create_compressor(VKTRACE_COMPRESS_TYPE_LZ4));
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (true) {
+        m_compressCondition.wait(lock, [this] { return m_exiting || !m_compressQueue.empty(); });
+        if (m_compressQueue.empty()) {
+            break;
+        }
+        Item* pItem = m_compressQueue.front();
+        m_compressQueue.pop_front();
+        lock.unlock();
+
+        Compress(pItem->pHeader, pCompressor.get());
+
+        lock.lock();
+        pItem->ready = true;
+        if (pItem == m_pending.front()) {
+            m_writeCondition.notify_one();
+        }
+    }
+}
+
+void TraceFileWriter::WriterThread() {
+    auto frontReady = [this] { return m_finished || (!m_pending.empty() && m_pending.front()->ready); };
+    auto lastFlush = std::chrono::steady_clock::now();
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (true) {
+        if (m_pending.empty() || !m_pending.front()->ready) {
+            if (m_finished) {
+                break;
+            }
+            if (m_dirty) {
+                auto deadline = lastFlush + std::chrono::milliseconds(m_flushInterval);
+                if (!m_writeCondition.wait_until(lock, deadline, frontReady)) {
+                    lock.unlock();
+                    WriteBlock(true);
+                    lastFlush = std::chrono::steady_clock::now();
+                    lock.lock();
+                }
+            } else {
+                m_writeCondition.wait(lock, frontReady);
+            }
+            continue;
+        }
+
+        Item* pItem = m_pending.front();
+        m_pending.pop_front();
+        lock.unlock();
+
+        WriteItem(*pItem);
+        if (pItem->flush) {
+            WriteBlock(true);
+            lastFlush = std::chrono::steady_clock::now();
+        }
+        const uint64_t size = pItem->size;
+        vktrace_delete_trace_packet_no_lock(&pItem->pHeader);
+        delete pItem;
+
+        lock.lock();
+        m_pendingBytes -= size;
+        m_spaceCondition.notify_all();
+    }
+    lock.unlock();
+    WriteBlock(true);
+}
+
+void TraceFileWriter::WriteItem(const Item& item) {
+    if (item.recordOffset) {
+        m_recordedOffsets.push_back(m_fileOffset);
+    }
+    const size_t size = (size_t)item.pHeader->size;
+    if (size >= kBlockSize) {
+        // Don't copy big packets into the block.
+        WriteBlock(false);
+        vktrace_enter_critical_section(m_pFileLock);
+        size_t written = fwrite(item.pHeader, 1, size, m_pFile);
+        vktrace_leave_critical_section(m_pFileLock);
+        if (written != size) {
+            vktrace_LogError("Failed to write the packet for packet_id = %hu", item.pHeader->packet_id);
+            m_writeErrorCount++;
+        }
+    } else {
+        const char* pData = reinterpret_cast<const char*>(item.pHeader);
+        m_block.insert(m_block.end(), pData, pData + size);
+        if (m_block.size() >= kBlockSize) {
+            WriteBlock(false);
+        }
+    }
+    m_fileOffset += size;
+    m_dirty = true;
+}
+
+void TraceFileWriter::WriteBlock(bool flush) {
+    if (m_block.empty() && !(flush && m_dirty)) {
+        return;
+    }
+    vktrace_enter_critical_section(m_pFileLock);
+    if (!m_block.empty()) {
+        size_t written = fwrite(m_block.data(), 1, m_block.size(), m_pFile);
+        if (written != m_block.size()) {
+            vktrace_LogError("Failed to write %zu bytes of packets to the trace file.", m_block.size());
+            m_writeErrorCount++;
+        }
+        m_block.clear();
+    }
+    if (flush) {
+        fflush(m_pFile);
+        m_dirty = false;
+    }
+    vktrace_leave_critical_section(m_pFileLock);
+}
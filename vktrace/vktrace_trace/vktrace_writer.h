@@ -0,0 +1,117 @@
+/*
+ *
+ * Copyright (C) 2016-2024 ARM Limited
+ * All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+extern "C" {
+#include "vktrace_platform.h"
+#include "vktrace_trace_packet_utils.h"
+}
+
+class compressor;
+
+// Writes the packets received by a recording thread to the trace file.
+//
+// The recording thread only receives packets from the socket and hands them
+// over with Write(). Packets bigger than the compression threshold are
+// compressed by a pool of worker threads, a single writer thread puts the
+// packets back in their original order, gathers them into large blocks and
+// writes the blocks to the file. The file is flushed at frame boundaries and
+// when nothing has been flushed for flushInterval milliseconds, not after
+// every packet.
+//
+// The amount of received but not yet written packet data is bounded. When the
+// bound is reached Write() blocks, so a slow disk still back-pressures the
+// traced application instead of using up the memory.
+class TraceFileWriter {
+   public:
+    // compressThreads == 0 compresses on the calling thread.
+    TraceFileWriter(FILE* pFile, VKTRACE_CRITICAL_SECTION* pFileLock, uint64_t fileOffset, bool compress,
+                    uint64_t compressThreshold, uint32_t compressThreads, uint32_t flushInterval);
+    ~TraceFileWriter();
+
+    TraceFileWriter(const TraceFileWriter&) = delete;
+    TraceFileWriter& operator=(const TraceFileWriter&) = delete;
+
+    // Takes ownership of pHeader. If recordOffset is true, the file offset of
+    // the packet is added to GetRecordedOffsets(). If flush is true the file
+    // is flushed once the packet is written.
+    void Write(vktrace_trace_packet_header* pHeader, bool recordOffset, bool flush);
+
+    // Write all pending packets, flush the file and stop the threads. The
+    // file can be used directly after this.
+    void Finish();
+
+    // Valid after Finish().
+    uint64_t GetFileOffset() const { return m_fileOffset; }
+    const std::vector<uint64_t>& GetRecordedOffsets() const { return m_recordedOffsets; }
+    uint64_t GetCompressedPacketCount() const { return m_compressedPacketCount.load(); }
+    uint64_t GetWriteErrorCount() const { return m_writeErrorCount; }
+
+   private:
+    struct Item {
+        vktrace_trace_packet_header* pHeader;
+        uint64_t size;  // as received, before compression
+        bool recordOffset;
+        bool flush;
+        bool ready;
+    };
+
+    void CompressThread();
+    void WriterThread();
+    void Compress(vktrace_trace_packet_header*& pHeader, compressor* pCompressor);
+    void WriteItem(const Item& item);
+    void WriteBlock(bool flush);
+
+    FILE* m_pFile;
+    VKTRACE_CRITICAL_SECTION* m_pFileLock;
+    uint64_t m_fileOffset;
+    bool m_compress;
+    uint64_t m_compressThreshold;
+    uint32_t m_flushInterval;
+
+    std::mutex m_mutex;
+    std::condition_variable m_compressCondition;
+    std::condition_variable m_writeCondition;
+    std::condition_variable m_spaceCondition;
+    std::deque<Item*> m_pending;        // submission order
+    std::deque<Item*> m_compressQueue;  // waiting for a compress thread
+    uint64_t m_pendingBytes;
+    bool m_exiting;
+    bool m_finished;
+
+    std::vector<std::thread> m_compressThreads;
+    std::thread m_writerThread;
+    compressor* m_pCompressor;  // used when there is no compress thread
+
+    // Only used by the writer thread until Finish() returns.
+    std::vector<char> m_block;
+    bool m_dirty;
+    std::vector<uint64_t> m_recordedOffsets;
+    uint64_t m_writeErrorCount;
+
+    std::atomic<uint64_t> m_compressedPacketCount;
+};
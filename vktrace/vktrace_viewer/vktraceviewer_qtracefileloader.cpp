@@ -71,6 +71,11 @@ void vktraceviewer_QTraceFileLoader::loadTraceFile(const QString& filename) {
                                        .arg(m_traceFileInfo.pHeader->trace_file_version)
                                        .arg(VKTRACE_TRACE_FILE_VERSION_MINIMUM_COMPATIBLE));
                 bOpened = false;
+            } else if (m_traceFileInfo.pHeader->bit_flags & ~VKTRACE_KNOWN_FILE_HEADER_FLAGS) {
+                emit OutputMessage(VKTRACE_LOG_ERROR,
+                                   QString("Trace file has unknown flags 0x%1.\nYou'll need a newer viewer.")
+                                       .arg(m_traceFileInfo.pHeader->bit_flags & ~VKTRACE_KNOWN_FILE_HEADER_FLAGS, 0, 16));
+                bOpened = false;
             }
         }
 #if defined(USE_STATIC_CONTROLLER_LIBRARY)